@@ -1,7 +1,7 @@
 # Requires usd-core Python Package.
 
 from pxr import Usd, UsdGeom, Sdf, Gf, UsdSkel
-import argparse, struct
+import argparse, struct, sys
 from tqdm import tqdm
 from pathlib import Path
 
@@ -69,7 +69,7 @@ def find_binding_matching_mesh(bindings, mesh):
                 return b, True
     return None, False
 
-def parse_scene(filepath, scale):
+def parse_scene(filepath, scale, legacy, output=None):
 
     scene_data = {"models": {}}
     total_models = 0
@@ -80,7 +80,8 @@ def parse_scene(filepath, scale):
     scale_constant = scale
 
     total_prims = 0
-    print("Finding prim count...")
+    # Progress goes to stderr, stdout may be carrying the .mp itself
+    print("Finding prim count...", file=sys.stderr)
 
     for prim in Usd.PrimRange(stage.GetPseudoRoot(), Usd.TraverseInstanceProxies()):
 
@@ -246,57 +247,128 @@ def parse_scene(filepath, scale):
             pbar.set_postfix_str(f"current model: {current_index}")
 
     # Pack data into buffer
-    name = Path(filepath).stem
+    if output is None:
+        output = f"{Path(filepath).stem}.mp"
 
-    with open(f"{name}.mp", "wb") as f:
+    # Written strictly front to back, so "-" can pipe straight into the renderer
+    if output == "-":
+        write_mp(sys.stdout.buffer, scene_data["models"], legacy)
+        sys.stdout.buffer.flush()
+    else:
+        with open(output, "wb") as f:
+            write_mp(f, scene_data["models"], legacy)
 
-        # Add Verification bytes (0x4D50) (MP in Hex)
-        f.write(struct.pack('<h', 0x4D50))
+    return 0
 
-        # Add object count
-        f.write(struct.pack('<I', total_models))
 
-        # Add object pointers
-        offset = 0
+def write_mp(f, models, legacy):
+    if legacy:
+        write_mp_v1(f, models)
+    else:
+        write_mp_v2(f, models)
 
-        for x in scene_data["models"]:
-            f.write(struct.pack('<I', offset))
-            object_header = 16
-            vertices = 4 * 3 * scene_data["models"][x]["vertex_count"]      # float * 3 per vertex
-            indices = 2 * scene_data["models"][x]["indices_count"]          # uint16t per index
-            normals = 4 * 3 * scene_data["models"][x]["normals_count"]      # float * 3 per normal
-            instances = 4 * 16 * scene_data["models"][x]["instance_count"]  # float * 16 per matrix
 
-            offset += object_header + vertices + indices + normals + instances
+def write_mp_v1(f, models):
 
-        # Add objects
-        for x in scene_data["models"]:
+    for x in models:
+        if models[x]["vertex_count"] > 65535:
+            raise ValueError(f"{x} has {models[x]['vertex_count']} vertices, v1 files only hold uint16 indices. Write v2 instead.")
 
-            # Write object header
-            f.write(struct.pack(
-                '<4I',
-                scene_data["models"][x]["vertex_count"],
-                scene_data["models"][x]["indices_count"],
-                scene_data["models"][x]["normals_count"],
-                scene_data["models"][x]["instance_count"]))
+    # Add Verification bytes (0x4D50) (MP in Hex)
+    f.write(struct.pack('<h', 0x4D50))
 
-            # Write vertices
-            f.write(struct.pack(f'<{scene_data["models"][x]["vertex_count"] * 3}f',
-                                *scene_data["models"][x]["vertices"]))
+    # Add object count
+    f.write(struct.pack('<I', len(models)))
 
-            # Write indices
-            f.write(struct.pack(f'<{scene_data["models"][x]["indices_count"]}H',
-                                *scene_data["models"][x]["indices"]))
+    # Add object pointers
+    offset = 0
 
-            # Write normals
-            f.write(struct.pack(f'<{scene_data["models"][x]["normals_count"] * 3}f',
-                                *scene_data["models"][x]["normals"]))
+    for x in models:
+        f.write(struct.pack('<I', offset))
+        object_header = 16
+        vertices = 4 * 3 * models[x]["vertex_count"]      # float * 3 per vertex
+        indices = 2 * models[x]["indices_count"]          # uint16t per index
+        normals = 4 * 3 * models[x]["normals_count"]      # float * 3 per normal
+        instances = 4 * 16 * models[x]["instance_count"]  # float * 16 per matrix
 
-            # Write instance matrices
-            for y in scene_data["models"][x]["instances"]:
-                f.write(struct.pack('<16f', *y))
+        offset += object_header + vertices + indices + normals + instances
 
-    return 0
+        if offset > 0xFFFFFFFF:
+            raise ValueError("Scene is over 4 GB, v1 files only hold uint32 pointers. Write v2 instead.")
+
+    # Add objects
+    for x in models:
+
+        # Write object header
+        f.write(struct.pack(
+            '<4I',
+            models[x]["vertex_count"],
+            models[x]["indices_count"],
+            models[x]["normals_count"],
+            models[x]["instance_count"]))
+
+        write_object_arrays(f, models[x], 'H')
+
+
+def write_mp_v2(f, models):
+
+    # Header: magic, v1 count escape, version, flags, reserved, object count
+    f.write(struct.pack('<HIHII', 0x4D50, 0xFFFFFFFF, 2, 0, 0))
+    f.write(struct.pack('<Q', len(models)))
+
+    # Add absolute object offsets
+    offset = 24 + 8 * len(models)
+
+    for x in models:
+        f.write(struct.pack('<Q', offset))
+        index_width = 4 if models[x]["vertex_count"] > 65535 else 2
+        object_header = 24 + (24 if models[x]["vertex_count"] > 0 else 0)  # bounds only when there are vertices
+        vertices = 4 * 3 * models[x]["vertex_count"]
+        indices = index_width * models[x]["indices_count"]
+        normals = 4 * 3 * models[x]["normals_count"]
+        instances = 4 * 16 * models[x]["instance_count"]
+
+        offset += object_header + vertices + indices + normals + instances
+
+    # Add objects
+    for x in models:
+        model = models[x]
+        index_width = 4 if model["vertex_count"] > 65535 else 2
+        has_bounds = model["vertex_count"] > 0
+
+        # Write object header: counts, index width, encoding, flags, reserved
+        f.write(struct.pack(
+            '<4IBBHI',
+            model["vertex_count"],
+            model["indices_count"],
+            model["normals_count"],
+            model["instance_count"],
+            index_width, 0, 1 if has_bounds else 0, 0))
+
+        # Write local bounds (min xyz, max xyz)
+        if has_bounds:
+            points = model["vertices"]
+            f.write(struct.pack('<6f',
+                                min(points[0::3]), min(points[1::3]), min(points[2::3]),
+                                max(points[0::3]), max(points[1::3]), max(points[2::3])))
+
+        write_object_arrays(f, model, 'I' if index_width == 4 else 'H')
+
+
+def write_object_arrays(f, model, index_format):
+
+    # Write vertices
+    f.write(struct.pack(f'<{model["vertex_count"] * 3}f', *model["vertices"]))
+
+    # Write indices
+    f.write(struct.pack(f'<{model["indices_count"]}{index_format}', *model["indices"]))
+
+    # Write normals
+    f.write(struct.pack(f'<{model["normals_count"] * 3}f', *model["normals"]))
+
+    # Write instance matrices
+    for y in model["instances"]:
+        f.write(struct.pack('<16f', *y))
 
 
 def main():
@@ -317,8 +389,21 @@ def main():
         type=float,
         help="The scale all meshes will be increased by.",
     )
+    parser.add_argument(
+        "--v1",
+        action="store_true",
+        dest="legacy",
+        help="Write the old v1 format (uint16 indices, 4 GB limit) for older renderer builds.",
+    )
+    parser.add_argument(
+        "--o",
+        "--output",
+        dest="output",
+        type=str,
+        help="Where to write the .mp, defaults to <usd name>.mp. Use - to write to stdout.",
+    )
     opts = parser.parse_args()
-    result = parse_scene(opts.filepath, opts.scale)
+    result = parse_scene(opts.filepath, opts.scale, opts.legacy, opts.output)
 
 
 if __name__ == "__main__":
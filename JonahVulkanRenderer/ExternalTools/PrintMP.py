@@ -1,21 +1,33 @@
 import struct,argparse
 
 """
-(dev.mp) Binary Format
+(dev.mp) Binary Format, see README.md for details
 
-Header
+v1 Header
 0x00  uint16    Verification bytes (0x4D50) (MP in Hex)
 0x02  uint32    # of Objects
-0x06  uint32[]  object pointers
-...   Object[]  object data
+0x06  uint32[]  object pointers (relative to the end of the pointer table)
+
+v2 Header
+0x00  uint16    Verification bytes (0x4D50) (MP in Hex)
+0x02  uint32    0xFFFFFFFF (marks a versioned header)
+0x06  uint16    Version (2)
+0x08  uint32    Flags
+0x0C  uint32    Reserved
+0x10  uint64    # of Objects
+0x18  uint64[]  object offsets (from the start of the file)
+...   Tile table when flags bit 0 is set: uint64 tile count, uint64 entry count, tiles, entries
 
 Object
 0x00  uint32      # of Vertices ( [x,y,z] = 1 )
 0x04  uint32      # of Indices
 0x08  uint32      # of Normals  ( [x,y,z] = 1 )
 0x0C  uint32      # of Instances ( 1 Mat4 per instance )
+(v2)  uint8       Index width (2 or 4 bytes), uint8 encoding, uint16 flags, uint32 reserved
+(v2)  float[6]    Local bounds min/max, only when flags bit 0 is set
+(v2)  uint64 x 2  Packed and unpacked byte size, only when encoding is 1. The packed bytes replace the arrays below
 ...   float[]     Vertices [x,y,z,x,y,z,...]
-...   uint16[]    Indices  [0,1,2,3,...]
+...   uint16[]    Indices  [0,1,2,3,...] (uint32 when index width is 4)
 ...   float[]     Normals  [x,y,z,x,y,z,...] // 1 normal per vertex
 ...   mat4[]      Instance Matrices (row-major order) (mat4 = float x 16)
 
@@ -43,7 +55,7 @@ def main():
     with open(opts.filepath, "rb") as f:
         verification_bytes = struct.unpack("<h", f.read(2))[0]
         object_count = struct.unpack("<I", f.read(4))[0]
-        pointers = struct.unpack(f"<{object_count}I", f.read(object_count * 4))
+        version = 1
 
         print(f"Verification bytes: {hex(verification_bytes)}")
 
@@ -51,28 +63,69 @@ def main():
             print("Verification failed, first 4 bytes of .mp should be 0x4D50.")
             return
 
+        if object_count == 0xFFFFFFFF:
+            version, flags, _ = struct.unpack("<HII", f.read(10))
+            object_count = struct.unpack("<Q", f.read(8))[0]
+            pointers = struct.unpack(f"<{object_count}Q", f.read(object_count * 8))
+            print(f"Version: {version}, Flags: {hex(flags)}")
+
+            if flags & 1:
+                tile_count, entry_count = struct.unpack("<2Q", f.read(16))
+                print(f"Tiles: {tile_count}, Tile entries: {entry_count}")
+                tiles = [struct.unpack("<6fQII", f.read(40)) for _ in range(tile_count)]
+                entries = [struct.unpack("<3I", f.read(12)) for _ in range(entry_count)]
+
+                if opts.verbose:
+                    for t, tile in enumerate(tiles):
+                        print(f"Tile {t}: min {tile[0:3]}, max {tile[3:6]}")
+                        for object_index, first, count in entries[tile[6]:tile[6] + tile[7]]:
+                            print(f"    Object {object_index}: instances {first} to {first + count - 1}")
+        else:
+            pointers = struct.unpack(f"<{object_count}I", f.read(object_count * 4))
+            table_end = 6 + 4 * object_count
+            pointers = [table_end + p for p in pointers]
+            print("Version: 1")
+
         print(f"Object count: {object_count}")
         print(f"Pointers: {pointers}")
 
         for x in range(0, object_count):
 
+            f.seek(pointers[x])
+
             if opts.verbose:
                 print(f"Object {x} printout --")
 
-            num_vertices = struct.unpack("<I", f.read(4))[0]
-            num_indices = struct.unpack("<I", f.read(4))[0]
-            num_normals = struct.unpack("<I", f.read(4))[0]
-            num_instances = struct.unpack("<I", f.read(4))[0]
+            num_vertices, num_indices, num_normals, num_instances = struct.unpack("<4I", f.read(16))
+            index_width = 2
+            encoding = 0
+            bounds = None
+
+            if version >= 2:
+                index_width, encoding, object_flags, _ = struct.unpack("<BBHI", f.read(8))
+                if object_flags & 1:
+                    bounds = struct.unpack("<6f", f.read(24))
 
             if opts.verbose:
                 print(f"""Vertices: {num_vertices}, Indices: {num_indices}, 
-                      Normals: {num_normals}, Instances: {num_instances}""")
+                      Normals: {num_normals}, Instances: {num_instances}, Index width: {index_width}""")
             else:
                 print(f"""Object {x}: Vertices: {num_vertices}, Indices: {num_indices}, 
-                      Normals: {num_normals}, Instances: {num_instances}""")
+                      Normals: {num_normals}, Instances: {num_instances}, Index width: {index_width}""")
+
+            if bounds is not None:
+                print(f"Bounds: min {bounds[0:3]}, max {bounds[3:6]}")
+
+            # Packed arrays are only decoded by the renderer, sizes are all this prints
+            if encoding == 1:
+                packed_size, unpacked_size = struct.unpack("<2Q", f.read(16))
+                print(f"Packed: {packed_size} bytes ({unpacked_size} bytes unpacked)")
+                continue
+
+            index_format = "I" if index_width == 4 else "H"
 
             vertices = struct.unpack(f"<{num_vertices * 3}f", f.read(num_vertices * 3 * 4))
-            indices = struct.unpack(f"<{num_indices}H", f.read(num_indices * 2))
+            indices = struct.unpack(f"<{num_indices}{index_format}", f.read(num_indices * index_width))
             normals = struct.unpack(f"<{num_normals * 3}f", f.read(num_normals * 3 * 4))
 
             if opts.verbose:
@@ -1,4 +1,5 @@
 C:/VulkanSDK/1.4.313.2/Bin/glslc.exe shader.vert -o vert.spv
+C:/VulkanSDK/1.4.313.2/Bin/glslc.exe -DDEPTH_ONLY shader.vert -o depth.spv
 C:/VulkanSDK/1.4.313.2/Bin/glslc.exe shader.frag -o frag.spv
 C:/VulkanSDK/1.4.313.2/Bin/glslc.exe cull.comp -o cull.spv
 pause
\ No newline at end of file
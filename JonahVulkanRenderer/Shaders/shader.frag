@@ -1,14 +1,23 @@
 #version 450
 
 layout(location = 0) in vec4 in_position;
-layout(location = 1) in vec3 in_color;
-layout(location = 2) in vec3 in_normal;
-layout(location = 3) in vec3 in_camera_position;
+layout(location = 1) in vec3 in_normal;
+layout(location = 2) in vec3 in_camera_position;
+
+// One per draw command, MaterialData in VkCommon.h
+struct Material {
+    vec4 color;
+};
+
+layout(std430, binding = 4) readonly buffer Materials {
+    Material materials[ ];
+};
 
 layout(push_constant) uniform LightData{
     vec4 light_color;
     vec4 light_position;
     vec4 light_mode;
+    uint draw_index;
 } light_data;
 
 layout(location = 0) out vec4 out_color;
@@ -41,6 +50,6 @@ void main() {
     vec3 lighting = ambient * 0 + diffuse * 1 + specular * 1;
 
     // Rendering
-    vec3 model_color = in_color;
+    vec3 model_color = materials[light_data.draw_index].color.rgb;
     out_color = vec4(model_color * lighting, 1.0);
 }
\ No newline at end of file
@@ -1,5 +1,8 @@
 #version 450
 
+// Built twice by compile.bat: vert.spv for the shaded pass and, with DEPTH_ONLY, depth.spv for depth only passes.
+// Depth only reads the position stream (binding 0) alone, the attribute stream is never bound.
+
 // -- Data --
 
 layout(binding = 0) uniform UniformBufferObject{
@@ -7,46 +10,122 @@ layout(binding = 0) uniform UniformBufferObject{
     mat4 proj;
 } ubo;
 
-struct Instance
-{
-	mat4 model;
-	vec4 array_index;
-};
-layout(std140, binding = 1) readonly buffer InstanceData {
-    Instance instance_data[ ];
+// 0: 3 rows of the affine model matrix, 1: position, half scale and snorm16 quaternion (VkCommon.h)
+layout(constant_id = 0) const uint INSTANCE_FORMAT = 0;
+
+layout(std430, binding = 1) readonly buffer InstanceData {
+    uvec4 instance_data[ ];
 };
 
 layout(std430, binding = 3) readonly buffer ShouldDraw {
     uint should_draw[ ];
 };
 
+// 0: float position and normal, 1: unorm16 position in the mesh box and octahedral snorm16 normal (VkVertexFormat.h)
+layout(constant_id = 1) const uint VERTEX_FORMAT = 0;
+
+// One per draw command, MeshDecodeData in VkCommon.h
+struct MeshDecode {
+    vec3 offset;
+    uint first_vertex;
+    vec3 scale;
+    uint vertex_count;
+};
+
+layout(std430, binding = 5) readonly buffer MeshDecodes {
+    MeshDecode mesh_decode[ ];
+};
+
+// Same block as shader.frag, only draw_index is used here
+layout(push_constant) uniform LightData{
+    vec4 light_color;
+    vec4 light_position;
+    vec4 light_mode;
+    uint draw_index;
+} light_data;
+
 layout(location = 0) in vec3 in_position;
-layout(location = 1) in vec3 in_color;
-layout(location = 2) in vec3 in_normal;
+
+// Both builds must place vertices identically, or the shaded pass would fail the pre-pass depth test
+invariant gl_Position;
+
+#ifndef DEPTH_ONLY
+layout(location = 1) in vec3 in_normal;
 
 layout(location = 0) out vec4 out_position;
-layout(location = 1) out vec3 out_color;
-layout(location = 2) out flat vec3 out_normal;
-layout(location = 3) out vec3 out_camera_pos;
+layout(location = 1) out flat vec3 out_normal;
+layout(location = 2) out vec3 out_camera_pos;
+#endif
+
+// -- Helper functions --
+
+mat3 quaternion_to_matrix(vec4 q){
+    vec3 q2 = q.xyz * 2.0;
+    float xx = q.x * q2.x, yy = q.y * q2.y, zz = q.z * q2.z;
+    float xy = q.x * q2.y, xz = q.x * q2.z, yz = q.y * q2.z;
+    float wx = q.w * q2.x, wy = q.w * q2.y, wz = q.w * q2.z;
+
+    return mat3(
+        1.0 - (yy + zz), xy + wz, xz - wy,
+        xy - wz, 1.0 - (xx + zz), yz + wx,
+        xz + wy, yz - wx, 1.0 - (xx + yy));
+}
+
+mat4 load_model_matrix(uint index){
+    if(INSTANCE_FORMAT == 1){
+        uvec4 first = instance_data[index * 2];
+        uvec4 second = instance_data[index * 2 + 1];
+
+        vec3 scale = vec3(unpackHalf2x16(first.w), unpackHalf2x16(second.x).x);
+        mat3 rotation = quaternion_to_matrix(normalize(vec4(unpackSnorm2x16(second.y), unpackSnorm2x16(second.z))));
+
+        return mat4(
+            vec4(rotation[0] * scale.x, 0.0),
+            vec4(rotation[1] * scale.y, 0.0),
+            vec4(rotation[2] * scale.z, 0.0),
+            vec4(uintBitsToFloat(first.xyz), 1.0));
+    }
+
+    vec4 row_0 = uintBitsToFloat(instance_data[index * 3]);
+    vec4 row_1 = uintBitsToFloat(instance_data[index * 3 + 1]);
+    vec4 row_2 = uintBitsToFloat(instance_data[index * 3 + 2]);
+
+    return transpose(mat4(row_0, row_1, row_2, vec4(0.0, 0.0, 0.0, 1.0)));
+}
+
+vec3 oct_decode(vec2 encoded){
+    vec3 normal = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+    float fold = max(-normal.z, 0.0);
+    normal.xy += mix(vec2(fold), vec2(-fold), greaterThanEqual(normal.xy, vec2(0.0)));
+    return normalize(normal);
+}
 
 // -- Main --
 
 void main() {
 
+    vec3 position = in_position;
+    if(VERTEX_FORMAT == 1){
+        MeshDecode decode = mesh_decode[light_data.draw_index];
+        position = decode.offset + in_position * decode.scale;
+    }
+
     // Culling 
 
-    mat4 instance_model_matrix = instance_data[gl_InstanceIndex].model;
+    mat4 instance_model_matrix = load_model_matrix(uint(gl_InstanceIndex));
 
     if(should_draw[gl_InstanceIndex] == 0){
         gl_Position = vec4(0,0,0,0);
     }else{
-        vec4 position = ubo.proj * ubo.view * instance_model_matrix * vec4(in_position, 1.0);
-        gl_Position = position;
+        gl_Position = ubo.proj * ubo.view * instance_model_matrix * vec4(position, 1.0);
     }
 
+#ifndef DEPTH_ONLY
+    vec3 normal = VERTEX_FORMAT == 1 ? oct_decode(in_normal.xy) : in_normal;
+
     // Setup fragment shader
-    out_position = ubo.view * instance_model_matrix * vec4(in_position, 1.0);
-    out_color = in_color;
-    out_normal = mat3(instance_model_matrix) * in_normal;
+    out_position = ubo.view * instance_model_matrix * vec4(position, 1.0);
+    out_normal = mat3(instance_model_matrix) * normal;
     out_camera_pos = inverse(ubo.view)[3].xyz;
+#endif
 }
\ No newline at end of file
@@ -1,8 +1,13 @@
 #include "Application.h"
 #include "../MP Loader/MP_Parser.h"
+#include "../MP Loader/MP_Cooked.h"
+#include "../MP Loader/MP_Dedup.h"
+#include "../Util/MemoryStats.h"
 #include "Camera.h"
 
 #include <iostream>
+#include <chrono>
+#include <filesystem>
 
 #include <ImGui/imgui.h>
 #include <ImGui/imgui_impl_glfw.h>
@@ -10,32 +15,77 @@
 
 namespace game {
 
-Application::Application() {
+namespace {
+
+	// Pipes, FIFOs and stdin can only be read once front to back, so they skip the validity check and cooked cache.
+	bool IsStreamSource(const std::string& MP_FilePath) {
+		std::error_code error;
+		return MP_FilePath == "-" || (std::filesystem::exists(MP_FilePath, error) && !std::filesystem::is_regular_file(MP_FilePath, error));
+	}
+
+} // namespace unnamed
+
+Application::Application(std::string MP_FilePath, bool Progressive, std::optional<glm::vec3> Focus, std::string LibraryPath, bool Watch, renderer::VERTEXFORMAT VertexFormat) {
 	last_frame_time = static_cast<float>(glfwGetTime());;
 
 	renderer = new renderer::Renderer(960,540);
+	renderer->SetVertexFormat(VertexFormat);
 
-	std::string mp_file_name;
-	std::cout << "Type the name of the .mp you would like to render. Scene file must be in the Assets folder." << std::endl;
-	std::cout << "File name: ";
-	std::cin >> mp_file_name;
+	if (!LibraryPath.empty()) {
+		library = std::make_unique<MP::GeometryLibrary>(LibraryPath);
+		std::cout << "Geometry library " << LibraryPath << " has " << library->GetMeshCount() << " meshes." << std::endl;
+	}
+
+	std::string mp_file_path = MP_FilePath;
+
+	if (!mp_file_path.empty() && !IsStreamSource(mp_file_path) && MP::CheckValidMP(mp_file_path) == false) {
+		std::cout << "Warning: " << mp_file_path << " is missing or not a valid .mp file." << std::endl;
+		mp_file_path.clear();
+	}
 
-	while (MP::CheckValidMP("Assets/" + mp_file_name) == false) {
-		std::cout << "Warning: File missing from Assets folder or not valid .mp file." << std::endl;
-		std::cout << "Try again, file name: ";
+	if (mp_file_path.empty()) {
+		std::string mp_file_name;
+		std::cout << "Type the name of the .mp you would like to render, or - to read it from stdin. Scene file must be in the Assets folder." << std::endl;
+		std::cout << "File name: ";
 		std::cin >> mp_file_name;
-	};
 
-	std::vector<renderer::MeshInstances> model_set = MP::ParseMP("Assets/" + mp_file_name, false);
+		while (mp_file_name != "-" && MP::CheckValidMP("Assets/" + mp_file_name) == false) {
+			std::cout << "Warning: File missing from Assets folder or not valid .mp file." << std::endl;
+			std::cout << "Try again, file name: ";
+			std::cin >> mp_file_name;
+		};
+
+		mp_file_path = mp_file_name == "-" ? mp_file_name : "Assets/" + mp_file_name;
+	}
+
+	// A pipe can only be read front to back, so it always loads whole
+	glm::vec3 scene_root;
+	if (Watch && !IsStreamSource(mp_file_path)) {
+		// Watching first, so a save during the first load is not missed
+		watcher = std::make_unique<MP::FileWatcher>(mp_file_path);
+		renderer->SetReloadTracking(true);
+		ReloadScene(mp_file_path);
+		scene_root = renderer->GetSceneRoot();
 
-	renderer->UpdateModelSet(model_set,true);
+		std::cout << "Watching " << mp_file_path << " for changes (" << watcher->GetBackendName() << ")." << std::endl;
+	}
+	else if (Progressive && !IsStreamSource(mp_file_path)) {
+		scene_root = StartProgressiveLoad(mp_file_path, Focus);
+	}
+	else if (library) {
+		SwitchScene(mp_file_path);
+		scene_root = renderer->GetSceneRoot();
+	}
+	else {
+		LoadScene(mp_file_path);
+		std::cout << "Model set updated." << std::endl;
+		scene_root = renderer->GetSceneRoot();
+	}
 
-	std::cout << "Model set updated." << std::endl;
 	window = renderer->Get_Window();
 	camera = new Camera(window);
 	renderer->AddObserver(camera);
 
-	glm::vec3 scene_root = renderer->GetSceneRoot();
 	camera->SetPosition(scene_root);
 	camera_position = scene_root;
 	std::cout << "Scene Root is: " << scene_root.x << "," << scene_root.y << "," << scene_root.z << std::endl;
@@ -57,6 +107,144 @@ Application::~Application() {
 	delete camera;
 }
 
+// Warm starts upload straight from the cooked cache file, cold starts parse the .mp and write the cache for next time.
+// Stream sources are parsed as they arrive and never cached.
+// Parsed geometry goes from the set straight into staging memory (SceneParser without CopyGeometry), so peak memory
+// stays near one copy of the decoded scene plus a staging chunk.
+void Application::LoadScene(std::string MP_FilePath) {
+	auto start = std::chrono::high_resolution_clock::now();
+	auto elapsed_ms = [&] { return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - start).count(); };
+
+	// Windows can not reset the peak, there an earlier higher peak (renderer startup) is reported instead
+	util::ResetPeakResidentBytes();
+	uint64_t resident_before = util::GetCurrentResidentBytes();
+	auto peak_growth_mb = [&] {
+		uint64_t peak = util::GetPeakResidentBytes();
+		return util::BytesToMegabytes(peak > resident_before ? peak - resident_before : 0);
+	};
+
+	// Parsed while it arrives, there is no file to hash for the cache
+	if (IsStreamSource(MP_FilePath)) {
+		std::unique_ptr<MP::ByteSource> source = MP::OpenByteSource(MP_FilePath);
+		renderer::ModelSet model_set = MP::ParseMPStream(*source);
+		MP::DeduplicateMeshes(model_set).Print();
+		renderer::scene::SceneParser parser = renderer::scene::SceneParser(model_set, false, true);
+		renderer->UpdateScene(parser, true);
+		std::cout << "Streamed " << (MP_FilePath == "-" ? "stdin" : MP_FilePath) << " in " << elapsed_ms() << "ms, peak RSS growth " << peak_growth_mb() << " MB." << std::endl;
+		return;
+	}
+
+	uint64_t source_hash = MP::HashMP(MP_FilePath);
+	std::string cooked_path = MP::GetCookedPath(source_hash);
+
+	if (MP::CheckValidCooked(cooked_path, source_hash)) {
+		MP::CookedScene cooked_scene(cooked_path, source_hash);
+		renderer->UpdateScene(cooked_scene.GetSceneView(), true);
+		std::cout << "Loaded cooked scene " << cooked_path << " in " << elapsed_ms() << "ms, peak RSS growth " << peak_growth_mb() << " MB." << std::endl;
+		return;
+	}
+
+	renderer::ModelSet model_set = MP::ParseMP(MP_FilePath, false);
+	if (MP::HasMeshReferences(model_set)) {
+		throw std::runtime_error(MP_FilePath + " takes its meshes from a geometry library, open it with --library.");
+	}
+	MP::DeduplicateMeshes(model_set).Print();
+	renderer::scene::SceneParser parser = renderer::scene::SceneParser(model_set, false, true);
+	renderer->UpdateScene(parser, true);
+	std::cout << "Parsed " << MP_FilePath << " in " << elapsed_ms() << "ms, peak RSS growth " << peak_growth_mb() << " MB for ";
+	std::cout << util::BytesToMegabytes(model_set.arena_size) << " MB of decoded scene." << std::endl;
+
+	try {
+		MP::WriteCookedScene(cooked_path, source_hash, parser);
+	}
+	catch (const std::exception& e) {
+		std::cout << "Warning: Could not write cooked scene, next launch will parse again. " << e.what() << std::endl;
+	}
+}
+
+// Meshes shared with the scenes loaded before stay on the GPU, see Renderer::SwitchScene. Never cooked, the cache
+// would copy the library geometry into every scene.
+void Application::SwitchScene(std::string MP_FilePath) {
+	auto start = std::chrono::high_resolution_clock::now();
+
+	renderer::ModelSet model_set = MP::ParseMP(MP_FilePath, false);
+	if (MP::HasMeshReferences(model_set)) {
+		if (!library) {
+			throw std::runtime_error(MP_FilePath + " takes its meshes from a geometry library, open it with --library.");
+		}
+		library->Resolve(model_set);
+	}
+	MP::DeduplicateMeshes(model_set).Print();
+
+	renderer::Renderer::SwitchStats stats = renderer->SwitchScene(model_set);
+
+	auto elapsed_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - start).count();
+	std::cout << "Switched to " << MP_FilePath << " in " << elapsed_ms << "ms: uploaded " << stats.uploaded_meshes << " meshes (" << util::BytesToMegabytes(stats.uploaded_bytes) << " MB), ";
+	std::cout << stats.reused_draws << " draws reused resident meshes, " << util::BytesToMegabytes(stats.resident_bytes) << " MB of geometry resident." << std::endl;
+}
+
+// Every mesh gets a content key, so the renderer can tell which meshes are already on the GPU and only the edited
+// ones are uploaded. Instance, bounds and draw data are diffed against what is drawn. Never cooked, the cache
+// would be rewritten on every save.
+void Application::ReloadScene(std::string MP_FilePath) {
+	auto start = std::chrono::high_resolution_clock::now();
+
+	renderer::ModelSet model_set = MP::ParseMP(MP_FilePath, false);
+	if (MP::HasMeshReferences(model_set)) {
+		if (!library) {
+			throw std::runtime_error(MP_FilePath + " takes its meshes from a geometry library, open it with --library.");
+		}
+		library->Resolve(model_set);
+	}
+	MP::DeduplicateMeshes(model_set);
+	MP::KeyMeshesByContent(model_set);
+
+	renderer::Renderer::SwitchStats stats = renderer->ReloadScene(model_set);
+
+	auto elapsed_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - start).count();
+	reload_status = "Reloaded in " + std::to_string(elapsed_ms) + "ms, " + std::to_string(stats.uploaded_meshes) + " meshes uploaded";
+	std::cout << "Reloaded " << MP_FilePath << " in " << elapsed_ms << "ms: uploaded " << stats.uploaded_meshes << " meshes (" << util::BytesToMegabytes(stats.uploaded_bytes) << " MB), ";
+	std::cout << stats.reused_draws << " draws reused resident meshes, " << util::BytesToMegabytes(stats.draw_data_bytes) << " MB of instance and draw data in " << stats.changed_ranges << " ranges";
+	std::cout << (stats.refilled ? ", geometry buffers refilled." : ".") << std::endl;
+}
+
+// Returns where the camera should start. Batches arrive through UploadNextBatch while frames are already being drawn.
+glm::vec3 Application::StartProgressiveLoad(std::string MP_FilePath, std::optional<glm::vec3> Focus) {
+	load_start = std::chrono::high_resolution_clock::now();
+
+	glm::vec3 focus = Focus ? *Focus : MP::GetDefaultFocus(MP_FilePath);
+	loader = std::make_unique<MP::ProgressiveLoader>(MP_FilePath, focus);
+
+	std::cout << "Loading " << MP_FilePath << " progressively around " << focus.x << "," << focus.y << "," << focus.z << "." << std::endl;
+	return focus;
+}
+
+// At most one batch per frame, so each upload stall stays short while the scene fills in around the camera.
+void Application::UploadNextBatch() {
+	auto elapsed_ms = [&] { return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - load_start).count(); };
+
+	std::unique_ptr<renderer::scene::SceneParser> batch = loader->TryPopBatch();
+	if (batch) {
+		renderer->AppendScene(batch->GetSceneView());
+		loaded_batch_count++;
+
+		if (loaded_batch_count == 1) {
+			std::cout << "First batch uploaded after " << elapsed_ms() << "ms." << std::endl;
+		}
+	}
+
+	try {
+		if (loader->IsFinished()) {
+			std::cout << "Progressive load finished in " << elapsed_ms() << "ms (" << loaded_batch_count << " batches)." << std::endl;
+			loader.reset();
+		}
+	}
+	catch (const std::exception& e) {
+		std::cout << "Warning: Progressive load stopped early. " << e.what() << std::endl;
+		loader.reset();
+	}
+}
+
 GLFWwindow* Application::Get_Window() {
 	return window;
 }
@@ -90,6 +278,35 @@ void Application::Update() {
 
 	ImGui::Text("Vulkan Renderer 1.0.0");
 
+	if (loader) {
+		ImGui::Text("Loading scene, %u batches in", loaded_batch_count);
+	}
+
+	if (watcher) {
+		ImGui::Text("Watching %s", watcher->GetPath().c_str());
+		if (!reload_status.empty()) {
+			ImGui::Text("%s", reload_status.c_str());
+		}
+	}
+
+	// Not while batches are still coming in, they would be appended to the new scene
+	if (!loader) {
+		ImGui::SeparatorText("Scene");
+		ImGui::Text("Instance format: %s", renderer->GetInstanceFormat() == renderer::INSTANCE_QUANTIZED ? "quantized, 32 bytes" : "affine 3x4, 48 bytes");
+		ImGui::Text("Vertex format: %s, %zu bytes", renderer::GetVertexFormatName(renderer->GetVertexFormat()), renderer::GetVertexStride(renderer->GetVertexFormat()));
+		ImGui::InputText("Path", switch_path, sizeof(switch_path));
+
+		if (ImGui::Button("Switch Scene")) {
+			try {
+				SwitchScene(switch_path);
+				camera->SetPosition(renderer->GetSceneRoot());
+			}
+			catch (const std::exception& e) {
+				std::cout << "Warning: Could not switch to " << switch_path << ". " << e.what() << std::endl;
+			}
+		}
+	}
+
 	ImGui::SeparatorText("Lighting");
 
 	if (ImGui::ColorEdit3("Light Color", light_color)) {
@@ -107,6 +324,12 @@ void Application::Update() {
 		camera->SetPosition(glm::vec3(current_position[0], current_position[1], current_position[2]));
 	}
 	ImGui::Checkbox("Pause Frustum Culling", &freeze_frustum_cull);
+	if (ImGui::Checkbox("Box Culling", &box_cull)) {
+		renderer->SetBoxCulling(box_cull);
+	}
+	if (ImGui::Checkbox("Depth Pre-pass", &depth_prepass)) {
+		renderer->SetDepthPrepass(depth_prepass);
+	}
 
 	//ImGui::SliderFloat("float", &f, 0.0f, 1.0f);            // Edit 1 float using a slider from 0.0f to 1.0f
 	//ImGui::ColorEdit3("clear color", (float*)&clear_color); // Edit 3 floats representing a color
@@ -126,6 +349,22 @@ void Application::Update() {
 	camera->MoveCamera(window, delta_time, !io.WantCaptureKeyboard, !io.WantCaptureMouse);
 	camera_position = camera->GetPosition();
 
+	// Stream in the next batch between frames
+	if (loader) {
+		UploadNextBatch();
+	}
+
+	// A bad save keeps the scene that is drawn, the next save tries again
+	if (watcher && watcher->PollChanged()) {
+		try {
+			ReloadScene(watcher->GetPath());
+		}
+		catch (const std::exception& e) {
+			reload_status = "Reload failed, see console";
+			std::cout << "Warning: Could not reload " << watcher->GetPath() << ". " << e.what() << std::endl;
+		}
+	}
+
 	// Draw scene
 	renderer->Draw(camera->GetViewMatrix(), !freeze_frustum_cull);
 }
@@ -1,13 +1,24 @@
 #pragma once
 #include "../Renderer/Renderer.h"
+#include "../MP Loader/MP_Progressive.h"
+#include "../MP Loader/MP_Library.h"
+#include "../MP Loader/MP_FileWatcher.h"
 #include "Camera.h"
+#include <chrono>
+#include <memory>
+#include <optional>
 
 namespace game {
 
 class Application {
 
 public:
-	Application();
+	// MP_FilePath of "" asks for a scene in the Assets folder. "-" reads the scene from stdin.
+	// Progressive starts drawing right away and streams the scene in nearest to Focus first (default: the scene root).
+	// LibraryPath names the geometry library (MP_Library.h) the scene's mesh references come from.
+	// Watch reloads the scene whenever its file is rewritten, uploading only what changed (Renderer::ReloadScene).
+	// VertexFormat is what the scene's vertices are packed to on the GPU (VkVertexFormat.h).
+	Application(std::string MP_FilePath = "", bool Progressive = false, std::optional<glm::vec3> Focus = std::nullopt, std::string LibraryPath = "", bool Watch = false, renderer::VERTEXFORMAT VertexFormat = renderer::VERTEX_FLOAT);
 	~Application();
 
 	GLFWwindow* Get_Window();
@@ -15,15 +26,33 @@ public:
 	void Update();
 
 private:
+	void LoadScene(std::string MP_FilePath);
+	glm::vec3 StartProgressiveLoad(std::string MP_FilePath, std::optional<glm::vec3> Focus);
+	void UploadNextBatch();
+	void SwitchScene(std::string MP_FilePath);
+	void ReloadScene(std::string MP_FilePath);
+
 	GLFWwindow* window;
 	renderer::Renderer* renderer;
 	Camera* camera;
 
+	std::unique_ptr<MP::GeometryLibrary> library;
+	char switch_path[256] = {};
+
+	std::unique_ptr<MP::FileWatcher> watcher;
+	std::string reload_status;
+
+	std::unique_ptr<MP::ProgressiveLoader> loader;
+	std::chrono::high_resolution_clock::time_point load_start;
+	uint32_t loaded_batch_count = 0;
+
 	float last_frame_time;
 	bool held_space = false;
 
 	bool show_another_window = false;
 	bool freeze_frustum_cull = false;
+	bool box_cull = true;
+	bool depth_prepass = false;
 	bool first_frame_complete = false;
 	glm::vec3 camera_position;
 
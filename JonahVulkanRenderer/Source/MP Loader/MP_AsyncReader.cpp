@@ -0,0 +1,454 @@
+#include "MP_AsyncReader.h"
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <new>
+#include <stdexcept>
+#include <string>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <atomic>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+#endif
+
+namespace {
+
+	// O_DIRECT and FILE_FLAG_NO_BUFFERING need sector alignment, 4 KB covers every disk we run on
+	constexpr uint64_t DirectAlignment = 4096;
+
+	// Larger reads are split by the caller, this keeps every request inside the 32 bit length both APIs take
+	constexpr uint64_t MaxRequestSize = uint64_t(1) << 30;
+
+	std::string GetReadErrorText(int64_t Error) {
+#ifdef _WIN32
+		return "error " + std::to_string(Error);
+#else
+		return std::strerror(static_cast<int>(Error));
+#endif
+	}
+
+} // namespace unnamed
+
+namespace MP {
+
+#ifdef _WIN32
+
+	struct AsyncFileReader::Backend {
+		HANDLE file = INVALID_HANDLE_VALUE;
+		HANDLE completion_port = nullptr;
+		std::vector<OVERLAPPED> overlapped;
+	};
+
+	AsyncFileReader::AsyncFileReader(const std::string& FilePath, bool DirectIO, uint32_t QueueDepth) : backend(std::make_unique<Backend>()) {
+		DWORD flags = FILE_FLAG_OVERLAPPED | (DirectIO ? FILE_FLAG_NO_BUFFERING : 0);
+
+		backend->file = CreateFileA(FilePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, flags, nullptr);
+		if (backend->file == INVALID_HANDLE_VALUE) {
+			throw std::invalid_argument("MP file could not open.");
+		}
+
+		backend->completion_port = CreateIoCompletionPort(backend->file, nullptr, 0, 1);
+		if (backend->completion_port == nullptr) {
+			CloseHandle(backend->file);
+			throw std::runtime_error("Failed to create an IO completion port.");
+		}
+
+		LARGE_INTEGER size{};
+		GetFileSizeEx(backend->file, &size);
+		file_size = static_cast<uint64_t>(size.QuadPart);
+		alignment = DirectIO ? DirectAlignment : 1;
+
+		requests.resize(QueueDepth);
+		backend->overlapped.resize(QueueDepth);
+		for (uint32_t i = QueueDepth; i > 0; i--) {
+			free_slots.push_back(i - 1);
+		}
+	}
+
+	AsyncFileReader::~AsyncFileReader() {
+		// Reads still in flight write into caller buffers, so they are finished before the handle goes
+		try {
+			while (GetInFlight() > 0) {
+				int64_t bytes_read = 0;
+				free_slots.push_back(WaitForSlot(bytes_read));
+			}
+		}
+		catch (const std::exception&) {
+			// Only the wait itself failed, there is nothing left to do but close
+		}
+
+		CloseHandle(backend->completion_port);
+		CloseHandle(backend->file);
+	}
+
+	const char* AsyncFileReader::GetBackendName() const {
+		return "overlapped";
+	}
+
+	void AsyncFileReader::Queue(uint32_t Slot) {
+		const Request& request = requests[Slot];
+		OVERLAPPED& overlapped = backend->overlapped[Slot];
+
+		overlapped = {};
+		overlapped.Offset = static_cast<DWORD>(request.offset);
+		overlapped.OffsetHigh = static_cast<DWORD>(request.offset >> 32);
+
+		if (!ReadFile(backend->file, request.output, static_cast<DWORD>(request.size), nullptr, &overlapped)) {
+			DWORD error = GetLastError();
+
+			// Past the end is reported as a failed read, it finishes with 0 bytes like a POSIX read
+			if (error == ERROR_HANDLE_EOF) {
+				PostQueuedCompletionStatus(backend->completion_port, 0, 0, &overlapped);
+			}
+			else if (error != ERROR_IO_PENDING) {
+				throw std::runtime_error("MP read failed (error " + std::to_string(error) + ").");
+			}
+		}
+	}
+
+	uint32_t AsyncFileReader::WaitForSlot(int64_t& BytesRead) {
+		DWORD bytes = 0;
+		ULONG_PTR key = 0;
+		OVERLAPPED* overlapped = nullptr;
+
+		BOOL success = GetQueuedCompletionStatus(backend->completion_port, &bytes, &key, &overlapped, INFINITE);
+		if (overlapped == nullptr) {
+			throw std::runtime_error("Waiting on MP reads failed.");
+		}
+
+		uint32_t slot = static_cast<uint32_t>(overlapped - backend->overlapped.data());
+		DWORD error = success ? ERROR_SUCCESS : GetLastError();
+
+		BytesRead = (error == ERROR_SUCCESS || error == ERROR_HANDLE_EOF) ? int64_t(bytes) : -int64_t(error);
+		return slot;
+	}
+
+	bool DropFileCache(const std::string& FilePath) {
+		// Opening without buffering flushes and purges the cached pages of a file nobody else has open
+		HANDLE file = CreateFileA(FilePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_NO_BUFFERING, nullptr);
+		if (file == INVALID_HANDLE_VALUE) {
+			return false;
+		}
+		CloseHandle(file);
+		return true;
+	}
+
+#else
+
+	struct AsyncFileReader::Backend {
+		int file_descriptor = -1;
+
+		// Blocking fallback, used when there is no ring
+		std::deque<uint32_t> blocking_queue;
+
+#ifdef __linux__
+		int ring_descriptor = -1;
+		unsigned pending_submits = 0;
+
+		void* sq_ring = MAP_FAILED;
+		size_t sq_ring_size = 0;
+		void* cq_ring = MAP_FAILED;
+		size_t cq_ring_size = 0;
+		io_uring_sqe* sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+		size_t sqes_size = 0;
+
+		unsigned* sq_tail = nullptr;
+		unsigned sq_mask = 0;
+		unsigned* sq_array = nullptr;
+		unsigned* cq_head = nullptr;
+		unsigned* cq_tail = nullptr;
+		unsigned cq_mask = 0;
+		io_uring_cqe* cqes = nullptr;
+
+		// glibc has no wrappers for these and liburing is not a dependency we ship
+		bool SetupRing(uint32_t QueueDepth) {
+			io_uring_params params{};
+			ring_descriptor = static_cast<int>(syscall(__NR_io_uring_setup, QueueDepth, &params));
+			if (ring_descriptor < 0) {
+				return false;
+			}
+
+			sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+			cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+			if (params.features & IORING_FEAT_SINGLE_MMAP) {
+				sq_ring_size = cq_ring_size = std::max(sq_ring_size, cq_ring_size);
+			}
+
+			sq_ring = mmap(nullptr, sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_descriptor, IORING_OFF_SQ_RING);
+			if (sq_ring == MAP_FAILED) {
+				return false;
+			}
+
+			cq_ring = sq_ring;
+			if ((params.features & IORING_FEAT_SINGLE_MMAP) == 0) {
+				cq_ring = mmap(nullptr, cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_descriptor, IORING_OFF_CQ_RING);
+				if (cq_ring == MAP_FAILED) {
+					return false;
+				}
+			}
+
+			sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+			sqes = static_cast<io_uring_sqe*>(mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_descriptor, IORING_OFF_SQES));
+			if (sqes == MAP_FAILED) {
+				return false;
+			}
+
+			std::uint8_t* sq = static_cast<std::uint8_t*>(sq_ring);
+			std::uint8_t* cq = static_cast<std::uint8_t*>(cq_ring);
+			sq_tail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+			sq_mask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+			sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+			cq_head = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+			cq_tail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+			cq_mask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+			cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+			return true;
+		}
+
+		void CloseRing() {
+			if (sqes != MAP_FAILED) munmap(sqes, sqes_size);
+			if (cq_ring != MAP_FAILED && cq_ring != sq_ring) munmap(cq_ring, cq_ring_size);
+			if (sq_ring != MAP_FAILED) munmap(sq_ring, sq_ring_size);
+			if (ring_descriptor >= 0) close(ring_descriptor);
+
+			sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+			cq_ring = sq_ring = MAP_FAILED;
+			ring_descriptor = -1;
+		}
+#endif
+	};
+
+	AsyncFileReader::AsyncFileReader(const std::string& FilePath, bool DirectIO, uint32_t QueueDepth) : backend(std::make_unique<Backend>()) {
+		int flags = O_RDONLY;
+#ifdef O_DIRECT
+		if (DirectIO) {
+			flags |= O_DIRECT;
+		}
+#endif
+
+		backend->file_descriptor = open(FilePath.c_str(), flags);
+		if (backend->file_descriptor < 0) {
+			if (DirectIO && errno == EINVAL) {
+				throw std::invalid_argument("MP file system does not support direct IO.");
+			}
+			throw std::invalid_argument("MP file could not open.");
+		}
+
+		struct stat file_stat {};
+		fstat(backend->file_descriptor, &file_stat);
+		file_size = static_cast<uint64_t>(file_stat.st_size);
+		alignment = DirectIO ? DirectAlignment : 1;
+
+#ifdef __linux__
+		if (!backend->SetupRing(QueueDepth)) {
+			backend->CloseRing();
+		}
+#endif
+
+		requests.resize(QueueDepth);
+		for (uint32_t i = QueueDepth; i > 0; i--) {
+			free_slots.push_back(i - 1);
+		}
+	}
+
+	AsyncFileReader::~AsyncFileReader() {
+		// Reads still in flight write into caller buffers, so they are finished before the ring goes
+		try {
+			while (GetInFlight() > 0) {
+				int64_t bytes_read = 0;
+				free_slots.push_back(WaitForSlot(bytes_read));
+			}
+		}
+		catch (const std::exception&) {
+			// Only the wait itself failed, there is nothing left to do but close
+		}
+
+#ifdef __linux__
+		backend->CloseRing();
+#endif
+		close(backend->file_descriptor);
+	}
+
+	const char* AsyncFileReader::GetBackendName() const {
+#ifdef __linux__
+		if (backend->ring_descriptor >= 0) {
+			return "io_uring";
+		}
+#endif
+		return "pread";
+	}
+
+	void AsyncFileReader::Queue(uint32_t Slot) {
+#ifdef __linux__
+		if (backend->ring_descriptor >= 0) {
+			const Request& request = requests[Slot];
+
+			// Only this thread writes the tail, the kernel reads it once io_uring_enter is called
+			unsigned tail = *backend->sq_tail;
+			unsigned index = tail & backend->sq_mask;
+
+			io_uring_sqe& sqe = backend->sqes[index];
+			std::memset(&sqe, 0, sizeof(sqe));
+			sqe.opcode = IORING_OP_READ;
+			sqe.fd = backend->file_descriptor;
+			sqe.addr = reinterpret_cast<uint64_t>(request.output);
+			sqe.len = static_cast<uint32_t>(request.size);
+			sqe.off = request.offset;
+			sqe.user_data = Slot;
+
+			backend->sq_array[index] = index;
+			std::atomic_ref<unsigned>(*backend->sq_tail).store(tail + 1, std::memory_order_release);
+			backend->pending_submits++;
+			return;
+		}
+#endif
+		backend->blocking_queue.push_back(Slot);
+	}
+
+	uint32_t AsyncFileReader::WaitForSlot(int64_t& BytesRead) {
+#ifdef __linux__
+		if (backend->ring_descriptor >= 0) {
+			while (true) {
+				unsigned head = *backend->cq_head;
+				unsigned tail = std::atomic_ref<unsigned>(*backend->cq_tail).load(std::memory_order_acquire);
+
+				if (head != tail) {
+					const io_uring_cqe& cqe = backend->cqes[head & backend->cq_mask];
+					uint32_t slot = static_cast<uint32_t>(cqe.user_data);
+					BytesRead = cqe.res;
+					std::atomic_ref<unsigned>(*backend->cq_head).store(head + 1, std::memory_order_release);
+					return slot;
+				}
+
+				// Hands every queued read to the kernel and sleeps until one completes
+				int submitted = static_cast<int>(syscall(__NR_io_uring_enter, backend->ring_descriptor, backend->pending_submits, 1, IORING_ENTER_GETEVENTS, nullptr, 0));
+				if (submitted < 0) {
+					if (errno == EINTR) continue;
+					throw std::runtime_error(std::string("io_uring_enter failed: ") + std::strerror(errno));
+				}
+				backend->pending_submits -= std::min<unsigned>(backend->pending_submits, static_cast<unsigned>(submitted));
+			}
+		}
+#endif
+
+		uint32_t slot = backend->blocking_queue.front();
+		backend->blocking_queue.pop_front();
+
+		const Request& request = requests[slot];
+		ssize_t result;
+		do {
+			result = pread(backend->file_descriptor, request.output, static_cast<size_t>(request.size), static_cast<off_t>(request.offset));
+		} while (result < 0 && errno == EINTR);
+
+		BytesRead = result < 0 ? -int64_t(errno) : int64_t(result);
+		return slot;
+	}
+
+	bool DropFileCache(const std::string& FilePath) {
+		int file_descriptor = open(FilePath.c_str(), O_RDONLY);
+		if (file_descriptor < 0) {
+			return false;
+		}
+
+#ifdef POSIX_FADV_DONTNEED
+		// Only clean pages can be dropped
+		fdatasync(file_descriptor);
+		bool dropped = posix_fadvise(file_descriptor, 0, 0, POSIX_FADV_DONTNEED) == 0;
+#else
+		bool dropped = false;
+#endif
+
+		close(file_descriptor);
+		return dropped;
+	}
+
+#endif
+
+	uint64_t AsyncFileReader::GetFileSize() const {
+		return file_size;
+	}
+
+	uint64_t AsyncFileReader::GetAlignment() const {
+		return alignment;
+	}
+
+	uint32_t AsyncFileReader::GetFreeSlots() const {
+		return static_cast<uint32_t>(free_slots.size());
+	}
+
+	uint32_t AsyncFileReader::GetInFlight() const {
+		return static_cast<uint32_t>(requests.size() - free_slots.size());
+	}
+
+	void AsyncFileReader::Submit(uint64_t Offset, uint64_t Size, void* Output, uint64_t Tag) {
+		if (free_slots.empty()) {
+			throw std::logic_error("AsyncFileReader queue is full, wait on a read first.");
+		}
+
+		if (Size > MaxRequestSize) {
+			throw std::invalid_argument("MP read is larger than a single request allows.");
+		}
+
+		if (Offset % alignment != 0 || Size % alignment != 0 || reinterpret_cast<uintptr_t>(Output) % alignment != 0) {
+			throw std::invalid_argument("Direct IO reads must be aligned to " + std::to_string(alignment) + " bytes.");
+		}
+
+		uint32_t slot = free_slots.back();
+		free_slots.pop_back();
+
+		requests[slot] = { Offset, Size, static_cast<std::uint8_t*>(Output), Tag };
+		Queue(slot);
+	}
+
+	uint64_t AsyncFileReader::WaitOne() {
+		if (GetInFlight() == 0) {
+			throw std::logic_error("AsyncFileReader has no reads in flight.");
+		}
+
+		while (true) {
+			int64_t bytes_read = 0;
+			uint32_t slot = WaitForSlot(bytes_read);
+			Request& request = requests[slot];
+
+			if (bytes_read < 0) {
+				free_slots.push_back(slot);
+				throw std::runtime_error("MP read failed (" + GetReadErrorText(-bytes_read) + ").");
+			}
+
+			request.offset += static_cast<uint64_t>(bytes_read);
+			request.output += bytes_read;
+			request.size -= std::min(request.size, static_cast<uint64_t>(bytes_read));
+
+			// Done when full, or when the read reached the end of the file
+			if (request.size == 0 || bytes_read == 0 || request.offset >= file_size) {
+				free_slots.push_back(slot);
+				return request.tag;
+			}
+
+			Queue(slot);
+		}
+	}
+
+	void AlignedFree::operator()(std::uint8_t* Bytes) const {
+		::operator delete[](Bytes, std::align_val_t(static_cast<size_t>(alignment)));
+	}
+
+	AlignedBuffer AllocateAligned(uint64_t ByteSize, uint64_t Alignment) {
+		void* bytes = ::operator new[](static_cast<size_t>(std::max<uint64_t>(ByteSize, 1)), std::align_val_t(static_cast<size_t>(Alignment)));
+		return AlignedBuffer(static_cast<std::uint8_t*>(bytes), AlignedFree{ Alignment });
+	}
+
+} // namespace MP
\ No newline at end of file
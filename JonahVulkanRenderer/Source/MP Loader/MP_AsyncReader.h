@@ -0,0 +1,70 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace MP {
+
+	// Queue of concurrent positional reads on one file. io_uring on Linux, overlapped reads on a completion port
+	// on Windows. Where neither is available (old kernels, io_uring blocked by a sandbox) each read runs as a
+	// blocking pread inside WaitOne, so callers still overlap reading with work on other threads.
+	class AsyncFileReader {
+
+	public:
+		// DirectIO bypasses the OS page cache (O_DIRECT / FILE_FLAG_NO_BUFFERING). Offsets, sizes and output
+		// buffers must then be multiples of GetAlignment().
+		AsyncFileReader(const std::string& FilePath, bool DirectIO, uint32_t QueueDepth = 32);
+		~AsyncFileReader();
+
+		AsyncFileReader(const AsyncFileReader&) = delete;
+		AsyncFileReader& operator=(const AsyncFileReader&) = delete;
+
+		uint64_t GetFileSize() const;
+		uint64_t GetAlignment() const;
+		const char* GetBackendName() const;
+
+		// Reads that can be submitted before one has to be waited on.
+		uint32_t GetFreeSlots() const;
+		uint32_t GetInFlight() const;
+
+		// Queues a read of Size bytes at Offset into Output. Reads past the end of the file stop at the end.
+		void Submit(uint64_t Offset, uint64_t Size, void* Output, uint64_t Tag);
+
+		// Blocks until a read has fully landed and returns its tag. Short reads are resubmitted internally.
+		uint64_t WaitOne();
+
+	private:
+		struct Request {
+			uint64_t offset;
+			uint64_t size;
+			std::uint8_t* output;
+			uint64_t tag;
+		};
+
+		struct Backend;
+
+		void Queue(uint32_t Slot);
+
+		// Next finished request. BytesRead is negative (the OS error code) when the read failed.
+		uint32_t WaitForSlot(int64_t& BytesRead);
+
+		std::unique_ptr<Backend> backend;
+		std::vector<Request> requests;
+		std::vector<uint32_t> free_slots;
+		uint64_t file_size = 0;
+		uint64_t alignment = 1;
+	};
+
+	// Buffer on an alignment DirectIO reads accept.
+	struct AlignedFree {
+		uint64_t alignment;
+		void operator()(std::uint8_t* Bytes) const;
+	};
+	using AlignedBuffer = std::unique_ptr<std::uint8_t[], AlignedFree>;
+	AlignedBuffer AllocateAligned(uint64_t ByteSize, uint64_t Alignment);
+
+	// Best effort: drops the file from the OS page cache so the next read comes from disk. Used by cold benchmarks.
+	bool DropFileCache(const std::string& FilePath);
+
+} // namespace MP
\ No newline at end of file
@@ -0,0 +1,98 @@
+#include "MP_ByteSource.h"
+#include <algorithm>
+#include <filesystem>
+#include <stdexcept>
+#include <vector>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+namespace MP {
+
+	uint64_t ByteSource::GetPosition() const {
+		return position;
+	}
+
+	uint64_t ByteSource::GetSizeHint() const {
+		return size_hint;
+	}
+
+	size_t ByteSource::ReadSome(void* Output, size_t Size) {
+		size_t read = Read(Output, Size);
+		position += read;
+		return read;
+	}
+
+	void ByteSource::ReadExact(void* Output, uint64_t Size) {
+		std::uint8_t* output = static_cast<std::uint8_t*>(Output);
+
+		while (Size > 0) {
+			size_t read = ReadSome(output, static_cast<size_t>(std::min<uint64_t>(Size, SIZE_MAX)));
+			if (read == 0) {
+				throw std::runtime_error("MP stream ended early");
+			}
+
+			output += read;
+			Size -= read;
+		}
+	}
+
+	void ByteSource::Skip(uint64_t Size) {
+		std::vector<std::uint8_t> scratch(static_cast<size_t>(std::min<uint64_t>(Size, 64 * 1024)));
+
+		while (Size > 0) {
+			uint64_t step = std::min<uint64_t>(Size, scratch.size());
+			ReadExact(scratch.data(), step);
+			Size -= step;
+		}
+	}
+
+	StdioByteSource::StdioByteSource(std::FILE* File, bool OwnsFile, uint64_t SizeHint) : file(File), owns_file(OwnsFile) {
+		size_hint = SizeHint;
+
+#ifdef _WIN32
+		// Text mode would turn 0D 0A into 0A inside the binary data
+		if (file == stdin) {
+			_setmode(_fileno(stdin), _O_BINARY);
+		}
+#endif
+	}
+
+	StdioByteSource::~StdioByteSource() {
+		if (owns_file) {
+			std::fclose(file);
+		}
+	}
+
+	size_t StdioByteSource::Read(void* Output, size_t Size) {
+		size_t read = std::fread(Output, 1, Size, file);
+
+		if (read == 0 && std::ferror(file)) {
+			throw std::runtime_error("Failed reading MP stream.");
+		}
+		return read;
+	}
+
+	std::unique_ptr<ByteSource> OpenByteSource(const std::string& FilePath) {
+		if (FilePath == "-") {
+			return std::make_unique<StdioByteSource>(stdin, false);
+		}
+
+		std::FILE* file = std::fopen(FilePath.c_str(), "rb");
+		if (file == nullptr) {
+			throw std::invalid_argument("MP file could not open.");
+		}
+
+		// Pipes and FIFOs have no size, they just get no hint
+		std::error_code error;
+		uint64_t size_hint = std::filesystem::is_regular_file(FilePath, error) ? std::filesystem::file_size(FilePath, error) : 0;
+		if (error) {
+			size_hint = 0;
+		}
+
+		return std::make_unique<StdioByteSource>(file, true, size_hint);
+	}
+
+} // namespace MP
\ No newline at end of file
@@ -0,0 +1,61 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+
+namespace MP {
+
+	// Forward-only byte input: a pipe, FIFO, decompressor or plain file. Nothing is ever seeked or sized up front.
+	class ByteSource {
+
+	public:
+		virtual ~ByteSource() = default;
+
+		// Bytes consumed so far.
+		uint64_t GetPosition() const;
+
+		// Total size when the source knows it up front (a regular file), 0 otherwise. Only a hint for buffer sizing.
+		uint64_t GetSizeHint() const;
+
+		// Up to Size bytes, returns 0 only at the end of the input.
+		size_t ReadSome(void* Output, size_t Size);
+
+		// Throws if the source ends before Size bytes.
+		void ReadExact(void* Output, uint64_t Size);
+
+		// Reads and drops Size bytes.
+		void Skip(uint64_t Size);
+
+	protected:
+		virtual size_t Read(void* Output, size_t Size) = 0;
+
+		uint64_t size_hint = 0;
+
+	private:
+		uint64_t position = 0;
+	};
+
+	// Reads through a C stdio stream, so stdin works the same as an opened file.
+	class StdioByteSource : public ByteSource {
+
+	public:
+		// OwnsFile closes the stream on destruction. stdin is switched to binary mode on Windows.
+		StdioByteSource(std::FILE* File, bool OwnsFile, uint64_t SizeHint = 0);
+		~StdioByteSource() override;
+
+		StdioByteSource(const StdioByteSource&) = delete;
+		StdioByteSource& operator=(const StdioByteSource&) = delete;
+
+	protected:
+		size_t Read(void* Output, size_t Size) override;
+
+	private:
+		std::FILE* file;
+		bool owns_file;
+	};
+
+	// "-" is stdin, anything else is opened for reading (FIFOs included).
+	std::unique_ptr<ByteSource> OpenByteSource(const std::string& FilePath);
+
+} // namespace MP
\ No newline at end of file
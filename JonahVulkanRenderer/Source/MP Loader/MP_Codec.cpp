@@ -0,0 +1,339 @@
+#include "MP_Codec.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+
+	constexpr size_t MinMatch = 4;
+	constexpr size_t MaxOffset = 65535;
+	constexpr int HashBits = 16;
+
+	uint32_t Load32(const std::uint8_t* Bytes) {
+		uint32_t x;
+		std::memcpy(&x, Bytes, sizeof(uint32_t));
+		return x;
+	}
+
+	uint32_t HashSequence(uint32_t Sequence) {
+		return (Sequence * 2654435761u) >> (32 - HashBits);
+	}
+
+	// Lengths of 15 and up spill into extra bytes, 255 meaning "keep adding".
+	void WriteLength(std::vector<std::uint8_t>& Output, size_t Length) {
+		Length -= 15;
+		while (Length >= 255) {
+			Output.push_back(255);
+			Length -= 255;
+		}
+		Output.push_back(static_cast<std::uint8_t>(Length));
+	}
+
+	size_t ReadLength(std::span<const std::uint8_t> Input, size_t& Position, size_t Length) {
+		if (Length != 15) return Length;
+
+		std::uint8_t b;
+		do {
+			if (Position >= Input.size()) {
+				throw std::runtime_error("Packed MP object is truncated");
+			}
+			b = Input[Position++];
+			Length += b;
+		} while (b == 255);
+
+		return Length;
+	}
+
+	// MatchLength 0 marks the last sequence, which is literals only.
+	void EmitSequence(std::vector<std::uint8_t>& Output, const std::uint8_t* Literals, size_t LiteralLength, size_t Offset, size_t MatchLength) {
+		size_t match_code = MatchLength ? MatchLength - MinMatch : 0;
+
+		Output.push_back(static_cast<std::uint8_t>((std::min<size_t>(LiteralLength, 15) << 4) | std::min<size_t>(match_code, 15)));
+		if (LiteralLength >= 15) WriteLength(Output, LiteralLength);
+
+		Output.insert(Output.end(), Literals, Literals + LiteralLength);
+		if (MatchLength == 0) return;
+
+		Output.push_back(static_cast<std::uint8_t>(Offset));
+		Output.push_back(static_cast<std::uint8_t>(Offset >> 8));
+		if (match_code >= 15) WriteLength(Output, match_code);
+	}
+
+	glm::vec2 OctEncode(glm::vec3 Normal) {
+		float l1 = std::abs(Normal.x) + std::abs(Normal.y) + std::abs(Normal.z);
+		if (l1 == 0) return glm::vec2(0);
+
+		glm::vec2 p = glm::vec2(Normal.x, Normal.y) / l1;
+
+		// Fold the lower hemisphere over the diagonals
+		if (Normal.z < 0) {
+			glm::vec2 sign = glm::vec2(p.x >= 0 ? 1.0f : -1.0f, p.y >= 0 ? 1.0f : -1.0f);
+			p = (1.0f - glm::abs(glm::vec2(p.y, p.x))) * sign;
+		}
+
+		return p;
+	}
+
+	glm::vec3 OctDecode(glm::vec2 Encoded) {
+		glm::vec3 n = glm::vec3(Encoded.x, Encoded.y, 1.0f - std::abs(Encoded.x) - std::abs(Encoded.y));
+		float t = std::max(-n.z, 0.0f);
+		n.x += n.x >= 0 ? -t : t;
+		n.y += n.y >= 0 ? -t : t;
+		return glm::normalize(n);
+	}
+
+	int16_t ToSnorm16(float Value) {
+		return static_cast<int16_t>(std::lround(std::clamp(Value, -1.0f, 1.0f) * 32767.0f));
+	}
+
+	float FromSnorm16(int16_t Value) {
+		return std::max(static_cast<float>(Value) / 32767.0f, -1.0f);
+	}
+
+	constexpr uint64_t MatrixFloats = 15; // w of column 3 is always 1, so it is not stored
+}
+
+namespace MP::codec {
+
+	std::vector<std::uint8_t> Compress(std::span<const std::uint8_t> Input) {
+
+		if (Input.size() > UINT32_MAX) {
+			throw std::runtime_error("MP object too large to pack");
+		}
+
+		// Reused between calls without clearing: a stale entry is only used when its bytes still match, which is still a valid match
+		thread_local std::vector<uint32_t> table(size_t(1) << HashBits, UINT32_MAX);
+
+		std::vector<std::uint8_t> output;
+		output.reserve(Input.size() + Input.size() / 255 + 16);
+
+		const std::uint8_t* in = Input.data();
+		const size_t n = Input.size();
+		size_t i = 0;
+		size_t anchor = 0;
+
+		while (i + MinMatch <= n) {
+			uint32_t sequence = Load32(in + i);
+			uint32_t& slot = table[HashSequence(sequence)];
+			size_t candidate = slot;
+			slot = static_cast<uint32_t>(i);
+
+			if (candidate < i && i - candidate <= MaxOffset && Load32(in + candidate) == sequence) {
+				size_t length = MinMatch;
+				while (i + length < n && in[candidate + length] == in[i + length]) {
+					length++;
+				}
+
+				EmitSequence(output, in + anchor, i - anchor, i - candidate, length);
+				i += length;
+				anchor = i;
+			}
+			else {
+				// Step faster through data that is not compressing
+				i += 1 + ((i - anchor) >> 6);
+			}
+		}
+
+		EmitSequence(output, in + anchor, n - anchor, 0, 0);
+		return output;
+	}
+
+	void Decompress(std::span<const std::uint8_t> Input, std::span<std::uint8_t> Output) {
+		size_t ip = 0;
+		size_t op = 0;
+
+		while (ip < Input.size()) {
+			std::uint8_t token = Input[ip++];
+
+			size_t literal_length = ReadLength(Input, ip, token >> 4);
+			if (literal_length > Input.size() - ip || literal_length > Output.size() - op) {
+				throw std::runtime_error("Packed MP object is corrupt");
+			}
+
+			std::memcpy(Output.data() + op, Input.data() + ip, literal_length);
+			ip += literal_length;
+			op += literal_length;
+
+			// Last sequence has no match
+			if (ip == Input.size()) break;
+
+			if (Input.size() - ip < 2) {
+				throw std::runtime_error("Packed MP object is truncated");
+			}
+
+			size_t offset = Input[ip] | (size_t(Input[ip + 1]) << 8);
+			ip += 2;
+
+			size_t match_length = ReadLength(Input, ip, token & 15) + MinMatch;
+			if (offset == 0 || offset > op || match_length > Output.size() - op) {
+				throw std::runtime_error("Packed MP object is corrupt");
+			}
+
+			std::uint8_t* destination = Output.data() + op;
+			const std::uint8_t* match = destination - offset;
+
+			if (offset >= match_length) {
+				std::memcpy(destination, match, match_length);
+			}
+			else {
+				// Overlapping match repeats the last offset bytes
+				for (size_t k = 0; k < match_length; k++) {
+					destination[k] = match[k];
+				}
+			}
+			op += match_length;
+		}
+
+		if (op != Output.size()) {
+			throw std::runtime_error("Packed MP object is truncated");
+		}
+	}
+
+	uint64_t UnpackedFixedSize(const format::ObjectHeader& Header) {
+		return uint64_t(Header.vertex_count) * 3 * sizeof(uint16_t)
+			+ uint64_t(Header.normal_count) * 2 * sizeof(int16_t)
+			+ uint64_t(Header.instance_count) * MatrixFloats * sizeof(float);
+	}
+
+	std::vector<std::uint8_t> PackObject(const ObjectArrays& Object, const float Bounds[6], uint64_t& UnpackedSize) {
+
+		format::ObjectHeader header{};
+		header.vertex_count = static_cast<uint32_t>(Object.positions.size() / 3);
+		header.normal_count = static_cast<uint32_t>(Object.normals.size() / 3);
+		header.index_count = static_cast<uint32_t>(Object.indices.size());
+		header.instance_count = static_cast<uint32_t>(Object.matrices.size());
+
+		std::vector<std::uint8_t> block(static_cast<size_t>(UnpackedFixedSize(header)));
+		block.reserve(block.size() + size_t(header.index_count) * 5);
+		std::uint8_t* cursor = block.data();
+
+		// Positions
+		for (size_t i = 0; i < Object.positions.size(); i++) {
+			size_t axis = i % 3;
+			float extent = Bounds[axis + 3] - Bounds[axis];
+			float t = extent > 0 ? (Object.positions[i] - Bounds[axis]) / extent : 0.0f;
+			uint16_t q = static_cast<uint16_t>(std::lround(std::clamp(t, 0.0f, 1.0f) * 65535.0f));
+
+			std::memcpy(cursor, &q, sizeof(uint16_t));
+			cursor += sizeof(uint16_t);
+		}
+
+		// Normals
+		for (size_t i = 0; i < header.normal_count; i++) {
+			glm::vec2 oct = OctEncode(glm::vec3(Object.normals[i * 3], Object.normals[i * 3 + 1], Object.normals[i * 3 + 2]));
+			int16_t q[2] = { ToSnorm16(oct.x), ToSnorm16(oct.y) };
+
+			std::memcpy(cursor, q, sizeof(q));
+			cursor += sizeof(q);
+		}
+
+		// Matrices, split into byte planes so the similar exponent bytes sit together for the LZ stage
+		const size_t float_count = size_t(header.instance_count) * MatrixFloats;
+		for (size_t k = 0; k < float_count; k++) {
+			const float* matrix = &Object.matrices[k / MatrixFloats][0][0];
+			std::uint8_t bytes[4];
+			std::memcpy(bytes, matrix + k % MatrixFloats, sizeof(float));
+
+			for (size_t plane = 0; plane < 4; plane++) {
+				cursor[plane * float_count + k] = bytes[plane];
+			}
+		}
+
+		// Indices
+		uint32_t previous = 0;
+		for (uint32_t index : Object.indices) {
+			int32_t delta = static_cast<int32_t>(index - previous);
+			uint32_t zigzag = (static_cast<uint32_t>(delta) << 1) ^ static_cast<uint32_t>(delta >> 31);
+			previous = index;
+
+			while (zigzag >= 0x80) {
+				block.push_back(static_cast<std::uint8_t>(zigzag | 0x80));
+				zigzag >>= 7;
+			}
+			block.push_back(static_cast<std::uint8_t>(zigzag));
+		}
+
+		UnpackedSize = block.size();
+		return Compress(block);
+	}
+
+	void UnpackObject(const format::ObjectHeader& Header, std::span<const std::uint8_t> Packed, float* Positions, float* Normals, uint32_t* Indices, glm::mat4* Matrices) {
+
+		// One decode buffer per worker, reused across objects
+		thread_local std::vector<std::uint8_t> block;
+		block.resize(static_cast<size_t>(Header.unpacked_size));
+		Decompress(Packed, block);
+
+		const std::uint8_t* cursor = block.data();
+
+		// Positions
+		float scale[3];
+		for (int axis = 0; axis < 3; axis++) {
+			scale[axis] = (Header.bounds[axis + 3] - Header.bounds[axis]) / 65535.0f;
+		}
+
+		for (size_t i = 0; i < size_t(Header.vertex_count) * 3; i++) {
+			uint16_t q;
+			std::memcpy(&q, cursor, sizeof(uint16_t));
+			cursor += sizeof(uint16_t);
+
+			size_t axis = i % 3;
+			Positions[i] = Header.bounds[axis] + static_cast<float>(q) * scale[axis];
+		}
+
+		// Normals
+		for (size_t i = 0; i < Header.normal_count; i++) {
+			int16_t q[2];
+			std::memcpy(q, cursor, sizeof(q));
+			cursor += sizeof(q);
+
+			glm::vec3 n = OctDecode(glm::vec2(FromSnorm16(q[0]), FromSnorm16(q[1])));
+			Normals[i * 3] = n.x;
+			Normals[i * 3 + 1] = n.y;
+			Normals[i * 3 + 2] = n.z;
+		}
+
+		// Matrices
+		const size_t float_count = size_t(Header.instance_count) * MatrixFloats;
+		for (size_t m = 0; m < Header.instance_count; m++) {
+			float* matrix = &Matrices[m][0][0];
+
+			for (size_t e = 0; e < MatrixFloats; e++) {
+				size_t k = m * MatrixFloats + e;
+				std::uint8_t bytes[4] = { cursor[k], cursor[float_count + k], cursor[2 * float_count + k], cursor[3 * float_count + k] };
+				std::memcpy(matrix + e, bytes, sizeof(float));
+			}
+			matrix[15] = 1.0f;
+		}
+		cursor += float_count * sizeof(float);
+
+		// Indices
+		const std::uint8_t* end = block.data() + block.size();
+		uint32_t previous = 0;
+
+		for (size_t i = 0; i < Header.index_count; i++) {
+			uint32_t zigzag = 0;
+			int shift = 0;
+			std::uint8_t b;
+
+			do {
+				if (cursor == end || shift > 28) {
+					throw std::runtime_error("Packed MP object is corrupt");
+				}
+				b = *cursor++;
+				zigzag |= uint32_t(b & 0x7F) << shift;
+				shift += 7;
+			} while (b & 0x80);
+
+			int32_t delta = static_cast<int32_t>(zigzag >> 1) ^ -static_cast<int32_t>(zigzag & 1);
+			previous += static_cast<uint32_t>(delta);
+			Indices[i] = previous;
+		}
+
+		if (cursor != end) {
+			throw std::runtime_error("Packed MP object is corrupt");
+		}
+	}
+
+} // namespace MP::codec
\ No newline at end of file
@@ -0,0 +1,38 @@
+#pragma once
+#include <cstdint>
+#include <span>
+#include <vector>
+#include "MP_Format.h"
+#include "../Renderer/VkUtil/VkCommon.h"
+
+// ENCODING_PACKED objects. Before compression the object is, in order:
+//   uint16[3 * vertices]    positions quantised to 16 bits per axis against the object bounds
+//   int16[2 * normals]      octahedral normals, snorm16
+//   byte[60 * instances]    matrices without the forced w, split into 4 byte planes (all byte 0s, then all byte 1s, ...)
+//   varint[indices]         zigzag delta from the previous index, LEB128
+// That block is then LZ compressed (LZ4 style tokens, 64 KB window). Each object decodes on its own.
+namespace MP::codec {
+
+	// Source arrays of one object. Positions and normals are float3.
+	struct ObjectArrays {
+		std::span<const float> positions;
+		std::span<const float> normals;
+		std::span<const uint32_t> indices;
+		std::span<const glm::mat4> matrices;
+	};
+
+	std::vector<std::uint8_t> Compress(std::span<const std::uint8_t> Input);
+
+	// Output must be exactly the decompressed size. Throws on malformed input.
+	void Decompress(std::span<const std::uint8_t> Input, std::span<std::uint8_t> Output);
+
+	// Bytes of the unpacked block before the index varints.
+	uint64_t UnpackedFixedSize(const format::ObjectHeader& Header);
+
+	// Returns the compressed block. UnpackedSize gets the size before compression.
+	std::vector<std::uint8_t> PackObject(const ObjectArrays& Object, const float Bounds[6], uint64_t& UnpackedSize);
+
+	// Positions and Normals are float3 outputs. Matrices get the w of column 3 set to 1 like raw objects.
+	void UnpackObject(const format::ObjectHeader& Header, std::span<const std::uint8_t> Packed, float* Positions, float* Normals, uint32_t* Indices, glm::mat4* Matrices);
+
+} // namespace MP::codec
\ No newline at end of file
@@ -0,0 +1,229 @@
+#include "MP_Cooked.h"
+#include "../Util/Hash.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+	const uint32_t CookedMagic = 0x4B43504D; // "MPCK"
+	const uint32_t CookedVersion = 7; // 2: meshes are deduplicated before cooking, 3: world AABB in the bounds, 4: 3x4 instances, 5: Morton order, 6: material table, 7: mesh decode boxes
+	const uint64_t SectionAlignment = 4096;
+
+	enum COOKEDSECTION { VERTICES, INDICES, INSTANCES, BOUNDS, DRAW_COMMANDS, MATERIALS, MESH_DECODE, SECTION_COUNT };
+
+	struct CookedSection {
+		uint64_t offset;
+		uint64_t byte_size;
+		uint32_t stride; // sizeof the element when cooked, guards against struct layout changes
+		uint32_t reserved;
+	};
+
+	struct CookedHeader {
+		uint32_t magic;
+		uint32_t version;
+		uint64_t source_hash;
+		uint32_t mesh_count;
+		float scene_root[3];
+		CookedSection sections[SECTION_COUNT];
+	};
+
+	const uint32_t SectionStrides[SECTION_COUNT] = {
+		sizeof(renderer::Vertex),
+		sizeof(uint32_t),
+		sizeof(renderer::InstanceData),
+		sizeof(renderer::BoundingBoxData),
+		sizeof(VkDrawIndexedIndirectCommand),
+		sizeof(renderer::MaterialData),
+		sizeof(renderer::MeshDecodeData)
+	};
+
+	uint64_t AlignSection(uint64_t Offset) {
+		return (Offset + SectionAlignment - 1) / SectionAlignment * SectionAlignment;
+	}
+
+	bool IsValidHeader(const CookedHeader& Header, uint64_t SourceHash, uint64_t FileSize) {
+		if (Header.magic != CookedMagic || Header.version != CookedVersion || Header.source_hash != SourceHash) {
+			return false;
+		}
+
+		for (int i = 0; i < SECTION_COUNT; i++) {
+			const CookedSection& section = Header.sections[i];
+
+			if (section.stride != SectionStrides[i] || section.byte_size % section.stride != 0) return false;
+			if (section.byte_size == 0) continue;
+			if (section.offset % SectionAlignment != 0) return false;
+			if (section.byte_size > FileSize || section.offset > FileSize - section.byte_size) return false;
+		}
+
+		return true;
+	}
+
+	template <class T>
+	std::span<const T> GetSection(std::span<const std::uint8_t> Bytes, const CookedSection& Section) {
+		if (Section.byte_size == 0) return {};
+
+		// Sections are page aligned inside a page aligned mapping, so the cast is aligned too
+		return { reinterpret_cast<const T*>(Bytes.data() + Section.offset), static_cast<size_t>(Section.byte_size / sizeof(T)) };
+	}
+} // namespace unnamed
+
+namespace MP {
+
+	uint64_t HashMP(std::string MP_FilePath) {
+		MappedFile file(MP_FilePath);
+		return util::HashParallel(file.GetBytes());
+	}
+
+	std::string GetCookedPath(uint64_t SourceHash) {
+		std::stringstream name;
+		name << "Cache/" << std::hex << std::setw(16) << std::setfill('0') << SourceHash << ".mpc";
+		return name.str();
+	}
+
+	bool CheckValidCooked(std::string CookedFilePath, uint64_t SourceHash) {
+		std::ifstream file(CookedFilePath, std::ios::binary | std::ios::ate);
+
+		if (!file) {
+			return false;
+		}
+
+		uint64_t file_size = static_cast<uint64_t>(file.tellg());
+		if (file_size < sizeof(CookedHeader)) {
+			return false;
+		}
+
+		CookedHeader header;
+		file.seekg(0, std::ios::beg);
+		file.read(reinterpret_cast<char*>(&header), sizeof(CookedHeader));
+
+		return file && IsValidHeader(header, SourceHash, file_size);
+	}
+
+	void WriteCookedScene(std::string CookedFilePath, uint64_t SourceHash, const renderer::scene::SceneParser& Scene) {
+
+		// Geometry sections come from WriteVertices / WriteIndices, so they are null here
+		const void* section_data[SECTION_COUNT] = {
+			nullptr, nullptr, Scene.GetInstanceData().data(), Scene.GetBoundingData().data(), Scene.GetDrawCommands().data(),
+			Scene.GetMaterials().data(), Scene.GetMeshDecode().data()
+		};
+
+		CookedHeader header{};
+		header.magic = CookedMagic;
+		header.version = CookedVersion;
+		header.source_hash = SourceHash;
+		header.mesh_count = Scene.GetMeshCount();
+		header.scene_root[0] = Scene.GetSceneRoot().x;
+		header.scene_root[1] = Scene.GetSceneRoot().y;
+		header.scene_root[2] = Scene.GetSceneRoot().z;
+
+		header.sections[VERTICES].byte_size = uint64_t(Scene.GetVertexCount()) * sizeof(renderer::Vertex);
+		header.sections[INDICES].byte_size = uint64_t(Scene.GetIndexCount()) * sizeof(uint32_t);
+		header.sections[INSTANCES].byte_size = Scene.GetInstanceData().size_bytes();
+		header.sections[BOUNDS].byte_size = Scene.GetBoundingData().size_bytes();
+		header.sections[DRAW_COMMANDS].byte_size = Scene.GetDrawCommands().size_bytes();
+		header.sections[MATERIALS].byte_size = Scene.GetMaterials().size_bytes();
+		header.sections[MESH_DECODE].byte_size = Scene.GetMeshDecode().size_bytes();
+
+		uint64_t offset = sizeof(CookedHeader);
+		for (int i = 0; i < SECTION_COUNT; i++) {
+			offset = AlignSection(offset);
+			header.sections[i].offset = offset;
+			header.sections[i].stride = SectionStrides[i];
+			offset += header.sections[i].byte_size;
+		}
+
+		std::filesystem::path final_path(CookedFilePath);
+		std::filesystem::path temp_path = final_path;
+		temp_path += ".tmp";
+
+		if (final_path.has_parent_path()) {
+			std::filesystem::create_directories(final_path.parent_path());
+		}
+
+		{
+			std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+			if (!file) {
+				throw std::runtime_error("Could not create cooked MP file.");
+			}
+
+			file.write(reinterpret_cast<const char*>(&header), sizeof(CookedHeader));
+
+			const std::vector<char> padding(SectionAlignment, 0);
+			uint64_t written = sizeof(CookedHeader);
+
+			// Geometry goes out through a small buffer, the scene's vertices never have to be in one array
+			const uint64_t chunk_bytes = 4 * 1024 * 1024;
+			std::vector<std::uint8_t> chunk(chunk_bytes);
+
+			for (int i = 0; i < SECTION_COUNT; i++) {
+				file.write(padding.data(), static_cast<std::streamsize>(header.sections[i].offset - written));
+
+				if (i == VERTICES || i == INDICES) {
+					uint64_t element_size = SectionStrides[i];
+					uint64_t element_count = header.sections[i].byte_size / element_size;
+					uint64_t chunk_elements = chunk_bytes / element_size;
+
+					for (uint64_t first = 0; first < element_count; first += chunk_elements) {
+						uint64_t count = std::min(chunk_elements, element_count - first);
+						if (i == VERTICES) {
+							Scene.WriteVertices(first, count, reinterpret_cast<renderer::Vertex*>(chunk.data()));
+						}
+						else {
+							Scene.WriteIndices(first, count, reinterpret_cast<uint32_t*>(chunk.data()));
+						}
+						file.write(reinterpret_cast<const char*>(chunk.data()), static_cast<std::streamsize>(count * element_size));
+					}
+				}
+				else {
+					file.write(static_cast<const char*>(section_data[i]), static_cast<std::streamsize>(header.sections[i].byte_size));
+				}
+
+				written = header.sections[i].offset + header.sections[i].byte_size;
+			}
+
+			if (!file) {
+				throw std::runtime_error("Failed writing cooked MP file.");
+			}
+		}
+
+		std::filesystem::rename(temp_path, final_path);
+	}
+
+	CookedScene::CookedScene(std::string CookedFilePath, uint64_t SourceHash) : file(CookedFilePath) {
+		std::span<const std::uint8_t> bytes = file.GetBytes();
+
+		CookedHeader header;
+		if (bytes.size() < sizeof(CookedHeader)) {
+			throw std::invalid_argument("Tried to load a invalid cooked MP file.");
+		}
+		std::memcpy(&header, bytes.data(), sizeof(CookedHeader));
+
+		if (!IsValidHeader(header, SourceHash, bytes.size())) {
+			throw std::invalid_argument("Tried to load a invalid cooked MP file.");
+		}
+
+		// Everything is read once by the upload, so start paging it all in now
+		file.Prefetch(0, bytes.size());
+
+		scene.vertices = GetSection<renderer::Vertex>(bytes, header.sections[VERTICES]);
+		scene.indices = GetSection<uint32_t>(bytes, header.sections[INDICES]);
+		scene.instance_data = GetSection<renderer::InstanceData>(bytes, header.sections[INSTANCES]);
+		scene.bounding_data = GetSection<renderer::BoundingBoxData>(bytes, header.sections[BOUNDS]);
+		scene.draw_commands = GetSection<VkDrawIndexedIndirectCommand>(bytes, header.sections[DRAW_COMMANDS]);
+		scene.materials = GetSection<renderer::MaterialData>(bytes, header.sections[MATERIALS]);
+		scene.mesh_decode = GetSection<renderer::MeshDecodeData>(bytes, header.sections[MESH_DECODE]);
+		scene.mesh_count = header.mesh_count;
+		scene.scene_root = glm::vec3(header.scene_root[0], header.scene_root[1], header.scene_root[2]);
+	}
+
+	const renderer::scene::SceneView& CookedScene::GetSceneView() const {
+		return scene;
+	}
+
+} // namespace MP
\ No newline at end of file
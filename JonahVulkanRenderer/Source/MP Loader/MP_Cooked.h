@@ -0,0 +1,37 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include "MP_MappedFile.h"
+#include "../Renderer/VkUtil/VkSceneProcesser.h"
+
+// Cooked scenes (.mpc) hold the final vertex, index, instance, bounds, draw command, material and mesh decode arrays of a parsed .mp,
+// each in its own page aligned section, so a warm start can hand them to the GPU upload with no CPU work.
+namespace MP {
+
+	// Content hash of a source .mp, the key of its cooked file.
+	uint64_t HashMP(std::string MP_FilePath);
+
+	// Where the cooked file for a source hash lives (Cache/<hash>.mpc).
+	std::string GetCookedPath(uint64_t SourceHash);
+
+	// True when the file is a cooked scene of SourceHash written by a build with the same struct layouts.
+	bool CheckValidCooked(std::string CookedFilePath, uint64_t SourceHash);
+
+	// Written to a temp file first and renamed into place, so a crash never leaves a half written cache behind.
+	// Works on parsers made without CopyGeometry, the geometry is written out in small pieces.
+	void WriteCookedScene(std::string CookedFilePath, uint64_t SourceHash, const renderer::scene::SceneParser& Scene);
+
+	// A mapped cooked file. The SceneView points straight into the mapping and is only valid while this lives.
+	class CookedScene {
+
+	public:
+		CookedScene(std::string CookedFilePath, uint64_t SourceHash);
+
+		const renderer::scene::SceneView& GetSceneView() const;
+
+	private:
+		MappedFile file;
+		renderer::scene::SceneView scene;
+	};
+
+} // namespace MP
\ No newline at end of file
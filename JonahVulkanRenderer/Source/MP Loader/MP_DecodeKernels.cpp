@@ -0,0 +1,251 @@
+#include "MP_DecodeKernels.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define MP_SIMD_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// MSVC lets any function use any intrinsic, GCC and Clang need the target enabled per function.
+#if defined(_MSC_VER) && !defined(__clang__)
+#define MP_TARGET_SSE41
+#define MP_TARGET_AVX2
+#else
+#define MP_TARGET_SSE41 __attribute__((target("sse4.1")))
+#define MP_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+static_assert(sizeof(renderer::Vertex) == 6 * sizeof(float), "Kernels write Vertex as 6 packed floats.");
+static_assert(offsetof(renderer::Vertex, position) == 0 && offsetof(renderer::Vertex, normal) == 12);
+static_assert(sizeof(glm::mat4) == 16 * sizeof(float));
+
+namespace {
+
+	using InterleaveFunction = void(*)(const std::uint8_t*, const std::uint8_t*, uint32_t, float*);
+	using WidenFunction = void(*)(const std::uint8_t*, uint32_t, uint32_t*);
+	using MatrixFunction = void(*)(const std::uint8_t*, uint32_t, float*);
+
+#pragma region Scalar
+
+	// Count vertices, all with normals. Output is Count * 6 floats.
+	void InterleaveScalar(const std::uint8_t* Positions, const std::uint8_t* Normals, uint32_t Count, float* Output) {
+		for (uint32_t i = 0; i < Count; i++) {
+			std::memcpy(Output, Positions + i * 12, 12);
+			std::memcpy(Output + 3, Normals + i * 12, 12);
+			Output += 6;
+		}
+	}
+
+	void WidenScalar(const std::uint8_t* Indices, uint32_t Count, uint32_t* Output) {
+		for (uint32_t i = 0; i < Count; i++) {
+			uint16_t x;
+			std::memcpy(&x, Indices + i * 2, 2);
+			Output[i] = x;
+		}
+	}
+
+	void CopyMatricesScalar(const std::uint8_t* Matrices, uint32_t Count, float* Output) {
+		std::memcpy(Output, Matrices, size_t(Count) * 64);
+		for (uint32_t i = 0; i < Count; i++) {
+			Output[i * 16 + 15] = 1.0f;
+		}
+	}
+
+#pragma endregion
+
+#ifdef MP_SIMD_X86
+
+#pragma region SSE4.1
+
+	// Four vertices per step: 12 position floats + 12 normal floats in, 24 interleaved floats out.
+	// P0..P2 / N0..N2 are the three 4-wide loads of each stream.
+	MP_TARGET_SSE41 void InterleaveSSE41(const std::uint8_t* Positions, const std::uint8_t* Normals, uint32_t Count, float* Output) {
+
+		uint32_t i = 0;
+		for (; i + 4 <= Count; i += 4) {
+			const float* p = reinterpret_cast<const float*>(Positions + i * 12);
+			const float* n = reinterpret_cast<const float*>(Normals + i * 12);
+
+			__m128 P0 = _mm_loadu_ps(p);		// p0x p0y p0z p1x
+			__m128 P1 = _mm_loadu_ps(p + 4);	// p1y p1z p2x p2y
+			__m128 P2 = _mm_loadu_ps(p + 8);	// p2z p3x p3y p3z
+			__m128 N0 = _mm_loadu_ps(n);
+			__m128 N1 = _mm_loadu_ps(n + 4);
+			__m128 N2 = _mm_loadu_ps(n + 8);
+
+			__m128 out0 = _mm_blend_ps(P0, _mm_shuffle_ps(N0, N0, _MM_SHUFFLE(0, 0, 0, 0)), 0b1000);									// p0x p0y p0z n0x
+			__m128 out1 = _mm_shuffle_ps(N0, _mm_shuffle_ps(P0, P1, _MM_SHUFFLE(0, 0, 3, 3)), _MM_SHUFFLE(2, 0, 2, 1));				// n0y n0z p1x p1y
+			__m128 out2 = _mm_shuffle_ps(_mm_shuffle_ps(P1, N0, _MM_SHUFFLE(3, 3, 1, 1)), N1, _MM_SHUFFLE(1, 0, 2, 0));				// p1z n1x n1y n1z
+			__m128 out3 = _mm_shuffle_ps(P1, _mm_shuffle_ps(P2, N1, _MM_SHUFFLE(2, 2, 0, 0)), _MM_SHUFFLE(2, 0, 3, 2));				// p2x p2y p2z n2x
+			__m128 out4 = _mm_shuffle_ps(_mm_shuffle_ps(N1, N2, _MM_SHUFFLE(0, 0, 3, 3)), P2, _MM_SHUFFLE(2, 1, 2, 0));				// n2y n2z p3x p3y
+			__m128 out5 = _mm_blend_ps(N2, _mm_shuffle_ps(P2, P2, _MM_SHUFFLE(3, 3, 3, 3)), 0b0001);									// p3z n3x n3y n3z
+
+			float* o = Output + i * 6;
+			_mm_storeu_ps(o, out0);
+			_mm_storeu_ps(o + 4, out1);
+			_mm_storeu_ps(o + 8, out2);
+			_mm_storeu_ps(o + 12, out3);
+			_mm_storeu_ps(o + 16, out4);
+			_mm_storeu_ps(o + 20, out5);
+		}
+
+		InterleaveScalar(Positions + i * 12, Normals + i * 12, Count - i, Output + i * 6);
+	}
+
+	MP_TARGET_SSE41 void WidenSSE41(const std::uint8_t* Indices, uint32_t Count, uint32_t* Output) {
+		uint32_t i = 0;
+		for (; i + 8 <= Count; i += 8) {
+			__m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(Indices + i * 2));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(Output + i), _mm_cvtepu16_epi32(x));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(Output + i + 4), _mm_cvtepu16_epi32(_mm_srli_si128(x, 8)));
+		}
+
+		WidenScalar(Indices + i * 2, Count - i, Output + i);
+	}
+
+	MP_TARGET_SSE41 void CopyMatricesSSE41(const std::uint8_t* Matrices, uint32_t Count, float* Output) {
+		const __m128 one = _mm_set1_ps(1.0f);
+
+		for (uint32_t i = 0; i < Count; i++) {
+			const float* m = reinterpret_cast<const float*>(Matrices + size_t(i) * 64);
+			float* o = Output + size_t(i) * 16;
+
+			_mm_storeu_ps(o, _mm_loadu_ps(m));
+			_mm_storeu_ps(o + 4, _mm_loadu_ps(m + 4));
+			_mm_storeu_ps(o + 8, _mm_loadu_ps(m + 8));
+			_mm_storeu_ps(o + 12, _mm_blend_ps(_mm_loadu_ps(m + 12), one, 0b1000));
+		}
+	}
+
+#pragma endregion
+
+#pragma region AVX2
+
+	// Vertex interleave stays on the 128-bit kernel, its 6-float stride would need cross-lane shuffles on 8-wide registers.
+	MP_TARGET_AVX2 void WidenAVX2(const std::uint8_t* Indices, uint32_t Count, uint32_t* Output) {
+		uint32_t i = 0;
+		for (; i + 16 <= Count; i += 16) {
+			__m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(Indices + i * 2));
+			__m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(Indices + i * 2 + 16));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(Output + i), _mm256_cvtepu16_epi32(lo));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(Output + i + 8), _mm256_cvtepu16_epi32(hi));
+		}
+
+		WidenScalar(Indices + i * 2, Count - i, Output + i);
+	}
+
+	MP_TARGET_AVX2 void CopyMatricesAVX2(const std::uint8_t* Matrices, uint32_t Count, float* Output) {
+		const __m256 one = _mm256_set1_ps(1.0f);
+
+		for (uint32_t i = 0; i < Count; i++) {
+			const float* m = reinterpret_cast<const float*>(Matrices + size_t(i) * 64);
+			float* o = Output + size_t(i) * 16;
+
+			_mm256_storeu_ps(o, _mm256_loadu_ps(m));
+			_mm256_storeu_ps(o + 8, _mm256_blend_ps(_mm256_loadu_ps(m + 8), one, 0b10000000));
+		}
+	}
+
+#pragma endregion
+
+	bool CPUSupportsAVX2() {
+#ifdef _MSC_VER
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] < 7) return false;
+
+		__cpuid(info, 1);
+		bool os_saves_ymm = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && ((_xgetbv(0) & 0x6) == 0x6);
+
+		__cpuidex(info, 7, 0);
+		return os_saves_ymm && (info[1] & (1 << 5));
+#else
+		return __builtin_cpu_supports("avx2");
+#endif
+	}
+
+	bool CPUSupportsSSE41() {
+#ifdef _MSC_VER
+		int info[4];
+		__cpuid(info, 1);
+		return (info[2] & (1 << 19)) != 0;
+#else
+		return __builtin_cpu_supports("sse4.1");
+#endif
+	}
+
+#endif // MP_SIMD_X86
+
+	struct KernelTable {
+		MP::kernels::SIMDLEVEL level = MP::kernels::SCALAR;
+		InterleaveFunction interleave = InterleaveScalar;
+		WidenFunction widen = WidenScalar;
+		MatrixFunction matrices = CopyMatricesScalar;
+	};
+
+	KernelTable PickKernels() {
+		KernelTable table;
+
+#ifdef MP_SIMD_X86
+		if (CPUSupportsSSE41()) {
+			table.level = MP::kernels::SSE41;
+			table.interleave = InterleaveSSE41;
+			table.widen = WidenSSE41;
+			table.matrices = CopyMatricesSSE41;
+		}
+
+		if (table.level == MP::kernels::SSE41 && CPUSupportsAVX2()) {
+			table.level = MP::kernels::AVX2;
+			table.widen = WidenAVX2;
+			table.matrices = CopyMatricesAVX2;
+		}
+#endif
+
+		return table;
+	}
+
+	const KernelTable& GetKernels() {
+		static const KernelTable table = PickKernels();
+		return table;
+	}
+}
+
+namespace MP::kernels {
+
+	SIMDLEVEL GetSIMDLevel() {
+		return GetKernels().level;
+	}
+
+	const char* GetSIMDLevelName(SIMDLEVEL Level) {
+		switch (Level) {
+		case AVX2: return "AVX2";
+		case SSE41: return "SSE4.1";
+		default: return "Scalar";
+		}
+	}
+
+	void InterleaveVertices(const std::uint8_t* Positions, const std::uint8_t* Normals, uint32_t VertexCount, uint32_t NormalCount, renderer::Vertex* Output) {
+
+		uint32_t with_normals = std::min(VertexCount, NormalCount);
+		GetKernels().interleave(Positions, Normals, with_normals, reinterpret_cast<float*>(Output));
+
+		for (uint32_t i = with_normals; i < VertexCount; i++) {
+			std::memcpy(&Output[i].position, Positions + i * 12, 12);
+			Output[i].normal = { 0, 0, 0 };
+		}
+	}
+
+	void WidenIndices(const std::uint8_t* Indices, uint32_t IndexCount, uint32_t* Output) {
+		GetKernels().widen(Indices, IndexCount, Output);
+	}
+
+	void CopyMatrices(const std::uint8_t* Matrices, uint32_t MatrixCount, glm::mat4* Output) {
+		GetKernels().matrices(Matrices, MatrixCount, reinterpret_cast<float*>(Output));
+	}
+
+} // namespace MP::kernels
\ No newline at end of file
@@ -0,0 +1,22 @@
+#pragma once
+#include <cstdint>
+#include "../Renderer/VkUtil/VkCommon.h"
+
+// Bulk decode kernels used by the MP parser. The best implementation for the running CPU (AVX2, SSE4.1 or scalar)
+// is picked once on first use. Inputs are raw little-endian .mp arrays and may be unaligned.
+namespace MP::kernels {
+
+	enum SIMDLEVEL { SCALAR, SSE41, AVX2 };
+
+	SIMDLEVEL GetSIMDLevel();
+	const char* GetSIMDLevelName(SIMDLEVEL Level);
+
+	// Builds VertexCount vertices from float3 position and normal streams. Vertices past NormalCount get a zero normal.
+	void InterleaveVertices(const std::uint8_t* Positions, const std::uint8_t* Normals, uint32_t VertexCount, uint32_t NormalCount, renderer::Vertex* Output);
+
+	void WidenIndices(const std::uint8_t* Indices, uint32_t IndexCount, uint32_t* Output);
+
+	// Copies column-major float4x4 matrices, forcing the w of column 3 to 1.0f.
+	void CopyMatrices(const std::uint8_t* Matrices, uint32_t MatrixCount, glm::mat4* Output);
+
+} // namespace MP::kernels
\ No newline at end of file
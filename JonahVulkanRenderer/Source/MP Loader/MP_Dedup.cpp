@@ -0,0 +1,169 @@
+#include "MP_Dedup.h"
+#include "../Util/Hash.h"
+#include "../Util/JobSystem.h"
+#include "../Util/MemoryStats.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+	using renderer::MeshInstances;
+	using renderer::Vertex;
+
+	bool HasGeometry(const MeshInstances& Model) {
+		return Model.mesh.vertices.size() > 0 && Model.mesh.indices.size() > 0;
+	}
+
+	// Vertex is packed position + normal, so hashing it in place gives the same keys as the old position/normal copy
+	static_assert(sizeof(Vertex) == 6 * sizeof(float));
+
+	// Geometry only, see DeduplicateMeshes for why the material is left out
+	uint64_t HashGeometry(const MeshInstances& Model) {
+		std::span<const std::uint8_t> vertex_bytes(reinterpret_cast<const std::uint8_t*>(Model.mesh.vertices.data()), Model.mesh.vertices.size_bytes());
+		std::span<const std::uint8_t> index_bytes(reinterpret_cast<const std::uint8_t*>(Model.mesh.indices.data()), Model.mesh.indices.size_bytes());
+
+		return util::Hash64(index_bytes, util::Hash64(vertex_bytes));
+	}
+
+	bool SameGeometry(const MeshInstances& A, const MeshInstances& B) {
+		if (A.mesh.vertices.size() != B.mesh.vertices.size() || A.mesh.indices.size() != B.mesh.indices.size()) {
+			return false;
+		}
+
+		if (std::memcmp(A.mesh.indices.data(), B.mesh.indices.data(), A.mesh.indices.size_bytes()) != 0) {
+			return false;
+		}
+
+		return std::memcmp(A.mesh.vertices.data(), B.mesh.vertices.data(), A.mesh.vertices.size_bytes()) == 0;
+	}
+
+} // namespace unnamed
+
+namespace MP {
+
+	void DedupStats::Print() const {
+		std::cout << "Deduplicated " << meshes_before << " meshes to " << meshes_after << ", " << util::BytesToMegabytes(bytes_saved) << " MB of geometry not uploaded";
+		std::cout << " (" << seconds * 1000.0 << "ms)." << std::endl;
+	}
+
+	DedupStats DeduplicateMeshes(renderer::ModelSet& Set) {
+		auto start = std::chrono::high_resolution_clock::now();
+
+		DedupStats stats;
+		uint32_t model_count = static_cast<uint32_t>(Set.models.size());
+		stats.meshes_before = model_count;
+
+		std::vector<uint64_t> hashes(model_count);
+		std::vector<uint64_t> costs(model_count);
+		for (uint32_t i = 0; i < model_count; i++) {
+			costs[i] = Set.models[i].mesh.vertices.size_bytes() + Set.models[i].mesh.indices.size_bytes();
+		}
+
+		util::JobSystem& job_system = util::GetJobSystem();
+		job_system.ParallelFor(model_count, [&](uint32_t i) {
+			if (HasGeometry(Set.models[i])) {
+				hashes[i] = HashGeometry(Set.models[i]);
+			}
+		}, costs);
+
+		// Same hash buckets in file order, so the first model of a bucket is always a keeper
+		std::unordered_map<uint64_t, std::vector<uint32_t>> buckets;
+		std::vector<const std::vector<uint32_t>*> bucket_of(model_count, nullptr);
+		for (uint32_t i = 0; i < model_count; i++) {
+			if (HasGeometry(Set.models[i])) {
+				buckets[hashes[i]].push_back(i);
+			}
+		}
+		for (uint32_t i = 0; i < model_count; i++) {
+			if (HasGeometry(Set.models[i])) {
+				bucket_of[i] = &buckets[hashes[i]];
+			}
+		}
+
+		// Equal geometry is transitive, so the first equal model in a bucket is itself a keeper
+		std::vector<uint32_t> keeper(model_count);
+		job_system.ParallelFor(model_count, [&](uint32_t i) {
+			keeper[i] = i;
+			if (bucket_of[i] == nullptr) return;
+
+			for (uint32_t candidate : *bucket_of[i]) {
+				if (candidate >= i) break;
+				if (SameGeometry(Set.models[candidate], Set.models[i])) {
+					keeper[i] = candidate;
+					break;
+				}
+			}
+		}, costs);
+
+		std::vector<uint32_t> merged_instance_count(model_count, 0);
+		std::vector<uint32_t> group_size(model_count, 0);
+		for (uint32_t i = 0; i < model_count; i++) {
+			merged_instance_count[keeper[i]] += Set.models[i].instance_count;
+			group_size[keeper[i]]++;
+		}
+
+		// Merged matrices go in one new arena block, lone meshes keep theirs
+		uint64_t matrix_count = 0;
+		for (uint32_t i = 0; i < model_count; i++) {
+			if (keeper[i] == i && group_size[i] > 1) {
+				matrix_count += merged_instance_count[i];
+			}
+		}
+
+		if (matrix_count == 0) {
+			stats.meshes_after = model_count;
+			stats.seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+			return stats;
+		}
+
+		uint64_t block_size = matrix_count * sizeof(glm::mat4);
+		Set.arena_blocks.push_back(std::make_unique_for_overwrite<std::byte[]>(static_cast<size_t>(block_size)));
+		Set.arena_size += block_size;
+		glm::mat4* matrices = reinterpret_cast<glm::mat4*>(Set.arena_blocks.back().get());
+
+		std::vector<std::span<glm::mat4>> merged_matrices(model_count);
+		for (uint32_t i = 0; i < model_count; i++) {
+			if (keeper[i] == i && group_size[i] > 1) {
+				merged_matrices[i] = std::span<glm::mat4>(matrices, merged_instance_count[i]);
+				matrices += merged_instance_count[i];
+			}
+		}
+
+		std::vector<uint32_t> written(model_count, 0);
+		for (uint32_t i = 0; i < model_count; i++) {
+			uint32_t k = keeper[i];
+			if (group_size[k] < 2) continue;
+
+			const MeshInstances& model = Set.models[i];
+			std::copy_n(model.instance_model_matrices.begin(), model.instance_count, merged_matrices[k].begin() + written[k]);
+			written[k] += model.instance_count;
+
+			if (k != i) {
+				stats.bytes_saved += model.mesh.vertices.size_bytes() + model.mesh.indices.size_bytes();
+			}
+		}
+
+		std::vector<MeshInstances> models;
+		models.reserve(model_count);
+		for (uint32_t i = 0; i < model_count; i++) {
+			if (keeper[i] != i) continue;
+
+			MeshInstances model = Set.models[i];
+			if (group_size[i] > 1) {
+				model.instance_count = merged_instance_count[i];
+				model.instance_model_matrices = merged_matrices[i];
+			}
+			models.push_back(model);
+		}
+
+		Set.models = std::move(models);
+		stats.meshes_after = static_cast<uint32_t>(Set.models.size());
+		stats.seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+		return stats;
+	}
+
+} // namespace MP
\ No newline at end of file
@@ -0,0 +1,24 @@
+#pragma once
+#include <cstdint>
+#include "../Renderer/VkUtil/VkCommon.h"
+
+namespace MP {
+
+	struct DedupStats {
+		uint32_t meshes_before = 0;
+		uint32_t meshes_after = 0;
+		uint64_t bytes_saved = 0;	// Vertex and index bytes no longer uploaded
+		double seconds = 0;
+
+		void Print() const;
+	};
+
+	// Merges meshes with the same geometry into one mesh holding every instance, so each shape is uploaded and drawn once.
+	// Exporters name meshes by prim, so the same geometry often comes in as many objects.
+	// Positions, normals and indices are hashed in parallel and matches are compared byte for byte before merging.
+	// Materials are a per object debug tint and are ignored, a merged mesh keeps the material of its first object.
+	// Meshes keep the order of their first object and instances keep object order, so the scene root does not move.
+	// Dropped meshes stay in the arena until the set is freed, only what is handed to SceneParser shrinks.
+	DedupStats DeduplicateMeshes(renderer::ModelSet& Set);
+
+} // namespace MP
\ No newline at end of file
@@ -0,0 +1,135 @@
+#include "MP_FileWatcher.h"
+#include <array>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+#endif
+
+namespace MP {
+
+	FileWatcher::FileWatcher(const std::string& FilePath, uint32_t SettleMilliseconds)
+		: file_path(FilePath), settle_time(SettleMilliseconds) {
+
+		std::filesystem::path path(FilePath);
+		file_name = path.filename().string();
+
+		std::filesystem::path folder = path.parent_path();
+		if (folder.empty()) {
+			folder = ".";
+		}
+
+		CheckTimestamp();
+		last_poll = std::chrono::steady_clock::now();
+
+#ifdef _WIN32
+		HANDLE handle = FindFirstChangeNotificationW(folder.wstring().c_str(), FALSE, FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_SIZE);
+		change_handle = handle == INVALID_HANDLE_VALUE ? nullptr : handle;
+#elif defined(__linux__)
+		// Close after write and rename into place, never a half written file
+		inotify_descriptor = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+		if (inotify_descriptor >= 0 && inotify_add_watch(inotify_descriptor, folder.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+			close(inotify_descriptor);
+			inotify_descriptor = -1;
+		}
+#endif
+	}
+
+	FileWatcher::~FileWatcher() {
+#ifdef _WIN32
+		if (change_handle != nullptr) {
+			FindCloseChangeNotification(change_handle);
+		}
+#else
+		if (inotify_descriptor >= 0) {
+			close(inotify_descriptor);
+		}
+#endif
+	}
+
+	// True when the file's write time or size moved since the last call
+	bool FileWatcher::CheckTimestamp() {
+		std::error_code error;
+		std::filesystem::file_time_type write_time = std::filesystem::last_write_time(file_path, error);
+		if (error) return false;
+		uintmax_t size = std::filesystem::file_size(file_path, error);
+		if (error) return false;
+
+		bool changed = write_time != last_write_time || size != last_size;
+		last_write_time = write_time;
+		last_size = size;
+		return changed;
+	}
+
+	bool FileWatcher::PollChanged() {
+		auto now = std::chrono::steady_clock::now();
+		bool changed = false;
+
+#ifdef _WIN32
+		// Fires for anything in the folder, the timestamp says whether it was this file
+		if (change_handle != nullptr) {
+			while (WaitForSingleObject(change_handle, 0) == WAIT_OBJECT_0) {
+				changed = true;
+				FindNextChangeNotification(change_handle);
+			}
+			changed = changed && CheckTimestamp();
+		}
+#elif defined(__linux__)
+		if (inotify_descriptor >= 0) {
+			alignas(inotify_event) std::array<char, 4096> events;
+			ssize_t length;
+			while ((length = read(inotify_descriptor, events.data(), events.size())) > 0) {
+				for (ssize_t offset = 0; offset < length;) {
+					const inotify_event* event = reinterpret_cast<const inotify_event*>(events.data() + offset);
+					if ((event->mask & IN_Q_OVERFLOW) || (event->len > 0 && file_name == event->name)) {
+						changed = true;
+					}
+					offset += sizeof(inotify_event) + event->len;
+				}
+			}
+		}
+#endif
+
+		// No notifications on this platform or folder, check a few times a second instead
+		bool polling;
+#ifdef _WIN32
+		polling = change_handle == nullptr;
+#else
+		polling = inotify_descriptor < 0;
+#endif
+		if (polling && now - last_poll >= std::chrono::milliseconds(250)) {
+			last_poll = now;
+			changed = CheckTimestamp();
+		}
+
+		if (changed) {
+			pending = true;
+			last_event = now;
+		}
+
+		if (pending && now - last_event >= settle_time) {
+			pending = false;
+			return true;
+		}
+		return false;
+	}
+
+	const std::string& FileWatcher::GetPath() const {
+		return file_path;
+	}
+
+	const char* FileWatcher::GetBackendName() const {
+#ifdef _WIN32
+		return change_handle != nullptr ? "folder change notification" : "timestamp poll";
+#else
+		return inotify_descriptor >= 0 ? "inotify" : "timestamp poll";
+#endif
+	}
+
+} // namespace MP
\ No newline at end of file
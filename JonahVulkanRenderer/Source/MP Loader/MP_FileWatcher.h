@@ -0,0 +1,50 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+
+namespace MP {
+
+	// Tells when a file has been rewritten, for hot reloading a scene while it is edited or re-exported.
+	// inotify on Linux, a change notification on the file's folder on Windows, and a timestamp poll elsewhere.
+	// The folder is watched rather than the file, so writers that replace it by renaming a temp file are seen too.
+	class FileWatcher {
+
+	public:
+		// A change is only reported once the file has been left alone for SettleMilliseconds, so an export that
+		// writes in several passes reloads once.
+		explicit FileWatcher(const std::string& FilePath, uint32_t SettleMilliseconds = 150);
+		~FileWatcher();
+
+		FileWatcher(const FileWatcher&) = delete;
+		FileWatcher& operator=(const FileWatcher&) = delete;
+
+		// Never blocks. True once per settled change, call it every frame.
+		bool PollChanged();
+
+		const std::string& GetPath() const;
+		const char* GetBackendName() const;
+
+	private:
+		bool CheckTimestamp();
+
+		std::string file_path;
+		std::string file_name;
+		std::chrono::milliseconds settle_time;
+
+		bool pending = false;
+		std::chrono::steady_clock::time_point last_event;
+		std::chrono::steady_clock::time_point last_poll;
+
+		std::filesystem::file_time_type last_write_time;
+		uintmax_t last_size = 0;
+
+#ifdef _WIN32
+		void* change_handle = nullptr;
+#else
+		int inotify_descriptor = -1;
+#endif
+	};
+
+} // namespace MP
\ No newline at end of file
@@ -0,0 +1,191 @@
+#include "MP_Format.h"
+#include "MP_Codec.h"
+#include <string>
+
+namespace MP::format {
+
+	uint64_t ObjectHeader::ObjectByteSize() const {
+		if (encoding == ENCODING_PACKED) {
+			return header_size + packed_size;
+		}
+		return header_size + RawArrayByteSize();
+	}
+
+	uint64_t ObjectHeader::RawArrayByteSize() const {
+		return uint64_t(vertex_count) * 3 * sizeof(float)
+			+ uint64_t(index_count) * index_width
+			+ uint64_t(normal_count) * 3 * sizeof(float)
+			+ uint64_t(instance_count) * 16 * sizeof(float);
+	}
+
+	bool ObjectHeader::IsMeshReference() const {
+		return (flags & OBJECT_HAS_KEY) && vertex_count == 0 && index_count == 0;
+	}
+
+	FileLayout ReadFileLayout(std::span<const std::uint8_t> Bytes) {
+		FileLayout layout;
+
+		if (Bytes.size() < V1HeaderSize || ReadValue<uint16_t>(Bytes, 0) != Magic) {
+			throw std::invalid_argument("Tried to parse a invalid MP file.");
+		}
+
+		uint32_t v1_model_count = ReadValue<uint32_t>(Bytes, 2);
+
+		if (v1_model_count != VersionEscape) {
+			layout.version = 1;
+
+			uint64_t pointer_table_end = V1HeaderSize + uint64_t(v1_model_count) * sizeof(uint32_t);
+			ArrayView<uint32_t> pointers = ReadArray<uint32_t>(Bytes, V1HeaderSize, v1_model_count);
+
+			// v1 pointers count from the end of the pointer table
+			layout.object_offsets.resize(v1_model_count);
+			for (uint32_t i = 0; i < v1_model_count; i++) {
+				layout.object_offsets[i] = pointer_table_end + pointers[i];
+			}
+			return layout;
+		}
+
+		layout.version = ReadValue<uint16_t>(Bytes, 6);
+		layout.flags = ReadValue<uint32_t>(Bytes, 8);
+		uint64_t model_count = ReadValue<uint64_t>(Bytes, 16);
+
+		if (layout.version < 2 || layout.version > LatestVersion) {
+			throw std::invalid_argument("Unsupported MP version " + std::to_string(layout.version) + ".");
+		}
+
+		if ((layout.flags & ~KnownFileFlags) != 0) {
+			throw std::invalid_argument("MP file uses flags this reader does not support.");
+		}
+
+		// Every offset is 8 bytes, so a count the file can not hold is rejected before anything is allocated
+		if (model_count > (Bytes.size() - V2HeaderSize) / sizeof(uint64_t) || model_count > UINT32_MAX) {
+			throw std::runtime_error("Out of bounds");
+		}
+
+		ArrayView<uint64_t> offsets = ReadArray<uint64_t>(Bytes, V2HeaderSize, model_count);
+
+		layout.object_offsets.resize(static_cast<size_t>(model_count));
+		for (size_t i = 0; i < layout.object_offsets.size(); i++) {
+			layout.object_offsets[i] = offsets[i];
+		}
+
+		if (layout.flags & FILE_HAS_TILES) {
+			layout.tile_table_offset = V2HeaderSize + model_count * sizeof(uint64_t);
+		}
+
+		return layout;
+	}
+
+	ObjectHeader ReadObjectHeader(std::span<const std::uint8_t> Bytes, uint64_t Offset, uint16_t Version) {
+		ObjectHeader header;
+		header.vertex_count = ReadValue<uint32_t>(Bytes, Offset);
+		header.index_count = ReadValue<uint32_t>(Bytes, Offset + 4);
+		header.normal_count = ReadValue<uint32_t>(Bytes, Offset + 8);
+		header.instance_count = ReadValue<uint32_t>(Bytes, Offset + 12);
+
+		if (Version == 1) {
+			return header;
+		}
+
+		header.index_width = ReadValue<uint8_t>(Bytes, Offset + 16);
+		header.encoding = ReadValue<uint8_t>(Bytes, Offset + 17);
+		header.flags = ReadValue<uint16_t>(Bytes, Offset + 18);
+		header.header_size = V2ObjectHeaderSize;
+
+		if (header.index_width != 2 && header.index_width != 4) {
+			throw std::runtime_error("Unsupported MP index width");
+		}
+
+		if (header.encoding != ENCODING_RAW && header.encoding != ENCODING_PACKED) {
+			throw std::runtime_error("Unsupported MP object encoding");
+		}
+
+		if (header.flags & OBJECT_HAS_BOUNDS) {
+			ArrayView<float> bounds = ReadArray<float>(Bytes, Offset + header.header_size, 6);
+			for (int i = 0; i < 6; i++) {
+				header.bounds[i] = bounds[i];
+			}
+			header.header_size += BoundsSize;
+		}
+
+		if (header.flags & OBJECT_HAS_KEY) {
+			header.mesh_key = ReadValue<uint64_t>(Bytes, Offset + header.header_size);
+			header.header_size += KeySize;
+		}
+
+		if (header.encoding == ENCODING_PACKED) {
+			if ((header.flags & OBJECT_HAS_BOUNDS) == 0) {
+				throw std::runtime_error("Packed MP object is missing its bounds");
+			}
+
+			header.packed_size = ReadValue<uint64_t>(Bytes, Offset + header.header_size);
+			header.unpacked_size = ReadValue<uint64_t>(Bytes, Offset + header.header_size + 8);
+			header.header_size += PackedSizesSize;
+
+			// Keeps a corrupt size from asking for a huge decode buffer
+			uint64_t fixed_size = codec::UnpackedFixedSize(header);
+			if (header.unpacked_size < fixed_size + header.index_count || header.unpacked_size > fixed_size + uint64_t(header.index_count) * 5) {
+				throw std::runtime_error("Packed MP object has a bad unpacked size");
+			}
+		}
+
+		return header;
+	}
+
+	TileTable ReadTileTable(std::span<const std::uint8_t> Bytes, const FileLayout& Layout) {
+		TileTable table;
+
+		if ((Layout.flags & FILE_HAS_TILES) == 0) {
+			return table;
+		}
+
+		uint64_t tile_count = ReadValue<uint64_t>(Bytes, Layout.tile_table_offset);
+		table.entry_count = ReadValue<uint64_t>(Bytes, Layout.tile_table_offset + 8);
+
+		uint64_t tiles_offset = Layout.tile_table_offset + TileTableHeaderSize;
+
+		// Same guard as the object count, nothing is allocated for counts the file can not hold
+		if (tile_count > Bytes.size() / TileSize || table.entry_count > Bytes.size() / TileEntrySize) {
+			throw std::runtime_error("Out of bounds");
+		}
+
+		table.entries_offset = tiles_offset + tile_count * TileSize;
+		if (!RangeInBounds(table.entries_offset, table.entry_count * TileEntrySize, Bytes.size())) {
+			throw std::runtime_error("Out of bounds");
+		}
+
+		table.tiles.resize(static_cast<size_t>(tile_count));
+		for (size_t i = 0; i < table.tiles.size(); i++) {
+			Tile& tile = table.tiles[i];
+			uint64_t offset = tiles_offset + i * TileSize;
+
+			ArrayView<float> bounds = ReadArray<float>(Bytes, offset, 6);
+			for (int k = 0; k < 6; k++) {
+				tile.bounds[k] = bounds[k];
+			}
+
+			tile.first_entry = ReadValue<uint64_t>(Bytes, offset + 24);
+			tile.entry_count = ReadValue<uint32_t>(Bytes, offset + 32);
+
+			if (tile.first_entry > table.entry_count || tile.entry_count > table.entry_count - tile.first_entry) {
+				throw std::runtime_error("MP tile lists entries past the end of the tile table");
+			}
+		}
+
+		return table;
+	}
+
+	std::vector<TileEntry> ReadTileEntries(std::span<const std::uint8_t> Bytes, const TileTable& Table, const Tile& TileToRead) {
+		ArrayView<uint32_t> values = ReadArray<uint32_t>(Bytes, Table.entries_offset + TileToRead.first_entry * TileEntrySize, uint64_t(TileToRead.entry_count) * 3);
+
+		std::vector<TileEntry> entries(TileToRead.entry_count);
+		for (size_t i = 0; i < entries.size(); i++) {
+			entries[i].object_index = values[i * 3];
+			entries[i].instances.first = values[i * 3 + 1];
+			entries[i].instances.count = values[i * 3 + 2];
+		}
+
+		return entries;
+	}
+
+} // namespace MP::format
\ No newline at end of file
@@ -0,0 +1,169 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+// Layout of the .mp format, shared by the parser, writer and tools. See ExternalTools/README.md for the full layout.
+//
+// v1 files are the magic, a uint32 object count and uint32 object pointers relative to the end of the pointer table.
+// v2 files put VersionEscape where the v1 count would be (a v1 file can never hold that many objects), followed by
+// a version, flags, a uint64 object count and uint64 object offsets from the start of the file.
+// Tiled v2 files (FILE_HAS_TILES) follow the offsets with a tile table, see ReadTileTable.
+namespace MP::format {
+
+	constexpr uint16_t Magic = 0x4D50; // MP in Hex
+	constexpr uint32_t VersionEscape = 0xFFFFFFFF;
+	constexpr uint16_t LatestVersion = 2;
+
+	constexpr uint64_t V1HeaderSize = 6;
+	constexpr uint64_t V2HeaderSize = 24;
+
+	// File flags. Readers refuse files with bits they do not know, so a new bit may change the layout.
+	constexpr uint32_t FILE_HAS_TILES = 1 << 0;		// A tile table follows the object offsets
+	constexpr uint32_t FILE_HAS_MESH_KEYS = 1 << 1;	// Objects may carry content keys (OBJECT_HAS_KEY)
+	constexpr uint32_t KnownFileFlags = FILE_HAS_TILES | FILE_HAS_MESH_KEYS;
+
+	constexpr uint64_t V1ObjectHeaderSize = 16;
+	constexpr uint64_t V2ObjectHeaderSize = 24;
+
+	// Object flags
+	constexpr uint16_t OBJECT_HAS_BOUNDS = 1 << 0; // 6 floats of local min/max follow the object header
+	constexpr uint16_t OBJECT_HAS_KEY = 1 << 1;	   // uint64 content key of the mesh follows the bounds, see MP_Library.h
+
+	constexpr uint64_t BoundsSize = 6 * sizeof(float);
+	constexpr uint64_t KeySize = sizeof(uint64_t);
+
+	// Object encodings
+	constexpr uint8_t ENCODING_RAW = 0;		// Float / uint16 / uint32 arrays as described in the README
+	constexpr uint8_t ENCODING_PACKED = 1;	// MP_Codec.h, needs bounds. uint64 packed size + uint64 unpacked size follow the bounds
+
+	constexpr uint64_t PackedSizesSize = 2 * sizeof(uint64_t);
+
+	// Tile table: uint64 tile count, uint64 entry count, the tiles, then the entries of every tile back to back
+	constexpr uint64_t TileTableHeaderSize = 2 * sizeof(uint64_t);
+	constexpr uint64_t TileSize = 6 * sizeof(float) + sizeof(uint64_t) + 2 * sizeof(uint32_t);
+	constexpr uint64_t TileEntrySize = 3 * sizeof(uint32_t);
+
+	// Read-only view over a packed array inside the MP byte data.
+	// Object data in .mp files is not aligned, so elements are loaded with memcpy instead of casting the pointer.
+	template <class T>
+	struct ArrayView {
+		std::span<const std::uint8_t> bytes;
+
+		size_t size() const {
+			return bytes.size() / sizeof(T);
+		}
+
+		T operator[](size_t Index) const {
+			T x;
+			std::memcpy(&x, bytes.data() + Index * sizeof(T), sizeof(T));
+			return x;
+		}
+	};
+
+	// Offset + ByteCount <= Size, written so neither side can wrap around.
+	inline bool RangeInBounds(uint64_t Offset, uint64_t ByteCount, uint64_t Size) {
+		return Offset <= Size && ByteCount <= Size - Offset;
+	}
+
+	template <class T>
+	T ReadValue(std::span<const std::uint8_t> ByteData, uint64_t Offset) {
+
+		if (!RangeInBounds(Offset, sizeof(T), ByteData.size())) {
+			throw std::runtime_error("Out of bounds");
+		}
+
+		T x;
+		std::memcpy(&x, ByteData.data() + Offset, sizeof(T));
+
+		return x;
+	}
+
+	template <class T>
+	ArrayView<T> ReadArray(std::span<const std::uint8_t> ByteData, uint64_t Offset, uint64_t OutputArraySize) {
+
+		// Counts come from 32 bit header fields, so this multiply can not overflow 64 bits
+		const uint64_t byte_count = OutputArraySize * sizeof(T);
+
+		if (!RangeInBounds(Offset, byte_count, ByteData.size())) {
+			throw std::runtime_error("Out of bounds");
+		}
+
+		return { ByteData.subspan(static_cast<size_t>(Offset), static_cast<size_t>(byte_count)) };
+	}
+
+	struct ObjectHeader {
+		uint32_t vertex_count;
+		uint32_t index_count;
+		uint32_t normal_count;
+		uint32_t instance_count;
+
+		// v2 only, v1 objects are always raw with 2 byte indices and no bounds
+		uint8_t index_width = 2;
+		uint8_t encoding = ENCODING_RAW;
+		uint16_t flags = 0;
+		float bounds[6] = {};
+		uint64_t mesh_key = 0;	// 0 without OBJECT_HAS_KEY
+
+		// ENCODING_PACKED only
+		uint64_t packed_size = 0;
+		uint64_t unpacked_size = 0;
+
+		// Everything before the object arrays (or packed bytes)
+		uint64_t header_size = V1ObjectHeaderSize;
+
+		// Size of the object inside the file.
+		uint64_t ObjectByteSize() const;
+
+		// Size the arrays take with raw encoding, what compression ratios are measured against.
+		uint64_t RawArrayByteSize() const;
+
+		// Keyed object without geometry, its mesh lives in a geometry library.
+		bool IsMeshReference() const;
+	};
+
+	struct FileLayout {
+		uint16_t version = 1;
+		uint32_t flags = 0;
+		std::vector<uint64_t> object_offsets; // From the start of the file
+		uint64_t tile_table_offset = 0;		  // Only when flags has FILE_HAS_TILES
+	};
+
+	// A run of instances inside one object.
+	struct InstanceRange {
+		uint32_t first;
+		uint32_t count;
+	};
+
+	// Instances of one object that sit in a tile. The writer sorts each object's instances by tile,
+	// so a tile's instances of an object are always one contiguous range.
+	struct TileEntry {
+		uint32_t object_index;
+		InstanceRange instances;
+	};
+
+	struct Tile {
+		float bounds[6];	  // World space min xyz, max xyz of every instance in the tile
+		uint64_t first_entry;
+		uint32_t entry_count;
+	};
+
+	struct TileTable {
+		std::vector<Tile> tiles;
+		uint64_t entry_count = 0;
+		uint64_t entries_offset = 0;
+	};
+
+	// Reads the v1 or v2 file header and turns the pointer table into absolute object offsets.
+	FileLayout ReadFileLayout(std::span<const std::uint8_t> Bytes);
+
+	ObjectHeader ReadObjectHeader(std::span<const std::uint8_t> Bytes, uint64_t Offset, uint16_t Version);
+
+	// Reads the tile list only, entries stay in the file until ReadTileEntries asks for them.
+	TileTable ReadTileTable(std::span<const std::uint8_t> Bytes, const FileLayout& Layout);
+
+	std::vector<TileEntry> ReadTileEntries(std::span<const std::uint8_t> Bytes, const TileTable& Table, const Tile& TileToRead);
+
+} // namespace MP::format
\ No newline at end of file
@@ -0,0 +1,67 @@
+#include "MP_Import.h"
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+
+namespace MP {
+
+	void ImportStats::Print() const {
+		std::cout << "Imported " << source_meshes << " meshes, " << instances << " instances, " << triangles << " triangles";
+		if (generated_normals > 0) {
+			std::cout << ", generated normals for " << generated_normals << " meshes";
+		}
+		std::cout << ". Parse " << parse_seconds * 1000.0 << "ms, build " << build_seconds * 1000.0 << "ms." << std::endl;
+	}
+
+	void GenerateNormals(ObjectSource& Object, const std::vector<bool>& Missing) {
+		size_t vertex_count = Object.positions.size() / 3;
+		std::vector<glm::vec3> sums(vertex_count, glm::vec3(0.0f));
+
+		auto position = [&](uint32_t Index) {
+			return glm::vec3(Object.positions[Index * 3], Object.positions[Index * 3 + 1], Object.positions[Index * 3 + 2]);
+		};
+
+		for (size_t t = 0; t + 2 < Object.indices.size(); t += 3) {
+			uint32_t a = Object.indices[t];
+			uint32_t b = Object.indices[t + 1];
+			uint32_t c = Object.indices[t + 2];
+
+			glm::vec3 normal = glm::cross(position(b) - position(a), position(c) - position(a));
+			float length = glm::length(normal);
+			if (!(length > 0.0f)) continue;
+
+			normal /= length;
+			sums[a] += normal;
+			sums[b] += normal;
+			sums[c] += normal;
+		}
+
+		Object.normals.resize(vertex_count * 3, 0.0f);
+		for (size_t v = 0; v < vertex_count; v++) {
+			if (!Missing.empty() && !Missing[v]) continue;
+
+			float length = glm::length(sums[v]);
+			glm::vec3 normal = length > 0.0f ? sums[v] / length : glm::vec3(0.0f);
+			Object.normals[v * 3] = normal.x;
+			Object.normals[v * 3 + 1] = normal.y;
+			Object.normals[v * 3 + 2] = normal.z;
+		}
+	}
+
+	ImportedScene ImportScene(std::string FilePath, const ImportOptions& Options) {
+		std::string extension = std::filesystem::path(FilePath).extension().string();
+		std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+
+		if (extension == ".obj") {
+			return ImportOBJ(FilePath, Options);
+		}
+		if (extension == ".gltf" || extension == ".glb") {
+			return ImportGLTF(FilePath, Options);
+		}
+
+		throw std::invalid_argument("Can not import " + FilePath + ", expected .obj, .gltf or .glb.");
+	}
+
+} // namespace MP
\ No newline at end of file
@@ -0,0 +1,46 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "MP_Writer.h"
+
+// Native OBJ and glTF importers, the C++ side of what ParseUSD.py does for USD.
+// Input files are memory mapped and parsed on the job system, the result goes out through MP::WriteMP.
+namespace MP {
+
+	struct ImportOptions {
+		float scale = 1.0f;	// Same as ParseUSD.py --scale: positions and instance translations are multiplied by it
+	};
+
+	struct ImportStats {
+		uint32_t source_meshes = 0;			// OBJ objects and groups, or glTF meshes used by a node
+		uint64_t instances = 0;
+		uint64_t triangles = 0;
+		uint32_t generated_normals = 0;		// Objects that had at least some normals generated
+		double parse_seconds = 0;			// Reading the file into per thread lists
+		double build_seconds = 0;			// Triangulating, welding corners and generating normals
+
+		void Print() const;
+	};
+
+	struct ImportedScene {
+		std::vector<ObjectSource> objects;
+		ImportStats stats;
+	};
+
+	// Each vertex gets the normalized average of the unit normals of its triangles, like ParseUSD.py's fallback.
+	// Only vertices where Missing is true are written. Missing empty means every vertex.
+	void GenerateNormals(ObjectSource& Object, const std::vector<bool>& Missing = {});
+
+	// Every "o" and "g" starts a new object. OBJ has no instancing, so each object gets one identity instance
+	// (identical copies are still merged at load by DeduplicateMeshes). Texture coordinates and materials are ignored.
+	ImportedScene ImportOBJ(std::string FilePath, const ImportOptions& Options = {});
+
+	// .gltf with external or embedded buffers, or .glb. Each mesh used by the default scene becomes one object
+	// with its primitives merged and one instance per node that uses it. Points and lines are skipped.
+	ImportedScene ImportGLTF(std::string FilePath, const ImportOptions& Options = {});
+
+	// Picks the importer from the file extension.
+	ImportedScene ImportScene(std::string FilePath, const ImportOptions& Options = {});
+
+} // namespace MP
\ No newline at end of file
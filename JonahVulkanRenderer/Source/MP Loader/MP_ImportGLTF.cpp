@@ -0,0 +1,717 @@
+#include "MP_Import.h"
+#include "MP_MappedFile.h"
+#include "../Util/JobSystem.h"
+#include <glm/gtc/quaternion.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <stdexcept>
+
+namespace {
+
+	// Just enough JSON for glTF. Numbers are doubles, objects keep their members in file order.
+	struct JsonValue {
+		enum TYPE {
+			JSON_NULL,
+			JSON_BOOL,
+			JSON_NUMBER,
+			JSON_STRING,
+			JSON_ARRAY,
+			JSON_OBJECT
+		};
+
+		TYPE type = JSON_NULL;
+		double number = 0;
+		std::string string;
+		std::vector<JsonValue> items;
+		std::vector<std::pair<std::string, JsonValue>> members;
+
+		const JsonValue* Find(std::string_view Key) const {
+			for (const auto& [name, value] : members) {
+				if (name == Key) return &value;
+			}
+			return nullptr;
+		}
+
+		double Number(std::string_view Key, double Default) const {
+			const JsonValue* value = Find(Key);
+			return value != nullptr && value->type == JSON_NUMBER ? value->number : Default;
+		}
+
+		int64_t Index(std::string_view Key) const {
+			return static_cast<int64_t>(Number(Key, -1));
+		}
+
+		const std::vector<JsonValue>& Array(std::string_view Key) const {
+			static const std::vector<JsonValue> empty;
+			const JsonValue* value = Find(Key);
+			return value != nullptr && value->type == JSON_ARRAY ? value->items : empty;
+		}
+	};
+
+	class JsonParser {
+	public:
+		JsonParser(const char* Begin, const char* End) : cursor(Begin), end(End) {}
+
+		JsonValue Parse() {
+			JsonValue value = ParseValue(0);
+			SkipSpace();
+			if (cursor != end) Fail("trailing data");
+			return value;
+		}
+
+	private:
+		const char* cursor;
+		const char* end;
+
+		[[noreturn]] void Fail(const char* What) {
+			throw std::runtime_error(std::string("glTF JSON is malformed: ") + What + ".");
+		}
+
+		void SkipSpace() {
+			while (cursor < end && (*cursor == ' ' || *cursor == '\t' || *cursor == '\n' || *cursor == '\r')) cursor++;
+		}
+
+		bool Consume(char c) {
+			SkipSpace();
+			if (cursor < end && *cursor == c) {
+				cursor++;
+				return true;
+			}
+			return false;
+		}
+
+		void Expect(const char* Literal) {
+			size_t length = std::strlen(Literal);
+			if (static_cast<size_t>(end - cursor) < length || std::memcmp(cursor, Literal, length) != 0) Fail("unknown literal");
+			cursor += length;
+		}
+
+		void AppendUtf8(std::string& Output, uint32_t Code) {
+			if (Code < 0x80) {
+				Output += static_cast<char>(Code);
+			}
+			else if (Code < 0x800) {
+				Output += static_cast<char>(0xC0 | (Code >> 6));
+				Output += static_cast<char>(0x80 | (Code & 0x3F));
+			}
+			else if (Code < 0x10000) {
+				Output += static_cast<char>(0xE0 | (Code >> 12));
+				Output += static_cast<char>(0x80 | ((Code >> 6) & 0x3F));
+				Output += static_cast<char>(0x80 | (Code & 0x3F));
+			}
+			else {
+				Output += static_cast<char>(0xF0 | (Code >> 18));
+				Output += static_cast<char>(0x80 | ((Code >> 12) & 0x3F));
+				Output += static_cast<char>(0x80 | ((Code >> 6) & 0x3F));
+				Output += static_cast<char>(0x80 | (Code & 0x3F));
+			}
+		}
+
+		uint32_t ParseHex4() {
+			if (end - cursor < 4) Fail("short \\u escape");
+			uint32_t code = 0;
+			for (int i = 0; i < 4; i++) {
+				char c = *cursor++;
+				code <<= 4;
+				if (c >= '0' && c <= '9') code |= c - '0';
+				else if (c >= 'a' && c <= 'f') code |= c - 'a' + 10;
+				else if (c >= 'A' && c <= 'F') code |= c - 'A' + 10;
+				else Fail("bad \\u escape");
+			}
+			return code;
+		}
+
+		std::string ParseString() {
+			if (!Consume('"')) Fail("expected a string");
+
+			std::string output;
+			while (true) {
+				if (cursor >= end) Fail("unterminated string");
+				char c = *cursor++;
+				if (c == '"') break;
+				if (c != '\\') {
+					output += c;
+					continue;
+				}
+
+				if (cursor >= end) Fail("unterminated escape");
+				char escape = *cursor++;
+				switch (escape) {
+				case 'b': output += '\b'; break;
+				case 'f': output += '\f'; break;
+				case 'n': output += '\n'; break;
+				case 'r': output += '\r'; break;
+				case 't': output += '\t'; break;
+				case 'u': {
+					uint32_t code = ParseHex4();
+					if (code >= 0xD800 && code < 0xDC00 && end - cursor >= 6 && cursor[0] == '\\' && cursor[1] == 'u') {
+						cursor += 2;
+						code = 0x10000 + ((code - 0xD800) << 10) + (ParseHex4() - 0xDC00);
+					}
+					AppendUtf8(output, code);
+					break;
+				}
+				default: output += escape; break;
+				}
+			}
+			return output;
+		}
+
+		// Nesting is capped so a hostile file can not overflow the stack
+		JsonValue ParseValue(int Depth) {
+			if (Depth > 64) Fail("nested too deep");
+			SkipSpace();
+			if (cursor >= end) Fail("unexpected end");
+
+			JsonValue value;
+			char c = *cursor;
+
+			if (c == '{') {
+				cursor++;
+				value.type = JsonValue::JSON_OBJECT;
+				if (Consume('}')) return value;
+				do {
+					std::string key = ParseString();
+					if (!Consume(':')) Fail("expected ':'");
+					value.members.emplace_back(std::move(key), ParseValue(Depth + 1));
+				} while (Consume(','));
+				if (!Consume('}')) Fail("expected '}'");
+			}
+			else if (c == '[') {
+				cursor++;
+				value.type = JsonValue::JSON_ARRAY;
+				if (Consume(']')) return value;
+				do {
+					value.items.push_back(ParseValue(Depth + 1));
+				} while (Consume(','));
+				if (!Consume(']')) Fail("expected ']'");
+			}
+			else if (c == '"') {
+				value.type = JsonValue::JSON_STRING;
+				value.string = ParseString();
+			}
+			else if (c == 't' || c == 'f') {
+				value.type = JsonValue::JSON_BOOL;
+				value.number = c == 't';
+				Expect(c == 't' ? "true" : "false");
+			}
+			else if (c == 'n') {
+				Expect("null");
+			}
+			else {
+				char* number_end = nullptr;
+				std::string text(cursor, std::min<ptrdiff_t>(end - cursor, 64));
+				value.type = JsonValue::JSON_NUMBER;
+				value.number = std::strtod(text.c_str(), &number_end);
+				if (number_end == text.c_str()) Fail("expected a value");
+				cursor += number_end - text.c_str();
+			}
+
+			return value;
+		}
+	};
+
+	constexpr uint32_t GlbMagic = 0x46546C67;		// "glTF"
+	constexpr uint32_t GlbChunkJson = 0x4E4F534A;	// "JSON"
+	constexpr uint32_t GlbChunkBin = 0x004E4942;	// "BIN\0"
+
+	enum COMPONENTTYPE {
+		COMPONENT_BYTE = 5120,
+		COMPONENT_UNSIGNED_BYTE = 5121,
+		COMPONENT_SHORT = 5122,
+		COMPONENT_UNSIGNED_SHORT = 5123,
+		COMPONENT_UNSIGNED_INT = 5125,
+		COMPONENT_FLOAT = 5126
+	};
+
+	enum PRIMITIVEMODE {
+		MODE_TRIANGLES = 4,
+		MODE_TRIANGLE_STRIP = 5,
+		MODE_TRIANGLE_FAN = 6
+	};
+
+	uint32_t ReadU32(const std::uint8_t* Bytes) {
+		uint32_t value;
+		std::memcpy(&value, Bytes, sizeof(value));
+		return value;
+	}
+
+	std::vector<std::uint8_t> DecodeBase64(std::string_view Text) {
+		auto value_of = [](char c) -> int {
+			if (c >= 'A' && c <= 'Z') return c - 'A';
+			if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+			if (c >= '0' && c <= '9') return c - '0' + 52;
+			if (c == '+' || c == '-') return 62;
+			if (c == '/' || c == '_') return 63;
+			return -1;
+		};
+
+		std::vector<std::uint8_t> output;
+		output.reserve(Text.size() / 4 * 3);
+		uint32_t bits = 0;
+		int bit_count = 0;
+		for (char c : Text) {
+			int value = value_of(c);
+			if (value < 0) continue;
+
+			bits = (bits << 6) | static_cast<uint32_t>(value);
+			bit_count += 6;
+			if (bit_count >= 8) {
+				bit_count -= 8;
+				output.push_back(static_cast<std::uint8_t>(bits >> bit_count));
+			}
+		}
+		return output;
+	}
+
+	// Everything an accessor read needs, buffers stay mapped or decoded until the import is done
+	class GltfDocument {
+	public:
+		explicit GltfDocument(const std::string& FilePath) {
+			file = std::make_unique<MP::MappedFile>(FilePath);
+			std::span<const std::uint8_t> bytes = file->GetBytes();
+			std::span<const std::uint8_t> json_bytes = bytes;
+			std::span<const std::uint8_t> glb_binary;
+
+			if (bytes.size() >= 12 && ReadU32(bytes.data()) == GlbMagic) {
+				uint64_t offset = 12;
+				while (offset + 8 <= bytes.size()) {
+					uint32_t chunk_length = ReadU32(bytes.data() + offset);
+					uint32_t chunk_type = ReadU32(bytes.data() + offset + 4);
+					if (offset + 8 + chunk_length > bytes.size()) {
+						throw std::runtime_error("GLB chunk runs past the end of the file.");
+					}
+
+					std::span<const std::uint8_t> chunk = bytes.subspan(offset + 8, chunk_length);
+					if (chunk_type == GlbChunkJson) json_bytes = chunk;
+					else if (chunk_type == GlbChunkBin && glb_binary.empty()) glb_binary = chunk;
+					offset += 8 + chunk_length;
+				}
+			}
+
+			const char* json_text = reinterpret_cast<const char*>(json_bytes.data());
+			root = JsonParser(json_text, json_text + json_bytes.size()).Parse();
+			if (root.type != JsonValue::JSON_OBJECT) {
+				throw std::runtime_error("glTF root is not an object.");
+			}
+
+			std::filesystem::path directory = std::filesystem::path(FilePath).parent_path();
+			for (const JsonValue& buffer : root.Array("buffers")) {
+				const JsonValue* uri = buffer.Find("uri");
+
+				if (uri == nullptr) {
+					// Only the first buffer of a .glb may leave out its uri
+					buffers.push_back(glb_binary);
+				}
+				else if (uri->string.starts_with("data:")) {
+					size_t comma = uri->string.find(',');
+					if (comma == std::string::npos || uri->string.find(";base64") > comma) {
+						throw std::runtime_error("glTF data URI buffers must be base64.");
+					}
+					decoded.push_back(DecodeBase64(std::string_view(uri->string).substr(comma + 1)));
+					buffers.push_back(decoded.back());
+				}
+				else {
+					external.push_back(std::make_unique<MP::MappedFile>((directory / UnescapeUri(uri->string)).string()));
+					buffers.push_back(external.back()->GetBytes());
+				}
+
+				if (buffers.back().size() < static_cast<uint64_t>(buffer.Number("byteLength", 0))) {
+					throw std::runtime_error("glTF buffer is shorter than its byteLength.");
+				}
+			}
+		}
+
+		const JsonValue& GetRoot() const { return root; }
+
+		// Reads Components values per element as floats, applying the normalisation rules for integer types
+		std::vector<float> ReadFloats(int64_t AccessorIndex, uint32_t Components) const {
+			Accessor accessor = GetAccessor(AccessorIndex, Components);
+			std::vector<float> output(accessor.count * Components, 0.0f);
+			if (accessor.data == nullptr) return output;
+
+			for (uint64_t i = 0; i < accessor.count; i++) {
+				const std::uint8_t* element = accessor.data + i * accessor.stride;
+				for (uint32_t c = 0; c < Components; c++) {
+					output[i * Components + c] = ReadComponent(element, c, accessor.component_type, accessor.normalized);
+				}
+			}
+			return output;
+		}
+
+		std::vector<uint32_t> ReadIndices(int64_t AccessorIndex) const {
+			Accessor accessor = GetAccessor(AccessorIndex, 1);
+			std::vector<uint32_t> output(accessor.count, 0);
+			if (accessor.data == nullptr) return output;
+
+			for (uint64_t i = 0; i < accessor.count; i++) {
+				const std::uint8_t* element = accessor.data + i * accessor.stride;
+				switch (accessor.component_type) {
+				case COMPONENT_UNSIGNED_BYTE: output[i] = element[0]; break;
+				case COMPONENT_UNSIGNED_SHORT: { uint16_t value; std::memcpy(&value, element, 2); output[i] = value; break; }
+				case COMPONENT_UNSIGNED_INT: output[i] = ReadU32(element); break;
+				default: throw std::runtime_error("glTF indices must be unsigned integers.");
+				}
+			}
+			return output;
+		}
+
+		uint64_t GetCount(int64_t AccessorIndex) const {
+			const std::vector<JsonValue>& accessors = root.Array("accessors");
+			if (AccessorIndex < 0 || AccessorIndex >= static_cast<int64_t>(accessors.size())) {
+				throw std::runtime_error("glTF primitive uses a missing accessor.");
+			}
+			return static_cast<uint64_t>(accessors[AccessorIndex].Number("count", 0));
+		}
+
+	private:
+		struct Accessor {
+			const std::uint8_t* data = nullptr;	// nullptr for an accessor without a buffer view, which reads as zeros
+			uint64_t count = 0;
+			uint64_t stride = 0;
+			int component_type = 0;
+			bool normalized = false;
+		};
+
+		std::unique_ptr<MP::MappedFile> file;
+		std::vector<std::unique_ptr<MP::MappedFile>> external;
+		std::vector<std::vector<std::uint8_t>> decoded;
+		std::vector<std::span<const std::uint8_t>> buffers;
+		JsonValue root;
+
+		static std::string UnescapeUri(const std::string& Uri) {
+			std::string output;
+			for (size_t i = 0; i < Uri.size(); i++) {
+				if (Uri[i] == '%' && i + 2 < Uri.size()) {
+					output += static_cast<char>(std::stoi(Uri.substr(i + 1, 2), nullptr, 16));
+					i += 2;
+				}
+				else {
+					output += Uri[i];
+				}
+			}
+			return output;
+		}
+
+		static uint32_t ComponentSize(int ComponentType) {
+			switch (ComponentType) {
+			case COMPONENT_BYTE:
+			case COMPONENT_UNSIGNED_BYTE: return 1;
+			case COMPONENT_SHORT:
+			case COMPONENT_UNSIGNED_SHORT: return 2;
+			case COMPONENT_UNSIGNED_INT:
+			case COMPONENT_FLOAT: return 4;
+			default: throw std::runtime_error("glTF accessor has an unknown component type.");
+			}
+		}
+
+		static float ReadComponent(const std::uint8_t* Element, uint32_t Component, int ComponentType, bool Normalized) {
+			switch (ComponentType) {
+			case COMPONENT_FLOAT: {
+				float value;
+				std::memcpy(&value, Element + Component * 4, 4);
+				return value;
+			}
+			case COMPONENT_BYTE: {
+				float value = static_cast<int8_t>(Element[Component]);
+				return Normalized ? std::max(value / 127.0f, -1.0f) : value;
+			}
+			case COMPONENT_UNSIGNED_BYTE: {
+				float value = Element[Component];
+				return Normalized ? value / 255.0f : value;
+			}
+			case COMPONENT_SHORT: {
+				int16_t raw;
+				std::memcpy(&raw, Element + Component * 2, 2);
+				return Normalized ? std::max(raw / 32767.0f, -1.0f) : raw;
+			}
+			case COMPONENT_UNSIGNED_SHORT: {
+				uint16_t raw;
+				std::memcpy(&raw, Element + Component * 2, 2);
+				return Normalized ? raw / 65535.0f : raw;
+			}
+			default:
+				return static_cast<float>(ReadU32(Element + Component * 4));
+			}
+		}
+
+		Accessor GetAccessor(int64_t AccessorIndex, uint32_t Components) const {
+			const std::vector<JsonValue>& accessors = root.Array("accessors");
+			if (AccessorIndex < 0 || AccessorIndex >= static_cast<int64_t>(accessors.size())) {
+				throw std::runtime_error("glTF primitive uses a missing accessor.");
+			}
+			const JsonValue& json = accessors[AccessorIndex];
+
+			if (json.Find("sparse") != nullptr) {
+				throw std::runtime_error("glTF sparse accessors are not supported.");
+			}
+
+			Accessor accessor;
+			accessor.count = static_cast<uint64_t>(json.Number("count", 0));
+			accessor.component_type = static_cast<int>(json.Number("componentType", 0));
+			const JsonValue* normalized = json.Find("normalized");
+			accessor.normalized = normalized != nullptr && normalized->number != 0;
+
+			uint64_t element_size = static_cast<uint64_t>(ComponentSize(accessor.component_type)) * Components;
+			accessor.stride = element_size;
+
+			int64_t view_index = json.Index("bufferView");
+			if (view_index < 0) return accessor;
+
+			const std::vector<JsonValue>& views = root.Array("bufferViews");
+			if (view_index >= static_cast<int64_t>(views.size())) {
+				throw std::runtime_error("glTF accessor uses a missing buffer view.");
+			}
+			const JsonValue& view = views[view_index];
+
+			int64_t buffer_index = view.Index("buffer");
+			if (buffer_index < 0 || buffer_index >= static_cast<int64_t>(buffers.size())) {
+				throw std::runtime_error("glTF buffer view uses a missing buffer.");
+			}
+
+			uint64_t view_offset = static_cast<uint64_t>(view.Number("byteOffset", 0));
+			uint64_t view_length = static_cast<uint64_t>(view.Number("byteLength", 0));
+			accessor.stride = static_cast<uint64_t>(view.Number("byteStride", 0));
+			if (accessor.stride == 0) accessor.stride = element_size;
+
+			uint64_t offset = view_offset + static_cast<uint64_t>(json.Number("byteOffset", 0));
+			uint64_t needed = accessor.count > 0 ? (accessor.count - 1) * accessor.stride + element_size : 0;
+			if (view_offset + view_length > buffers[buffer_index].size() || offset + needed > view_offset + view_length) {
+				throw std::runtime_error("glTF accessor reads past the end of its buffer view.");
+			}
+
+			accessor.data = buffers[buffer_index].data() + offset;
+			return accessor;
+		}
+	};
+
+	glm::mat4 LocalMatrix(const JsonValue& Node) {
+		const std::vector<JsonValue>& matrix = Node.Array("matrix");
+		if (matrix.size() == 16) {
+			glm::mat4 output;
+			float* values = glm::value_ptr(output);
+			for (int i = 0; i < 16; i++) values[i] = static_cast<float>(matrix[i].number);	// Column major in both
+			return output;
+		}
+
+		glm::vec3 translation(0.0f);
+		glm::quat rotation(1.0f, 0.0f, 0.0f, 0.0f);
+		glm::vec3 scale(1.0f);
+
+		const std::vector<JsonValue>& t = Node.Array("translation");
+		const std::vector<JsonValue>& r = Node.Array("rotation");
+		const std::vector<JsonValue>& s = Node.Array("scale");
+		if (t.size() == 3) translation = glm::vec3(t[0].number, t[1].number, t[2].number);
+		if (r.size() == 4) rotation = glm::quat(static_cast<float>(r[3].number), static_cast<float>(r[0].number), static_cast<float>(r[1].number), static_cast<float>(r[2].number));
+		if (s.size() == 3) scale = glm::vec3(s[0].number, s[1].number, s[2].number);
+
+		glm::mat4 output = glm::mat4_cast(rotation);
+		output[0] *= scale.x;
+		output[1] *= scale.y;
+		output[2] *= scale.z;
+		output[3] = glm::vec4(translation, 1.0f);
+		return output;
+	}
+
+	// Turns strips and fans into a triangle list, keeping the winding of the first triangle
+	void AppendTriangles(std::vector<uint32_t>& Output, const std::vector<uint32_t>& Indices, int64_t Mode, uint32_t Base) {
+		if (Mode == MODE_TRIANGLES) {
+			for (size_t i = 0; i + 2 < Indices.size(); i += 3) {
+				Output.insert(Output.end(), { Indices[i] + Base, Indices[i + 1] + Base, Indices[i + 2] + Base });
+			}
+		}
+		else if (Mode == MODE_TRIANGLE_STRIP) {
+			for (size_t i = 0; i + 2 < Indices.size(); i++) {
+				bool odd = i % 2 == 1;
+				Output.insert(Output.end(), { Indices[i + (odd ? 1 : 0)] + Base, Indices[i + (odd ? 0 : 1)] + Base, Indices[i + 2] + Base });
+			}
+		}
+		else if (Mode == MODE_TRIANGLE_FAN) {
+			for (size_t i = 1; i + 1 < Indices.size(); i++) {
+				Output.insert(Output.end(), { Indices[0] + Base, Indices[i] + Base, Indices[i + 1] + Base });
+			}
+		}
+	}
+
+	// All triangle primitives of one mesh in one object
+	MP::ObjectSource BuildMesh(const GltfDocument& Document, const JsonValue& Mesh, float Scale, bool& GeneratedNormals) {
+		MP::ObjectSource object;
+		std::vector<bool> missing;
+
+		for (const JsonValue& primitive : Mesh.Array("primitives")) {
+			int64_t mode = static_cast<int64_t>(primitive.Number("mode", MODE_TRIANGLES));
+			if (mode != MODE_TRIANGLES && mode != MODE_TRIANGLE_STRIP && mode != MODE_TRIANGLE_FAN) continue;
+
+			const JsonValue* attributes = primitive.Find("attributes");
+			if (attributes == nullptr || attributes->Find("POSITION") == nullptr) continue;
+
+			std::vector<float> positions = Document.ReadFloats(attributes->Index("POSITION"), 3);
+			uint32_t vertex_count = static_cast<uint32_t>(positions.size() / 3);
+			for (float& value : positions) value *= Scale;
+
+			std::vector<float> normals;
+			if (attributes->Find("NORMAL") != nullptr) {
+				normals = Document.ReadFloats(attributes->Index("NORMAL"), 3);
+				if (normals.size() != positions.size()) {
+					throw std::runtime_error("glTF primitive has a different number of normals and positions.");
+				}
+			}
+
+			std::vector<uint32_t> indices;
+			if (primitive.Find("indices") != nullptr) {
+				indices = Document.ReadIndices(primitive.Index("indices"));
+			}
+			else {
+				indices.resize(vertex_count);
+				for (uint32_t i = 0; i < vertex_count; i++) indices[i] = i;
+			}
+
+			for (uint32_t index : indices) {
+				if (index >= vertex_count) {
+					throw std::runtime_error("glTF primitive index is past its vertices.");
+				}
+			}
+
+			uint32_t base = static_cast<uint32_t>(object.positions.size() / 3);
+			AppendTriangles(object.indices, indices, mode, base);
+			object.positions.insert(object.positions.end(), positions.begin(), positions.end());
+			if (normals.empty()) {
+				object.normals.insert(object.normals.end(), positions.size(), 0.0f);
+			}
+			else {
+				object.normals.insert(object.normals.end(), normals.begin(), normals.end());
+			}
+			missing.insert(missing.end(), vertex_count, normals.empty());
+		}
+
+		GeneratedNormals = std::find(missing.begin(), missing.end(), true) != missing.end();
+		if (GeneratedNormals) {
+			MP::GenerateNormals(object, missing);
+		}
+
+		return object;
+	}
+
+	double SecondsSince(std::chrono::high_resolution_clock::time_point Start) {
+		return std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - Start).count();
+	}
+
+} // namespace unnamed
+
+namespace MP {
+
+	ImportedScene ImportGLTF(std::string FilePath, const ImportOptions& Options) {
+		auto start = std::chrono::high_resolution_clock::now();
+
+		GltfDocument document(FilePath);
+		const JsonValue& root = document.GetRoot();
+		const std::vector<JsonValue>& nodes = root.Array("nodes");
+		const std::vector<JsonValue>& meshes = root.Array("meshes");
+
+		// The default scene's roots, or every node that is nobody's child when there are no scenes
+		std::vector<int64_t> roots;
+		const std::vector<JsonValue>& scenes = root.Array("scenes");
+		if (!scenes.empty()) {
+			int64_t scene_index = std::clamp<int64_t>(root.Index("scene"), 0, static_cast<int64_t>(scenes.size()) - 1);
+			for (const JsonValue& node : scenes[scene_index].Array("nodes")) {
+				roots.push_back(static_cast<int64_t>(node.number));
+			}
+		}
+		else {
+			std::vector<bool> is_child(nodes.size(), false);
+			for (const JsonValue& node : nodes) {
+				for (const JsonValue& child : node.Array("children")) {
+					if (child.number >= 0 && child.number < nodes.size()) is_child[static_cast<size_t>(child.number)] = true;
+				}
+			}
+			for (size_t i = 0; i < nodes.size(); i++) {
+				if (!is_child[i]) roots.push_back(static_cast<int64_t>(i));
+			}
+		}
+
+		// Instances grouped by mesh. Only the final translation is scaled, the same as ParseUSD.py
+		std::map<int64_t, std::vector<glm::mat4>> instances_of;
+		std::vector<std::pair<int64_t, glm::mat4>> stack;
+		std::vector<bool> visited(nodes.size(), false);
+		for (auto it = roots.rbegin(); it != roots.rend(); it++) {
+			stack.push_back({ *it, glm::mat4(1.0f) });
+		}
+
+		while (!stack.empty()) {
+			auto [node_index, parent] = stack.back();
+			stack.pop_back();
+
+			if (node_index < 0 || node_index >= static_cast<int64_t>(nodes.size()) || visited[node_index]) {
+				throw std::runtime_error("glTF node hierarchy is not a tree.");
+			}
+			visited[node_index] = true;
+
+			const JsonValue& node = nodes[node_index];
+			glm::mat4 world = parent * LocalMatrix(node);
+
+			int64_t mesh_index = node.Index("mesh");
+			if (mesh_index >= 0) {
+				if (mesh_index >= static_cast<int64_t>(meshes.size())) {
+					throw std::runtime_error("glTF node uses a missing mesh.");
+				}
+
+				glm::mat4 instance = world;
+				instance[3] = glm::vec4(glm::vec3(world[3]) * Options.scale, world[3].w);
+				instances_of[mesh_index].push_back(instance);
+			}
+
+			const std::vector<JsonValue>& children = node.Array("children");
+			for (auto child = children.rbegin(); child != children.rend(); child++) {
+				stack.push_back({ static_cast<int64_t>(child->number), world });
+			}
+		}
+
+		ImportedScene scene;
+		scene.stats.parse_seconds = SecondsSince(start);
+		start = std::chrono::high_resolution_clock::now();
+
+		std::vector<int64_t> used_meshes;
+		std::vector<uint64_t> costs;
+		for (const auto& [mesh_index, instances] : instances_of) {
+			used_meshes.push_back(mesh_index);
+
+			uint64_t cost = 0;
+			for (const JsonValue& primitive : meshes[mesh_index].Array("primitives")) {
+				const JsonValue* attributes = primitive.Find("attributes");
+				if (attributes != nullptr && attributes->Find("POSITION") != nullptr) {
+					cost += document.GetCount(attributes->Index("POSITION"));
+				}
+			}
+			costs.push_back(cost);
+		}
+
+		uint32_t object_count = static_cast<uint32_t>(used_meshes.size());
+		scene.objects.resize(object_count);
+		std::vector<uint8_t> generated(object_count, 0);
+		util::GetJobSystem().ParallelFor(object_count, [&](uint32_t i) {
+			bool generated_normals = false;
+			scene.objects[i] = BuildMesh(document, meshes[used_meshes[i]], Options.scale, generated_normals);
+			scene.objects[i].instances = instances_of.at(used_meshes[i]);
+			generated[i] = generated_normals;
+		}, costs);
+
+		scene.stats.build_seconds = SecondsSince(start);
+		scene.stats.source_meshes = object_count;
+		for (uint32_t i = 0; i < object_count; i++) {
+			scene.stats.instances += scene.objects[i].instances.size();
+			scene.stats.triangles += scene.objects[i].indices.size() / 3;
+			scene.stats.generated_normals += generated[i];
+		}
+
+		// Meshes made only of points or lines
+		std::erase_if(scene.objects, [](const ObjectSource& Object) { return Object.indices.empty(); });
+
+		return scene;
+	}
+
+} // namespace MP
\ No newline at end of file
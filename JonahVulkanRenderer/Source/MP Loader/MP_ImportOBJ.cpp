@@ -0,0 +1,373 @@
+#include "MP_Import.h"
+#include "MP_MappedFile.h"
+#include "../Util/JobSystem.h"
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+#include <string_view>
+#include <unordered_map>
+
+namespace {
+
+	constexpr uint64_t ChunkSize = 4 * 1024 * 1024;
+	constexpr uint32_t NoNormal = UINT32_MAX;
+
+	enum LINETYPE {
+		LINE_OTHER,
+		LINE_POSITION,
+		LINE_NORMAL,
+		LINE_FACE,
+		LINE_OBJECT
+	};
+
+	struct TextRange {
+		const char* begin;
+		const char* end;
+	};
+
+	struct Corner {
+		uint32_t position;
+		uint32_t normal;	// NoNormal when the face gave none
+	};
+
+	struct ObjChunk {
+		// Counting pass, summed into the bases so negative (relative) indices resolve in one go
+		uint32_t position_count = 0;
+		uint32_t normal_count = 0;
+		uint32_t position_base = 0;
+		uint32_t normal_base = 0;
+
+		std::vector<float> positions;
+		std::vector<float> normals;
+		std::vector<uint32_t> face_starts;	// Into corners, with one past the last face at the end
+		std::vector<Corner> corners;
+		std::vector<uint32_t> object_starts;	// First face of each "o" or "g"
+	};
+
+	struct FaceRange {
+		uint32_t chunk;
+		uint32_t first_face;
+		uint32_t end_face;
+	};
+
+	struct ObjectFaces {
+		std::vector<FaceRange> ranges;
+		uint64_t corner_count = 0;
+	};
+
+	bool IsSpace(char c) {
+		return c == ' ' || c == '\t' || c == '\r';
+	}
+
+	const char* SkipSpace(const char* Cursor, const char* End) {
+		while (Cursor < End && IsSpace(*Cursor)) Cursor++;
+		return Cursor;
+	}
+
+	// Chunks end on line breaks so no line is split between threads
+	std::vector<TextRange> SplitChunks(std::span<const std::uint8_t> Bytes) {
+		const char* begin = reinterpret_cast<const char*>(Bytes.data());
+		const char* end = begin + Bytes.size();
+
+		std::vector<TextRange> chunks;
+		while (begin < end) {
+			const char* chunk_end = end - begin > static_cast<ptrdiff_t>(ChunkSize) ? begin + ChunkSize : end;
+			const char* line_break = static_cast<const char*>(std::memchr(chunk_end - 1, '\n', end - (chunk_end - 1)));
+			chunk_end = line_break != nullptr ? line_break + 1 : end;
+
+			chunks.push_back({ begin, chunk_end });
+			begin = chunk_end;
+		}
+		return chunks;
+	}
+
+	// Leaves Cursor after the keyword
+	LINETYPE Classify(const char*& Cursor, const char* End) {
+		Cursor = SkipSpace(Cursor, End);
+		ptrdiff_t left = End - Cursor;
+
+		if (left >= 2 && Cursor[0] == 'v' && IsSpace(Cursor[1])) {
+			Cursor += 2;
+			return LINE_POSITION;
+		}
+		if (left >= 3 && Cursor[0] == 'v' && Cursor[1] == 'n' && IsSpace(Cursor[2])) {
+			Cursor += 3;
+			return LINE_NORMAL;
+		}
+		if (left >= 2 && Cursor[0] == 'f' && IsSpace(Cursor[1])) {
+			Cursor += 2;
+			return LINE_FACE;
+		}
+		if (left >= 2 && (Cursor[0] == 'o' || Cursor[0] == 'g') && IsSpace(Cursor[1])) {
+			Cursor += 2;
+			return LINE_OBJECT;
+		}
+		return LINE_OTHER;
+	}
+
+	template <class Function>
+	void ForEachLine(TextRange Chunk, Function OnLine) {
+		const char* cursor = Chunk.begin;
+		while (cursor < Chunk.end) {
+			const char* line_end = static_cast<const char*>(std::memchr(cursor, '\n', Chunk.end - cursor));
+			if (line_end == nullptr) line_end = Chunk.end;
+
+			OnLine(cursor, line_end);
+			cursor = line_end + 1;
+		}
+	}
+
+	template <class T>
+	const char* ParseNumber(const char* Cursor, const char* End, T& Value) {
+		Cursor = SkipSpace(Cursor, End);
+		if (Cursor < End && *Cursor == '+') Cursor++;
+
+		std::from_chars_result result = std::from_chars(Cursor, End, Value);
+		if (result.ec != std::errc()) {
+			throw std::runtime_error("OBJ has a malformed number near \"" + std::string(Cursor, std::min<ptrdiff_t>(End - Cursor, 32)) + "\".");
+		}
+		return result.ptr;
+	}
+
+	void ParseFloat3(const char* Cursor, const char* End, std::vector<float>& Output, float Scale) {
+		for (int i = 0; i < 3; i++) {
+			float value = 0;
+			Cursor = ParseNumber(Cursor, End, value);
+			Output.push_back(value * Scale);
+		}
+	}
+
+	// 1 based, or negative to count back from the last one read
+	uint32_t ResolveIndex(int64_t Index, uint32_t ReadSoFar) {
+		int64_t resolved = Index > 0 ? Index - 1 : static_cast<int64_t>(ReadSoFar) + Index;
+		if (Index == 0 || resolved < 0) {
+			throw std::runtime_error("OBJ face has index " + std::to_string(Index) + " with " + std::to_string(ReadSoFar) + " read before it.");
+		}
+		return static_cast<uint32_t>(resolved);
+	}
+
+	void ParseFace(const char* Cursor, const char* End, ObjChunk& Chunk) {
+		uint32_t positions_read = Chunk.position_base + static_cast<uint32_t>(Chunk.positions.size() / 3);
+		uint32_t normals_read = Chunk.normal_base + static_cast<uint32_t>(Chunk.normals.size() / 3);
+
+		while (true) {
+			Cursor = SkipSpace(Cursor, End);
+			if (Cursor >= End) break;
+
+			// v, v/vt, v//vn or v/vt/vn
+			int64_t position = 0;
+			Cursor = ParseNumber(Cursor, End, position);
+			Corner corner{ ResolveIndex(position, positions_read), NoNormal };
+
+			if (Cursor < End && *Cursor == '/') {
+				Cursor++;
+				while (Cursor < End && *Cursor != '/' && !IsSpace(*Cursor)) Cursor++;
+
+				if (Cursor < End && *Cursor == '/') {
+					int64_t normal = 0;
+					Cursor = ParseNumber(Cursor + 1, End, normal);
+					corner.normal = ResolveIndex(normal, normals_read);
+				}
+			}
+
+			Chunk.corners.push_back(corner);
+		}
+
+		Chunk.face_starts.push_back(static_cast<uint32_t>(Chunk.corners.size()));
+	}
+
+	void ParseChunk(TextRange Range, ObjChunk& Chunk, float Scale) {
+		Chunk.positions.reserve(Chunk.position_count * 3);
+		Chunk.normals.reserve(Chunk.normal_count * 3);
+		Chunk.face_starts.push_back(0);
+
+		ForEachLine(Range, [&](const char* Line, const char* End) {
+			switch (Classify(Line, End)) {
+			case LINE_POSITION:
+				ParseFloat3(Line, End, Chunk.positions, Scale);
+				break;
+			case LINE_NORMAL:
+				ParseFloat3(Line, End, Chunk.normals, 1.0f);
+				break;
+			case LINE_FACE:
+				ParseFace(Line, End, Chunk);
+				break;
+			case LINE_OBJECT:
+				Chunk.object_starts.push_back(static_cast<uint32_t>(Chunk.face_starts.size() - 1));
+				break;
+			default:
+				break;
+			}
+		});
+	}
+
+	MP::ObjectSource BuildObject(const ObjectFaces& Faces, const std::vector<ObjChunk>& Chunks, const std::vector<float>& Positions, const std::vector<float>& Normals, bool& GeneratedNormals) {
+		uint32_t position_count = static_cast<uint32_t>(Positions.size() / 3);
+		uint32_t normal_count = static_cast<uint32_t>(Normals.size() / 3);
+
+		MP::ObjectSource object;
+		std::unordered_map<uint64_t, uint32_t> vertex_of;
+		vertex_of.reserve(Faces.corner_count);
+		std::vector<bool> missing;
+		std::vector<uint32_t> face;
+
+		// Corners with the same position and normal share a vertex, vertices are numbered by first use
+		auto vertex = [&](Corner C) {
+			if (C.position >= position_count || (C.normal != NoNormal && C.normal >= normal_count)) {
+				throw std::runtime_error("OBJ face uses a vertex or normal past the end of the file.");
+			}
+
+			uint64_t key = (static_cast<uint64_t>(C.position) << 32) | C.normal;
+			auto [it, inserted] = vertex_of.try_emplace(key, static_cast<uint32_t>(missing.size()));
+			if (inserted) {
+				const float* position = &Positions[static_cast<size_t>(C.position) * 3];
+				object.positions.insert(object.positions.end(), position, position + 3);
+				if (C.normal != NoNormal) {
+					const float* normal = &Normals[static_cast<size_t>(C.normal) * 3];
+					object.normals.insert(object.normals.end(), normal, normal + 3);
+				}
+				else {
+					object.normals.insert(object.normals.end(), 3, 0.0f);
+				}
+				missing.push_back(C.normal == NoNormal);
+			}
+			return it->second;
+		};
+
+		for (const FaceRange& range : Faces.ranges) {
+			const ObjChunk& chunk = Chunks[range.chunk];
+
+			for (uint32_t f = range.first_face; f < range.end_face; f++) {
+				uint32_t first = chunk.face_starts[f];
+				uint32_t count = chunk.face_starts[f + 1] - first;
+				if (count < 3) continue;
+
+				face.clear();
+				for (uint32_t i = 0; i < count; i++) {
+					face.push_back(vertex(chunk.corners[first + i]));
+				}
+
+				// Fan from the first corner, same as ParseUSD.py. Fine for the convex n-gons exporters write
+				for (uint32_t i = 0; i + 2 < count; i++) {
+					object.indices.push_back(face[0]);
+					object.indices.push_back(face[i + 1]);
+					object.indices.push_back(face[i + 2]);
+				}
+			}
+		}
+
+		GeneratedNormals = std::find(missing.begin(), missing.end(), true) != missing.end();
+		if (GeneratedNormals) {
+			MP::GenerateNormals(object, missing);
+		}
+
+		object.instances.push_back(glm::mat4(1.0f));
+		return object;
+	}
+
+	double SecondsSince(std::chrono::high_resolution_clock::time_point Start) {
+		return std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - Start).count();
+	}
+
+} // namespace unnamed
+
+namespace MP {
+
+	ImportedScene ImportOBJ(std::string FilePath, const ImportOptions& Options) {
+		auto start = std::chrono::high_resolution_clock::now();
+
+		MappedFile file(FilePath);
+		std::vector<TextRange> ranges = SplitChunks(file.GetBytes());
+		uint32_t chunk_count = static_cast<uint32_t>(ranges.size());
+		std::vector<ObjChunk> chunks(chunk_count);
+		util::JobSystem& job_system = util::GetJobSystem();
+
+		job_system.ParallelFor(chunk_count, [&](uint32_t c) {
+			ForEachLine(ranges[c], [&](const char* Line, const char* End) {
+				LINETYPE type = Classify(Line, End);
+				chunks[c].position_count += type == LINE_POSITION;
+				chunks[c].normal_count += type == LINE_NORMAL;
+			});
+		});
+
+		uint32_t position_total = 0;
+		uint32_t normal_total = 0;
+		for (ObjChunk& chunk : chunks) {
+			chunk.position_base = position_total;
+			chunk.normal_base = normal_total;
+			position_total += chunk.position_count;
+			normal_total += chunk.normal_count;
+		}
+
+		job_system.ParallelFor(chunk_count, [&](uint32_t c) {
+			ParseChunk(ranges[c], chunks[c], Options.scale);
+		});
+
+		std::vector<float> positions(static_cast<size_t>(position_total) * 3);
+		std::vector<float> normals(static_cast<size_t>(normal_total) * 3);
+		job_system.ParallelFor(chunk_count, [&](uint32_t c) {
+			std::copy(chunks[c].positions.begin(), chunks[c].positions.end(), positions.begin() + chunks[c].position_base * size_t(3));
+			std::copy(chunks[c].normals.begin(), chunks[c].normals.end(), normals.begin() + chunks[c].normal_base * size_t(3));
+			chunks[c].positions = {};
+			chunks[c].normals = {};
+		});
+
+		// Faces before the first "o" or "g" of a chunk carry on the object the previous chunk ended in
+		std::vector<ObjectFaces> objects(1);
+		for (uint32_t c = 0; c < chunk_count; c++) {
+			const ObjChunk& chunk = chunks[c];
+			uint32_t face_count = static_cast<uint32_t>(chunk.face_starts.size() - 1);
+			uint32_t cursor = 0;
+
+			auto close_range = [&](uint32_t End) {
+				if (End > cursor) {
+					objects.back().ranges.push_back({ c, cursor, End });
+					objects.back().corner_count += chunk.face_starts[End] - chunk.face_starts[cursor];
+				}
+				cursor = End;
+			};
+
+			for (uint32_t object_start : chunk.object_starts) {
+				close_range(object_start);
+				if (!objects.back().ranges.empty()) {
+					objects.emplace_back();
+				}
+			}
+			close_range(face_count);
+		}
+		if (objects.back().ranges.empty()) {
+			objects.pop_back();
+		}
+
+		ImportedScene scene;
+		scene.stats.parse_seconds = SecondsSince(start);
+		start = std::chrono::high_resolution_clock::now();
+
+		uint32_t object_count = static_cast<uint32_t>(objects.size());
+		std::vector<uint64_t> costs(object_count);
+		for (uint32_t i = 0; i < object_count; i++) {
+			costs[i] = objects[i].corner_count;
+		}
+
+		scene.objects.resize(object_count);
+		std::vector<uint8_t> generated(object_count, 0);
+		job_system.ParallelFor(object_count, [&](uint32_t i) {
+			bool generated_normals = false;
+			scene.objects[i] = BuildObject(objects[i], chunks, positions, normals, generated_normals);
+			generated[i] = generated_normals;
+		}, costs);
+
+		scene.stats.build_seconds = SecondsSince(start);
+		scene.stats.source_meshes = object_count;
+		scene.stats.instances = object_count;
+		for (uint32_t i = 0; i < object_count; i++) {
+			scene.stats.triangles += scene.objects[i].indices.size() / 3;
+			scene.stats.generated_normals += generated[i];
+		}
+
+		return scene;
+	}
+
+} // namespace MP
\ No newline at end of file
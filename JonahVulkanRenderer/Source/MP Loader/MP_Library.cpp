@@ -0,0 +1,193 @@
+#include "MP_Library.h"
+#include "MP_Format.h"
+#include "MP_MappedFile.h"
+#include "MP_Parser.h"
+#include "../Util/Hash.h"
+#include "../Util/JobSystem.h"
+#include <filesystem>
+#include <stdexcept>
+
+namespace {
+
+	template <class T>
+	std::span<const std::uint8_t> AsBytes(const std::vector<T>& Values) {
+		return { reinterpret_cast<const std::uint8_t*>(Values.data()), Values.size() * sizeof(T) };
+	}
+
+} // namespace unnamed
+
+namespace MP {
+
+	uint64_t MeshKey(const ObjectSource& Object) {
+		uint64_t key = util::Hash64(AsBytes(Object.positions), format::Magic);
+		key = util::Hash64(AsBytes(Object.normals), key);
+		key = util::Hash64(AsBytes(Object.indices), key);
+
+		// 0 means no key in the file
+		return key != 0 ? key : 1;
+	}
+
+	LibraryWriteStats WriteMPWithLibrary(std::string ScenePath, std::string LibraryPath, const std::vector<ObjectSource>& Objects, const WriteOptions& Options) {
+		std::vector<uint64_t> keys(Objects.size());
+		util::GetJobSystem().ParallelFor(static_cast<uint32_t>(Objects.size()), [&](uint32_t i) {
+			keys[i] = Objects[i].mesh_key != 0 ? Objects[i].mesh_key : MeshKey(Objects[i]);
+		});
+
+		std::vector<ObjectSource> library;
+		if (std::filesystem::exists(LibraryPath)) {
+			library = ReadMPSource(LibraryPath);
+		}
+
+		std::unordered_map<uint64_t, uint32_t> library_index;
+		for (uint32_t i = 0; i < library.size(); i++) {
+			if (library[i].mesh_key == 0) {
+				throw std::runtime_error(LibraryPath + " is not a geometry library.");
+			}
+			library_index.emplace(library[i].mesh_key, i);
+		}
+
+		LibraryWriteStats stats;
+		std::vector<ObjectSource> scene(Objects.size());
+
+		for (size_t i = 0; i < Objects.size(); i++) {
+			const ObjectSource& object = Objects[i];
+
+			// Nothing to share, kept in the scene as it is
+			if (object.mesh_key == 0 && object.positions.empty() && object.indices.empty()) {
+				scene[i] = object;
+				continue;
+			}
+
+			auto found = library_index.find(keys[i]);
+
+			if (found == library_index.end()) {
+				// Scenes already written against a library can only share meshes the library has
+				if (object.positions.empty() && object.mesh_key != 0) {
+					throw std::runtime_error("Scene references a mesh that is not in " + LibraryPath + ".");
+				}
+
+				ObjectSource mesh = object;
+				mesh.instances.clear();
+				mesh.mesh_key = keys[i];
+
+				found = library_index.emplace(keys[i], static_cast<uint32_t>(library.size())).first;
+				library.push_back(std::move(mesh));
+				stats.meshes_added++;
+			}
+			else {
+				stats.meshes_shared++;
+			}
+
+			ObjectSource& reference = scene[i];
+			reference.mesh_key = keys[i];
+			reference.instances = object.instances;
+			GetLocalBounds(library[found->second], reference.reference_bounds);
+		}
+
+		// The library has no instances, so there is nothing to tile
+		if (stats.meshes_added > 0) {
+			WriteOptions library_options = Options;
+			library_options.tile_grid = 0;
+			WriteMP(LibraryPath, library, library_options);
+		}
+
+		stats.scene = WriteMP(ScenePath, scene, Options);
+		return stats;
+	}
+
+	bool HasMeshReferences(const renderer::ModelSet& Set) {
+		for (const renderer::MeshInstances& model : Set.models) {
+			if (model.mesh_key != 0 && model.mesh.vertices.empty()) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void KeyMeshesByContent(renderer::ModelSet& Set) {
+		util::GetJobSystem().ParallelFor(static_cast<uint32_t>(Set.models.size()), [&](uint32_t i) {
+			renderer::MeshInstances& model = Set.models[i];
+			if (model.mesh_key != 0 || model.mesh.vertices.empty()) return;
+
+			// Same arrays MeshKey hashes, so a mesh with a normal per vertex keys the same in a library as in the scene
+			thread_local ObjectSource scratch;
+			scratch.positions.clear();
+			scratch.normals.clear();
+			for (const renderer::Vertex& v : model.mesh.vertices) {
+				scratch.positions.insert(scratch.positions.end(), { v.position.x, v.position.y, v.position.z });
+				scratch.normals.insert(scratch.normals.end(), { v.normal.x, v.normal.y, v.normal.z });
+			}
+			scratch.indices.assign(model.mesh.indices.begin(), model.mesh.indices.end());
+
+			model.mesh_key = MeshKey(scratch);
+		});
+	}
+
+	GeometryLibrary::GeometryLibrary(std::string LibraryPath) : library_path(LibraryPath) {
+		MappedFile file(LibraryPath);
+		std::span<const std::uint8_t> bytes = file.GetBytes();
+
+		format::FileLayout layout = format::ReadFileLayout(bytes);
+		if ((layout.flags & format::FILE_HAS_MESH_KEYS) == 0) {
+			throw std::invalid_argument(LibraryPath + " is not a geometry library.");
+		}
+
+		for (uint32_t i = 0; i < layout.object_offsets.size(); i++) {
+			format::ObjectHeader header = format::ReadObjectHeader(bytes, layout.object_offsets[i], layout.version);
+			if (header.mesh_key == 0 || header.IsMeshReference()) {
+				throw std::invalid_argument(LibraryPath + " is not a geometry library.");
+			}
+			object_of_key.emplace(header.mesh_key, i);
+		}
+	}
+
+	void GeometryLibrary::Resolve(renderer::ModelSet& Set) const {
+
+		// Each library mesh is decoded once however many references share it
+		std::vector<uint32_t> objects;
+		std::unordered_map<uint64_t, uint32_t> decoded_slot;
+
+		for (const renderer::MeshInstances& model : Set.models) {
+			if (model.mesh_key == 0 || !model.mesh.vertices.empty() || decoded_slot.contains(model.mesh_key)) {
+				continue;
+			}
+
+			auto found = object_of_key.find(model.mesh_key);
+			if (found == object_of_key.end()) {
+				throw std::runtime_error("Scene references a mesh that is not in " + library_path + ".");
+			}
+
+			decoded_slot.emplace(model.mesh_key, static_cast<uint32_t>(objects.size()));
+			objects.push_back(found->second);
+		}
+
+		if (objects.empty()) return;
+
+		renderer::ModelSet meshes = ParseMPObjects(library_path, objects);
+
+		for (renderer::MeshInstances& model : Set.models) {
+			auto slot = decoded_slot.find(model.mesh_key);
+			if (slot == decoded_slot.end() || !model.mesh.vertices.empty()) {
+				continue;
+			}
+
+			const renderer::MeshInstances& mesh = meshes.models[slot->second];
+			model.mesh = mesh.mesh;
+			model.material = mesh.material;
+			model.has_local_bounds = mesh.has_local_bounds;
+			model.local_bounds_min = mesh.local_bounds_min;
+			model.local_bounds_max = mesh.local_bounds_max;
+		}
+
+		// The scene now points into the library arena, so it takes ownership of it
+		for (std::unique_ptr<std::byte[]>& block : meshes.arena_blocks) {
+			Set.arena_blocks.push_back(std::move(block));
+		}
+		Set.arena_size += meshes.arena_size;
+	}
+
+	uint32_t GeometryLibrary::GetMeshCount() const {
+		return static_cast<uint32_t>(object_of_key.size());
+	}
+
+} // namespace MP
\ No newline at end of file
@@ -0,0 +1,51 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "MP_Writer.h"
+#include "../Renderer/VkUtil/VkCommon.h"
+
+// A geometry library is a plain v2 .mp file of unique meshes with no instances, each tagged with its content key
+// (OBJECT_HAS_KEY). Scenes written against a library store every object as a reference: the key, the mesh bounds and
+// the instance matrices. Props shared by many maps are then stored once, and Renderer::SwitchScene keeps them on the GPU.
+namespace MP {
+
+	// Content key of an object's positions, normals and indices. Never 0.
+	uint64_t MeshKey(const ObjectSource& Object);
+
+	struct LibraryWriteStats {
+		WriteStats scene;
+		uint32_t meshes_added = 0;	// Not in the library before
+		uint32_t meshes_shared = 0;	// Already there, from this scene or an earlier one
+	};
+
+	// Writes Objects to ScenePath as references and adds the meshes LibraryPath is missing, creating it if needed.
+	// Meshes already in the library keep their place, so their colors stay the same in every scene.
+	LibraryWriteStats WriteMPWithLibrary(std::string ScenePath, std::string LibraryPath, const std::vector<ObjectSource>& Objects, const WriteOptions& Options);
+
+	// True when some model of Set is a reference still waiting for its library mesh.
+	bool HasMeshReferences(const renderer::ModelSet& Set);
+
+	// Gives every model without a key the one MeshKey would give its geometry, in parallel. Renderer::ReloadScene
+	// finds meshes already on the GPU by key, so an edited scene only uploads the meshes that changed.
+	void KeyMeshesByContent(renderer::ModelSet& Set);
+
+	class GeometryLibrary {
+
+	public:
+		// Reads the key of every mesh. Nothing is decoded until Resolve needs it.
+		GeometryLibrary(std::string LibraryPath);
+
+		// Points every reference in Set at its library mesh, decoding each mesh it needs once.
+		// Throws on a key the library does not have.
+		void Resolve(renderer::ModelSet& Set) const;
+
+		uint32_t GetMeshCount() const;
+
+	private:
+		std::string library_path;
+		std::unordered_map<uint64_t, uint32_t> object_of_key;
+	};
+
+} // namespace MP
\ No newline at end of file
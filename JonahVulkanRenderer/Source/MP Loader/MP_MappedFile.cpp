@@ -0,0 +1,133 @@
+#include "MP_MappedFile.h"
+#include <algorithm>
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+#ifndef _WIN32
+	// madvise requires a page aligned start address.
+	void AdviseRange(const std::uint8_t* Base, uint64_t FileSize, uint64_t Offset, uint64_t Size, int Advice) {
+		if (Base == nullptr || Offset >= FileSize) return;
+
+		Size = std::min(Size, FileSize - Offset);
+
+		static const uint64_t page_size = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+		uint64_t aligned_offset = Offset & ~(page_size - 1);
+
+		madvise(const_cast<std::uint8_t*>(Base) + aligned_offset, static_cast<size_t>(Size + (Offset - aligned_offset)), Advice);
+	}
+#endif
+}
+
+namespace MP {
+
+#ifdef _WIN32
+
+	MappedFile::MappedFile(const std::string& FilePath) {
+
+		HANDLE file = CreateFileA(FilePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE) {
+			throw std::invalid_argument("MP file could not open.");
+		}
+		file_handle = file;
+
+		LARGE_INTEGER file_size{};
+		if (!GetFileSizeEx(file, &file_size)) {
+			CloseHandle(file);
+			throw std::runtime_error("Failed to read MP file size.");
+		}
+		size = static_cast<uint64_t>(file_size.QuadPart);
+
+		if (size == 0) return;
+
+		mapping_handle = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mapping_handle == nullptr) {
+			CloseHandle(file);
+			throw std::runtime_error("Failed to create MP file mapping.");
+		}
+
+		data = static_cast<const std::uint8_t*>(MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0));
+		if (data == nullptr) {
+			CloseHandle(mapping_handle);
+			CloseHandle(file);
+			throw std::runtime_error("Failed to map MP file.");
+		}
+	}
+
+	MappedFile::~MappedFile() {
+		if (data != nullptr) UnmapViewOfFile(data);
+		if (mapping_handle != nullptr) CloseHandle(mapping_handle);
+		if (file_handle != nullptr) CloseHandle(file_handle);
+	}
+
+	void MappedFile::Prefetch(uint64_t Offset, uint64_t Size) const {
+		if (data == nullptr || Offset >= size) return;
+
+		WIN32_MEMORY_RANGE_ENTRY range{};
+		range.VirtualAddress = const_cast<std::uint8_t*>(data) + Offset;
+		range.NumberOfBytes = static_cast<SIZE_T>(std::min(Size, size - Offset));
+		PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+	}
+
+	void MappedFile::Release(uint64_t Offset, uint64_t Size) const {
+		// Windows has no per-range hint for read-only file views. Pages are trimmed from the working set under pressure.
+	}
+
+#else
+
+	MappedFile::MappedFile(const std::string& FilePath) {
+
+		file_descriptor = open(FilePath.c_str(), O_RDONLY);
+		if (file_descriptor < 0) {
+			throw std::invalid_argument("MP file could not open.");
+		}
+
+		struct stat file_stat {};
+		if (fstat(file_descriptor, &file_stat) != 0) {
+			close(file_descriptor);
+			throw std::runtime_error("Failed to read MP file size.");
+		}
+		size = static_cast<uint64_t>(file_stat.st_size);
+
+		if (size == 0) return;
+
+		void* mapping = mmap(nullptr, static_cast<size_t>(size), PROT_READ, MAP_PRIVATE, file_descriptor, 0);
+		if (mapping == MAP_FAILED) {
+			close(file_descriptor);
+			throw std::runtime_error("Failed to map MP file.");
+		}
+
+		data = static_cast<const std::uint8_t*>(mapping);
+	}
+
+	MappedFile::~MappedFile() {
+		if (data != nullptr) munmap(const_cast<std::uint8_t*>(data), static_cast<size_t>(size));
+		if (file_descriptor >= 0) close(file_descriptor);
+	}
+
+	void MappedFile::Prefetch(uint64_t Offset, uint64_t Size) const {
+		AdviseRange(data, size, Offset, Size, MADV_WILLNEED);
+	}
+
+	void MappedFile::Release(uint64_t Offset, uint64_t Size) const {
+		AdviseRange(data, size, Offset, Size, MADV_DONTNEED);
+	}
+
+#endif
+
+	std::span<const std::uint8_t> MappedFile::GetBytes() const {
+		return { data, static_cast<size_t>(size) };
+	}
+
+} // namespace MP
\ No newline at end of file
@@ -0,0 +1,39 @@
+#pragma once
+#include <cstdint>
+#include <span>
+#include <string>
+
+namespace MP {
+
+	// Read-only memory map of a whole file. Bytes are paged in on first touch, so decoding straight out of
+	// GetBytes() avoids copying the file into a heap buffer first.
+	class MappedFile {
+
+	public:
+		explicit MappedFile(const std::string& FilePath);
+		~MappedFile();
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		std::span<const std::uint8_t> GetBytes() const;
+
+		// Hint that [Offset, Offset + Size) will be read soon so the OS can start paging it in.
+		void Prefetch(uint64_t Offset, uint64_t Size) const;
+
+		// Hint that [Offset, Offset + Size) is no longer needed. Pages are file backed so this only drops them from RAM.
+		void Release(uint64_t Offset, uint64_t Size) const;
+
+	private:
+		const std::uint8_t* data = nullptr;
+		uint64_t size = 0;
+
+#ifdef _WIN32
+		void* file_handle = nullptr;
+		void* mapping_handle = nullptr;
+#else
+		int file_descriptor = -1;
+#endif
+	};
+
+} // namespace MP
\ No newline at end of file
@@ -0,0 +1,471 @@
+#include "MP_Optimize.h"
+#include "../Util/Hash.h"
+#include "../Util/JobSystem.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace {
+
+	using renderer::Vertex;
+
+	constexpr uint32_t AnalyzeCacheSize = 16;	// What ACMR is usually quoted at
+	constexpr uint32_t ForsythCacheSize = 32;	// The reorder assumes a bigger LRU cache, which also does well on small FIFOs
+	constexpr float ClusterThreshold = 1.05f;	// How much ACMR the overdraw pass may give up
+	constexpr int OverdrawGrid = 64;			// Coarse keeps big triangles cheap, the ratio hardly moves at 256
+
+	struct VertexHasher {
+		size_t operator()(const Vertex& V) const {
+			// + 0.0f turns -0 into 0, they compare equal so they have to hash the same
+			float key[6] = { V.position.x + 0.0f, V.position.y + 0.0f, V.position.z + 0.0f, V.normal.x + 0.0f, V.normal.y + 0.0f, V.normal.z + 0.0f };
+			return static_cast<size_t>(util::Hash64({ reinterpret_cast<const std::uint8_t*>(key), sizeof(key) }));
+		}
+	};
+
+	glm::vec3 Position(const std::vector<float>& Positions, uint32_t Index) {
+		return { Positions[Index * 3], Positions[Index * 3 + 1], Positions[Index * 3 + 2] };
+	}
+
+	void CheckIndices(const MP::ObjectSource& Object) {
+		uint32_t vertex_count = static_cast<uint32_t>(Object.positions.size() / 3);
+		for (uint32_t index : Object.indices) {
+			if (index >= vertex_count) {
+				throw std::runtime_error("Object index " + std::to_string(index) + " is past its " + std::to_string(vertex_count) + " vertices.");
+			}
+		}
+	}
+
+	// Vertex shader runs of a FIFO cache, where a hit does not move the vertex up.
+	// A vertex is cached if it was one of the last CacheSize misses since Reset.
+	class FifoCache {
+	public:
+		explicit FifoCache(uint32_t VertexCount) : stamps(VertexCount, 0) {}
+
+		// True on a miss
+		bool Touch(uint32_t Vertex) {
+			if (stamps[Vertex] > reset_at && misses - stamps[Vertex] < AnalyzeCacheSize) {
+				return false;
+			}
+			stamps[Vertex] = ++misses;
+			return true;
+		}
+
+		void Reset() { reset_at = misses; }
+		uint64_t GetMisses() const { return misses; }
+
+	private:
+		std::vector<uint64_t> stamps;
+		uint64_t misses = 0;
+		uint64_t reset_at = 0;
+	};
+
+	// Ortho views down +-x, +-y and +-z with back faces culled, like the scene pipeline does.
+	float MeasureOverdraw(const std::vector<uint32_t>& Indices, const std::vector<float>& Positions) {
+		glm::vec3 min(std::numeric_limits<float>::max());
+		glm::vec3 max(std::numeric_limits<float>::lowest());
+		for (uint32_t index : Indices) {
+			glm::vec3 p = Position(Positions, index);
+			min = glm::min(min, p);
+			max = glm::max(max, p);
+		}
+
+		float extent = std::max({ max.x - min.x, max.y - min.y, max.z - min.z });
+		if (!(extent > 0.0f)) {
+			return 0.0f;
+		}
+		float scale = OverdrawGrid / extent;
+
+		std::vector<float> depth(OverdrawGrid * OverdrawGrid);
+		uint64_t shaded = 0;
+		uint64_t covered = 0;
+
+		for (int axis = 0; axis < 3; axis++) {
+			int u_axis = (axis + 1) % 3;
+			int v_axis = (axis + 2) % 3;
+
+			for (float direction : { 1.0f, -1.0f }) {
+				std::fill(depth.begin(), depth.end(), std::numeric_limits<float>::max());
+
+				for (size_t t = 0; t + 2 < Indices.size(); t += 3) {
+					glm::vec3 a = Position(Positions, Indices[t]);
+					glm::vec3 b = Position(Positions, Indices[t + 1]);
+					glm::vec3 c = Position(Positions, Indices[t + 2]);
+
+					// Looking down direction * axis, front faces point back at the eye
+					glm::vec3 normal = glm::cross(b - a, c - a);
+					if (direction * normal[axis] >= 0.0f) continue;
+
+					float x[3] = { (a[u_axis] - min[u_axis]) * scale, (b[u_axis] - min[u_axis]) * scale, (c[u_axis] - min[u_axis]) * scale };
+					float y[3] = { (a[v_axis] - min[v_axis]) * scale, (b[v_axis] - min[v_axis]) * scale, (c[v_axis] - min[v_axis]) * scale };
+					float z[3] = { direction * a[axis], direction * b[axis], direction * c[axis] };
+
+					float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+					if (area == 0.0f) continue;
+
+					int min_x = std::max(0, static_cast<int>(std::floor(std::min({ x[0], x[1], x[2] }))));
+					int min_y = std::max(0, static_cast<int>(std::floor(std::min({ y[0], y[1], y[2] }))));
+					int max_x = std::min(OverdrawGrid - 1, static_cast<int>(std::ceil(std::max({ x[0], x[1], x[2] }))));
+					int max_y = std::min(OverdrawGrid - 1, static_cast<int>(std::ceil(std::max({ y[0], y[1], y[2] }))));
+
+					for (int py = min_y; py <= max_y; py++) {
+						for (int px = min_x; px <= max_x; px++) {
+							float sx = px + 0.5f;
+							float sy = py + 0.5f;
+
+							// Barycentrics from the edge functions, divided by area so either winding works
+							float w0 = ((x[2] - x[1]) * (sy - y[1]) - (y[2] - y[1]) * (sx - x[1])) / area;
+							float w1 = ((x[0] - x[2]) * (sy - y[2]) - (y[0] - y[2]) * (sx - x[2])) / area;
+							float w2 = 1.0f - w0 - w1;
+							if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f) continue;
+
+							float fragment_depth = w0 * z[0] + w1 * z[1] + w2 * z[2];
+							float& stored = depth[py * OverdrawGrid + px];
+							if (fragment_depth < stored) {
+								stored = fragment_depth;
+								shaded++;
+							}
+						}
+					}
+				}
+
+				for (float d : depth) {
+					covered += d != std::numeric_limits<float>::max();
+				}
+			}
+		}
+
+		return covered > 0 ? static_cast<float>(shaded) / covered : 0.0f;
+	}
+
+	float ForsythScore(int CachePosition, uint32_t LiveTriangles) {
+		if (LiveTriangles == 0) {
+			return -1.0f;
+		}
+
+		float score = 0.0f;
+		if (CachePosition >= 0) {
+			// The last triangle's vertices get a fixed score so the next pick does not just reuse its edge
+			score = CachePosition < 3 ? 0.75f : std::pow(1.0f - static_cast<float>(CachePosition - 3) / (ForsythCacheSize - 3), 1.5f);
+		}
+
+		// Vertices with few triangles left are finished off first, so they do not come back later as lone misses
+		return score + 2.0f / std::sqrt(static_cast<float>(LiveTriangles));
+	}
+
+	// Tom Forsyth, "Linear-Speed Vertex Cache Optimisation".
+	std::vector<uint32_t> OptimizeVertexCache(const std::vector<uint32_t>& Indices, uint32_t VertexCount) {
+		uint32_t triangle_count = static_cast<uint32_t>(Indices.size() / 3);
+
+		std::vector<uint32_t> live(VertexCount, 0);
+		for (uint32_t index : Indices) {
+			live[index]++;
+		}
+
+		// Triangles of each vertex, live ones first
+		std::vector<uint32_t> first_triangle(VertexCount + 1, 0);
+		for (uint32_t v = 0; v < VertexCount; v++) {
+			first_triangle[v + 1] = first_triangle[v] + live[v];
+		}
+		std::vector<uint32_t> triangles(Indices.size());
+		std::vector<uint32_t> fill(first_triangle.begin(), first_triangle.end() - 1);
+		for (uint32_t t = 0; t < triangle_count; t++) {
+			for (int k = 0; k < 3; k++) {
+				uint32_t v = Indices[t * 3 + k];
+				triangles[fill[v]++] = t;
+			}
+		}
+
+		std::vector<int> cache_position(VertexCount, -1);
+		std::vector<float> vertex_score(VertexCount);
+		for (uint32_t v = 0; v < VertexCount; v++) {
+			vertex_score[v] = ForsythScore(-1, live[v]);
+		}
+
+		std::vector<bool> emitted(triangle_count, false);
+		std::vector<uint32_t> cache;
+		std::vector<uint32_t> next_cache;
+		cache.reserve(ForsythCacheSize + 3);
+		next_cache.reserve(ForsythCacheSize + 3);
+
+		std::vector<uint32_t> output;
+		output.reserve(Indices.size());
+
+		uint32_t scan = 0;
+		int64_t best = -1;
+
+		for (uint32_t n = 0; n < triangle_count; n++) {
+			if (best < 0) {
+				// Nothing in the cache has triangles left, carry on from the input order
+				while (emitted[scan]) scan++;
+				best = scan;
+			}
+
+			uint32_t triangle = static_cast<uint32_t>(best);
+			const uint32_t* corners = &Indices[triangle * 3];
+			emitted[triangle] = true;
+			output.insert(output.end(), corners, corners + 3);
+
+			for (int k = 0; k < 3; k++) {
+				uint32_t v = corners[k];
+				uint32_t* begin = &triangles[first_triangle[v]];
+				uint32_t* end = begin + live[v];
+				*std::find(begin, end, triangle) = *(end - 1);
+				live[v]--;
+			}
+
+			// The triangle's vertices move to the front, everything else shifts back
+			next_cache.clear();
+			for (int k = 0; k < 3; k++) {
+				if (std::find(next_cache.begin(), next_cache.end(), corners[k]) == next_cache.end()) {
+					next_cache.push_back(corners[k]);
+				}
+			}
+			for (uint32_t v : cache) {
+				if (v != corners[0] && v != corners[1] && v != corners[2]) {
+					next_cache.push_back(v);
+				}
+			}
+			std::swap(cache, next_cache);
+
+			for (size_t i = 0; i < cache.size(); i++) {
+				uint32_t v = cache[i];
+				cache_position[v] = i < ForsythCacheSize ? static_cast<int>(i) : -1;
+				vertex_score[v] = ForsythScore(cache_position[v], live[v]);
+			}
+
+			// Only triangles of cached vertices changed score
+			best = -1;
+			float best_score = -1.0f;
+			for (uint32_t v : cache) {
+				for (uint32_t i = first_triangle[v]; i < first_triangle[v] + live[v]; i++) {
+					uint32_t t = triangles[i];
+					float score = vertex_score[Indices[t * 3]] + vertex_score[Indices[t * 3 + 1]] + vertex_score[Indices[t * 3 + 2]];
+					if (cache_position[v] >= 0 && score > best_score) {
+						best_score = score;
+						best = t;
+					}
+				}
+			}
+
+			if (cache.size() > ForsythCacheSize) {
+				cache.resize(ForsythCacheSize);
+			}
+		}
+
+		return output;
+	}
+
+	// Pedro Sander, Diego Nehab, Joshua Barczak, "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw".
+	// The cache friendly order is cut into clusters that pay for their own cold start, then clusters facing out
+	// from the middle of the mesh are drawn first. This needs no view, so it suits objects seen from anywhere.
+	std::vector<uint32_t> OptimizeOverdraw(const std::vector<uint32_t>& Indices, const std::vector<float>& Positions) {
+		uint32_t triangle_count = static_cast<uint32_t>(Indices.size() / 3);
+		uint32_t vertex_count = static_cast<uint32_t>(Positions.size() / 3);
+
+		FifoCache warm(vertex_count);
+		for (uint32_t index : Indices) {
+			warm.Touch(index);
+		}
+		float target = ClusterThreshold * static_cast<float>(warm.GetMisses()) / triangle_count;
+
+		// A cluster ends once its cold cache ACMR is back under the target, so reordering clusters costs little
+		std::vector<uint32_t> cluster_starts;
+		FifoCache cold(vertex_count);
+		uint64_t cluster_misses = 0;
+		uint32_t cluster_start = 0;
+		for (uint32_t t = 0; t < triangle_count; t++) {
+			if (t == cluster_start) {
+				cluster_starts.push_back(t);
+				cold.Reset();
+				cluster_misses = 0;
+			}
+
+			for (int k = 0; k < 3; k++) {
+				cluster_misses += cold.Touch(Indices[t * 3 + k]);
+			}
+
+			if (static_cast<float>(cluster_misses) / (t + 1 - cluster_start) <= target) {
+				cluster_start = t + 1;
+			}
+		}
+		cluster_starts.push_back(triangle_count);
+
+		uint32_t cluster_count = static_cast<uint32_t>(cluster_starts.size() - 1);
+		std::vector<glm::vec3> cluster_centroid(cluster_count, glm::vec3(0.0f));
+		std::vector<glm::vec3> cluster_normal(cluster_count, glm::vec3(0.0f));
+		std::vector<float> cluster_area(cluster_count, 0.0f);
+		glm::vec3 mesh_centroid(0.0f);
+		float mesh_area = 0.0f;
+
+		for (uint32_t c = 0; c < cluster_count; c++) {
+			for (uint32_t t = cluster_starts[c]; t < cluster_starts[c + 1]; t++) {
+				glm::vec3 a = Position(Positions, Indices[t * 3]);
+				glm::vec3 b = Position(Positions, Indices[t * 3 + 1]);
+				glm::vec3 v = Position(Positions, Indices[t * 3 + 2]);
+
+				glm::vec3 normal = glm::cross(b - a, v - a);
+				float area = glm::length(normal);
+				glm::vec3 centroid = (a + b + v) / 3.0f;
+
+				cluster_centroid[c] += centroid * area;
+				cluster_normal[c] += normal;
+				cluster_area[c] += area;
+			}
+
+			mesh_centroid += cluster_centroid[c];
+			mesh_area += cluster_area[c];
+		}
+
+		if (mesh_area > 0.0f) {
+			mesh_centroid /= mesh_area;
+		}
+
+		std::vector<float> sort_key(cluster_count, 0.0f);
+		for (uint32_t c = 0; c < cluster_count; c++) {
+			float normal_length = glm::length(cluster_normal[c]);
+			if (cluster_area[c] > 0.0f && normal_length > 0.0f) {
+				glm::vec3 centroid = cluster_centroid[c] / cluster_area[c];
+				sort_key[c] = glm::dot(centroid - mesh_centroid, cluster_normal[c] / normal_length);
+			}
+		}
+
+		std::vector<uint32_t> order(cluster_count);
+		std::iota(order.begin(), order.end(), 0);
+		std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return sort_key[a] > sort_key[b]; });
+
+		std::vector<uint32_t> output;
+		output.reserve(Indices.size());
+		for (uint32_t c : order) {
+			output.insert(output.end(), Indices.begin() + cluster_starts[c] * 3, Indices.begin() + cluster_starts[c + 1] * 3);
+		}
+		return output;
+	}
+
+} // namespace unnamed
+
+namespace MP {
+
+	MeshStats AnalyzeMesh(const ObjectSource& Object) {
+		MeshStats stats;
+		stats.vertex_count = static_cast<uint32_t>(Object.positions.size() / 3);
+		if (Object.indices.size() < 3) {
+			return stats;
+		}
+
+		FifoCache cache(stats.vertex_count);
+		std::vector<bool> used(stats.vertex_count, false);
+		uint32_t used_count = 0;
+		for (uint32_t index : Object.indices) {
+			cache.Touch(index);
+			if (!used[index]) {
+				used[index] = true;
+				used_count++;
+			}
+		}
+
+		stats.acmr = static_cast<float>(cache.GetMisses()) / (Object.indices.size() / 3);
+		stats.atvr = static_cast<float>(cache.GetMisses()) / used_count;
+		stats.overdraw = MeasureOverdraw(Object.indices, Object.positions);
+		return stats;
+	}
+
+	OptimizeReport OptimizeObject(ObjectSource& Object) {
+		OptimizeReport report;
+		if (Object.mesh_key != 0 || Object.positions.empty() || Object.indices.size() < 3) {
+			report.skipped = true;
+			return report;
+		}
+
+		CheckIndices(Object);
+		report.before = AnalyzeMesh(Object);
+
+		uint32_t vertex_count = static_cast<uint32_t>(Object.positions.size() / 3);
+		uint32_t normal_count = static_cast<uint32_t>(Object.normals.size() / 3);
+		bool has_normals = normal_count > 0;
+
+		// Weld. The parser pads missing normals with 0, so that is what they are compared as
+		std::unordered_map<Vertex, uint32_t, VertexHasher> unique;
+		unique.reserve(vertex_count);
+		std::vector<uint32_t> weld(vertex_count);
+		std::vector<uint32_t> welded_from;
+		for (uint32_t v = 0; v < vertex_count; v++) {
+			Vertex vertex{};
+			vertex.position = Position(Object.positions, v);
+			vertex.normal = v < normal_count ? Position(Object.normals, v) : glm::vec3(0.0f);
+
+			auto [it, inserted] = unique.try_emplace(vertex, static_cast<uint32_t>(welded_from.size()));
+			if (inserted) {
+				welded_from.push_back(v);
+			}
+			weld[v] = it->second;
+		}
+
+		std::vector<uint32_t> indices(Object.indices.size());
+		for (size_t i = 0; i < indices.size(); i++) {
+			indices[i] = weld[Object.indices[i]];
+		}
+
+		std::vector<float> positions(welded_from.size() * 3);
+		for (size_t v = 0; v < welded_from.size(); v++) {
+			std::memcpy(&positions[v * 3], &Object.positions[welded_from[v] * 3], sizeof(float) * 3);
+		}
+
+		// A trailing partial triangle draws nothing, it stays at the end
+		std::vector<uint32_t> tail(indices.end() - indices.size() % 3, indices.end());
+		indices.resize(indices.size() - tail.size());
+
+		if (!indices.empty()) {
+			indices = OptimizeVertexCache(indices, static_cast<uint32_t>(welded_from.size()));
+			indices = OptimizeOverdraw(indices, positions);
+		}
+		indices.insert(indices.end(), tail.begin(), tail.end());
+
+		// Fetch order. Vertices no triangle uses are dropped here
+		std::vector<uint32_t> remap(welded_from.size(), UINT32_MAX);
+		std::vector<uint32_t> fetch_order;
+		fetch_order.reserve(welded_from.size());
+		for (uint32_t& index : indices) {
+			if (remap[index] == UINT32_MAX) {
+				remap[index] = static_cast<uint32_t>(fetch_order.size());
+				fetch_order.push_back(index);
+			}
+			index = remap[index];
+		}
+
+		Object.positions.assign(fetch_order.size() * 3, 0.0f);
+		std::vector<float> normals(has_normals ? fetch_order.size() * 3 : 0, 0.0f);
+		for (size_t v = 0; v < fetch_order.size(); v++) {
+			uint32_t source = welded_from[fetch_order[v]];
+			std::memcpy(&Object.positions[v * 3], &positions[fetch_order[v] * 3], sizeof(float) * 3);
+			if (has_normals && source < normal_count) {
+				std::memcpy(&normals[v * 3], &Object.normals[source * 3], sizeof(float) * 3);
+			}
+		}
+
+		Object.normals = std::move(normals);
+		Object.indices = std::move(indices);
+
+		report.after = AnalyzeMesh(Object);
+		return report;
+	}
+
+	std::vector<OptimizeReport> OptimizeObjects(std::vector<ObjectSource>& Objects) {
+		std::vector<OptimizeReport> reports(Objects.size());
+
+		std::vector<uint64_t> costs(Objects.size());
+		for (size_t i = 0; i < Objects.size(); i++) {
+			costs[i] = Objects[i].positions.size() + Objects[i].indices.size();
+		}
+
+		util::GetJobSystem().ParallelFor(static_cast<uint32_t>(Objects.size()), [&](uint32_t i) {
+			reports[i] = OptimizeObject(Objects[i]);
+		}, costs);
+
+		return reports;
+	}
+
+} // namespace MP
\ No newline at end of file
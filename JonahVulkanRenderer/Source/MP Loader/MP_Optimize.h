@@ -0,0 +1,35 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "MP_Writer.h"
+
+// Offline mesh optimisation for .mp objects, run through the optimize tool command.
+namespace MP {
+
+	struct MeshStats {
+		uint32_t vertex_count = 0;
+		float acmr = 0;			// Vertex shader runs per triangle on a 16 entry FIFO cache, 0.5 is the best a grid can do
+		float atvr = 0;			// Vertex shader runs per vertex, 1 means every vertex is transformed exactly once
+		float overdraw = 0;		// Depth tested fragments written per covered pixel, averaged over 6 axis views
+	};
+
+	struct OptimizeReport {
+		MeshStats before;
+		MeshStats after;
+		bool skipped = false;	// Empty objects, and library meshes and references whose key would no longer match the geometry
+	};
+
+	// Measures the mesh as it would be drawn: back faces culled, indices in file order.
+	MeshStats AnalyzeMesh(const ObjectSource& Object);
+
+	// 1. Welds vertices whose position and normal are equal (Vertex::operator==), exporters often split them per face.
+	// 2. Reorders triangles for the post-transform vertex cache (Forsyth).
+	// 3. Cuts that order into clusters and sorts them outside first, so the mesh occludes its own inner faces (Sander et al.).
+	// 4. Renumbers vertices in order of first use, so vertex fetch walks memory forward.
+	// Instances and the set of triangles drawn are unchanged.
+	OptimizeReport OptimizeObject(ObjectSource& Object);
+
+	// OptimizeObject on every object, in parallel on the job system.
+	std::vector<OptimizeReport> OptimizeObjects(std::vector<ObjectSource>& Objects);
+
+} // namespace MP
\ No newline at end of file
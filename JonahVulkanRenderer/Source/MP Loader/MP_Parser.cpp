@@ -1,237 +1,1191 @@
 #include "MP_Parser.h"
+#include "MP_MappedFile.h"
+#include "MP_AsyncReader.h"
+#include "MP_ByteSource.h"
+#include "MP_DecodeKernels.h"
+#include "MP_Format.h"
+#include "MP_Codec.h"
+#include "../Util/MemoryStats.h"
+#include "../Util/JobSystem.h"
 #include <fstream>
 #include <iostream>
 #include <random>
 #include <chrono>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <limits>
+#include <exception>
+#include <mutex>
 #include <thread>
+#include <span>
+#include <string>
 
 namespace {
 
-	uint32_t ReadUnsignedInt32(const std::vector<std::uint8_t>& ByteData, uint32_t Offset, uint32_t BufferSize)
-	{
-		const size_t byte_count = sizeof(uint32_t);
+	using MP::format::ArrayView;
+	using MP::format::ObjectHeader;
+	using MP::format::ReadArray;
 
-		if (Offset + byte_count > BufferSize) {
-			throw std::runtime_error("Out of bounds");
+	inline ArrayView<float> ReadFloatArray(std::span<const std::uint8_t> ByteData, uint64_t Offset, uint64_t OutputArraySize) {
+		return ReadArray<float>(ByteData, Offset, OutputArraySize);
+	}
+
+	// One object to decode. Region parses only take some of an object's instances.
+	struct SelectedObject {
+		uint32_t index;		// In the file, also seeds the mesh color
+		uint64_t offset;	// From the start of the file
+		uint64_t cost;		// Bytes the decode reads, drives scheduling
+		bool all_instances = true;
+		std::vector<MP::format::InstanceRange> instances;
+	};
+
+	// Buffer holds the whole file, object offsets are absolute. mapped_file is set when Buffer is a memory map,
+	// so object ranges can be prefetched and released.
+	struct ObjectData {
+		std::span<const std::uint8_t> buffer;
+		const MP::MappedFile* mapped_file = nullptr;
+		uint16_t version = 1;
+		std::vector<SelectedObject> objects;
+
+		// Only set by LoadAsync
+		std::stop_token stop_token;
+		MP::LoadProgress* progress = nullptr;
+	};
+
+	// Dequantises a packed object into per worker float scratch, then interleaves like a raw object.
+	void ReadPackedModelData(const ObjectData& Data, const ObjectHeader& Header, uint64_t ByteOffset, const SelectedObject& Selection, renderer::MeshInstances& OutputData) {
+		std::span<const std::uint8_t> packed = ReadArray<std::uint8_t>(Data.buffer, ByteOffset, Header.packed_size).bytes;
+
+		thread_local std::vector<float> scratch;
+		scratch.resize((size_t(Header.vertex_count) + Header.normal_count) * 3);
+		float* positions = scratch.data();
+		float* normals = scratch.data() + size_t(Header.vertex_count) * 3;
+
+		// Packed matrices only come out all at once, a partial selection copies its ranges out afterwards
+		thread_local std::vector<glm::mat4> matrix_scratch;
+		glm::mat4* matrices = OutputData.instance_model_matrices.data();
+		if (!Selection.all_instances) {
+			matrix_scratch.resize(Header.instance_count);
+			matrices = matrix_scratch.data();
 		}
 
-		uint32_t x;
-		std::memcpy(&x, ByteData.data() + Offset, byte_count);
+		MP::codec::UnpackObject(Header, packed, positions, normals, OutputData.mesh.indices.data(), matrices);
+
+		if (!Selection.all_instances) {
+			glm::mat4* output = OutputData.instance_model_matrices.data();
+			for (const MP::format::InstanceRange& range : Selection.instances) {
+				output = std::copy_n(matrix_scratch.begin() + range.first, range.count, output);
+			}
+		}
 
-		return x;
+		const std::uint8_t* position_bytes = reinterpret_cast<const std::uint8_t*>(positions);
+		const std::uint8_t* normal_bytes = reinterpret_cast<const std::uint8_t*>(normals);
+		MP::kernels::InterleaveVertices(position_bytes, normal_bytes, Header.vertex_count, Header.normal_count, OutputData.mesh.vertices.data());
 	}
 
-	template <class T>
-	std::vector<T> ReadArray(const std::vector<std::uint8_t>& ByteData, uint32_t Offset, uint32_t BufferSize, uint32_t OutputArraySize) {
+	void ReadRawModelData(const ObjectData& Data, const ObjectHeader& Header, uint64_t ByteOffset, const SelectedObject& Selection, renderer::MeshInstances& OutputData) {
+
+		const std::span<const std::uint8_t> Buffer = Data.buffer;
+		uint64_t byte_offset = ByteOffset;
+
+		uint32_t vertex_count = Header.vertex_count;
+		uint32_t index_count = Header.index_count;
+		uint32_t normal_count = Header.normal_count;
+		uint32_t instance_count = Header.instance_count;
+
+		// Parse object data
+		ArrayView<float> vertices = ReadFloatArray(Buffer, byte_offset, uint64_t(vertex_count) * 3);
+		byte_offset += uint64_t(vertex_count) * 3 * sizeof(float);
+
+		std::span<const std::uint8_t> indices = ReadArray<std::uint8_t>(Buffer, byte_offset, uint64_t(index_count) * Header.index_width).bytes;
+		byte_offset += uint64_t(index_count) * Header.index_width;
+
+		ArrayView<float> normals = ReadFloatArray(Buffer, byte_offset, uint64_t(normal_count) * 3);
+		byte_offset += uint64_t(normal_count) * 3 * sizeof(float);
 
-		const size_t byte_count = OutputArraySize * sizeof(T);
+		ArrayView<float> matrices = ReadFloatArray(Buffer, byte_offset, uint64_t(instance_count) * 16);
+		const uint64_t matrix_offset = byte_offset;
 
-		if (Offset + byte_count > BufferSize) {
-			throw std::runtime_error("Out of bounds");
+		MP::kernels::InterleaveVertices(vertices.bytes.data(), normals.bytes.data(), vertex_count, normal_count, OutputData.mesh.vertices.data());
+
+		if (Header.index_width == 2) {
+			MP::kernels::WidenIndices(indices.data(), index_count, OutputData.mesh.indices.data());
+		}
+		else {
+			std::memcpy(OutputData.mesh.indices.data(), indices.data(), indices.size());
 		}
 
-		std::vector<T> x(OutputArraySize);
-		std::memcpy(x.data(), ByteData.data() + Offset, byte_count);
+		// Note GLM matrices are Column-Major! Column 3 w is forced to 1
+		if (Selection.all_instances) {
+			MP::kernels::CopyMatrices(matrices.bytes.data(), instance_count, OutputData.instance_model_matrices.data());
+			return;
+		}
 
-		return x;
+		// Only the selected matrix bytes are touched
+		glm::mat4* output = OutputData.instance_model_matrices.data();
+		for (const MP::format::InstanceRange& range : Selection.instances) {
+			ArrayView<float> range_matrices = ReadFloatArray(Buffer, matrix_offset + uint64_t(range.first) * sizeof(glm::mat4), uint64_t(range.count) * 16);
+			MP::kernels::CopyMatrices(range_matrices.bytes.data(), range.count, output);
+			output += range.count;
+		}
 	}
 
-	inline std::vector<float> ReadFloatArray(const std::vector<std::uint8_t>& ByteData, uint32_t Offset, uint32_t BufferSize, uint32_t OutputArraySize) {
-		return ReadArray<float>(ByteData, Offset, BufferSize, OutputArraySize);
+	// OutputData already points at its arena slots (see AllocateModelSet), decoding only fills them in.
+	void ReadModelData(const ObjectData& Data, const SelectedObject& Selection, renderer::MeshInstances& OutputData) {
+
+		// Seeded per object so mesh colors do not depend on which worker decoded it
+		std::mt19937 rng(12345 + Selection.index);
+		std::uniform_real_distribution<float> dist(0.2f, 1.0f);
+
+		// Get Object start byte
+		uint64_t object_pointer = Selection.offset;
+
+		// Parse object header
+		ObjectHeader header = MP::format::ReadObjectHeader(Data.buffer, object_pointer, Data.version);
+		uint64_t byte_offset = object_pointer + header.header_size;
+
+		// Fill model object
+		renderer::MeshInstances& new_model = OutputData;
+
+		if (new_model.mesh.vertices.size() != header.vertex_count || new_model.mesh.indices.size() != header.index_count || (Selection.all_instances && new_model.instance_model_matrices.size() != header.instance_count)) {
+			throw std::runtime_error("Object header changed while parsing");
+		}
+
+		new_model.material.color = glm::vec4(dist(rng), dist(rng), dist(rng), 1.0f);
+
+		if (header.encoding == MP::format::ENCODING_PACKED) {
+			ReadPackedModelData(Data, header, byte_offset, Selection, new_model);
+		}
+		else {
+			ReadRawModelData(Data, header, byte_offset, Selection, new_model);
+		}
+
+		// Decoded, the mapped pages can be dropped from RAM
+		if (Data.mapped_file != nullptr) {
+			Data.mapped_file->Release(object_pointer, header.ObjectByteSize());
+		}
 	}
 
-	inline std::vector<uint16_t> ReadUnsignedInt16Array(const std::vector<std::uint8_t>& ByteData, uint32_t Offset, uint32_t BufferSize, uint32_t OutputArraySize) {
-		return ReadArray<uint16_t>(ByteData, Offset, BufferSize, OutputArraySize);
+	// Everything left in Source. Sized from the hint when the source has one, so no seeking is needed and pipes work too.
+	std::vector<std::uint8_t> ReadRest(MP::ByteSource& Source) {
+
+		// Create byte array
+		std::vector<std::uint8_t> remaining_bytes(static_cast<size_t>(Source.GetSizeHint()));
+		size_t filled = 0;
+
+		// Read data
+		while (true) {
+			if (filled == remaining_bytes.size()) {
+
+				// Full, only grow if there really is more
+				std::uint8_t next;
+				if (Source.ReadSome(&next, 1) == 0) {
+					break;
+				}
+
+				remaining_bytes.resize(std::max<size_t>(remaining_bytes.size() * 2, 1024 * 1024));
+				remaining_bytes[filled++] = next;
+			}
+
+			size_t read = Source.ReadSome(remaining_bytes.data() + filled, remaining_bytes.size() - filled);
+			if (read == 0) {
+				break;
+			}
+			filled += read;
+		}
+
+		remaining_bytes.resize(filled);
+		return remaining_bytes;
 	}
 
-	void ReadModelData(const std::vector<std::uint8_t>& Buffer, const std::vector<uint32_t>& ObjectPointers, std::vector<renderer::MeshInstances>& OutputData, uint32_t ChunkSize, uint32_t TID, uint32_t BufferSize, uint32_t ModelCount) {
+	// Byte size of every object, taken from the gap to the next object in the offset table.
+	std::vector<uint64_t> GetObjectCosts(const std::vector<uint64_t>& ModelPointers, uint64_t DataSize) {
 
-		uint32_t start = ChunkSize * TID;
-		uint32_t end = std::min(start + ChunkSize, ModelCount);
+		std::vector<uint64_t> sorted_pointers = ModelPointers;
+		std::sort(sorted_pointers.begin(), sorted_pointers.end());
 
-		std::mt19937 rng(12345);
-		std::uniform_real_distribution<float> dist(0.2f, 1.0f);
+		std::vector<uint64_t> costs(ModelPointers.size());
+		for (size_t i = 0; i < ModelPointers.size(); i++) {
+			auto next = std::upper_bound(sorted_pointers.begin(), sorted_pointers.end(), ModelPointers[i]);
+			uint64_t object_end = next == sorted_pointers.end() ? DataSize : *next;
+			costs[i] = object_end > ModelPointers[i] ? object_end - ModelPointers[i] : 0;
+		}
+
+		return costs;
+	}
+
+	// Every arena section starts 16 byte aligned.
+	constexpr uint64_t AlignArenaSection(uint64_t ByteSize) {
+		return (ByteSize + 15) & ~uint64_t(15);
+	}
+
+	// Object bytes as stored in the file and as they would be with raw encoding.
+	struct ByteTotals {
+		uint64_t stored = 0;
+		uint64_t raw = 0;
+	};
+
+	// Every object with all of its instances, in file order.
+	void SelectAllObjects(ObjectData& Data, const std::vector<uint64_t>& ObjectOffsets) {
+		std::vector<uint64_t> costs = GetObjectCosts(ObjectOffsets, Data.buffer.size());
+
+		Data.objects.resize(ObjectOffsets.size());
+		for (size_t i = 0; i < ObjectOffsets.size(); i++) {
+			Data.objects[i].index = static_cast<uint32_t>(i);
+			Data.objects[i].offset = ObjectOffsets[i];
+			Data.objects[i].cost = costs[i];
+		}
+	}
+
+	// Reads and checks the header of every selected object. Partial selections of raw objects only
+	// prefetch (and are costed by) the mesh arrays and their own matrix ranges.
+	std::vector<ObjectHeader> ReadSelectedHeaders(ObjectData& Data) {
+		std::vector<ObjectHeader> headers(Data.objects.size());
+
+		for (size_t i = 0; i < Data.objects.size(); i++) {
+			SelectedObject& selection = Data.objects[i];
+			ObjectHeader& header = headers[i];
+			header = MP::format::ReadObjectHeader(Data.buffer, selection.offset, Data.version);
+
+			// Checked here so a corrupt header can not ask for a huge arena
+			if (!MP::format::RangeInBounds(selection.offset, header.ObjectByteSize(), Data.buffer.size())) {
+				throw std::runtime_error("Out of bounds");
+			}
+
+			if (selection.all_instances) {
+				continue;
+			}
+
+			uint64_t selected_count = 0;
+			for (const MP::format::InstanceRange& range : selection.instances) {
+				if (range.first > header.instance_count || range.count > header.instance_count - range.first) {
+					throw std::runtime_error("MP tile lists instances the object does not have");
+				}
+				selected_count += range.count;
+			}
+
+			if (selected_count > header.instance_count) {
+				throw std::runtime_error("MP tiles list an instance more than once");
+			}
+
+			if (header.encoding == MP::format::ENCODING_PACKED) {
+				selection.cost = header.ObjectByteSize();
+				if (Data.mapped_file != nullptr) {
+					Data.mapped_file->Prefetch(selection.offset, selection.cost);
+				}
+				continue;
+			}
+
+			uint64_t mesh_bytes = header.ObjectByteSize() - uint64_t(header.instance_count) * sizeof(glm::mat4);
+			selection.cost = mesh_bytes + selected_count * sizeof(glm::mat4);
+
+			if (Data.mapped_file != nullptr) {
+				Data.mapped_file->Prefetch(selection.offset, mesh_bytes);
+				for (const MP::format::InstanceRange& range : selection.instances) {
+					Data.mapped_file->Prefetch(selection.offset + mesh_bytes + uint64_t(range.first) * sizeof(glm::mat4), uint64_t(range.count) * sizeof(glm::mat4));
+				}
+			}
+		}
+
+		return headers;
+	}
+
+	uint32_t GetSelectedInstanceCount(const SelectedObject& Selection, const ObjectHeader& Header) {
+		if (Selection.all_instances) {
+			return Header.instance_count;
+		}
+
+		uint32_t count = 0;
+		for (const MP::format::InstanceRange& range : Selection.instances) {
+			count += range.count;
+		}
+		return count;
+	}
+
+	// Arena bytes one decoded model takes.
+	uint64_t ModelArenaSize(const ObjectHeader& Header, uint32_t InstanceCount) {
+		return AlignArenaSection(uint64_t(Header.vertex_count) * sizeof(renderer::Vertex))
+			+ AlignArenaSection(uint64_t(Header.index_count) * sizeof(uint32_t))
+			+ AlignArenaSection(uint64_t(InstanceCount) * sizeof(glm::mat4));
+	}
+
+	// Points Model at its arena slice starting at Cursor (ModelArenaSize bytes) and fills in what the header knows.
+	void PlaceModel(const ObjectHeader& Header, uint32_t InstanceCount, std::byte* Cursor, renderer::MeshInstances& Model) {
+		Model.instance_count = InstanceCount;
+		Model.mesh_key = Header.mesh_key;
+
+		if (Header.flags & MP::format::OBJECT_HAS_BOUNDS) {
+			Model.has_local_bounds = true;
+			Model.local_bounds_min = glm::vec3(Header.bounds[0], Header.bounds[1], Header.bounds[2]);
+			Model.local_bounds_max = glm::vec3(Header.bounds[3], Header.bounds[4], Header.bounds[5]);
+		}
+
+		Model.mesh.vertices = { reinterpret_cast<renderer::Vertex*>(Cursor), Header.vertex_count };
+		Cursor += AlignArenaSection(uint64_t(Header.vertex_count) * sizeof(renderer::Vertex));
+
+		Model.mesh.indices = { reinterpret_cast<uint32_t*>(Cursor), Header.index_count };
+		Cursor += AlignArenaSection(uint64_t(Header.index_count) * sizeof(uint32_t));
+
+		Model.instance_model_matrices = { reinterpret_cast<glm::mat4*>(Cursor), InstanceCount };
+	}
+
+	// All output sizes are known from the object headers, so the whole scene gets one arena up front
+	// and each model is pointed at its own slice of it.
+	renderer::ModelSet AllocateModelSet(const ObjectData& Data, const std::vector<ObjectHeader>& Headers, ByteTotals& Totals) {
+
+		std::vector<uint32_t> instance_counts(Headers.size());
+		uint64_t arena_size = 0;
+
+		for (size_t i = 0; i < Headers.size(); i++) {
+			instance_counts[i] = GetSelectedInstanceCount(Data.objects[i], Headers[i]);
+
+			Totals.stored += Headers[i].ObjectByteSize();
+			Totals.raw += Headers[i].RawArrayByteSize() + Headers[i].header_size;
+
+			arena_size += ModelArenaSize(Headers[i], instance_counts[i]);
+		}
+
+		renderer::ModelSet model_set;
+		model_set.arena_blocks.push_back(std::make_unique_for_overwrite<std::byte[]>(static_cast<size_t>(arena_size)));
+		model_set.arena_size = static_cast<size_t>(arena_size);
+		model_set.models.resize(Headers.size());
+
+		std::byte* cursor = model_set.arena_blocks.back().get();
+		for (size_t i = 0; i < Headers.size(); i++) {
+			PlaceModel(Headers[i], instance_counts[i], cursor, model_set.models[i]);
+			cursor += ModelArenaSize(Headers[i], instance_counts[i]);
+		}
+
+		return model_set;
+	}
+
+	// Data.objects must already be selected (SelectAllObjects or SelectRegionObjects).
+	// PrintSummary off keeps batched callers from printing a line per batch.
+	renderer::ModelSet DecodeObjects(ObjectData& Data, bool PrintStats, bool PrintSummary = true) {
+
+		uint32_t model_count = static_cast<uint32_t>(Data.objects.size());
+		if (model_count == 0) return {};
+
+		if (Data.progress != nullptr) {
+			uint64_t bytes_total = 0;
+			for (const SelectedObject& selection : Data.objects) {
+				bytes_total += selection.cost;
+			}
+			Data.progress->bytes_total = bytes_total;
+			Data.progress->objects_total = model_count;
+		}
+
+		// Ask the OS to start paging in every whole object before workers reach it
+		if (Data.mapped_file != nullptr) {
+			for (const SelectedObject& selection : Data.objects) {
+				if (selection.all_instances) {
+					Data.mapped_file->Prefetch(selection.offset, selection.cost);
+				}
+			}
+		}
 
-		std::vector<float> vertices(0);
-		std::vector<uint16_t> indices(0);
-		std::vector<float> normals(0);
-		std::vector<float> matrices(0);
+		std::vector<ObjectHeader> headers = ReadSelectedHeaders(Data);
+
+		// Each object writes its own arena slice, so no merge step is needed afterwards
+		ByteTotals totals;
+		renderer::ModelSet model_set = AllocateModelSet(Data, headers, totals);
+
+		std::vector<uint64_t> costs(model_count);
+		for (uint32_t i = 0; i < model_count; i++) {
+			costs[i] = Data.objects[i].cost;
+		}
+
+		util::JobSystem& job_system = util::GetJobSystem();
+		std::atomic<bool> skipped_objects = false;
+		util::BatchStats stats = job_system.ParallelFor(model_count, [&](uint32_t i) {
+			// Once stopped the remaining jobs drain without touching their pages
+			if (Data.stop_token.stop_requested()) {
+				skipped_objects = true;
+				return;
+			}
 
-		std::vector<renderer::MeshInstances> local_model_data;
+			ReadModelData(Data, Data.objects[i], model_set.models[i]);
 
-		for (int i = static_cast<int>(start); i < static_cast<int>(end); i++) {
+			if (Data.progress != nullptr) {
+				Data.progress->bytes_done += Data.objects[i].cost;
+				Data.progress->objects_done++;
+			}
+		}, costs);
 
-			// Get Object start byte
-			uint32_t object_pointer = ObjectPointers[i];
-			uint32_t byte_offset = object_pointer;
+		if (skipped_objects) {
+			throw MP::LoadCancelled();
+		}
 
-			// Parse object header
-			uint32_t vertex_count = ReadUnsignedInt32(Buffer, byte_offset, BufferSize);
-			byte_offset += sizeof(uint32_t);
-			uint32_t index_count = ReadUnsignedInt32(Buffer, byte_offset, BufferSize);
-			byte_offset += sizeof(uint32_t);
-			uint32_t normal_count = ReadUnsignedInt32(Buffer, byte_offset, BufferSize);
-			byte_offset += sizeof(uint32_t);
-			uint32_t instance_count = ReadUnsignedInt32(Buffer, byte_offset, BufferSize);
-			byte_offset += sizeof(uint32_t);
+		if (PrintSummary) {
+			std::cout << "Parsed " << model_count << " objects (MP v" << Data.version << ") on " << job_system.GetWorkerCount() << " workers (" << MP::kernels::GetSIMDLevelName(MP::kernels::GetSIMDLevel()) << " decode)." << std::endl;
+		}
 
-			// Parse object data
-			vertices.resize(vertex_count * 3);
-			indices.resize(index_count);
-			normals.resize(normal_count * 3);
-			matrices.resize(instance_count * 16);
+		if (PrintStats) {
+			stats.Print();
 
-			vertices = ReadFloatArray(Buffer, byte_offset, BufferSize, vertex_count * 3);
-			byte_offset += vertex_count * 3 * sizeof(float);
+			// Raw sized bytes per second of worker time, so packed and raw files compare on equal terms
+			double busy_seconds = 0;
+			for (const util::WorkerStats& worker : stats.workers) {
+				busy_seconds += worker.busy_seconds;
+			}
 
-			indices = ReadUnsignedInt16Array(Buffer, byte_offset, BufferSize, index_count);
-			byte_offset += index_count * sizeof(uint16_t);
+			std::cout << "Decoded " << util::BytesToMegabytes(totals.raw) << " MB from " << util::BytesToMegabytes(totals.stored) << " MB of objects";
+			std::cout << " (compression ratio " << static_cast<double>(totals.raw) / std::max<uint64_t>(totals.stored, 1) << "x), ";
+			std::cout << (busy_seconds > 0 ? static_cast<double>(totals.raw) / busy_seconds / 1e9 : 0.0) << " GB/s per core." << std::endl;
+		}
 
-			normals = ReadFloatArray(Buffer, byte_offset, BufferSize, normal_count * 3);
-			byte_offset += normal_count * 3 * sizeof(float);
+		return model_set;
+	}
 
-			matrices = ReadFloatArray(Buffer, byte_offset, BufferSize, instance_count * 16);
+	bool BoundsOverlap(const float Bounds[6], const MP::AABB& Region) {
+		return Bounds[0] <= Region.max.x && Bounds[3] >= Region.min.x
+			&& Bounds[1] <= Region.max.y && Bounds[4] >= Region.min.y
+			&& Bounds[2] <= Region.max.z && Bounds[5] >= Region.min.z;
+	}
 
-			// Create model object
-			renderer::MeshInstances new_model;
-			new_model.instance_count = instance_count;
+	// Objects with instances in tiles that overlap Region, in file order. Only the entries of those tiles are read.
+	void SelectRegionObjects(ObjectData& Data, const MP::format::FileLayout& Layout, const MP::AABB& Region) {
+		MP::format::TileTable table = MP::format::ReadTileTable(Data.buffer, Layout);
 
-			glm::vec3 mesh_color = { dist(rng), dist(rng), dist(rng) };
+		std::vector<std::vector<MP::format::InstanceRange>> ranges(Layout.object_offsets.size());
 
-			for (int j = 0; j < vertices.size(); j += 3) {
-				renderer::Vertex v;
-				v.color = mesh_color;
-				v.position = { vertices[j], vertices[j + 1],vertices[j + 2] };
+		for (const MP::format::Tile& tile : table.tiles) {
+			if (!BoundsOverlap(tile.bounds, Region)) {
+				continue;
+			}
 
-				if (j >= normals.size()) {
-					v.normal = {0, 0, 0};
+			for (const MP::format::TileEntry& entry : MP::format::ReadTileEntries(Data.buffer, table, tile)) {
+				if (entry.object_index >= ranges.size()) {
+					throw std::runtime_error("MP tile lists an object that does not exist");
+				}
+				if (entry.instances.count > 0) {
+					ranges[entry.object_index].push_back(entry.instances);
+				}
+			}
+		}
+
+		for (uint32_t i = 0; i < ranges.size(); i++) {
+			if (ranges[i].empty()) {
+				continue;
+			}
+
+			// Neighbouring tiles usually hold neighbouring runs, merged so each run is copied once
+			std::vector<MP::format::InstanceRange>& object_ranges = ranges[i];
+			std::sort(object_ranges.begin(), object_ranges.end(), [](const MP::format::InstanceRange& A, const MP::format::InstanceRange& B) {
+				return A.first < B.first;
+			});
+
+			std::vector<MP::format::InstanceRange> merged = { object_ranges[0] };
+			for (size_t k = 1; k < object_ranges.size(); k++) {
+				MP::format::InstanceRange& last = merged.back();
+				if (object_ranges[k].first == uint64_t(last.first) + last.count) {
+					last.count += object_ranges[k].count;
 				}
 				else {
-					v.normal = { normals[j], normals[j + 1], normals[j + 2] };
+					merged.push_back(object_ranges[k]);
+				}
+			}
+
+			SelectedObject selection;
+			selection.index = i;
+			selection.offset = Layout.object_offsets[i];
+			selection.cost = 0; // Set once the header is read
+			selection.all_instances = false;
+			selection.instances = std::move(merged);
+			Data.objects.push_back(std::move(selection));
+		}
+	}
+
+	// Distance from Point to the closest point of a min xyz, max xyz box, 0 inside it.
+	float DistanceToBounds(const float Bounds[6], glm::vec3 Point) {
+		glm::vec3 closest = glm::clamp(Point, glm::vec3(Bounds[0], Bounds[1], Bounds[2]), glm::vec3(Bounds[3], Bounds[4], Bounds[5]));
+		return glm::distance(Point, closest);
+	}
+
+	// How far the nearest instance of every selected object is from Focus. Tiled files are answered from the tile table alone,
+	// otherwise raw objects read just the translation of each instance matrix. Packed objects in untiled files can not be
+	// placed without decoding them, so they stay at infinity and load last.
+	std::vector<float> GetObjectDistances(const ObjectData& Data, const std::vector<ObjectHeader>& Headers, const MP::format::FileLayout& Layout, glm::vec3 Focus) {
+		std::vector<float> distances(Data.objects.size(), std::numeric_limits<float>::infinity());
+
+		if (Layout.flags & MP::format::FILE_HAS_TILES) {
+			MP::format::TileTable table = MP::format::ReadTileTable(Data.buffer, Layout);
+
+			for (const MP::format::Tile& tile : table.tiles) {
+				float distance = DistanceToBounds(tile.bounds, Focus);
+
+				for (const MP::format::TileEntry& entry : MP::format::ReadTileEntries(Data.buffer, table, tile)) {
+					if (entry.object_index >= distances.size()) {
+						throw std::runtime_error("MP tile lists an object that does not exist");
+					}
+					if (entry.instances.count > 0) {
+						distances[entry.object_index] = std::min(distances[entry.object_index], distance);
+					}
 				}
+			}
+
+			return distances;
+		}
+
+		for (size_t i = 0; i < Data.objects.size(); i++) {
+			const ObjectHeader& header = Headers[i];
+			if (header.encoding == MP::format::ENCODING_PACKED) {
+				continue;
+			}
+
+			glm::vec3 local_center = glm::vec3(0);
+			if (header.flags & MP::format::OBJECT_HAS_BOUNDS) {
+				local_center = glm::vec3(header.bounds[0] + header.bounds[3], header.bounds[1] + header.bounds[4], header.bounds[2] + header.bounds[5]) * 0.5f;
+			}
+
+			// Matrices are the last array of a raw object, translation is floats 12 to 14 of each
+			uint64_t matrix_offset = Data.objects[i].offset + header.ObjectByteSize() - uint64_t(header.instance_count) * sizeof(glm::mat4);
+			ArrayView<float> matrices = ReadFloatArray(Data.buffer, matrix_offset, uint64_t(header.instance_count) * 16);
+
+			for (uint32_t k = 0; k < header.instance_count; k++) {
+				glm::vec3 position = glm::vec3(matrices[k * 16 + 12], matrices[k * 16 + 13], matrices[k * 16 + 14]) + local_center;
+				distances[i] = std::min(distances[i], glm::distance(position, Focus));
+			}
+		}
+
+		return distances;
+	}
+
+	renderer::ModelSet Run_ParseMP_Stream(std::string MP_FilePath, bool PrintStats) {
+		std::unique_ptr<MP::ByteSource> file = MP::OpenByteSource(MP_FilePath);
+
+		// Whole file as one byte array, header included
+		std::vector<std::uint8_t> file_bytes = ReadRest(*file);
+
+		ObjectData data;
+		data.buffer = file_bytes;
+
+		MP::format::FileLayout layout = MP::format::ReadFileLayout(data.buffer);
+		data.version = layout.version;
+		SelectAllObjects(data, layout.object_offsets);
+
+		return DecodeObjects(data, PrintStats);
+	}
+
+	renderer::ModelSet Run_ParseMP_Mapped(std::string MP_FilePath, bool PrintStats, const MP::LoadOptions& Options = {}) {
+		MP::MappedFile file(MP_FilePath);
+
+		// Objects are decoded straight out of the mapped pages
+		ObjectData data;
+		data.buffer = file.GetBytes();
+		data.mapped_file = &file;
+		data.stop_token = Options.stop_token;
+		data.progress = Options.progress.get();
+
+		MP::format::FileLayout layout = MP::format::ReadFileLayout(data.buffer);
+		data.version = layout.version;
+		SelectAllObjects(data, layout.object_offsets);
+
+		return DecodeObjects(data, PrintStats);
+	}
+
+	constexpr uint64_t AlignDown(uint64_t Value, uint64_t Alignment) {
+		return Value - Value % Alignment;
+	}
 
-				new_model.mesh.vertices.push_back(v);
+	constexpr uint64_t AlignUp(uint64_t Value, uint64_t Alignment) {
+		return AlignDown(Value + Alignment - 1, Alignment);
+	}
+
+	// Largest object header: v2 fields, bounds, key and packed sizes
+	constexpr uint64_t MaxObjectHeaderSize = MP::format::V2ObjectHeaderSize + MP::format::BoundsSize + MP::format::KeySize + MP::format::PackedSizesSize;
+
+	// Big objects are read in pieces, so even a single huge mesh keeps several reads in flight
+	constexpr uint64_t AsyncChunkSize = 4 * 1024 * 1024;
+
+	// Objects whose bytes have all landed, waiting for a decode worker.
+	class ReadyQueue {
+
+	public:
+		void Push(uint32_t Object) {
+			{
+				std::lock_guard<std::mutex> guard(lock);
+				objects.push_back(Object);
 			}
+			signal.notify_one();
+		}
 
-			for (int j = 0; j < indices.size(); j += 1) {
-				new_model.mesh.indices.push_back(indices[j]);
+		// No more objects will be pushed. Error is rethrown by the parse once the workers are done.
+		void Finish(std::exception_ptr Error = nullptr) {
+			{
+				std::lock_guard<std::mutex> guard(lock);
+				finished = true;
+				error = Error;
 			}
+			signal.notify_all();
+		}
+
+		void Abort() {
+			{
+				std::lock_guard<std::mutex> guard(lock);
+				aborted = true;
+			}
+			signal.notify_all();
+		}
 
-			for (int j = 0; j < matrices.size(); j += 16) {
-				// Note GLM matrices are Column-Major!
+		bool IsAborted() {
+			std::lock_guard<std::mutex> guard(lock);
+			return aborted;
+		}
+
+		// False once everything has been handed out, or when the parse was aborted.
+		bool Pop(uint32_t& Object) {
+			std::unique_lock<std::mutex> guard(lock);
+			signal.wait(guard, [&] { return aborted || !objects.empty() || finished; });
 
-				glm::mat4 instance_matrix(
-					matrices[j + 0], matrices[j + 1], matrices[j + 2], matrices[j + 3],		// Column 0
-					matrices[j + 4], matrices[j + 5], matrices[j + 6], matrices[j + 7],		// Column 1
-					matrices[j + 8], matrices[j + 9], matrices[j + 10], matrices[j + 11],	// Column 2
-					matrices[j + 12], matrices[j + 13], matrices[j + 14], 1.0f				// Column 3
-				);
+			if (aborted || objects.empty()) {
+				return false;
+			}
+
+			Object = objects.front();
+			objects.pop_front();
+			return true;
+		}
 
-				new_model.instance_model_matrices.push_back(instance_matrix);
+		void RethrowError() {
+			if (error) {
+				std::rethrow_exception(error);
 			}
+		}
 
-			local_model_data.push_back(new_model);
+	private:
+		std::mutex lock;
+		std::condition_variable signal;
+		std::deque<uint32_t> objects;
+		bool finished = false;
+		bool aborted = false;
+		std::exception_ptr error;
+	};
+
+	// Blocking read used for the header and pointer table, nothing can start before they are in.
+	void ReadNow(MP::AsyncFileReader& Reader, uint64_t Offset, uint64_t Size, std::uint8_t* FileBytes) {
+		const uint64_t alignment = Reader.GetAlignment();
+		const uint64_t end = AlignUp(Offset + Size, alignment);
+
+		for (uint64_t offset = AlignDown(Offset, alignment); offset < end; offset += AsyncChunkSize) {
+			if (Reader.GetFreeSlots() == 0) {
+				Reader.WaitOne();
+			}
+			Reader.Submit(offset, std::min(AsyncChunkSize, end - offset), FileBytes + offset, 0);
 		}
 
-		OutputData = std::move(local_model_data);
+		while (Reader.GetInFlight() > 0) {
+			Reader.WaitOne();
+		}
 	}
 
-	std::vector<std::uint8_t> ReadRest(std::ifstream& File) {
+	// Reads object bytes with many requests in flight and decodes each object as soon as all of its bytes have landed,
+	// so the disk and the CPU work at the same time. Object headers are read first since the arena needs every size.
+	renderer::ModelSet Run_ParseMP_Async(std::string MP_FilePath, bool DirectIO, bool PrintStats) {
 
-		// Get remaining size leftover
-		std::streampos file_mark_current = File.tellg();
-		File.seekg(0, std::ios::end);
-		std::streampos file_mark_end = File.tellg();
-		File.seekg(file_mark_current, std::ios::beg);
-		std::size_t remaining_file_size = static_cast<std::size_t>(file_mark_end - file_mark_current);
+		// Declared before the reader so in-flight reads are drained before the buffer goes away
+		MP::AlignedBuffer file_bytes;
+		MP::AsyncFileReader reader(MP_FilePath, DirectIO);
 
-		// Create byte array
-		std::vector<std::uint8_t> remaining_bytes(remaining_file_size);
+		const uint64_t file_size = reader.GetFileSize();
+		const uint64_t alignment = reader.GetAlignment();
 
-		// Read data
-		File.read(reinterpret_cast<char*>(remaining_bytes.data()), remaining_file_size);
+		// Same whole file buffer as FILE_STREAM, object bytes land at their own offsets
+		file_bytes = MP::AllocateAligned(AlignUp(file_size, alignment), alignment);
 
-		return remaining_bytes;
+		ObjectData data;
+		data.buffer = { file_bytes.get(), static_cast<size_t>(file_size) };
+
+		// Header, then the pointer table it describes
+		ReadNow(reader, 0, std::min(MP::format::V2HeaderSize, file_size), file_bytes.get());
+
+		uint64_t table_end = MP::format::V1HeaderSize + uint64_t(MP::format::ReadValue<uint32_t>(data.buffer, 2)) * sizeof(uint32_t);
+		if (MP::format::ReadValue<uint32_t>(data.buffer, 2) == MP::format::VersionEscape) {
+			uint64_t model_count = MP::format::ReadValue<uint64_t>(data.buffer, 16);
+			table_end = MP::format::V2HeaderSize + std::min(model_count, file_size / sizeof(uint64_t)) * sizeof(uint64_t);
+		}
+		ReadNow(reader, 0, std::min(table_end, file_size), file_bytes.get());
+
+		MP::format::FileLayout layout = MP::format::ReadFileLayout(data.buffer);
+		data.version = layout.version;
+		SelectAllObjects(data, layout.object_offsets);
+
+		const uint32_t model_count = static_cast<uint32_t>(data.objects.size());
+		if (model_count == 0) return {};
+
+		// Chunk edges sit on every object start and just past every object header, so headers come in small reads of their own
+		std::vector<uint64_t> edges = { AlignUp(file_size, alignment) };
+		for (const SelectedObject& selection : data.objects) {
+			uint64_t start = std::min(selection.offset, file_size);
+			edges.push_back(AlignDown(start, alignment));
+			edges.push_back(AlignUp(std::min(start + MaxObjectHeaderSize, file_size), alignment));
+		}
+		std::sort(edges.begin(), edges.end());
+		edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+		std::vector<uint64_t> chunk_offsets;
+		for (size_t i = 0; i + 1 < edges.size(); i++) {
+			for (uint64_t offset = edges[i]; offset < edges[i + 1]; offset += AsyncChunkSize) {
+				chunk_offsets.push_back(offset);
+			}
+		}
+		chunk_offsets.push_back(edges.back());
+
+		auto chunk_at = [&](uint64_t Offset) {
+			return static_cast<uint32_t>(std::upper_bound(chunk_offsets.begin(), chunk_offsets.end(), Offset) - chunk_offsets.begin() - 1);
+		};
+
+		const uint32_t chunk_count = static_cast<uint32_t>(chunk_offsets.size() - 1);
+		std::vector<bool> chunk_read(chunk_count, false);
+		uint32_t read_count = 0;
+
+		auto submit_chunk = [&](uint32_t Chunk) {
+			reader.Submit(chunk_offsets[Chunk], chunk_offsets[Chunk + 1] - chunk_offsets[Chunk], file_bytes.get() + chunk_offsets[Chunk], Chunk);
+			chunk_read[Chunk] = true;
+			read_count++;
+		};
+
+		// Header chunks
+		std::vector<uint32_t> header_chunks;
+		for (const SelectedObject& selection : data.objects) {
+			uint64_t start = std::min(selection.offset, file_size);
+			uint64_t end = std::min(start + MaxObjectHeaderSize, file_size);
+			for (uint32_t chunk = chunk_at(start); start < end && chunk <= chunk_at(end - 1); chunk++) {
+				header_chunks.push_back(chunk);
+			}
+		}
+		std::sort(header_chunks.begin(), header_chunks.end());
+		header_chunks.erase(std::unique(header_chunks.begin(), header_chunks.end()), header_chunks.end());
+
+		for (uint32_t chunk : header_chunks) {
+			if (reader.GetFreeSlots() == 0) {
+				reader.WaitOne();
+			}
+			submit_chunk(chunk);
+		}
+		while (reader.GetInFlight() > 0) {
+			reader.WaitOne();
+		}
+
+		std::vector<ObjectHeader> headers = ReadSelectedHeaders(data);
+
+		ByteTotals totals;
+		renderer::ModelSet model_set = AllocateModelSet(data, headers, totals);
+
+		// Which objects each unread chunk completes
+		std::vector<uint32_t> pending(model_count, 0);
+		std::vector<std::vector<uint32_t>> waiting(chunk_count);
+		ReadyQueue ready;
+
+		for (uint32_t i = 0; i < model_count; i++) {
+			uint64_t start = data.objects[i].offset;
+			uint64_t end = start + headers[i].ObjectByteSize();
+
+			for (uint32_t chunk = chunk_at(start); chunk <= chunk_at(end - 1); chunk++) {
+				if (!chunk_read[chunk]) {
+					pending[i]++;
+					waiting[chunk].push_back(i);
+				}
+			}
+
+			if (pending[i] == 0) {
+				ready.Push(i);
+			}
+		}
+
+		auto start_time = std::chrono::high_resolution_clock::now();
+
+		// Only this thread touches the reader and the pending counts
+		std::thread io_thread([&] {
+			try {
+				uint32_t next_chunk = 0;
+				while (true) {
+					while (!ready.IsAborted() && reader.GetFreeSlots() > 0 && next_chunk < chunk_count) {
+						if (!chunk_read[next_chunk] && !waiting[next_chunk].empty()) {
+							submit_chunk(next_chunk);
+						}
+						next_chunk++;
+					}
+
+					if (reader.GetInFlight() == 0) {
+						break;
+					}
+
+					uint32_t chunk = static_cast<uint32_t>(reader.WaitOne());
+					for (uint32_t object : waiting[chunk]) {
+						if (--pending[object] == 0) {
+							ready.Push(object);
+						}
+					}
+				}
+				ready.Finish();
+			}
+			catch (...) {
+				ready.Finish(std::current_exception());
+			}
+		});
+
+		// One long running loop per thread, each pulling whatever object landed next. They block on reads, which is fine:
+		// ParallelFor callers only help with their own batch, so no unrelated caller can get stuck in one.
+		util::JobSystem& job_system = util::GetJobSystem();
+		std::exception_ptr decode_error;
+		util::BatchStats stats;
+
+		try {
+			stats = job_system.ParallelFor(job_system.GetWorkerCount() + 1, [&](uint32_t) {
+				uint32_t object;
+				while (ready.Pop(object)) {
+					try {
+						ReadModelData(data, data.objects[object], model_set.models[object]);
+					}
+					catch (...) {
+						ready.Abort();
+						throw;
+					}
+				}
+			});
+		}
+		catch (...) {
+			decode_error = std::current_exception();
+		}
+
+		io_thread.join();
+
+		if (decode_error) {
+			std::rethrow_exception(decode_error);
+		}
+		ready.RethrowError();
+
+		double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start_time).count();
+
+		std::cout << "Parsed " << model_count << " objects (MP v" << data.version << ") on " << job_system.GetWorkerCount() << " workers (" << MP::kernels::GetSIMDLevelName(MP::kernels::GetSIMDLevel()) << " decode, ";
+		std::cout << reader.GetBackendName() << (DirectIO ? " direct" : "") << " reads)." << std::endl;
+
+		if (PrintStats) {
+			stats.Print();
+			std::cout << "Read " << util::BytesToMegabytes(file_size) << " MB in " << read_count << " reads, decoding overlapped: " << util::BytesToMegabytes(totals.raw) / std::max(seconds, 1e-9) << " MB/s after headers." << std::endl;
+		}
+
+		return model_set;
 	}
 
-	std::vector<renderer::MeshInstances> Run_ParseMP(std::string MP_FilePath) {
-		std::ifstream file(MP_FilePath, std::ios::binary);
+	// Streamed models are carved out of blocks this big, a bigger model gets a block of its own.
+	constexpr uint64_t StreamArenaBlockSize = 64 * 1024 * 1024;
 
-		if (!file) {
-			throw std::invalid_argument("MP file could not open.");
+	// Caps the object bytes a streamed parse holds at once. The reader waits here until decode workers give bytes back.
+	class ByteBudget {
+
+	public:
+		explicit ByteBudget(uint64_t Limit) : limit(Limit) {}
+
+		// False once aborted. An object bigger than the whole budget waits until nothing else is held.
+		bool Acquire(uint64_t Size) {
+			std::unique_lock<std::mutex> guard(lock);
+			signal.wait(guard, [&] { return aborted || used == 0 || used + Size <= limit; });
+
+			if (aborted) {
+				return false;
+			}
+
+			used += Size;
+			peak = std::max(peak, used);
+			return true;
 		}
 
-		uint64_t total_unique_objects = 0;
+		void Release(uint64_t Size) {
+			{
+				std::lock_guard<std::mutex> guard(lock);
+				used -= Size;
+			}
+			signal.notify_all();
+		}
 
-		// Get header data 
-		uint16_t mp_identifier; // All .mp files start with 4D 50 (MP in Hex) to quick screen invalid files.
-		file.read(reinterpret_cast<char*>(&mp_identifier), sizeof(uint16_t));
+		void Abort() {
+			{
+				std::lock_guard<std::mutex> guard(lock);
+				aborted = true;
+			}
+			signal.notify_all();
+		}
+
+		uint64_t GetPeak() {
+			std::lock_guard<std::mutex> guard(lock);
+			return peak;
+		}
 
-		if (mp_identifier != 0x4D50) {
+	private:
+		std::mutex lock;
+		std::condition_variable signal;
+		uint64_t limit;
+		uint64_t used = 0;
+		uint64_t peak = 0;
+		bool aborted = false;
+	};
+
+	// Header and pointer table off the front of Source. The table is read a piece at a time,
+	// so a corrupt count runs out of stream before it can ask for a huge buffer.
+	MP::format::FileLayout ReadStreamLayout(MP::ByteSource& Source) {
+		std::vector<std::uint8_t> bytes(MP::format::V1HeaderSize);
+		Source.ReadExact(bytes.data(), bytes.size());
+
+		if (MP::format::ReadValue<uint16_t>(bytes, 0) != MP::format::Magic) {
 			throw std::invalid_argument("Tried to parse a invalid MP file.");
 		}
 
-		uint32_t model_count;
-		file.read(reinterpret_cast<char*>(&model_count), sizeof(uint32_t));
+		uint64_t table_size = uint64_t(MP::format::ReadValue<uint32_t>(bytes, 2)) * sizeof(uint32_t);
+
+		if (MP::format::ReadValue<uint32_t>(bytes, 2) == MP::format::VersionEscape) {
+			bytes.resize(MP::format::V2HeaderSize);
+			Source.ReadExact(bytes.data() + MP::format::V1HeaderSize, MP::format::V2HeaderSize - MP::format::V1HeaderSize);
+
+			uint64_t model_count = MP::format::ReadValue<uint64_t>(bytes, 16);
+			if (model_count > UINT32_MAX) {
+				throw std::runtime_error("Out of bounds");
+			}
+			table_size = model_count * sizeof(uint64_t);
+		}
+
+		while (table_size > 0) {
+			uint64_t step = std::min<uint64_t>(table_size, 1024 * 1024);
+			size_t read_to = bytes.size();
 
-		std::vector<uint32_t> model_pointers(model_count);
-		file.read(reinterpret_cast<char*>(model_pointers.data()), model_count * sizeof(uint32_t));
+			bytes.resize(read_to + static_cast<size_t>(step));
+			Source.ReadExact(bytes.data() + read_to, step);
+			table_size -= step;
+		}
 
-		// Get rest of object data as byte array
-		std::vector<std::uint8_t> remaining_bytes = ReadRest(file);
-		uint32_t data_size = static_cast<uint32_t>(remaining_bytes.size());
+		return MP::format::ReadFileLayout(bytes);
+	}
 
-		// Prepare for thread launch
-		uint32_t max_thread_count = std::thread::hardware_concurrency();
-		uint8_t thread_count = static_cast<uint8_t>(std::min(max_thread_count, model_count));
-		uint32_t chunk_size = (model_count + (thread_count - 1)) / thread_count;
+	// Reads one object header into Output and returns its size. The size depends on flags inside the header,
+	// so it comes in a field group at a time.
+	uint64_t ReadStreamObjectHeader(MP::ByteSource& Source, uint16_t Version, std::uint8_t* Output) {
+		uint64_t size = MP::format::V1ObjectHeaderSize;
+		Source.ReadExact(Output, size);
+
+		if (Version == 1) {
+			return size;
+		}
 
-		// Launch threads
-		std::vector<std::thread> threads;
-		threads.reserve(thread_count);
+		auto read_more = [&](uint64_t Size) {
+			Source.ReadExact(Output + size, Size);
+			size += Size;
+		};
 
-		std::vector<std::vector<renderer::MeshInstances>> output_data(thread_count);
+		read_more(MP::format::V2ObjectHeaderSize - MP::format::V1ObjectHeaderSize);
 
-		std::cout << "Launched: " << static_cast<int>(thread_count) << " threads with a chunk size of " << chunk_size << "." << std::endl;
+		std::span<const std::uint8_t> fields = { Output, static_cast<size_t>(size) };
+		uint8_t encoding = MP::format::ReadValue<uint8_t>(fields, 17);
+		uint16_t flags = MP::format::ReadValue<uint16_t>(fields, 18);
 
-		for (int i = 0; i < thread_count; i++) {
-			threads.emplace_back(ReadModelData, std::cref(remaining_bytes), std::cref(model_pointers), std::ref(output_data[i]), chunk_size, i, data_size, model_count);
+		if (flags & MP::format::OBJECT_HAS_BOUNDS) {
+			read_more(MP::format::BoundsSize);
 		}
+		if (flags & MP::format::OBJECT_HAS_KEY) {
+			read_more(MP::format::KeySize);
+		}
+		if (encoding == MP::format::ENCODING_PACKED) {
+			read_more(MP::format::PackedSizesSize);
+		}
+
+		return size;
+	}
+
+	// Forward-only parse. Objects are read in file order into buffers of their own and handed to decode workers as each
+	// one completes, holding at most BufferBytes of object data. Nothing seeks, so pipes and FIFOs work.
+	renderer::ModelSet Run_ParseMP_Streamed(MP::ByteSource& Source, uint64_t BufferBytes, bool PrintStats) {
+		auto start_time = std::chrono::high_resolution_clock::now();
 
-		// Wait for threads to join
-		for (std::thread& t : threads) {
-			if (t.joinable()) {
-				t.join();
+		MP::format::FileLayout layout = ReadStreamLayout(Source);
+
+		const uint32_t model_count = static_cast<uint32_t>(layout.object_offsets.size());
+		if (model_count == 0) return {};
+
+		std::vector<uint32_t> file_order(model_count);
+		for (uint32_t i = 0; i < model_count; i++) {
+			file_order[i] = i;
+		}
+		std::stable_sort(file_order.begin(), file_order.end(), [&](uint32_t A, uint32_t B) {
+			return layout.object_offsets[A] < layout.object_offsets[B];
+		});
+
+		// Sized up front so the reader can point models at the arena while workers decode others
+		renderer::ModelSet model_set;
+		model_set.models.resize(model_count);
+
+		std::vector<std::vector<std::uint8_t>> object_bytes(model_count);
+
+		ByteBudget budget(BufferBytes);
+		ReadyQueue ready;
+		ByteTotals totals;
+
+		// Only this thread touches Source, the arena blocks and the totals
+		std::thread reader_thread([&] {
+			try {
+				std::byte* block_cursor = nullptr;
+				uint64_t block_left = 0;
+
+				for (uint32_t object : file_order) {
+					uint64_t offset = layout.object_offsets[object];
+					if (offset < Source.GetPosition()) {
+						throw std::runtime_error("MP objects overlap, the file can not be streamed");
+					}
+
+					// Tile table and any padding
+					Source.Skip(offset - Source.GetPosition());
+
+					std::uint8_t header_bytes[MaxObjectHeaderSize];
+					uint64_t header_size = ReadStreamObjectHeader(Source, layout.version, header_bytes);
+					ObjectHeader header = MP::format::ReadObjectHeader({ header_bytes, static_cast<size_t>(header_size) }, 0, layout.version);
+					uint64_t object_size = header.ObjectByteSize();
+
+					if (!budget.Acquire(object_size)) {
+						break;
+					}
+
+					// Header included, so the object decodes exactly like one inside a whole file buffer at offset 0.
+					// Grown a budget sized step at a time, so a corrupt size runs out of stream before it can ask for a huge buffer
+					std::vector<std::uint8_t>& bytes = object_bytes[object];
+					bytes.assign(header_bytes, header_bytes + header_size);
+					while (bytes.size() < object_size) {
+						size_t read_to = bytes.size();
+						uint64_t step = std::min<uint64_t>(object_size - read_to, BufferBytes);
+
+						bytes.resize(read_to + static_cast<size_t>(step));
+						Source.ReadExact(bytes.data() + read_to, step);
+					}
+
+					totals.stored += object_size;
+					totals.raw += header.RawArrayByteSize() + header.header_size;
+
+					uint64_t arena_bytes = ModelArenaSize(header, header.instance_count);
+					if (arena_bytes > block_left) {
+						uint64_t block_size = std::max(arena_bytes, StreamArenaBlockSize);
+						model_set.arena_blocks.push_back(std::make_unique_for_overwrite<std::byte[]>(static_cast<size_t>(block_size)));
+						block_cursor = model_set.arena_blocks.back().get();
+						block_left = block_size;
+					}
+
+					PlaceModel(header, header.instance_count, block_cursor, model_set.models[object]);
+					block_cursor += arena_bytes;
+					block_left -= arena_bytes;
+					model_set.arena_size += static_cast<size_t>(arena_bytes);
+
+					ready.Push(object);
+				}
+				ready.Finish();
+			}
+			catch (...) {
+				ready.Finish(std::current_exception());
 			}
+		});
+
+		// Same blocking consumer loops as the overlapped parse, kept off unrelated callers by ParallelFor
+		util::JobSystem& job_system = util::GetJobSystem();
+		std::exception_ptr decode_error;
+		util::BatchStats stats;
+
+		try {
+			stats = job_system.ParallelFor(job_system.GetWorkerCount() + 1, [&](uint32_t) {
+				uint32_t object;
+				while (ready.Pop(object)) {
+					try {
+						ObjectData data;
+						data.buffer = object_bytes[object];
+						data.version = layout.version;
+
+						SelectedObject selection;
+						selection.index = object;
+						selection.offset = 0;
+						selection.cost = object_bytes[object].size();
+
+						ReadModelData(data, selection, model_set.models[object]);
+					}
+					catch (...) {
+						ready.Abort();
+						budget.Abort();
+						throw;
+					}
+
+					// Decoded, the bytes go back to the reader
+					uint64_t object_size = object_bytes[object].size();
+					object_bytes[object] = {};
+					budget.Release(object_size);
+				}
+			});
+		}
+		catch (...) {
+			decode_error = std::current_exception();
+		}
+
+		reader_thread.join();
+
+		if (decode_error) {
+			std::rethrow_exception(decode_error);
 		}
+		ready.RethrowError();
 
-		// Threads complete merge workload
-		std::vector<renderer::MeshInstances> merged_object_data;
-		for (auto& vector : output_data) {
-			merged_object_data.insert(merged_object_data.end(),
-				std::make_move_iterator(vector.begin()),
-				std::make_move_iterator(vector.end()));
+		double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start_time).count();
+
+		std::cout << "Streamed " << model_count << " objects (MP v" << layout.version << ") on " << job_system.GetWorkerCount() << " workers, ";
+		std::cout << util::BytesToMegabytes(budget.GetPeak()) << " MB of object data buffered at most." << std::endl;
+
+		if (PrintStats) {
+			stats.Print();
+			std::cout << "Read " << util::BytesToMegabytes(Source.GetPosition()) << " MB, decoded " << util::BytesToMegabytes(totals.raw) << " MB from " << util::BytesToMegabytes(totals.stored) << " MB of objects";
+			std::cout << " at " << util::BytesToMegabytes(totals.raw) / std::max(seconds, 1e-9) << " MB/s." << std::endl;
+		}
+
+		return model_set;
+	}
+
+	renderer::ModelSet Run_ParseMP(std::string MP_FilePath, MP::LOADMODE Mode, bool PrintStats = false) {
+		switch (Mode) {
+		case MP::LOADMODE::MEMORY_MAPPED:
+			return Run_ParseMP_Mapped(MP_FilePath, PrintStats);
+		case MP::LOADMODE::ASYNC_READ:
+			return Run_ParseMP_Async(MP_FilePath, false, PrintStats);
+		case MP::LOADMODE::ASYNC_READ_DIRECT:
+			return Run_ParseMP_Async(MP_FilePath, true, PrintStats);
+		default:
+			return Run_ParseMP_Stream(MP_FilePath, PrintStats);
 		}
+	}
+
+	// Peak resident memory a single parse adds on top of what the process already holds.
+	// Where the peak counter can not be reset (Windows) run the cheaper mode first, otherwise the larger earlier peak hides it.
+	uint64_t MeasurePeakResidentGrowth(std::string MP_FilePath, MP::LOADMODE Mode) {
+		util::ResetPeakResidentBytes();
 
-		return merged_object_data;
+		uint64_t resident_before = util::GetCurrentResidentBytes();
+		Run_ParseMP(MP_FilePath, Mode);
+		uint64_t peak_after = util::GetPeakResidentBytes();
+
+		return peak_after > resident_before ? peak_after - resident_before : 0;
 	}
 } // namespace unnamed
 
 namespace MP {
 
-	std::vector<renderer::MeshInstances> ParseMP(std::string MP_FilePath, bool BenchmarkMode){
-		
+	renderer::ModelSet ParseMP(std::string MP_FilePath, bool BenchmarkMode, LOADMODE Mode){
+
 		if (BenchmarkMode == false) {
-			return Run_ParseMP(MP_FilePath);
+			return Run_ParseMP(MP_FilePath, Mode);
 		}
 
+		// Measured before the timed runs so neither mode inherits the other's heap high-water mark
+		uint64_t mapped_peak = MeasurePeakResidentGrowth(MP_FilePath, LOADMODE::MEMORY_MAPPED);
+		uint64_t stream_peak = MeasurePeakResidentGrowth(MP_FilePath, LOADMODE::FILE_STREAM);
+
 		int run_count = 10;
 		long long total = 0;
 
 		for (int i = 0; i < run_count; i++) {
 			auto start = std::chrono::high_resolution_clock::now();
 
-			Run_ParseMP(MP_FilePath);
+			Run_ParseMP(MP_FilePath, Mode);
 
 			auto end = std::chrono::high_resolution_clock::now();
 			auto execution_time_us = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
@@ -242,8 +1196,147 @@ namespace MP {
 
 		std::cout << "Average time over " << run_count << " executions: ";
 		std::cout << average_time / 60000000 << "m " << (average_time / 1000000) % 60 << "s " << (average_time / 1000) % 1000 << "ms " << average_time % 1000 << "us" << std::endl;
-	
-		return Run_ParseMP(MP_FilePath);
+
+		std::cout << "Peak RSS growth: memory mapped " << util::BytesToMegabytes(mapped_peak) << " MB, ";
+		std::cout << "file stream " << util::BytesToMegabytes(stream_peak) << " MB." << std::endl;
+
+		return Run_ParseMP(MP_FilePath, Mode, true);
+	}
+
+	renderer::ModelSet ParseMPRegion(std::string MP_FilePath, const AABB& Region, bool PrintStats) {
+		MP::MappedFile file(MP_FilePath);
+
+		ObjectData data;
+		data.buffer = file.GetBytes();
+		data.mapped_file = &file;
+
+		MP::format::FileLayout layout = MP::format::ReadFileLayout(data.buffer);
+		data.version = layout.version;
+
+		if ((layout.flags & MP::format::FILE_HAS_TILES) == 0) {
+			throw std::invalid_argument("MP file has no tile table, write it with tiles to load regions.");
+		}
+
+		SelectRegionObjects(data, layout, Region);
+
+		return DecodeObjects(data, PrintStats);
+	}
+
+	renderer::ModelSet ParseMPObjects(std::string MP_FilePath, std::span<const uint32_t> ObjectIndices) {
+		MP::MappedFile file(MP_FilePath);
+
+		ObjectData data;
+		data.buffer = file.GetBytes();
+		data.mapped_file = &file;
+
+		MP::format::FileLayout layout = MP::format::ReadFileLayout(data.buffer);
+		data.version = layout.version;
+
+		std::vector<uint64_t> costs = GetObjectCosts(layout.object_offsets, data.buffer.size());
+		for (uint32_t index : ObjectIndices) {
+			if (index >= layout.object_offsets.size()) {
+				throw std::runtime_error("MP object index out of range");
+			}
+
+			SelectedObject selection;
+			selection.index = index;
+			selection.offset = layout.object_offsets[index];
+			selection.cost = costs[index];
+			data.objects.push_back(std::move(selection));
+		}
+
+		return DecodeObjects(data, false, false);
+	}
+
+	void ParseMPProgressive(std::string MP_FilePath, glm::vec3 Focus, uint64_t BatchBytes, const BatchCallback& OnBatch) {
+		MP::MappedFile file(MP_FilePath);
+
+		ObjectData data;
+		data.buffer = file.GetBytes();
+		data.mapped_file = &file;
+
+		MP::format::FileLayout layout = MP::format::ReadFileLayout(data.buffer);
+		data.version = layout.version;
+		SelectAllObjects(data, layout.object_offsets);
+
+		std::vector<ObjectHeader> headers = ReadSelectedHeaders(data);
+		std::vector<float> distances = GetObjectDistances(data, headers, layout, Focus);
+
+		// Nearest first, ties keep file order
+		std::vector<uint32_t> order(data.objects.size());
+		for (uint32_t i = 0; i < order.size(); i++) {
+			order[i] = i;
+		}
+		std::stable_sort(order.begin(), order.end(), [&](uint32_t A, uint32_t B) {
+			return distances[A] < distances[B];
+		});
+
+		ObjectData batch;
+		batch.buffer = data.buffer;
+		batch.mapped_file = data.mapped_file;
+		batch.version = data.version;
+		uint64_t batch_bytes = 0;
+
+		for (size_t k = 0; k < order.size(); k++) {
+			batch.objects.push_back(data.objects[order[k]]);
+			batch_bytes += headers[order[k]].ObjectByteSize();
+
+			if (batch_bytes < BatchBytes && k + 1 < order.size()) {
+				continue;
+			}
+
+			if (!OnBatch(DecodeObjects(batch, false, false))) {
+				return;
+			}
+
+			batch.objects.clear();
+			batch_bytes = 0;
+		}
+	}
+
+	glm::vec3 GetDefaultFocus(std::string MP_FilePath) {
+		MP::MappedFile file(MP_FilePath);
+
+		ObjectData data;
+		data.buffer = file.GetBytes();
+		data.mapped_file = &file;
+
+		MP::format::FileLayout layout = MP::format::ReadFileLayout(data.buffer);
+		data.version = layout.version;
+		SelectAllObjects(data, layout.object_offsets);
+
+		for (const SelectedObject& selection : data.objects) {
+			ObjectHeader header = MP::format::ReadObjectHeader(data.buffer, selection.offset, data.version);
+			if (header.vertex_count == 0 || header.index_count == 0 || header.instance_count == 0) {
+				continue;
+			}
+
+			ObjectData first = data;
+			first.objects = { selection };
+			renderer::ModelSet model_set = DecodeObjects(first, false, false);
+			const renderer::MeshInstances& model = model_set.models[0];
+
+			// Same rule SceneParser uses for the scene root: the first instance's world centre, pushed out by its radius
+			renderer::BoundingBoxData bounds = renderer::TransformBounds(renderer::ComputeMeshBounds(model.mesh), model.instance_model_matrices[0]);
+			return glm::vec3(bounds.center_point) + glm::vec3(bounds.center_point.w, 0, 0);
+		}
+
+		return glm::vec3(0);
+	}
+
+	renderer::ModelSet ParseMPStream(ByteSource& Source, uint64_t BufferBytes, bool PrintStats) {
+		return Run_ParseMP_Streamed(Source, BufferBytes, PrintStats);
+	}
+
+	util::Task<renderer::ModelSet> LoadAsync(std::string MP_FilePath, LoadOptions Options) {
+		// Off the awaiting thread before the file is opened
+		co_await util::ResumeOnJobSystem();
+
+		if (Options.stop_token.stop_requested()) {
+			throw LoadCancelled();
+		}
+
+		co_return Run_ParseMP_Mapped(MP_FilePath, Options.print_stats, Options);
 	}
 
 	// All .mp files start with 4D 50 (MP in Hex) to quick screen invalid files.
@@ -254,7 +1347,7 @@ namespace MP {
 			return false;
 		}
 
-		uint16_t mp_identifier; 
+		uint16_t mp_identifier;
 		file.read(reinterpret_cast<char*>(&mp_identifier), sizeof(uint16_t));
 
 		return mp_identifier == 0x4D50;
@@ -1,10 +1,77 @@
 #pragma once
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <stop_token>
 #include <string>
+#include "MP_ByteSource.h"
 #include "../Renderer/VkUtil/VkCommon.h"
+#include "../Util/Task.h"
 
 namespace MP {
 
-	std::vector<renderer::MeshInstances> ParseMP(std::string json_file_path, bool BenchmarkMode = false);
+	// MEMORY_MAPPED decodes objects straight out of the mapped file. FILE_STREAM reads the file into a heap buffer first.
+	// ASYNC_READ keeps many object sized reads in flight (io_uring / overlapped IO) and decodes each object as soon as
+	// it lands, which wins on a cold page cache. ASYNC_READ_DIRECT does the same bypassing the page cache.
+	enum LOADMODE { FILE_STREAM, MEMORY_MAPPED, ASYNC_READ, ASYNC_READ_DIRECT };
+
+	renderer::ModelSet ParseMP(std::string json_file_path, bool BenchmarkMode = false, LOADMODE Mode = MEMORY_MAPPED);
+
+	// World space box
+	struct AABB {
+		glm::vec3 min;
+		glm::vec3 max;
+	};
+
+	// Loads only the objects and instances of tiles that overlap Region, touching no other object bytes.
+	// Needs a tiled file (see MP_Writer.h). Tiles are bounded by whole instances, so a few instances past the edge come along.
+	renderer::ModelSet ParseMPRegion(std::string MP_FilePath, const AABB& Region, bool PrintStats = false);
+
+	// Decodes only the listed objects, in that order. Meshes keep the colors they get in a full parse.
+	renderer::ModelSet ParseMPObjects(std::string MP_FilePath, std::span<const uint32_t> ObjectIndices);
+
+	// Gets each batch of a progressive parse. Returning false stops the parse.
+	using BatchCallback = std::function<bool(renderer::ModelSet&&)>;
+
+	// Decodes whole objects in batches of about BatchBytes (as stored), nearest to Focus first, so what is around the camera
+	// can be drawn long before the rest of the scene is in. Runs on the calling thread, see MP_Progressive.h for the background loader.
+	// Tiled files are ordered from the tile table alone; untiled files read every instance translation first, and their packed
+	// objects can not be placed without decoding so they come last.
+	void ParseMPProgressive(std::string MP_FilePath, glm::vec3 Focus, uint64_t BatchBytes, const BatchCallback& OnBatch);
+
+	// Where the full parse would put the scene root, found by decoding only the first non-empty object.
+	glm::vec3 GetDefaultFocus(std::string MP_FilePath);
+
+	// Reads Source front to back once, for inputs that can not seek or be opened twice (stdin, pipes, FIFOs).
+	// Objects decode as they arrive with at most BufferBytes of undecoded object data held, so the parse
+	// never needs the whole file in memory. Objects must not overlap, which is true of every file MP_Writer writes.
+	renderer::ModelSet ParseMPStream(ByteSource& Source, uint64_t BufferBytes = 64 * 1024 * 1024, bool PrintStats = false);
+
+	// Filled in as a LoadAsync runs, safe to read from any thread. Bytes are as stored in the file.
+	struct LoadProgress {
+		std::atomic<uint64_t> bytes_total = 0;
+		std::atomic<uint64_t> bytes_done = 0;
+		std::atomic<uint32_t> objects_total = 0;
+		std::atomic<uint32_t> objects_done = 0;
+	};
+
+	struct LoadOptions {
+		std::stop_token stop_token;				// Once a stop is requested the load ends at the next object
+		std::shared_ptr<LoadProgress> progress;	// Optional
+		bool print_stats = false;
+	};
+
+	// Thrown by a load that was stopped through LoadOptions::stop_token.
+	class LoadCancelled : public std::runtime_error {
+	public:
+		LoadCancelled() : std::runtime_error("MP load cancelled") {}
+	};
+
+	// Memory mapped parse run on the shared job system, nothing happens until the task is awaited or started.
+	// Objects that have not started decoding are skipped once a stop is requested, so a half finished
+	// multi GB load can be dropped about one object's decode time after asking.
+	util::Task<renderer::ModelSet> LoadAsync(std::string MP_FilePath, LoadOptions Options = {});
 
 	bool CheckValidMP(std::string json_file_path);
 
@@ -0,0 +1,59 @@
+#include "MP_Progressive.h"
+#include "MP_Parser.h"
+#include "MP_Dedup.h"
+#include <chrono>
+
+namespace MP {
+
+	ProgressiveLoader::ProgressiveLoader(std::string MP_FilePath, glm::vec3 Focus, uint64_t BatchBytes) : batches(8) {
+
+		thread = std::thread([this, MP_FilePath, Focus, BatchBytes] {
+			try {
+				ParseMPProgressive(MP_FilePath, Focus, BatchBytes, [&](renderer::ModelSet&& Batch) {
+					// Only within the batch, a shape first met in a later batch is drawn on its own there
+					DeduplicateMeshes(Batch);
+					auto scene = std::make_unique<renderer::scene::SceneParser>(Batch, true, true);
+
+					// The render thread has fallen behind, wait for it instead of decoding further ahead
+					while (!batches.TryPush(std::move(scene))) {
+						if (stop.load()) {
+							return false;
+						}
+						std::this_thread::sleep_for(std::chrono::milliseconds(1));
+					}
+
+					return !stop.load();
+				});
+			}
+			catch (...) {
+				error = std::current_exception();
+			}
+
+			done.store(true);
+		});
+	}
+
+	ProgressiveLoader::~ProgressiveLoader() {
+		stop.store(true);
+		thread.join();
+	}
+
+	std::unique_ptr<renderer::scene::SceneParser> ProgressiveLoader::TryPopBatch() {
+		std::optional<std::unique_ptr<renderer::scene::SceneParser>> batch = batches.TryPop();
+		return batch ? std::move(*batch) : nullptr;
+	}
+
+	bool ProgressiveLoader::IsFinished() {
+
+		// done is set after the last push, so an empty queue after seeing it really is the end
+		if (!done.load() || !batches.Empty()) {
+			return false;
+		}
+
+		if (error) {
+			std::rethrow_exception(error);
+		}
+		return true;
+	}
+
+} // namespace MP
\ No newline at end of file
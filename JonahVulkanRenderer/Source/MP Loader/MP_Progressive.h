@@ -0,0 +1,43 @@
+#pragma once
+#include <atomic>
+#include <exception>
+#include <memory>
+#include <string>
+#include <thread>
+#include "../Renderer/VkUtil/VkSceneProcesser.h"
+#include "../Util/SPSCQueue.h"
+
+namespace MP {
+
+	// Batches of about this many stored object bytes. Small enough that the first one lands within a frame or two.
+	constexpr uint64_t DefaultBatchBytes = 16 * 1024 * 1024;
+
+	// Runs ParseMPProgressive on a thread of its own and turns every batch into GPU ready arrays there too,
+	// so the render thread only has to pick finished batches up between frames and append them (Renderer::AppendScene).
+	class ProgressiveLoader {
+
+	public:
+		// Starts loading straight away.
+		ProgressiveLoader(std::string MP_FilePath, glm::vec3 Focus, uint64_t BatchBytes = DefaultBatchBytes);
+
+		// Stops after the batch being decoded and waits for the thread.
+		~ProgressiveLoader();
+
+		ProgressiveLoader(const ProgressiveLoader&) = delete;
+		ProgressiveLoader& operator=(const ProgressiveLoader&) = delete;
+
+		// Never blocks. Null when no batch is waiting. Render thread only.
+		std::unique_ptr<renderer::scene::SceneParser> TryPopBatch();
+
+		// True once the last batch has been popped. Rethrows the load error if the loader thread failed.
+		bool IsFinished();
+
+	private:
+		util::SPSCQueue<std::unique_ptr<renderer::scene::SceneParser>> batches;
+		std::atomic<bool> stop = false;
+		std::atomic<bool> done = false;
+		std::exception_ptr error;
+		std::thread thread;
+	};
+
+} // namespace MP
\ No newline at end of file
@@ -0,0 +1,515 @@
+#include "MP_Tool.h"
+#include "MP_Parser.h"
+#include "MP_Writer.h"
+#include "MP_Format.h"
+#include "MP_AsyncReader.h"
+#include "MP_ByteSource.h"
+#include "MP_MappedFile.h"
+#include "MP_Dedup.h"
+#include "MP_Library.h"
+#include "MP_Optimize.h"
+#include "MP_Import.h"
+#include "../Util/MemoryStats.h"
+#include "../Renderer/VkUtil/VkDataSetup.h"
+#include "../Renderer/VkUtil/VkSceneProcesser.h"
+#include "../Renderer/VkUtil/VkVertexFormat.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <chrono>
+#include <algorithm>
+#include <stop_token>
+#include <thread>
+#include <iostream>
+#include <string>
+
+namespace {
+
+	void PrintUsage() {
+		std::cout << "Usage:" << std::endl;
+		std::cout << "  pack <in.mp> <out.mp> [grid]     Re-encode with the packed (compressed) encoding" << std::endl;
+		std::cout << "  unpack <in.mp> <out.mp> [grid]   Re-encode with the raw encoding" << std::endl;
+		std::cout << "                                   grid splits the scene into grid x grid tiles for region loading" << std::endl;
+		std::cout << "  bench <file.mp>                  Time parsing and report decode throughput" << std::endl;
+		std::cout << "  region <file.mp> <min x y z> <max x y z>   Time loading one region of a tiled file" << std::endl;
+		std::cout << "  coldbench <file.mp> [runs]       Time every load mode on a cold OS file cache" << std::endl;
+		std::cout << "  import <scene.obj | .gltf | .glb> <out.mp> [scale]   Convert a mesh file to .mp" << std::endl;
+		std::cout << "  generate <out.mp> <megabytes>    Write a synthetic file for load benchmarks" << std::endl;
+		std::cout << "  stream <file.mp | -> [buffer MB] Parse front to back without seeking, - reads stdin" << std::endl;
+		std::cout << "  share <in.mp> <out.mp> <library.mp> [grid]   Move the meshes of in.mp into a shared geometry library" << std::endl;
+		std::cout << "  optimize <in.mp> <out.mp> [grid]   Weld and reorder every mesh for the vertex cache and overdraw" << std::endl;
+		std::cout << "  dedup <file.mp>                  Report how many meshes share geometry and what merging them saves" << std::endl;
+		std::cout << "  memory <file.mp>                 Peak RSS of preparing the upload, streamed against copied geometry" << std::endl;
+		std::cout << "  cull <file.mp> [x y z]           Count the instances frustum culling keeps from the start view" << std::endl;
+		std::cout << "  vertices <file.mp>               Vertex stream bytes and packing error of every GPU vertex format" << std::endl;
+		std::cout << "  switch <first.mp> <second.mp> [ms]   Start loading first, drop it after ms and load second" << std::endl;
+	}
+
+	int Recode(std::string InputPath, std::string OutputPath, uint8_t Encoding, uint32_t TileGrid) {
+		std::vector<MP::ObjectSource> objects = MP::ReadMPSource(InputPath);
+
+		MP::WriteOptions options;
+		options.encoding = Encoding;
+		options.tile_grid = TileGrid;
+		MP::WriteStats stats = MP::WriteMP(OutputPath, objects, options);
+
+		std::cout << "Wrote " << objects.size() << " objects to " << OutputPath << " in " << stats.seconds * 1000.0 << "ms." << std::endl;
+		if (TileGrid > 0) {
+			std::cout << stats.tile_count << " non-empty tiles on a " << TileGrid << "x" << TileGrid << " grid." << std::endl;
+		}
+		std::cout << util::BytesToMegabytes(stats.raw_bytes) << " MB raw, " << util::BytesToMegabytes(stats.written_bytes) << " MB written";
+		std::cout << " (compression ratio " << static_cast<double>(stats.raw_bytes) / std::max<uint64_t>(stats.written_bytes, 1) << "x)." << std::endl;
+
+		return 0;
+	}
+
+	double MillisecondsSince(std::chrono::high_resolution_clock::time_point Start) {
+		return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - Start).count();
+	}
+
+	uint64_t CountInstances(const renderer::ModelSet& Set) {
+		uint64_t count = 0;
+		for (const renderer::MeshInstances& model : Set.models) {
+			count += model.instance_count;
+		}
+		return count;
+	}
+
+	int Region(std::string FilePath, char** Bounds) {
+		MP::AABB region;
+		for (int axis = 0; axis < 3; axis++) {
+			region.min[axis] = std::stof(Bounds[axis]);
+			region.max[axis] = std::stof(Bounds[axis + 3]);
+		}
+
+		auto start = std::chrono::high_resolution_clock::now();
+		renderer::ModelSet full = MP::ParseMP(FilePath);
+		double full_ms = MillisecondsSince(start);
+
+		start = std::chrono::high_resolution_clock::now();
+		renderer::ModelSet partial = MP::ParseMPRegion(FilePath, region);
+		double region_ms = MillisecondsSince(start);
+
+		std::cout << "Full: " << full.models.size() << " objects, " << CountInstances(full) << " instances, " << util::BytesToMegabytes(full.arena_size) << " MB in " << full_ms << "ms." << std::endl;
+		std::cout << "Region: " << partial.models.size() << " objects, " << CountInstances(partial) << " instances, " << util::BytesToMegabytes(partial.arena_size) << " MB in " << region_ms << "ms." << std::endl;
+
+		return 0;
+	}
+
+	// Each run starts with the file dropped from the OS cache, so the disk is part of what gets timed.
+	int ColdBench(std::string FilePath, int Runs) {
+		const MP::LOADMODE modes[] = { MP::FILE_STREAM, MP::MEMORY_MAPPED, MP::ASYNC_READ, MP::ASYNC_READ_DIRECT };
+		const char* mode_names[] = { "file stream", "memory mapped", "async read", "async direct" };
+
+		if (!MP::DropFileCache(FilePath)) {
+			std::cout << "Could not drop the file from the OS cache, timings below are warm." << std::endl;
+		}
+
+		double results[4] = {};
+
+		for (int m = 0; m < 4; m++) {
+			double total_ms = 0;
+
+			for (int run = 0; run < Runs; run++) {
+				MP::DropFileCache(FilePath);
+
+				auto start = std::chrono::high_resolution_clock::now();
+				renderer::ModelSet set = MP::ParseMP(FilePath, false, modes[m]);
+				total_ms += MillisecondsSince(start);
+			}
+
+			results[m] = total_ms / Runs;
+		}
+
+		std::cout << "Cold load of " << FilePath << ", average of " << Runs << " runs:" << std::endl;
+		for (int m = 0; m < 4; m++) {
+			std::cout << "  " << mode_names[m] << ": " << results[m] << "ms (" << results[0] / std::max(results[m], 1e-9) << "x file stream)" << std::endl;
+		}
+
+		return 0;
+	}
+
+	// Peak RSS growth is what matters here, a streamed parse should stay near the buffer size plus the decoded scene.
+	int Stream(std::string FilePath, uint64_t BufferMegabytes) {
+		std::unique_ptr<MP::ByteSource> source = MP::OpenByteSource(FilePath);
+
+		util::ResetPeakResidentBytes();
+		uint64_t resident_before = util::GetCurrentResidentBytes();
+
+		auto start = std::chrono::high_resolution_clock::now();
+		renderer::ModelSet set = MP::ParseMPStream(*source, BufferMegabytes * 1024 * 1024, true);
+		double stream_ms = MillisecondsSince(start);
+
+		uint64_t peak_after = util::GetPeakResidentBytes();
+		uint64_t peak_growth = peak_after > resident_before ? peak_after - resident_before : 0;
+
+		std::cout << set.models.size() << " objects, " << CountInstances(set) << " instances, " << util::BytesToMegabytes(set.arena_size) << " MB decoded in " << stream_ms << "ms. ";
+		std::cout << "Peak RSS growth " << util::BytesToMegabytes(peak_growth) << " MB." << std::endl;
+
+		return 0;
+	}
+
+	// Encoding of the first object, raw for an empty file
+	uint8_t ReadEncoding(std::string FilePath) {
+		MP::MappedFile input(FilePath);
+		MP::format::FileLayout layout = MP::format::ReadFileLayout(input.GetBytes());
+
+		if (layout.object_offsets.empty()) {
+			return MP::format::ENCODING_RAW;
+		}
+		return MP::format::ReadObjectHeader(input.GetBytes(), layout.object_offsets[0], layout.version).encoding;
+	}
+
+	// Keeps the encoding of the input, the library is written in the same encoding.
+	int Share(std::string InputPath, std::string OutputPath, std::string LibraryPath, uint32_t TileGrid) {
+		MP::WriteOptions options;
+		options.encoding = ReadEncoding(InputPath);
+		options.tile_grid = TileGrid;
+
+		std::vector<MP::ObjectSource> objects = MP::ReadMPSource(InputPath);
+		MP::LibraryWriteStats stats = MP::WriteMPWithLibrary(OutputPath, LibraryPath, objects, options);
+
+		std::cout << "Wrote " << objects.size() << " references to " << OutputPath << ", " << util::BytesToMegabytes(stats.scene.written_bytes) << " MB." << std::endl;
+		std::cout << stats.meshes_added << " meshes added to " << LibraryPath << ", " << stats.meshes_shared << " already there." << std::endl;
+		return 0;
+	}
+
+	// Keeps the encoding of the input. Before and after numbers are printed for each mesh, totals are triangle weighted.
+	int Optimize(std::string InputPath, std::string OutputPath, uint32_t TileGrid) {
+		MP::WriteOptions options;
+		options.encoding = ReadEncoding(InputPath);
+		options.tile_grid = TileGrid;
+
+		std::vector<MP::ObjectSource> objects = MP::ReadMPSource(InputPath);
+
+		auto start = std::chrono::high_resolution_clock::now();
+		std::vector<MP::OptimizeReport> reports = MP::OptimizeObjects(objects);
+		double optimize_ms = MillisecondsSince(start);
+
+		uint64_t vertices_before = 0;
+		uint64_t vertices_after = 0;
+		double triangles = 0;
+		MP::MeshStats total_before;
+		MP::MeshStats total_after;
+		uint32_t skipped = 0;
+
+		for (size_t i = 0; i < reports.size(); i++) {
+			const MP::OptimizeReport& report = reports[i];
+			if (report.skipped) {
+				skipped++;
+				continue;
+			}
+
+			std::cout << "  " << i << ": vertices " << report.before.vertex_count << " -> " << report.after.vertex_count;
+			std::cout << ", ACMR " << report.before.acmr << " -> " << report.after.acmr;
+			std::cout << ", ATVR " << report.before.atvr << " -> " << report.after.atvr;
+			std::cout << ", overdraw " << report.before.overdraw << " -> " << report.after.overdraw << std::endl;
+
+			double weight = objects[i].indices.size() / 3.0;
+			vertices_before += report.before.vertex_count;
+			vertices_after += report.after.vertex_count;
+			triangles += weight;
+			total_before.acmr += static_cast<float>(report.before.acmr * weight);
+			total_after.acmr += static_cast<float>(report.after.acmr * weight);
+			total_before.atvr += static_cast<float>(report.before.atvr * weight);
+			total_after.atvr += static_cast<float>(report.after.atvr * weight);
+			total_before.overdraw += static_cast<float>(report.before.overdraw * weight);
+			total_after.overdraw += static_cast<float>(report.after.overdraw * weight);
+		}
+
+		triangles = std::max(triangles, 1.0);
+		std::cout << "Optimized " << reports.size() - skipped << " meshes in " << optimize_ms << "ms";
+		if (skipped > 0) {
+			std::cout << ", skipped " << skipped << " library or empty objects";
+		}
+		std::cout << "." << std::endl;
+		std::cout << "Vertices " << vertices_before << " -> " << vertices_after;
+		std::cout << ", ACMR " << total_before.acmr / triangles << " -> " << total_after.acmr / triangles;
+		std::cout << ", ATVR " << total_before.atvr / triangles << " -> " << total_after.atvr / triangles;
+		std::cout << ", overdraw " << total_before.overdraw / triangles << " -> " << total_after.overdraw / triangles << "." << std::endl;
+
+		MP::WriteStats stats = MP::WriteMP(OutputPath, objects, options);
+		std::cout << "Wrote " << objects.size() << " objects to " << OutputPath << ", " << util::BytesToMegabytes(stats.written_bytes) << " MB." << std::endl;
+		return 0;
+	}
+
+	int Import(std::string InputPath, std::string OutputPath, float Scale) {
+		MP::ImportOptions options;
+		options.scale = Scale;
+
+		MP::ImportedScene scene = MP::ImportScene(InputPath, options);
+		scene.stats.Print();
+
+		MP::WriteStats stats = MP::WriteMP(OutputPath, scene.objects, {});
+		std::cout << "Wrote " << scene.objects.size() << " objects to " << OutputPath << ", " << util::BytesToMegabytes(stats.written_bytes) << " MB in " << stats.seconds * 1000.0 << "ms";
+		std::cout << " using " << util::GetJobSystem().GetWorkerCount() << " workers." << std::endl;
+		return 0;
+	}
+
+	int Dedup(std::string FilePath) {
+		renderer::ModelSet set = MP::ParseMP(FilePath);
+		uint64_t instances_before = CountInstances(set);
+
+		MP::DedupStats stats = MP::DeduplicateMeshes(set);
+		stats.Print();
+
+		std::cout << "Indirect draws " << stats.meshes_before << " -> " << stats.meshes_after << ", instances " << instances_before << " -> " << CountInstances(set) << "." << std::endl;
+		return 0;
+	}
+
+	// The staging buffers are host vectors here, mapped staging memory is host memory too.
+	void StageGeometry(const renderer::scene::SceneParser& Parser, bool CopyGeometry) {
+		if (CopyGeometry) {
+			// Concatenated in the parser, then one staging buffer the size of each array
+			{
+				std::vector<renderer::Vertex> staging(Parser.GetSceneVertices().begin(), Parser.GetSceneVertices().end());
+			}
+			std::vector<uint32_t> staging(Parser.GetSceneIndices().begin(), Parser.GetSceneIndices().end());
+			return;
+		}
+
+		// What data::CreateBufferStreamed does: one staging chunk, refilled until everything is through
+		uint64_t largest = std::max<uint64_t>(uint64_t(Parser.GetVertexCount()) * sizeof(renderer::Vertex), uint64_t(Parser.GetIndexCount()) * sizeof(uint32_t));
+		std::vector<std::uint8_t> chunk(std::max<uint64_t>(std::min<uint64_t>(renderer::data::StagingChunkSize, largest), sizeof(renderer::Vertex)));
+		uint64_t chunk_vertices = chunk.size() / sizeof(renderer::Vertex);
+		uint64_t chunk_indices = chunk.size() / sizeof(uint32_t);
+
+		for (uint64_t first = 0; first < Parser.GetVertexCount(); first += chunk_vertices) {
+			Parser.WriteVertices(first, std::min<uint64_t>(chunk_vertices, Parser.GetVertexCount() - first), reinterpret_cast<renderer::Vertex*>(chunk.data()));
+		}
+		for (uint64_t first = 0; first < Parser.GetIndexCount(); first += chunk_indices) {
+			Parser.WriteIndices(first, std::min<uint64_t>(chunk_indices, Parser.GetIndexCount() - first), reinterpret_cast<uint32_t*>(chunk.data()));
+		}
+	}
+
+	// Peak RSS growth of parsing a scene and getting its geometry to staging memory, the way Application::LoadScene
+	// does it against concatenating the geometry in the parser first. Streamed runs first, where the peak can not be
+	// reset (Windows) the larger copying peak would hide it.
+	int UploadMemory(std::string FilePath) {
+		uint64_t arena_size = 0;
+		uint64_t geometry_size = 0;
+
+		auto measure = [&](bool CopyGeometry) {
+			util::ResetPeakResidentBytes();
+			uint64_t resident_before = util::GetCurrentResidentBytes();
+			{
+				renderer::ModelSet set = MP::ParseMP(FilePath);
+				MP::DeduplicateMeshes(set);
+				renderer::scene::SceneParser parser(set, CopyGeometry);
+				StageGeometry(parser, CopyGeometry);
+
+				arena_size = set.arena_size;
+				geometry_size = uint64_t(parser.GetVertexCount()) * sizeof(renderer::Vertex) + uint64_t(parser.GetIndexCount()) * sizeof(uint32_t);
+			}
+			uint64_t peak_after = util::GetPeakResidentBytes();
+			return peak_after > resident_before ? peak_after - resident_before : 0;
+		};
+
+		uint64_t streamed_peak = measure(false);
+		uint64_t copied_peak = measure(true);
+
+		std::cout << "Decoded scene " << util::BytesToMegabytes(arena_size) << " MB, uploaded geometry " << util::BytesToMegabytes(geometry_size) << " MB." << std::endl;
+		std::cout << "Peak RSS growth: streamed " << util::BytesToMegabytes(streamed_peak) << " MB, copied " << util::BytesToMegabytes(copied_peak) << " MB." << std::endl;
+		return 0;
+	}
+
+	// Instances the frustum cull keeps from the view the renderer starts with: at the scene root, looking down
+	// (-1, -1, -1) with z up, on the 960x540 window. Position overrides the scene root.
+	int CullReport(std::string FilePath, const glm::vec3* Position) {
+		renderer::ModelSet set = MP::ParseMP(FilePath);
+		MP::DeduplicateMeshes(set);
+		renderer::scene::SceneParser parser(set, false);
+
+		glm::vec3 eye = Position ? *Position : parser.GetSceneRoot();
+		glm::mat4 view = glm::lookAt(eye, eye + glm::vec3(-1.0f, -1.0f, -1.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+		glm::mat4 proj = glm::perspective(glm::radians(45.0f), 960.0f / 540.0f, 0.01f, 100.0f);
+		proj[1][1] *= -1;
+
+		glm::vec4 planes[6];
+		renderer::scene::ExtractFrustumPlanes(proj * view, planes);
+
+		uint64_t sphere_visible = 0;
+		uint64_t box_visible = 0;
+		for (const renderer::BoundingBoxData& bounds : parser.GetBoundingData()) {
+			sphere_visible += renderer::scene::IsInFrustum(bounds, planes, false);
+			box_visible += renderer::scene::IsInFrustum(bounds, planes, true);
+		}
+
+		std::cout << "Camera at " << eye.x << "," << eye.y << "," << eye.z << ", " << parser.GetMeshCount() << " instances." << std::endl;
+		std::cout << "Visible: sphere " << sphere_visible << ", sphere and box " << box_visible << "." << std::endl;
+		return 0;
+	}
+
+	// Packs the scene's vertex streams in every vertex format the way the upload does, then unpacks them again to find
+	// the largest position error (scene units, before instance transforms) and normal error (degrees). Depth only
+	// passes fetch the position stream alone.
+	int VertexFormats(std::string FilePath) {
+		renderer::ModelSet set = MP::ParseMP(FilePath);
+		MP::DeduplicateMeshes(set);
+		renderer::scene::SceneParser parser(set, false);
+
+		std::span<const renderer::MeshDecodeData> mesh_decode = parser.GetMeshDecode();
+
+		std::vector<renderer::Vertex> original(parser.GetVertexCount());
+		parser.WriteVertices(0, original.size(), original.data());
+
+		std::cout << parser.GetVertexCount() << " vertices in " << mesh_decode.size() << " meshes." << std::endl;
+		for (uint32_t f = 0; f < renderer::VERTEX_FORMAT_COUNT; f++) {
+			renderer::VERTEXFORMAT format = static_cast<renderer::VERTEXFORMAT>(f);
+			size_t position_stride = renderer::GetStreamStride(format, renderer::VERTEX_STREAM_POSITION);
+			size_t attribute_stride = renderer::GetStreamStride(format, renderer::VERTEX_STREAM_ATTRIBUTES);
+
+			auto start = std::chrono::high_resolution_clock::now();
+			std::vector<std::byte> positions(original.size() * position_stride);
+			std::vector<std::byte> attributes(original.size() * attribute_stride);
+			parser.WriteVertexStream(format, renderer::VERTEX_STREAM_POSITION, 0, original.size(), positions.data());
+			parser.WriteVertexStream(format, renderer::VERTEX_STREAM_ATTRIBUTES, 0, original.size(), attributes.data());
+			double pack_ms = MillisecondsSince(start);
+
+			float position_error = 0.0f;
+			float normal_error = 0.0f;
+			std::vector<renderer::Vertex> unpacked;
+			for (const renderer::MeshDecodeData& decode : mesh_decode) {
+				unpacked.resize(decode.vertex_count);
+				renderer::UnpackVertices(format, positions.data() + uint64_t(decode.first_vertex) * position_stride, attributes.data() + uint64_t(decode.first_vertex) * attribute_stride, decode.vertex_count, decode, unpacked.data());
+
+				for (uint32_t v = 0; v < decode.vertex_count; v++) {
+					const renderer::Vertex& before = original[decode.first_vertex + v];
+					glm::vec3 error = glm::abs(unpacked[v].position - before.position);
+					position_error = std::max({ position_error, error.x, error.y, error.z });
+
+					// Only the direction is lit, zero normals stay unlit whatever they decode to
+					if (glm::length(before.normal) > 0.0f && glm::length(unpacked[v].normal) > 0.0f) {
+						// In double, float acos alone is off by hundredths of a degree next to 1
+						double cosine = glm::clamp(glm::dot(glm::normalize(glm::dvec3(before.normal)), glm::normalize(glm::dvec3(unpacked[v].normal))), -1.0, 1.0);
+						normal_error = std::max(normal_error, static_cast<float>(glm::degrees(std::acos(cosine))));
+					}
+				}
+			}
+
+			// Against what one interleaved float vertex (the layout before the streams were split) costs every pass
+			double depth_share = double(position_stride) / sizeof(renderer::Vertex);
+			std::cout << "  " << renderer::GetVertexFormatName(format) << ": " << position_stride << " + " << attribute_stride << " bytes per vertex, " << util::BytesToMegabytes(positions.size() + attributes.size()) << " MB, packed in " << pack_ms << "ms";
+			std::cout << ", depth only fetches " << util::BytesToMegabytes(positions.size()) << " MB (" << depth_share * 100.0 << "% of interleaved float)";
+			std::cout << ", max position error " << position_error << ", max normal error " << normal_error << " degrees." << std::endl;
+		}
+		return 0;
+	}
+
+	// What an editor switching maps does: the first load is abandoned part way and the second starts straight after.
+	int SwitchScene(std::string FirstPath, std::string SecondPath, int CancelMilliseconds) {
+		std::stop_source stop_source;
+
+		MP::LoadOptions options;
+		options.stop_token = stop_source.get_token();
+		options.progress = std::make_shared<MP::LoadProgress>();
+
+		auto start = std::chrono::high_resolution_clock::now();
+		util::Task<renderer::ModelSet> first_load = MP::LoadAsync(FirstPath, options);
+		first_load.Start();
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(CancelMilliseconds));
+
+		auto stop_start = std::chrono::high_resolution_clock::now();
+		stop_source.request_stop();
+
+		try {
+			renderer::ModelSet set = first_load.Get();
+			std::cout << "First load finished before the stop, " << set.models.size() << " objects in " << MillisecondsSince(start) << "ms." << std::endl;
+		}
+		catch (const MP::LoadCancelled&) {
+			std::cout << "First load stopped at " << options.progress->objects_done << " of " << options.progress->objects_total << " objects (";
+			std::cout << util::BytesToMegabytes(options.progress->bytes_done) << " of " << util::BytesToMegabytes(options.progress->bytes_total) << " MB), ";
+			std::cout << MillisecondsSince(stop_start) << "ms after asking." << std::endl;
+		}
+
+		start = std::chrono::high_resolution_clock::now();
+		renderer::ModelSet second = MP::LoadAsync(SecondPath).Get();
+		std::cout << "Second load: " << second.models.size() << " objects, " << CountInstances(second) << " instances in " << MillisecondsSince(start) << "ms." << std::endl;
+
+		return 0;
+	}
+
+} // namespace unnamed
+
+namespace MP {
+
+	int RunToolCommand(int argc, char** argv) {
+		std::string command = argc > 1 ? argv[1] : "";
+
+		try {
+			bool recode = command == "pack" || command == "unpack";
+			uint32_t tile_grid = recode && argc == 5 ? static_cast<uint32_t>(std::stoul(argv[4])) : 0;
+
+			if (command == "pack" && (argc == 4 || argc == 5)) {
+				return Recode(argv[2], argv[3], format::ENCODING_PACKED, tile_grid);
+			}
+
+			if (command == "unpack" && (argc == 4 || argc == 5)) {
+				return Recode(argv[2], argv[3], format::ENCODING_RAW, tile_grid);
+			}
+
+			if (command == "region" && argc == 9) {
+				return Region(argv[2], argv + 3);
+			}
+
+			if (command == "coldbench" && (argc == 3 || argc == 4)) {
+				return ColdBench(argv[2], argc == 4 ? std::max(1, std::stoi(argv[3])) : 3);
+			}
+
+			if (command == "generate" && argc == 4) {
+				MP::WriteStats stats = MP::GenerateSyntheticMP(argv[2], std::stoull(argv[3]) * 1024 * 1024);
+				std::cout << "Wrote " << util::BytesToMegabytes(stats.written_bytes) << " MB of objects in " << stats.seconds << "s." << std::endl;
+				return 0;
+			}
+
+			if (command == "import" && (argc == 4 || argc == 5)) {
+				return Import(argv[2], argv[3], argc == 5 ? std::stof(argv[4]) : 1.0f);
+			}
+
+			if (command == "stream" && (argc == 3 || argc == 4)) {
+				return Stream(argv[2], argc == 4 ? std::max<uint64_t>(1, std::stoull(argv[3])) : 64);
+			}
+
+			if (command == "share" && (argc == 5 || argc == 6)) {
+				return Share(argv[2], argv[3], argv[4], argc == 6 ? static_cast<uint32_t>(std::stoul(argv[5])) : 0);
+			}
+
+			if (command == "optimize" && (argc == 4 || argc == 5)) {
+				return Optimize(argv[2], argv[3], argc == 5 ? static_cast<uint32_t>(std::stoul(argv[4])) : 0);
+			}
+
+			if (command == "dedup" && argc == 3) {
+				return Dedup(argv[2]);
+			}
+
+			if (command == "memory" && argc == 3) {
+				return UploadMemory(argv[2]);
+			}
+
+			if (command == "cull" && (argc == 3 || argc == 6)) {
+				glm::vec3 position = argc == 6 ? glm::vec3(std::stof(argv[3]), std::stof(argv[4]), std::stof(argv[5])) : glm::vec3(0);
+				return CullReport(argv[2], argc == 6 ? &position : nullptr);
+			}
+
+			if (command == "vertices" && argc == 3) {
+				return VertexFormats(argv[2]);
+			}
+
+			if (command == "switch" && (argc == 4 || argc == 5)) {
+				return SwitchScene(argv[2], argv[3], argc == 5 ? std::max(0, std::stoi(argv[4])) : 100);
+			}
+
+			if (command == "bench" && argc == 3) {
+				ParseMP(argv[2], true);
+				return 0;
+			}
+		}
+		catch (const std::exception& e) {
+			std::cerr << "Error: " << e.what() << std::endl;
+			return 1;
+		}
+
+		PrintUsage();
+		return 1;
+	}
+
+} // namespace MP
\ No newline at end of file
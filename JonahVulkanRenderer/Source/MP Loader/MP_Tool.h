@@ -0,0 +1,24 @@
+#pragma once
+
+// Command line tools run instead of the renderer when the exe gets arguments:
+//   pack <in.mp> <out.mp> [grid]     re-encode every object with ENCODING_PACKED, tiled when grid is given
+//   unpack <in.mp> <out.mp> [grid]   re-encode every object with ENCODING_RAW, tiled when grid is given
+//   bench <file.mp>                  time ParseMP and report decode throughput
+//   region <file.mp> <min xyz> <max xyz>   time ParseMPRegion against a full parse
+//   coldbench <file.mp> [runs]       time every load mode with the file dropped from the OS cache before each run
+//   generate <out.mp> <megabytes>    write a synthetic raw file of random meshes for load benchmarks
+//   stream <file.mp | -> [buffer MB] parse front to back with ParseMPStream, - reads stdin
+//   switch <first.mp> <second.mp> [ms]   start LoadAsync on first, cancel it after ms and load second
+//   dedup <file.mp>                  report how many meshes share geometry and what merging them saves
+//   share <in.mp> <out.mp> <library.mp> [grid]   move the meshes of in.mp into a shared geometry library
+//   optimize <in.mp> <out.mp> [grid]   weld and reorder every mesh for the vertex cache and overdraw, then report both
+//   import <scene.obj | .gltf | .glb> <out.mp> [scale]   convert a mesh file to .mp with the native importers
+//   memory <file.mp>                 peak RSS of preparing the upload, streamed into staging against copied geometry
+//   cull <file.mp> [x y z]           count the instances the frustum cull keeps from the start view, x y z moves the camera
+//   vertices <file.mp>               vertex stream bytes and packing error of every GPU vertex format
+namespace MP {
+
+	// Returns the process exit code.
+	int RunToolCommand(int argc, char** argv);
+
+} // namespace MP
\ No newline at end of file
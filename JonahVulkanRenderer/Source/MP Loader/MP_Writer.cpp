@@ -0,0 +1,525 @@
+#include "MP_Writer.h"
+#include "MP_Format.h"
+#include "MP_Codec.h"
+#include "MP_MappedFile.h"
+#include "../Util/JobSystem.h"
+#include <algorithm>
+#include <array>
+#include <cfloat>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+
+namespace {
+
+	template <class T>
+	void AppendValue(std::vector<std::uint8_t>& Output, T Value) {
+		size_t at = Output.size();
+		Output.resize(at + sizeof(T));
+		std::memcpy(Output.data() + at, &Value, sizeof(T));
+	}
+
+	void AppendBytes(std::vector<std::uint8_t>& Output, const void* Bytes, size_t ByteCount) {
+		const std::uint8_t* bytes = static_cast<const std::uint8_t*>(Bytes);
+		Output.insert(Output.end(), bytes, bytes + ByteCount);
+	}
+
+	template <class T>
+	std::vector<T> CopyArray(std::span<const std::uint8_t> Bytes, uint64_t Offset, uint64_t Count) {
+		MP::format::ArrayView<T> view = MP::format::ReadArray<T>(Bytes, Offset, Count);
+
+		std::vector<T> output(view.size());
+		std::memcpy(output.data(), view.bytes.data(), view.bytes.size());
+		return output;
+	}
+
+	// Same rule as ParseUSD.py, 2 byte indices while every vertex can be addressed with them
+	uint8_t GetIndexWidth(uint64_t VertexCount) {
+		return VertexCount > 65535 ? 4 : 2;
+	}
+
+	uint8_t GetIndexWidth(const MP::ObjectSource& Object) {
+		return GetIndexWidth(Object.positions.size() / 3);
+	}
+
+	bool IsReference(const MP::ObjectSource& Object) {
+		return Object.mesh_key != 0 && Object.positions.empty() && Object.indices.empty();
+	}
+
+	// Object header, bounds and arrays of one object.
+	// Instances is the object's instances in the order they are written.
+	std::vector<std::uint8_t> EncodeObject(const MP::ObjectSource& Object, std::span<const glm::mat4> Instances, uint8_t Encoding) {
+		const uint8_t index_width = GetIndexWidth(Object);
+		const bool has_bounds = Encoding == MP::format::ENCODING_PACKED || !Object.positions.empty() || IsReference(Object);
+		const bool has_key = Object.mesh_key != 0;
+
+		float bounds[6];
+		MP::GetLocalBounds(Object, bounds);
+
+		std::vector<std::uint8_t> output;
+		AppendValue<uint32_t>(output, static_cast<uint32_t>(Object.positions.size() / 3));
+		AppendValue<uint32_t>(output, static_cast<uint32_t>(Object.indices.size()));
+		AppendValue<uint32_t>(output, static_cast<uint32_t>(Object.normals.size() / 3));
+		AppendValue<uint32_t>(output, static_cast<uint32_t>(Instances.size()));
+		AppendValue<uint8_t>(output, index_width);
+		AppendValue<uint8_t>(output, Encoding);
+		AppendValue<uint16_t>(output, (has_bounds ? MP::format::OBJECT_HAS_BOUNDS : 0) | (has_key ? MP::format::OBJECT_HAS_KEY : 0));
+		AppendValue<uint32_t>(output, 0);
+
+		if (has_bounds) {
+			AppendBytes(output, bounds, sizeof(bounds));
+		}
+		if (has_key) {
+			AppendValue<uint64_t>(output, Object.mesh_key);
+		}
+
+		if (Encoding == MP::format::ENCODING_PACKED) {
+			MP::codec::ObjectArrays arrays{ Object.positions, Object.normals, Object.indices, Instances };
+
+			uint64_t unpacked_size = 0;
+			std::vector<std::uint8_t> packed = MP::codec::PackObject(arrays, bounds, unpacked_size);
+
+			AppendValue<uint64_t>(output, packed.size());
+			AppendValue<uint64_t>(output, unpacked_size);
+			AppendBytes(output, packed.data(), packed.size());
+			return output;
+		}
+
+		AppendBytes(output, Object.positions.data(), Object.positions.size() * sizeof(float));
+
+		for (uint32_t index : Object.indices) {
+			if (index_width == 2) {
+				AppendValue<uint16_t>(output, static_cast<uint16_t>(index));
+			}
+			else {
+				AppendValue<uint32_t>(output, index);
+			}
+		}
+
+		AppendBytes(output, Object.normals.data(), Object.normals.size() * sizeof(float));
+		AppendBytes(output, Instances.data(), Instances.size_bytes());
+
+		return output;
+	}
+
+	uint64_t RawObjectSize(uint64_t VertexCount, uint64_t IndexCount, uint64_t NormalCount, uint64_t InstanceCount) {
+		bool has_bounds = VertexCount > 0;
+
+		return MP::format::V2ObjectHeaderSize + (has_bounds ? MP::format::BoundsSize : 0)
+			+ VertexCount * 3 * sizeof(float)
+			+ IndexCount * GetIndexWidth(VertexCount)
+			+ NormalCount * 3 * sizeof(float)
+			+ InstanceCount * sizeof(glm::mat4);
+	}
+
+	uint64_t RawObjectSize(const MP::ObjectSource& Object) {
+		uint64_t key_size = Object.mesh_key != 0 ? MP::format::KeySize : 0;
+		uint64_t reference_bounds_size = IsReference(Object) ? MP::format::BoundsSize : 0;
+		return RawObjectSize(Object.positions.size() / 3, Object.indices.size(), Object.normals.size() / 3, Object.instances.size()) + key_size + reference_bounds_size;
+	}
+
+	// Tile table plus the order instances and objects are written in.
+	struct TileLayout {
+		std::vector<std::vector<uint32_t>> instance_order;	// Per object, source instance index for each written slot
+		std::vector<uint32_t> object_order;					// Order objects are stored in the file
+		std::vector<MP::format::Tile> tiles;
+		std::vector<MP::format::TileEntry> entries;
+	};
+
+	// World bounds of an instance, from the 8 corners of the local bounds.
+	void GetWorldBounds(const float Local[6], const glm::mat4& Matrix, float World[6]) {
+		for (int corner = 0; corner < 8; corner++) {
+			glm::vec3 point(Local[(corner & 1) ? 3 : 0], Local[(corner & 2) ? 4 : 1], Local[(corner & 4) ? 5 : 2]);
+			glm::vec3 world = glm::vec3(Matrix * glm::vec4(point, 1.0f));
+
+			for (int axis = 0; axis < 3; axis++) {
+				World[axis] = corner == 0 ? world[axis] : std::min(World[axis], world[axis]);
+				World[axis + 3] = corner == 0 ? world[axis] : std::max(World[axis + 3], world[axis]);
+			}
+		}
+	}
+
+	void MergeBounds(float Bounds[6], const float Other[6]) {
+		for (int axis = 0; axis < 3; axis++) {
+			Bounds[axis] = std::min(Bounds[axis], Other[axis]);
+			Bounds[axis + 3] = std::max(Bounds[axis + 3], Other[axis + 3]);
+		}
+	}
+
+	// Instances go in the grid cell holding their world bounds centre, on the XZ plane (maps are wide, not tall).
+	// A tile is bounded by its instances rather than its cell, so instances crossing a cell edge are still found.
+	TileLayout BuildTileLayout(const std::vector<MP::ObjectSource>& Objects, uint32_t Grid) {
+		TileLayout layout;
+		layout.instance_order.resize(Objects.size());
+
+		std::vector<std::vector<std::array<float, 6>>> world_bounds(Objects.size());
+		float centre_min[2] = { FLT_MAX, FLT_MAX };
+		float centre_max[2] = { -FLT_MAX, -FLT_MAX };
+
+		for (size_t i = 0; i < Objects.size(); i++) {
+			float local[6];
+			MP::GetLocalBounds(Objects[i], local);
+
+			world_bounds[i].resize(Objects[i].instances.size());
+			for (size_t k = 0; k < Objects[i].instances.size(); k++) {
+				float* world = world_bounds[i][k].data();
+				GetWorldBounds(local, Objects[i].instances[k], world);
+
+				for (int c = 0; c < 2; c++) {
+					float centre = (world[c * 2] + world[c * 2 + 3]) * 0.5f;
+					centre_min[c] = std::min(centre_min[c], centre);
+					centre_max[c] = std::max(centre_max[c], centre);
+				}
+			}
+		}
+
+		auto cell_of = [&](const std::array<float, 6>& World) {
+			uint32_t cell[2];
+			for (int c = 0; c < 2; c++) {
+				float extent = centre_max[c] - centre_min[c];
+				float centre = (World[c * 2] + World[c * 2 + 3]) * 0.5f;
+				float t = extent > 0 ? (centre - centre_min[c]) / extent : 0.0f;
+				cell[c] = std::min(static_cast<uint32_t>(t * Grid), Grid - 1);
+			}
+			return cell[1] * Grid + cell[0];
+		};
+
+		struct Run {
+			uint32_t cell;
+			MP::format::TileEntry entry;
+			float bounds[6];
+		};
+		std::vector<Run> runs;
+		std::vector<uint32_t> first_cell(Objects.size(), UINT32_MAX);
+
+		for (uint32_t i = 0; i < Objects.size(); i++) {
+			std::vector<uint32_t> cells(Objects[i].instances.size());
+			for (size_t k = 0; k < cells.size(); k++) {
+				cells[k] = cell_of(world_bounds[i][k]);
+			}
+
+			std::vector<uint32_t>& order = layout.instance_order[i];
+			order.resize(cells.size());
+			std::iota(order.begin(), order.end(), 0);
+			std::stable_sort(order.begin(), order.end(), [&](uint32_t A, uint32_t B) { return cells[A] < cells[B]; });
+
+			for (uint32_t slot = 0; slot < order.size(); slot++) {
+				uint32_t cell = cells[order[slot]];
+				const float* bounds = world_bounds[i][order[slot]].data();
+
+				if (slot == 0 || runs.back().cell != cell) {
+					Run run{ cell, { i, { slot, 0 } }, {} };
+					std::copy(bounds, bounds + 6, run.bounds);
+					runs.push_back(run);
+				}
+
+				runs.back().entry.instances.count++;
+				MergeBounds(runs.back().bounds, bounds);
+			}
+
+			if (!order.empty()) {
+				first_cell[i] = cells[order[0]];
+			}
+		}
+
+		// Runs are already in object order inside each cell, so a stable sort by cell groups them into tiles
+		std::stable_sort(runs.begin(), runs.end(), [](const Run& A, const Run& B) { return A.cell < B.cell; });
+
+		for (size_t r = 0; r < runs.size(); r++) {
+			if (r == 0 || runs[r].cell != runs[r - 1].cell) {
+				MP::format::Tile tile{};
+				std::copy(runs[r].bounds, runs[r].bounds + 6, tile.bounds);
+				tile.first_entry = layout.entries.size();
+				layout.tiles.push_back(tile);
+			}
+
+			MP::format::Tile& tile = layout.tiles.back();
+			MergeBounds(tile.bounds, runs[r].bounds);
+			tile.entry_count++;
+			layout.entries.push_back(runs[r].entry);
+		}
+
+		layout.object_order.resize(Objects.size());
+		std::iota(layout.object_order.begin(), layout.object_order.end(), 0);
+		std::stable_sort(layout.object_order.begin(), layout.object_order.end(), [&](uint32_t A, uint32_t B) { return first_cell[A] < first_cell[B]; });
+
+		return layout;
+	}
+
+	std::vector<std::uint8_t> EncodeTileTable(const TileLayout& Layout) {
+		std::vector<std::uint8_t> output;
+		AppendValue<uint64_t>(output, Layout.tiles.size());
+		AppendValue<uint64_t>(output, Layout.entries.size());
+
+		for (const MP::format::Tile& tile : Layout.tiles) {
+			AppendBytes(output, tile.bounds, sizeof(tile.bounds));
+			AppendValue<uint64_t>(output, tile.first_entry);
+			AppendValue<uint32_t>(output, tile.entry_count);
+			AppendValue<uint32_t>(output, 0);
+		}
+
+		for (const MP::format::TileEntry& entry : Layout.entries) {
+			AppendValue<uint32_t>(output, entry.object_index);
+			AppendValue<uint32_t>(output, entry.instances.first);
+			AppendValue<uint32_t>(output, entry.instances.count);
+		}
+
+		return output;
+	}
+
+} // namespace unnamed
+
+namespace MP {
+
+	void GetLocalBounds(const ObjectSource& Object, float Bounds[6]) {
+		if (IsReference(Object)) {
+			std::copy(Object.reference_bounds, Object.reference_bounds + 6, Bounds);
+			return;
+		}
+
+		std::fill(Bounds, Bounds + 6, 0.0f);
+
+		for (size_t i = 0; i < Object.positions.size(); i++) {
+			size_t axis = i % 3;
+			if (i < 3) {
+				Bounds[axis] = Bounds[axis + 3] = Object.positions[i];
+			}
+			Bounds[axis] = std::min(Bounds[axis], Object.positions[i]);
+			Bounds[axis + 3] = std::max(Bounds[axis + 3], Object.positions[i]);
+		}
+	}
+
+	std::vector<ObjectSource> ReadMPSource(std::string MP_FilePath) {
+		MappedFile file(MP_FilePath);
+		std::span<const std::uint8_t> bytes = file.GetBytes();
+
+		format::FileLayout layout = format::ReadFileLayout(bytes);
+		std::vector<ObjectSource> objects(layout.object_offsets.size());
+
+		for (size_t i = 0; i < objects.size(); i++) {
+			format::ObjectHeader header = format::ReadObjectHeader(bytes, layout.object_offsets[i], layout.version);
+			uint64_t offset = layout.object_offsets[i] + header.header_size;
+			ObjectSource& object = objects[i];
+			object.mesh_key = header.mesh_key;
+
+			if (header.IsMeshReference()) {
+				std::copy(header.bounds, header.bounds + 6, object.reference_bounds);
+			}
+
+			if (header.encoding == format::ENCODING_PACKED) {
+				std::span<const std::uint8_t> packed = format::ReadArray<std::uint8_t>(bytes, offset, header.packed_size).bytes;
+
+				object.positions.resize(size_t(header.vertex_count) * 3);
+				object.normals.resize(size_t(header.normal_count) * 3);
+				object.indices.resize(header.index_count);
+				object.instances.resize(header.instance_count);
+
+				codec::UnpackObject(header, packed, object.positions.data(), object.normals.data(), object.indices.data(), object.instances.data());
+				continue;
+			}
+
+			object.positions = CopyArray<float>(bytes, offset, uint64_t(header.vertex_count) * 3);
+			offset += uint64_t(header.vertex_count) * 3 * sizeof(float);
+
+			if (header.index_width == 2) {
+				std::vector<uint16_t> narrow = CopyArray<uint16_t>(bytes, offset, header.index_count);
+				object.indices.assign(narrow.begin(), narrow.end());
+			}
+			else {
+				object.indices = CopyArray<uint32_t>(bytes, offset, header.index_count);
+			}
+			offset += uint64_t(header.index_count) * header.index_width;
+
+			object.normals = CopyArray<float>(bytes, offset, uint64_t(header.normal_count) * 3);
+			offset += uint64_t(header.normal_count) * 3 * sizeof(float);
+
+			// Kept exactly as stored, the parser is what forces w to 1
+			std::span<const std::uint8_t> matrices = format::ReadArray<std::uint8_t>(bytes, offset, uint64_t(header.instance_count) * sizeof(glm::mat4)).bytes;
+			object.instances.resize(header.instance_count);
+			std::memcpy(&object.instances.data()[0][0][0], matrices.data(), matrices.size());
+		}
+
+		return objects;
+	}
+
+	WriteStats WriteMP(std::string MP_FilePath, const std::vector<ObjectSource>& Objects, const WriteOptions& Options) {
+		if (Options.encoding != format::ENCODING_RAW && Options.encoding != format::ENCODING_PACKED) {
+			throw std::invalid_argument("Unknown MP object encoding.");
+		}
+
+		auto start = std::chrono::high_resolution_clock::now();
+
+		const bool tiled = Options.tile_grid > 0;
+		TileLayout tile_layout;
+		if (tiled) {
+			tile_layout = BuildTileLayout(Objects, Options.tile_grid);
+		}
+
+		// Objects are independent, so each one is encoded on its own worker
+		std::vector<std::vector<std::uint8_t>> encoded(Objects.size());
+		std::vector<uint64_t> costs(Objects.size());
+		for (size_t i = 0; i < Objects.size(); i++) {
+			costs[i] = RawObjectSize(Objects[i]);
+		}
+
+		util::GetJobSystem().ParallelFor(static_cast<uint32_t>(Objects.size()), [&](uint32_t Index) {
+			if (!tiled) {
+				encoded[Index] = EncodeObject(Objects[Index], Objects[Index].instances, Options.encoding);
+				return;
+			}
+
+			std::vector<glm::mat4> instances;
+			instances.reserve(Objects[Index].instances.size());
+			for (uint32_t source : tile_layout.instance_order[Index]) {
+				instances.push_back(Objects[Index].instances[source]);
+			}
+			encoded[Index] = EncodeObject(Objects[Index], instances, Options.encoding);
+		}, costs);
+
+		WriteStats stats;
+		stats.tile_count = static_cast<uint32_t>(tile_layout.tiles.size());
+
+		std::vector<std::uint8_t> tile_table;
+		if (tiled) {
+			tile_table = EncodeTileTable(tile_layout);
+		}
+		else {
+			tile_layout.object_order.resize(Objects.size());
+			std::iota(tile_layout.object_order.begin(), tile_layout.object_order.end(), 0);
+		}
+
+		std::vector<std::uint8_t> header;
+		AppendValue<uint16_t>(header, format::Magic);
+		AppendValue<uint32_t>(header, format::VersionEscape);
+		AppendValue<uint16_t>(header, format::LatestVersion);
+		bool keyed = std::any_of(Objects.begin(), Objects.end(), [](const ObjectSource& Object) { return Object.mesh_key != 0; });
+		AppendValue<uint32_t>(header, (tiled ? format::FILE_HAS_TILES : 0) | (keyed ? format::FILE_HAS_MESH_KEYS : 0));
+		AppendValue<uint32_t>(header, 0);
+		AppendValue<uint64_t>(header, Objects.size());
+
+		// Offsets stay in object index order, only the bytes move
+		std::vector<uint64_t> offsets(Objects.size());
+		uint64_t offset = format::V2HeaderSize + Objects.size() * sizeof(uint64_t) + tile_table.size();
+		for (uint32_t i : tile_layout.object_order) {
+			offsets[i] = offset;
+			offset += encoded[i].size();
+
+			stats.raw_bytes += costs[i];
+			stats.written_bytes += encoded[i].size();
+		}
+
+		for (uint64_t object_offset : offsets) {
+			AppendValue<uint64_t>(header, object_offset);
+		}
+		header.insert(header.end(), tile_table.begin(), tile_table.end());
+
+		// Same temp file and rename as the cooked cache, so a failed write never replaces a good file
+		std::filesystem::path final_path(MP_FilePath);
+		std::filesystem::path temp_path = final_path;
+		temp_path += ".tmp";
+
+		{
+			std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+			if (!file) {
+				throw std::runtime_error("Could not create MP file.");
+			}
+
+			file.write(reinterpret_cast<const char*>(header.data()), static_cast<std::streamsize>(header.size()));
+			for (uint32_t i : tile_layout.object_order) {
+				file.write(reinterpret_cast<const char*>(encoded[i].data()), static_cast<std::streamsize>(encoded[i].size()));
+			}
+
+			if (!file) {
+				throw std::runtime_error("Failed writing MP file.");
+			}
+		}
+
+		std::filesystem::rename(temp_path, final_path);
+
+		auto end = std::chrono::high_resolution_clock::now();
+		stats.seconds = std::chrono::duration<double>(end - start).count();
+
+		return stats;
+	}
+
+	WriteStats GenerateSyntheticMP(std::string MP_FilePath, uint64_t TargetBytes, uint32_t Seed) {
+		auto start = std::chrono::high_resolution_clock::now();
+
+		struct ObjectCounts {
+			uint32_t vertices;
+			uint32_t instances;
+		};
+
+		// Sizes are planned up front so the offset table can be written before any object
+		std::mt19937 rng(Seed);
+		std::vector<ObjectCounts> plan;
+		std::vector<uint64_t> sizes;
+		uint64_t total = 0;
+
+		while (total < TargetBytes) {
+			ObjectCounts counts = { 1000 + static_cast<uint32_t>(rng() % 150000), 1 + static_cast<uint32_t>(rng() % 64) };
+
+			plan.push_back(counts);
+			sizes.push_back(RawObjectSize(counts.vertices, uint64_t(counts.vertices) * 3, counts.vertices, counts.instances));
+			total += sizes.back();
+		}
+
+		std::vector<std::uint8_t> header;
+		AppendValue<uint16_t>(header, format::Magic);
+		AppendValue<uint32_t>(header, format::VersionEscape);
+		AppendValue<uint16_t>(header, format::LatestVersion);
+		AppendValue<uint32_t>(header, 0);
+		AppendValue<uint32_t>(header, 0);
+		AppendValue<uint64_t>(header, plan.size());
+
+		uint64_t offset = format::V2HeaderSize + plan.size() * sizeof(uint64_t);
+		for (uint64_t size : sizes) {
+			AppendValue<uint64_t>(header, offset);
+			offset += size;
+		}
+
+		std::ofstream file(MP_FilePath, std::ios::binary | std::ios::trunc);
+		if (!file) {
+			throw std::runtime_error("Could not create MP file.");
+		}
+		file.write(reinterpret_cast<const char*>(header.data()), static_cast<std::streamsize>(header.size()));
+
+		std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+		WriteStats stats;
+
+		for (const ObjectCounts& counts : plan) {
+			ObjectSource object;
+			object.positions.resize(size_t(counts.vertices) * 3);
+			object.normals.resize(size_t(counts.vertices) * 3);
+			object.indices.resize(size_t(counts.vertices) * 3);
+
+			for (float& value : object.positions) value = unit(rng);
+			for (float& value : object.normals) value = unit(rng);
+			for (uint32_t& index : object.indices) index = rng() % counts.vertices;
+
+			for (uint32_t k = 0; k < counts.instances; k++) {
+				glm::mat4 matrix(1.0f);
+				matrix[3] = glm::vec4(unit(rng) * 1000.0f, unit(rng) * 10.0f, unit(rng) * 1000.0f, 1.0f);
+				object.instances.push_back(matrix);
+			}
+
+			std::vector<std::uint8_t> encoded = EncodeObject(object, object.instances, format::ENCODING_RAW);
+			file.write(reinterpret_cast<const char*>(encoded.data()), static_cast<std::streamsize>(encoded.size()));
+
+			stats.raw_bytes += encoded.size();
+			stats.written_bytes += encoded.size();
+		}
+
+		if (!file) {
+			throw std::runtime_error("Failed writing MP file.");
+		}
+
+		stats.seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+		return stats;
+	}
+
+} // namespace MP
\ No newline at end of file
@@ -0,0 +1,48 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "../Renderer/VkUtil/VkCommon.h"
+
+// Writes v2 .mp files from C++, so tools can re-encode scenes without going back through ParseUSD.py.
+namespace MP {
+
+	// One object as plain arrays. Positions and normals are float3.
+	// A library reference (see MP_Library.h) has a mesh_key and no geometry, reference_bounds stand in for its positions.
+	struct ObjectSource {
+		std::vector<float> positions;
+		std::vector<float> normals;
+		std::vector<uint32_t> indices;
+		std::vector<glm::mat4> instances;
+
+		uint64_t mesh_key = 0;			// Written when not 0
+		float reference_bounds[6] = {};
+	};
+
+	struct WriteOptions {
+		uint8_t encoding = 0;	 // One of MP::format::ENCODING_*
+		uint32_t tile_grid = 0;	 // Split the scene's XZ extent into tile_grid x tile_grid tiles for ParseMPRegion. 0 writes no tiles
+	};
+
+	struct WriteStats {
+		uint64_t raw_bytes = 0;		// Object bytes the file would take with raw encoding
+		uint64_t written_bytes = 0;	// Object bytes actually written
+		double seconds = 0;
+		uint32_t tile_count = 0;
+	};
+
+	// Local min xyz, max xyz of the positions, or the reference_bounds of a reference.
+	void GetLocalBounds(const ObjectSource& Object, float Bounds[6]);
+
+	// Reads every object of a v1 or v2 file, raw or packed, back into plain arrays.
+	std::vector<ObjectSource> ReadMPSource(std::string MP_FilePath);
+
+	// Objects are encoded in parallel on the job system. With tiles, each object's instances are reordered by tile
+	// and objects are stored in the order of their first tile, so a region's bytes sit close together.
+	WriteStats WriteMP(std::string MP_FilePath, const std::vector<ObjectSource>& Objects, const WriteOptions& Options);
+
+	// Raw v2 file of random meshes about TargetBytes large, for load benchmarks. Objects are generated and written
+	// one at a time, so multi-GB files need no more memory than one object.
+	WriteStats GenerateSyntheticMP(std::string MP_FilePath, uint64_t TargetBytes, uint32_t Seed = 1);
+
+} // namespace MP
\ No newline at end of file
@@ -1,6 +1,9 @@
 #include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
 #include <chrono>
+#include <cstring>
 #include <unordered_map>
+#include <unordered_set>
 #include <iostream>
 
 #include <ImGui/imgui.h>
@@ -30,25 +33,39 @@ namespace renderer {
 			ubo.proj[1][1] *= -1;
 			ubo.view = CameraPosition;
 
-			glm::mat4 matrix = ubo.proj * ubo.view;
-			matrix = glm::transpose(matrix);
+			scene::ExtractFrustumPlanes(ubo.proj * ubo.view, ubo.frustum_planes);
 
-			enum side { LEFT = 0, RIGHT = 1, TOP = 2, BOTTOM = 3, NEAR_ = 4, FAR_ = 5 };
-
-			ubo.frustum_planes[LEFT] = matrix[3] + matrix[0];
-			ubo.frustum_planes[RIGHT] = matrix[3] - matrix[0];
-			ubo.frustum_planes[TOP] = matrix[3] - matrix[1];
-			ubo.frustum_planes[BOTTOM] = matrix[3] + matrix[1];
-			ubo.frustum_planes[NEAR_] = matrix[2];
-			ubo.frustum_planes[FAR_] = matrix[3] - matrix[2];
+			return ubo;
+		}
 
-			for (auto i = 0; i < 6; i++)
-			{
-				float length = glm::length(glm::vec3(ubo.frustum_planes[i]));
-				ubo.frustum_planes[i] /= length;
+		// Byte ranges of New that differ from Old, as copies with the same source and destination offset.
+		// Elements past the end of Old count as changed. Ranges less than MergeGap elements apart become one copy,
+		// a few unchanged bytes cost less than another copy region.
+		template <class T>
+		std::vector<VkBufferCopy> ChangedRanges(std::span<const T> Old, std::span<const T> New, size_t MergeGap = 16) {
+			std::vector<VkBufferCopy> ranges;
+			size_t start = 0;
+			size_t end = 0;
+
+			for (size_t i = 0; i < New.size(); i++) {
+				if (i < Old.size() && std::memcmp(&Old[i], &New[i], sizeof(T)) == 0) continue;
+
+				if (end > start && i - end <= MergeGap) {
+					end = i + 1;
+					continue;
+				}
+
+				if (end > start) {
+					ranges.push_back({.srcOffset = start * sizeof(T), .dstOffset = start * sizeof(T), .size = (end - start) * sizeof(T)});
+				}
+				start = i;
+				end = i + 1;
 			}
 
-			return ubo;
+			if (end > start) {
+				ranges.push_back({.srcOffset = start * sizeof(T), .dstOffset = start * sizeof(T), .size = (end - start) * sizeof(T)});
+			}
+			return ranges;
 		}
 
 		static void VKCheckResult(VkResult err)
@@ -73,6 +90,7 @@ namespace renderer {
 		mesh_count = 0;
 		unique_mesh_count = 0;
 		const char* vertex_shader_path = "shaders/vert.spv";
+		const char* depth_shader_path = "shaders/depth.spv";
 		const char* fragment_shader_path = "shaders/frag.spv";
 		const char* compute_shader_path = "shaders/cull.spv";
 
@@ -134,7 +152,12 @@ namespace renderer {
 		descriptor_sets = pipeline::CreateDescriptorSets(logical_device, descriptor_layout, descriptor_pool);
 
 		pipeline_layout = pipeline::CreatePipelineLayout(logical_device, descriptor_layout);
-		graphics_pipeline = pipeline::CreateGraphicsPipeline(logical_device, pipeline_layout, render_pass, vertex_shader_path, fragment_shader_path);
+		for (uint32_t format = 0; format < INSTANCE_FORMAT_COUNT; format++) {
+			for (uint32_t vertex = 0; vertex < VERTEX_FORMAT_COUNT; vertex++) {
+				graphics_pipelines[format][vertex] = pipeline::CreateGraphicsPipeline(logical_device, pipeline_layout, render_pass, vertex_shader_path, fragment_shader_path, static_cast<INSTANCEFORMAT>(format), static_cast<VERTEXFORMAT>(vertex));
+				depth_pipelines[format][vertex] = pipeline::CreateGraphicsPipeline(logical_device, pipeline_layout, render_pass, depth_shader_path, nullptr, static_cast<INSTANCEFORMAT>(format), static_cast<VERTEXFORMAT>(vertex));
+			}
+		}
 		compute_pipeline = pipeline::CreateComputePipeline(logical_device, pipeline_layout, compute_shader_path);
 
 		// Draw setup
@@ -229,17 +252,26 @@ namespace renderer {
 		}
 
 		// Cleanup render data
-		data::DestroyBuffer(logical_device, vertex_buffer);
+		for (data::Buffer& vertex_buffer : vertex_buffers) {
+			data::DestroyBuffer(logical_device, vertex_buffer);
+		}
 		data::DestroyBuffer(logical_device, index_buffer);
 		data::DestroyBuffer(logical_device, bounding_box_buffer);
 		data::DestroyBuffer(logical_device, instance_data_buffer);
+		data::DestroyBuffer(logical_device, material_buffer);
+		data::DestroyBuffer(logical_device, mesh_decode_buffer);
 
 		// Cleanup draw framework
 		vkDestroyCommandPool(logical_device, graphics_command_pool, nullptr);
 		vkDestroyCommandPool(logical_device, compute_command_pool, nullptr);
 
 		// Cleanup pipeline
-		vkDestroyPipeline(logical_device, graphics_pipeline, nullptr);
+		for (uint32_t format = 0; format < INSTANCE_FORMAT_COUNT; format++) {
+			for (uint32_t vertex = 0; vertex < VERTEX_FORMAT_COUNT; vertex++) {
+				vkDestroyPipeline(logical_device, graphics_pipelines[format][vertex], nullptr);
+				vkDestroyPipeline(logical_device, depth_pipelines[format][vertex], nullptr);
+			}
+		}
 		vkDestroyPipeline(logical_device, compute_pipeline, nullptr);
 		vkDestroyPipelineLayout(logical_device, pipeline_layout, nullptr);
 
@@ -280,6 +312,18 @@ namespace renderer {
 		return scene_root;
 	}
 
+	INSTANCEFORMAT Renderer::GetInstanceFormat() {
+		return instance_format;
+	}
+
+	void Renderer::SetVertexFormat(VERTEXFORMAT Format) {
+		requested_vertex_format = Format;
+	}
+
+	VERTEXFORMAT Renderer::GetVertexFormat() {
+		return vertex_format;
+	}
+
 	void Renderer::AddObserver(IObserver *Observer){
 		window_resize_callbacks.push_back(Observer);
 	}
@@ -302,8 +346,8 @@ namespace renderer {
 		vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute_pipeline);
 		vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_layout, 0, 1, &descriptor_sets[CurrentFrame], 0, 0);
 
-		if (FrustumCull) {
-			int dispatches = std::max(mesh_count / 64, 1u);
+		if (FrustumCull && mesh_count > 0) {
+			uint32_t dispatches = (mesh_count + 63) / 64; // cull.comp skips the invocations past mesh_count
 			vkCmdDispatch(command_buffer, dispatches, 1, 1);
 		}
 		else {
@@ -347,7 +391,6 @@ namespace renderer {
 		render_pass_info.pClearValues = clear_values.data();
 
 		vkCmdBeginRenderPass(command_buffer, &render_pass_info, VK_SUBPASS_CONTENTS_INLINE);
-		vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphics_pipeline);
 
 		VkViewport viewport{};
 		viewport.x = 0.0f;
@@ -363,21 +406,16 @@ namespace renderer {
 		scissor.extent = swapchain_extent;
 		vkCmdSetScissor(command_buffer, 0, 1, & scissor);
 
-		if (vertex_buffer.ByteSize != 0) {
+		if (vertex_buffers[VERTEX_STREAM_POSITION].ByteSize != 0) {
 
-			VkBuffer vertex_buffers[] = { vertex_buffer.Buffer };
-			VkDeviceSize offsets[] = { 0 };
-
-			vkCmdBindVertexBuffers(command_buffer, 0, 1, vertex_buffers, offsets);
 			vkCmdBindIndexBuffer(command_buffer, index_buffer.Buffer, 0, VK_INDEX_TYPE_UINT32);
 			vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout, 0, 1, &descriptor_sets[current_frame], 0, nullptr);
-			vkCmdPushConstants(command_buffer, pipeline_layout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(PushConstants), &push_constants);
-
-			uint32_t size_of_command = sizeof(VkDrawIndexedIndirectCommand);
+			vkCmdPushConstants(command_buffer, pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(PushConstants), &push_constants);
 
-			for (uint32_t x = 0; x < unique_mesh_count; x++) {
-				vkCmdDrawIndexedIndirect(command_buffer, indirect_command_buffers[current_frame].Buffer, x * size_of_command, 1, size_of_command);
+			if (depth_prepass) {
+				RecordSceneDraws(command_buffer, current_frame, true);
 			}
+			RecordSceneDraws(command_buffer, current_frame, false);
 		}
 
 		// Render UI
@@ -393,12 +431,31 @@ namespace renderer {
 		}
 	}
 
+	// One indirect draw per mesh. Depth only binds just the position stream, the attribute stream is never fetched.
+	void Renderer::RecordSceneDraws(VkCommandBuffer CommandBuffer, uint32_t CurrentFrame, bool DepthOnly) {
+
+		VkPipeline pipeline = DepthOnly ? depth_pipelines[instance_format][vertex_format] : graphics_pipelines[instance_format][vertex_format];
+		vkCmdBindPipeline(CommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+
+		VkBuffer buffers[VERTEX_STREAM_COUNT] = { vertex_buffers[VERTEX_STREAM_POSITION].Buffer, vertex_buffers[VERTEX_STREAM_ATTRIBUTES].Buffer };
+		VkDeviceSize offsets[VERTEX_STREAM_COUNT] = {};
+		vkCmdBindVertexBuffers(CommandBuffer, 0, DepthOnly ? 1 : VERTEX_STREAM_COUNT, buffers, offsets);
+
+		uint32_t size_of_command = sizeof(VkDrawIndexedIndirectCommand);
+
+		for (uint32_t x = 0; x < unique_mesh_count; x++) {
+			vkCmdPushConstants(CommandBuffer, pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, offsetof(PushConstants, draw_index), sizeof(uint32_t), &x);
+			vkCmdDrawIndexedIndirect(CommandBuffer, indirect_command_buffers[CurrentFrame].Buffer, x * size_of_command, 1, size_of_command);
+		}
+	}
+
 	void Renderer::Draw(glm::mat4 CameraPosition, bool FrustumCull) {
 
 		vkWaitForFences(logical_device, 1, &in_flight_fences[current_frame], VK_TRUE, UINT64_MAX);
 		vkWaitForFences(logical_device, 1, &compute_in_flight_fences[current_frame], VK_TRUE, UINT64_MAX);
 
 		UBOData current_ubo_data = GetNextUBO(swapchain_extent, CameraPosition);
+		current_ubo_data.cull_settings = glm::uvec4(mesh_count, box_culling ? 1 : 0, 0, 0);
 		memcpy(uniform_buffers[current_frame].BufferMapped, &current_ubo_data, sizeof(UBOData));
 
 		vkResetFences(logical_device, 1, &compute_in_flight_fences[current_frame]);
@@ -480,60 +537,487 @@ namespace renderer {
 		current_frame = (current_frame + 1) % MAX_FRAMES_IN_FLIGHT;
 	}
 
-	void Renderer::UpdateModelSet(std::vector<MeshInstances> NewModelSet, bool UseWhiteTexture) {
+	void Renderer::UpdateModelSet(const ModelSet& NewModelSet, bool UseWhiteTexture) {
+		scene::SceneParser parser = scene::SceneParser(NewModelSet, false, true);
+		UpdateScene(parser, UseWhiteTexture);
+	}
+
+	void Renderer::UpdateScene(const scene::SceneView& Scene, bool UseWhiteTexture) {
 
 		vkDeviceWaitIdle(logical_device);
 
+		auto read_vertices = [&](uint64_t First, uint64_t Count, Vertex* Output) {
+			std::copy_n(Scene.vertices.begin() + First, Count, Output);
+		};
+		auto write_vertices = [&](VERTEXFORMAT Format, VERTEXSTREAM Stream, void* Output, VkDeviceSize First, VkDeviceSize Count) {
+			scene::WriteVertexStream(Format, Stream, Scene.mesh_decode, First, Count, read_vertices, Output);
+		};
+		auto write_indices = [&](void* Output, VkDeviceSize First, VkDeviceSize Count) {
+			std::copy_n(Scene.indices.begin() + First, Count, static_cast<uint32_t*>(Output));
+		};
+
+		ReplaceGeometry(static_cast<uint32_t>(Scene.vertices.size()), static_cast<uint32_t>(Scene.indices.size()), write_vertices, write_indices);
+		scene_root = Scene.scene_root;
+
+		ReplaceDrawBuffers(Scene.instance_data, Scene.bounding_data, Scene.draw_commands, Scene.materials, Scene.mesh_decode);
+	}
+
+	void Renderer::UpdateScene(const scene::SceneParser& Scene, bool UseWhiteTexture) {
+
+		vkDeviceWaitIdle(logical_device);
+
+		auto write_vertices = [&](VERTEXFORMAT Format, VERTEXSTREAM Stream, void* Output, VkDeviceSize First, VkDeviceSize Count) {
+			Scene.WriteVertexStream(Format, Stream, First, Count, Output);
+		};
+		auto write_indices = [&](void* Output, VkDeviceSize First, VkDeviceSize Count) {
+			Scene.WriteIndices(First, Count, static_cast<uint32_t*>(Output));
+		};
+
+		ReplaceGeometry(Scene.GetVertexCount(), Scene.GetIndexCount(), write_vertices, write_indices);
+		scene_root = Scene.GetSceneRoot();
+
+		ReplaceDrawBuffers(Scene.GetInstanceData(), Scene.GetBoundingData(), Scene.GetDrawCommands(), Scene.GetMaterials(), Scene.GetMeshDecode());
+	}
+
+	// New vertex and index buffers holding only this scene, each vertex stream packed in the requested format as it
+	// streams. Caller waits for the device first.
+	void Renderer::ReplaceGeometry(uint32_t VertexCount, uint32_t IndexCount, const VertexStreamFill& WriteVertices, const data::StreamFill& WriteIndices) {
+
 		// Clear old data
-		data::DestroyBuffer(logical_device, vertex_buffer);
+		for (data::Buffer& vertex_buffer : vertex_buffers) {
+			data::DestroyBuffer(logical_device, vertex_buffer);
+		}
 		data::DestroyBuffer(logical_device, index_buffer);
+		resident_meshes.clear();
+
+		vertex_count = VertexCount;
+		index_count = IndexCount;
+		vertex_format = requested_vertex_format;
+
+		// Load new data to GPU
+		data::BaseBufferContext ctx = {};
+		ctx.LogicalDevice = logical_device;
+		ctx.PhysicalDevice = physical_device;
+		ctx.GraphicsQueue = graphics_queue;
+		ctx.CommandPool = graphics_command_pool;
+
+		// Source too, so AppendScene can grow these buffers later
+		VkBufferUsageFlags transfer_bit = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+		VkBufferUsageFlags vertex_bit = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+		VkBufferUsageFlags index_bit = VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
+
+		for (uint32_t stream = 0; stream < VERTEX_STREAM_COUNT; stream++) {
+			VERTEXSTREAM vertex_stream = static_cast<VERTEXSTREAM>(stream);
+			auto write_stream = [&](void* Output, VkDeviceSize First, VkDeviceSize Count) {
+				WriteVertices(vertex_format, vertex_stream, Output, First, Count);
+			};
+			vertex_buffers[stream] = data::CreateBufferStreamed(VertexCount, GetStreamStride(vertex_format, vertex_stream), write_stream, transfer_bit | vertex_bit, ctx);
+		}
+		index_buffer = data::CreateBufferStreamed(IndexCount, sizeof(uint32_t), WriteIndices, transfer_bit | index_bit, ctx);
+	}
+
+	// Per instance and per draw buffers of a new scene. Caller waits for the device first.
+	void Renderer::ReplaceDrawBuffers(std::span<const InstanceData> Instances, std::span<const BoundingBoxData> Bounds, std::span<const VkDrawIndexedIndirectCommand> DrawCommands, std::span<const MaterialData> Materials, std::span<const MeshDecodeData> MeshDecode) {
+
 		data::DestroyBuffer(logical_device, bounding_box_buffer);
 		data::DestroyBuffer(logical_device, instance_data_buffer);
-	
+		data::DestroyBuffer(logical_device, material_buffer);
+		data::DestroyBuffer(logical_device, mesh_decode_buffer);
+
 		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
 			data::DestroyBuffer(logical_device, indirect_command_buffers[i]);
 			data::DestroyBuffer(logical_device, should_draw_buffers[i]);
 		}
 
-		// Get new data
-		scene::SceneParser parser = scene::SceneParser(NewModelSet);
-
-		mesh_count = parser.GetMeshCount();
+		mesh_count = static_cast<uint32_t>(Instances.size());
+		unique_mesh_count = static_cast<uint32_t>(DrawCommands.size());
 
-		std::vector<Vertex> vertex_buffer_data = parser.GetSceneVertices();
-		std::vector<uint32_t> index_buffer_data = parser.GetSceneIndices();
-		std::vector<InstanceData> instance_data = parser.GetInstanceData();
-		std::vector<BoundingBoxData> bounding_box_data = parser.GetBoundingData();
-		std::vector<VkDrawIndexedIndirectCommand> indirect_commands = parser.GetDrawCommands();
 		std::vector<uint32_t> should_draw_flags(mesh_count, 0);
 
-		unique_mesh_count = indirect_commands.size();
-		scene_root = parser.GetSceneRoot();
+		data::BaseBufferContext ctx = {};
+		ctx.LogicalDevice = logical_device;
+		ctx.PhysicalDevice = physical_device;
+		ctx.GraphicsQueue = graphics_queue;
+		ctx.CommandPool = graphics_command_pool;
+
+		VkBufferUsageFlags transfer_bit = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+		VkBufferUsageFlags indirect_bit = VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT;
+		VkBufferUsageFlags storage_bit = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+
+		instance_format = scene::ChooseInstanceFormat(Instances);
+		auto write_instances = [&](void* Output, VkDeviceSize First, VkDeviceSize Count) {
+			scene::WriteInstances(instance_format, Instances.subspan(First, Count), Output);
+		};
+
+		instance_data_buffer = data::CreateBufferStreamed(Instances.size(), scene::GetInstanceStride(instance_format), write_instances, storage_bit | transfer_bit, ctx);
+		bounding_box_buffer = data::CreateBuffer(Bounds.data(), Bounds.size_bytes(), storage_bit | transfer_bit, ctx);
+		material_buffer = data::CreateBuffer(Materials.data(), Materials.size_bytes(), storage_bit | transfer_bit, ctx);
+		drawn_materials.assign(Materials.begin(), Materials.end());
+		mesh_decode_buffer = data::CreateBuffer(MeshDecode.data(), MeshDecode.size_bytes(), storage_bit | transfer_bit, ctx);
+
+		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+			indirect_command_buffers[i] = data::CreateBuffer(DrawCommands.data(), DrawCommands.size_bytes(), indirect_bit | storage_bit | transfer_bit, ctx);
+			should_draw_buffers[i] = data::CreateBuffer(should_draw_flags.data(), sizeof(uint32_t) * should_draw_flags.size(), storage_bit | transfer_bit, ctx);
+		}
+
+		// What ReloadScene diffs the next version of the scene against
+		if (reload_tracking) {
+			drawn_instances.assign(Instances.begin(), Instances.end());
+			drawn_bounds.assign(Bounds.begin(), Bounds.end());
+			drawn_commands.assign(DrawCommands.begin(), DrawCommands.end());
+			drawn_mesh_decode.assign(MeshDecode.begin(), MeshDecode.end());
+		}
+
+		data::UpdateDescriptorSets(descriptor_sets, logical_device, instance_data_buffer, bounding_box_buffer, uniform_buffers, should_draw_buffers, material_buffer, mesh_decode_buffer);
+	}
+
+	Renderer::SwitchStats Renderer::SwitchScene(const ModelSet& NewModelSet) {
+
+		vkDeviceWaitIdle(logical_device);
+
+		// Instance, bounds and draw data still come from the parser, only the geometry placement changes.
+		// The geometry is placed from NewModelSet, so the parser does not copy it
+		scene::SceneParser parser = scene::SceneParser(NewModelSet, false, true);
+		scene::SceneView scene = parser.GetSceneView();
+
+		SwitchStats stats;
+		std::vector<VkDrawIndexedIndirectCommand> draw_commands(scene.draw_commands.begin(), scene.draw_commands.end());
+		std::vector<MeshDecodeData> mesh_decode(scene.mesh_decode.begin(), scene.mesh_decode.end());
+		PlaceGeometry(NewModelSet, draw_commands, mesh_decode, ResidentGeometryBudget, stats);
+
+		scene_root = scene.scene_root;
+		ReplaceDrawBuffers(scene.instance_data, scene.bounding_data, draw_commands, scene.materials, mesh_decode);
+
+		stats.draw_data_bytes = scene.instance_data.size() * scene::GetInstanceStride(instance_format) + scene.bounding_data.size_bytes() + draw_commands.size() * sizeof(VkDrawIndexedIndirectCommand) + scene.materials.size_bytes() + std::span(mesh_decode).size_bytes();
+		return stats;
+	}
+
+	Renderer::SwitchStats Renderer::ReloadScene(const ModelSet& NewModelSet) {
+
+		vkDeviceWaitIdle(logical_device);
+
+		scene::SceneParser parser = scene::SceneParser(NewModelSet, false, true);
+		scene::SceneView scene = parser.GetSceneView();
+
+		// Meshes replaced by an edit stay in the buffers, so keep room for a few edits before starting over
+		VkDeviceSize scene_bytes = VkDeviceSize(parser.GetVertexCount()) * GetVertexStride(requested_vertex_format) + VkDeviceSize(parser.GetIndexCount()) * sizeof(uint32_t);
+
+		SwitchStats stats;
+		std::vector<VkDrawIndexedIndirectCommand> draw_commands(scene.draw_commands.begin(), scene.draw_commands.end());
+		std::vector<MeshDecodeData> mesh_decode(scene.mesh_decode.begin(), scene.mesh_decode.end());
+		PlaceGeometry(NewModelSet, draw_commands, mesh_decode, std::max(ResidentGeometryBudget, scene_bytes * 2), stats);
+
+		scene_root = scene.scene_root;
+		// A scene that needs another instance format is uploaded whole
+		if (reload_tracking && scene::ChooseInstanceFormat(scene.instance_data) == instance_format) {
+			UpdateDrawBuffers(scene.instance_data, scene.bounding_data, draw_commands, scene.materials, mesh_decode, stats);
+		}
+		else {
+			ReplaceDrawBuffers(scene.instance_data, scene.bounding_data, draw_commands, scene.materials, mesh_decode);
+			stats.draw_data_bytes = scene.instance_data.size() * scene::GetInstanceStride(instance_format) + scene.bounding_data.size_bytes() + draw_commands.size() * sizeof(VkDrawIndexedIndirectCommand) + scene.materials.size_bytes() + std::span(mesh_decode).size_bytes();
+		}
+
+		return stats;
+	}
+
+	void Renderer::SetReloadTracking(bool Enabled) {
+		reload_tracking = Enabled;
+		if (!reload_tracking) {
+			drawn_instances = {};
+			drawn_bounds = {};
+			drawn_commands = {};
+			drawn_mesh_decode = {};
+		}
+	}
+
+	// Points DrawCommands and MeshDecode (in NewModelSet's drawn model order) at resident copies of keyed meshes and uploads the rest.
+	// Once the buffers would grow past Budget, or another vertex format was asked for, they are refilled with this scene's
+	// meshes only. Caller waits for the device.
+	void Renderer::PlaceGeometry(const ModelSet& NewModelSet, std::vector<VkDrawIndexedIndirectCommand>& DrawCommands, std::vector<MeshDecodeData>& MeshDecode, VkDeviceSize Budget, SwitchStats& Stats) {
+
+		// Same models the parser made draws for, in the same order
+		std::vector<const MeshInstances*> drawn_models;
+		for (const MeshInstances& model : NewModelSet.models) {
+			if (model.mesh.vertices.size() > 0 && model.mesh.indices.size() > 0) {
+				drawn_models.push_back(&model);
+			}
+		}
+
+		VkDeviceSize missing_bytes = 0;
+		std::unordered_set<uint64_t> counted_keys;
+		for (const MeshInstances* model : drawn_models) {
+			if (model->mesh_key != 0 && (resident_meshes.contains(model->mesh_key) || !counted_keys.insert(model->mesh_key).second)) {
+				continue;
+			}
+			missing_bytes += model->mesh.vertices.size() * GetVertexStride(requested_vertex_format) + model->mesh.indices.size_bytes();
+		}
+
+		// Start over with only this scene's meshes, the buffers keep their size
+		size_t stride = GetVertexStride(vertex_format);
+		VkDeviceSize used_bytes = VkDeviceSize(vertex_count) * stride + VkDeviceSize(index_count) * sizeof(uint32_t);
+		if (used_bytes + missing_bytes > Budget || vertex_format != requested_vertex_format) {
+			resident_meshes.clear();
+			vertex_count = 0;
+			index_count = 0;
+			vertex_format = requested_vertex_format;
+			stride = GetVertexStride(vertex_format);
+			Stats.refilled = true;
+		}
+
+		std::vector<std::byte> new_vertices[VERTEX_STREAM_COUNT];
+		uint32_t new_vertex_count = 0;
+		std::vector<uint32_t> new_indices;
+
+		for (size_t i = 0; i < drawn_models.size(); i++) {
+			const MeshInstances& model = *drawn_models[i];
+			auto found = model.mesh_key != 0 ? resident_meshes.find(model.mesh_key) : resident_meshes.end();
+
+			ResidentMesh placed;
+			if (found != resident_meshes.end()) {
+				placed = found->second;
+				Stats.reused_draws++;
+			}
+			else {
+				// Indices stay mesh local, vertexOffset rebases them like AppendScene does
+				placed.first_index = index_count + static_cast<uint32_t>(new_indices.size());
+				placed.vertex_offset = static_cast<int32_t>(vertex_count + new_vertex_count);
+
+				// Same key, same geometry and bounds, so a reused copy was packed against this decode box too
+				for (uint32_t stream = 0; stream < VERTEX_STREAM_COUNT; stream++) {
+					size_t stream_stride = GetStreamStride(vertex_format, static_cast<VERTEXSTREAM>(stream));
+					new_vertices[stream].resize(VkDeviceSize(new_vertex_count + model.mesh.vertices.size()) * stream_stride);
+					PackVertices(vertex_format, static_cast<VERTEXSTREAM>(stream), model.mesh.vertices, MeshDecode[i], new_vertices[stream].data() + VkDeviceSize(new_vertex_count) * stream_stride);
+				}
+				new_vertex_count += static_cast<uint32_t>(model.mesh.vertices.size());
+				new_indices.insert(new_indices.end(), model.mesh.indices.begin(), model.mesh.indices.end());
+				Stats.uploaded_meshes++;
+
+				if (model.mesh_key != 0) {
+					resident_meshes.emplace(model.mesh_key, placed);
+				}
+			}
+
+			DrawCommands[i].firstIndex = placed.first_index;
+			DrawCommands[i].vertexOffset = placed.vertex_offset;
+			MeshDecode[i].first_vertex = static_cast<uint32_t>(placed.vertex_offset);
+		}
+
+		data::BaseBufferContext ctx = {};
+		ctx.LogicalDevice = logical_device;
+		ctx.PhysicalDevice = physical_device;
+		ctx.GraphicsQueue = graphics_queue;
+		ctx.CommandPool = graphics_command_pool;
+
+		VkBufferUsageFlags transfer_bit = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+		VkBufferUsageFlags vertex_bit = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+		VkBufferUsageFlags index_bit = VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
+
+		for (uint32_t stream = 0; stream < VERTEX_STREAM_COUNT; stream++) {
+			size_t stream_stride = GetStreamStride(vertex_format, static_cast<VERTEXSTREAM>(stream));
+			data::AppendToBuffer(vertex_buffers[stream], VkDeviceSize(vertex_count) * stream_stride, new_vertices[stream].data(), new_vertices[stream].size(), transfer_bit | vertex_bit, ctx);
+		}
+		data::AppendToBuffer(index_buffer, VkDeviceSize(index_count) * sizeof(uint32_t), new_indices.data(), new_indices.size() * sizeof(uint32_t), transfer_bit | index_bit, ctx);
+
+		vertex_count += new_vertex_count;
+		index_count += static_cast<uint32_t>(new_indices.size());
+
+		Stats.uploaded_bytes = VkDeviceSize(new_vertex_count) * stride + new_indices.size() * sizeof(uint32_t);
+		Stats.resident_bytes = VkDeviceSize(vertex_count) * stride + VkDeviceSize(index_count) * sizeof(uint32_t);
+	}
+
+	// Writes only the parts of the per instance and per draw buffers that differ from what is drawn now.
+	// Caller waits for the device first.
+	void Renderer::UpdateDrawBuffers(std::span<const InstanceData> Instances, std::span<const BoundingBoxData> Bounds, std::span<const VkDrawIndexedIndirectCommand> DrawCommands, std::span<const MaterialData> Materials, std::span<const MeshDecodeData> MeshDecode, SwitchStats& Stats) {
+
+		// Found on the InstanceData copies, then moved to where those instances sit in instance_format
+		std::vector<VkBufferCopy> instance_regions = ChangedRanges(std::span<const InstanceData>(drawn_instances), Instances);
+		size_t instance_stride = scene::GetInstanceStride(instance_format);
+		for (VkBufferCopy& region : instance_regions) {
+			region.srcOffset = region.srcOffset / sizeof(InstanceData) * instance_stride;
+			region.dstOffset = region.dstOffset / sizeof(InstanceData) * instance_stride;
+			region.size = region.size / sizeof(InstanceData) * instance_stride;
+		}
+
+		std::vector<std::byte> instance_bytes(Instances.size() * instance_stride);
+		scene::WriteInstances(instance_format, Instances, instance_bytes.data());
+
+		std::vector<VkBufferCopy> bound_regions = ChangedRanges(std::span<const BoundingBoxData>(drawn_bounds), Bounds);
+		std::vector<VkBufferCopy> command_regions = ChangedRanges(std::span<const VkDrawIndexedIndirectCommand>(drawn_commands), DrawCommands);
+		std::vector<VkBufferCopy> material_regions = ChangedRanges(std::span<const MaterialData>(drawn_materials), Materials);
+		std::vector<VkBufferCopy> decode_regions = ChangedRanges(std::span<const MeshDecodeData>(drawn_mesh_decode), MeshDecode);
+
+		// Changed instances draw until the next cull pass says otherwise, like AppendScene
+		std::vector<VkBufferCopy> flag_regions;
+		for (const VkBufferCopy& region : instance_regions) {
+			VkDeviceSize first = region.dstOffset / instance_stride;
+			VkDeviceSize count = region.size / instance_stride;
+			flag_regions.push_back({.srcOffset = first * sizeof(uint32_t), .dstOffset = first * sizeof(uint32_t), .size = count * sizeof(uint32_t)});
+		}
+		std::vector<uint32_t> should_draw_flags(Instances.size(), 1);
 
-		// Load new data to GPU
 		data::BaseBufferContext ctx = {};
 		ctx.LogicalDevice = logical_device;
 		ctx.PhysicalDevice = physical_device;
 		ctx.GraphicsQueue = graphics_queue;
 		ctx.CommandPool = graphics_command_pool;
 
-		VkBufferUsageFlags transfer_bit = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+		VkBufferUsageFlags transfer_bit = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+		VkBufferUsageFlags indirect_bit = VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT;
+		VkBufferUsageFlags storage_bit = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+
+		data::WriteBufferRegions(instance_data_buffer, drawn_instances.size() * instance_stride, instance_bytes.data(), instance_bytes.size(), instance_regions, storage_bit | transfer_bit, ctx);
+		data::WriteBufferRegions(bounding_box_buffer, std::span(drawn_bounds).size_bytes(), Bounds.data(), Bounds.size_bytes(), bound_regions, storage_bit | transfer_bit, ctx);
+		data::WriteBufferRegions(material_buffer, std::span(drawn_materials).size_bytes(), Materials.data(), Materials.size_bytes(), material_regions, storage_bit | transfer_bit, ctx);
+		data::WriteBufferRegions(mesh_decode_buffer, std::span(drawn_mesh_decode).size_bytes(), MeshDecode.data(), MeshDecode.size_bytes(), decode_regions, storage_bit | transfer_bit, ctx);
+
+		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+			data::WriteBufferRegions(indirect_command_buffers[i], std::span(drawn_commands).size_bytes(), DrawCommands.data(), DrawCommands.size_bytes(), command_regions, indirect_bit | storage_bit | transfer_bit, ctx);
+			data::WriteBufferRegions(should_draw_buffers[i], drawn_instances.size() * sizeof(uint32_t), should_draw_flags.data(), should_draw_flags.size() * sizeof(uint32_t), flag_regions, storage_bit | transfer_bit, ctx);
+		}
+
+		for (const std::vector<VkBufferCopy>* regions : { &instance_regions, &bound_regions, &command_regions, &material_regions, &decode_regions }) {
+			for (const VkBufferCopy& region : *regions) {
+				Stats.draw_data_bytes += region.size;
+			}
+			Stats.changed_ranges += static_cast<uint32_t>(regions->size());
+		}
+
+		drawn_instances.assign(Instances.begin(), Instances.end());
+		drawn_bounds.assign(Bounds.begin(), Bounds.end());
+		drawn_commands.assign(DrawCommands.begin(), DrawCommands.end());
+		drawn_materials.assign(Materials.begin(), Materials.end());
+		drawn_mesh_decode.assign(MeshDecode.begin(), MeshDecode.end());
+
+		mesh_count = static_cast<uint32_t>(Instances.size());
+		unique_mesh_count = static_cast<uint32_t>(DrawCommands.size());
+
+		data::UpdateDescriptorSets(descriptor_sets, logical_device, instance_data_buffer, bounding_box_buffer, uniform_buffers, should_draw_buffers, material_buffer, mesh_decode_buffer);
+	}
+
+	void Renderer::AppendScene(const scene::SceneView& Batch) {
+
+		if (Batch.draw_commands.empty()) return;
+
+		// Buffers may be replaced below, nothing in flight can still be using them
+		vkDeviceWaitIdle(logical_device);
+
+		// The rest of a streamed scene is unknown, so it starts out in the format every instance fits
+		if (mesh_count == 0) {
+			scene_root = Batch.scene_root;
+			instance_format = INSTANCE_AFFINE;
+
+			// Nothing is drawn yet, so the geometry can start over in the requested vertex format
+			if (vertex_format != requested_vertex_format) {
+				resident_meshes.clear();
+				vertex_count = 0;
+				index_count = 0;
+				vertex_format = requested_vertex_format;
+			}
+		}
+		else if (instance_format == INSTANCE_QUANTIZED && scene::ChooseInstanceFormat(Batch.instance_data) != INSTANCE_QUANTIZED) {
+			throw std::runtime_error("Appended instances do not fit the quantized instance format of the scene.");
+		}
+
+		// Batch draw commands count from the start of the batch, move them past what is already loaded.
+		// vertexOffset does the rebasing for the indices, so the index data is uploaded unchanged
+		std::vector<VkDrawIndexedIndirectCommand> draw_commands(Batch.draw_commands.begin(), Batch.draw_commands.end());
+		for (VkDrawIndexedIndirectCommand& command : draw_commands) {
+			command.firstIndex += index_count;
+			command.vertexOffset += static_cast<int32_t>(vertex_count);
+			command.firstInstance += mesh_count;
+		}
+
+		std::vector<MeshDecodeData> mesh_decode(Batch.mesh_decode.begin(), Batch.mesh_decode.end());
+		for (MeshDecodeData& decode : mesh_decode) {
+			decode.first_vertex += vertex_count;
+		}
+
+		auto read_vertices = [&](uint64_t First, uint64_t Count, Vertex* Output) {
+			std::copy_n(Batch.vertices.begin() + First, Count, Output);
+		};
+
+		// New instances draw until the next cull pass says otherwise, so they show even while culling is paused
+		std::vector<uint32_t> should_draw_flags(Batch.mesh_count, 1);
+
+		data::BaseBufferContext ctx = {};
+		ctx.LogicalDevice = logical_device;
+		ctx.PhysicalDevice = physical_device;
+		ctx.GraphicsQueue = graphics_queue;
+		ctx.CommandPool = graphics_command_pool;
+
+		VkBufferUsageFlags transfer_bit = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
 		VkBufferUsageFlags indirect_bit = VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT;
 		VkBufferUsageFlags storage_bit = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
 		VkBufferUsageFlags vertex_bit = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
 		VkBufferUsageFlags index_bit = VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
 
-		vertex_buffer = data::CreateBuffer(vertex_buffer_data.data(), sizeof(Vertex) * vertex_buffer_data.size(), transfer_bit | vertex_bit, ctx);
-		index_buffer = data::CreateBuffer(index_buffer_data.data(), sizeof(uint32_t) * index_buffer_data.size(), transfer_bit | index_bit, ctx);
-		instance_data_buffer = data::CreateBuffer(instance_data.data(), sizeof(InstanceData) * instance_data.size(), storage_bit | transfer_bit, ctx);
-		bounding_box_buffer = data::CreateBuffer(bounding_box_data.data(), sizeof(BoundingBoxData) * bounding_box_data.size(), storage_bit | transfer_bit, ctx);
+		for (uint32_t stream = 0; stream < VERTEX_STREAM_COUNT; stream++) {
+			size_t stream_stride = GetStreamStride(vertex_format, static_cast<VERTEXSTREAM>(stream));
+			std::vector<std::byte> vertex_bytes(Batch.vertices.size() * stream_stride);
+			scene::WriteVertexStream(vertex_format, static_cast<VERTEXSTREAM>(stream), Batch.mesh_decode, 0, Batch.vertices.size(), read_vertices, vertex_bytes.data());
+			data::AppendToBuffer(vertex_buffers[stream], uint64_t(vertex_count) * stream_stride, vertex_bytes.data(), vertex_bytes.size(), transfer_bit | vertex_bit, ctx);
+		}
+		data::AppendToBuffer(index_buffer, uint64_t(index_count) * sizeof(uint32_t), Batch.indices.data(), Batch.indices.size_bytes(), transfer_bit | index_bit, ctx);
+		size_t instance_stride = scene::GetInstanceStride(instance_format);
+		std::vector<std::byte> instance_bytes(Batch.instance_data.size() * instance_stride);
+		scene::WriteInstances(instance_format, Batch.instance_data, instance_bytes.data());
+
+		data::AppendToBuffer(instance_data_buffer, uint64_t(mesh_count) * instance_stride, instance_bytes.data(), instance_bytes.size(), storage_bit | transfer_bit, ctx);
+		data::AppendToBuffer(bounding_box_buffer, uint64_t(mesh_count) * sizeof(BoundingBoxData), Batch.bounding_data.data(), Batch.bounding_data.size_bytes(), storage_bit | transfer_bit, ctx);
+		data::AppendToBuffer(material_buffer, uint64_t(unique_mesh_count) * sizeof(MaterialData), Batch.materials.data(), Batch.materials.size_bytes(), storage_bit | transfer_bit, ctx);
+		data::AppendToBuffer(mesh_decode_buffer, uint64_t(unique_mesh_count) * sizeof(MeshDecodeData), mesh_decode.data(), std::span(mesh_decode).size_bytes(), storage_bit | transfer_bit, ctx);
 
 		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-			indirect_command_buffers[i] = data::CreateBuffer(indirect_commands.data(), sizeof(VkDrawIndexedIndirectCommand) * indirect_commands.size(), indirect_bit | storage_bit | transfer_bit, ctx);
-			should_draw_buffers[i] = data::CreateBuffer(should_draw_flags.data(), sizeof(uint32_t) * should_draw_flags.size(), storage_bit | transfer_bit, ctx);
+			data::AppendToBuffer(indirect_command_buffers[i], uint64_t(unique_mesh_count) * sizeof(VkDrawIndexedIndirectCommand), draw_commands.data(), draw_commands.size() * sizeof(VkDrawIndexedIndirectCommand), indirect_bit | storage_bit | transfer_bit, ctx);
+			data::AppendToBuffer(should_draw_buffers[i], uint64_t(mesh_count) * sizeof(uint32_t), should_draw_flags.data(), should_draw_flags.size() * sizeof(uint32_t), storage_bit | transfer_bit, ctx);
 		}
 
-		data::UpdateDescriptorSets(descriptor_sets, logical_device, instance_data_buffer, bounding_box_buffer, uniform_buffers, should_draw_buffers);
+		vertex_count += static_cast<uint32_t>(Batch.vertices.size());
+		index_count += static_cast<uint32_t>(Batch.indices.size());
+		mesh_count += Batch.mesh_count;
+		unique_mesh_count += static_cast<uint32_t>(draw_commands.size());
+		drawn_materials.insert(drawn_materials.end(), Batch.materials.begin(), Batch.materials.end());
+
+		if (reload_tracking) {
+			drawn_instances.insert(drawn_instances.end(), Batch.instance_data.begin(), Batch.instance_data.end());
+			drawn_bounds.insert(drawn_bounds.end(), Batch.bounding_data.begin(), Batch.bounding_data.end());
+			drawn_commands.insert(drawn_commands.end(), draw_commands.begin(), draw_commands.end());
+			drawn_mesh_decode.insert(drawn_mesh_decode.end(), mesh_decode.begin(), mesh_decode.end());
+		}
+
+		data::UpdateDescriptorSets(descriptor_sets, logical_device, instance_data_buffer, bounding_box_buffer, uniform_buffers, should_draw_buffers, material_buffer, mesh_decode_buffer);
+	}
+
+	uint32_t Renderer::GetMaterialCount() {
+		return static_cast<uint32_t>(drawn_materials.size());
+	}
+
+	MaterialData Renderer::GetMaterial(uint32_t DrawIndex) {
+		if (DrawIndex >= drawn_materials.size()) {
+			throw std::runtime_error("No draw command with that index.");
+		}
+		return drawn_materials[DrawIndex];
+	}
+
+	void Renderer::SetMaterial(uint32_t DrawIndex, const MaterialData& Material) {
+		if (DrawIndex >= drawn_materials.size()) {
+			throw std::runtime_error("No draw command with that index.");
+		}
+
+		// The material buffer is shared by the frames in flight
+		vkDeviceWaitIdle(logical_device);
+
+		drawn_materials[DrawIndex] = Material;
+
+		data::BaseBufferContext ctx = {};
+		ctx.LogicalDevice = logical_device;
+		ctx.PhysicalDevice = physical_device;
+		ctx.GraphicsQueue = graphics_queue;
+		ctx.CommandPool = graphics_command_pool;
+
+		VkDeviceSize offset = VkDeviceSize(DrawIndex) * sizeof(MaterialData);
+		VkBufferCopy region = { .srcOffset = offset, .dstOffset = offset, .size = sizeof(MaterialData) };
+		data::WriteBufferRegions(material_buffer, std::span(drawn_materials).size_bytes(), drawn_materials.data(), std::span(drawn_materials).size_bytes(), std::span(&region, 1), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT, ctx);
 	}
 
 	void Renderer::UpdateLightPosition(glm::vec3 LightPosition) {
@@ -548,6 +1032,14 @@ namespace renderer {
 		push_constants.mode = glm::vec4(DrawMode, 0, 0, 0);
 	}
 
+	void Renderer::SetBoxCulling(bool Enabled) {
+		box_culling = Enabled;
+	}
+
+	void Renderer::SetDepthPrepass(bool Enabled) {
+		depth_prepass = Enabled;
+	}
+
 	Renderer::DrawInfo Renderer::GetLightData() {
 
 		DrawInfo return_data;
@@ -5,10 +5,13 @@
 #include <array>
 #include <string>
 #include <functional>
+#include <span>
+#include <unordered_map>
 
 #include "VkUtil/VkCommon.h"
 #include "VkUtil/VkDrawSetup.h"
 #include "VkUtil/VkDataSetup.h"
+#include "VkUtil/VkSceneProcesser.h"
 #include "../Observer.h"
 
 #ifdef NDEBUG
@@ -17,6 +20,9 @@ const bool UseValidationLayers = false;
 const bool UseValidationLayers = true;
 #endif
 
+// Vertex and index bytes SwitchScene may keep loaded for scenes that are no longer drawn
+const VkDeviceSize ResidentGeometryBudget = 512ull * 1024 * 1024;
+
 namespace renderer {
 
 class Renderer {
@@ -26,8 +32,49 @@ public:
 	~Renderer();
 
 	void Draw(glm::mat4 CameraPosition, bool FrustumCull);
-	void UpdateModelSet(std::vector<MeshInstances> NewModelSet, bool UseWhiteTexture);
+	void UpdateModelSet(const ModelSet& NewModelSet, bool UseWhiteTexture);
+	void UpdateScene(const scene::SceneView& Scene, bool UseWhiteTexture);
+
+	// Same as above, but the geometry is written from the parser straight into staging memory, so a parser made
+	// without CopyGeometry never holds a second copy of the scene's vertices and indices.
+	void UpdateScene(const scene::SceneParser& Scene, bool UseWhiteTexture);
+
+	// Adds Batch to what is already drawn, growing the GPU buffers as needed. Call between frames.
+	// The first batch of an empty renderer sets the scene root.
+	void AppendScene(const scene::SceneView& Batch);
+
+	struct SwitchStats {
+		uint32_t uploaded_meshes = 0;
+		uint32_t reused_draws = 0;			// Draws whose mesh was already in the buffers
+		VkDeviceSize uploaded_bytes = 0;
+		VkDeviceSize resident_bytes = 0;	// Vertex and index bytes in use after the switch
+		VkDeviceSize draw_data_bytes = 0;	// Instance, bounds and draw command bytes written
+		uint32_t changed_ranges = 0;		// Copy regions ReloadScene wrote them with
+		bool refilled = false;				// Resident meshes went over budget and only this scene's were kept
+	};
+
+	// Replaces the drawn scene but keeps the vertex and index data of keyed meshes (MeshInstances::mesh_key) loaded
+	// by earlier switches, so only meshes new to the GPU are uploaded. Once the buffers would grow past
+	// ResidentGeometryBudget they are refilled with this scene's meshes only.
+	SwitchStats SwitchScene(const ModelSet& NewModelSet);
+
+	// Hot reload of an edited scene. Geometry is placed like SwitchScene, so meshes need a mesh_key to be found again
+	// (MP::KeyMeshesByContent). With reload tracking on, only instances, bounds and draw commands that differ from
+	// what is drawn now are uploaded. An instance added or removed mid scene still moves every instance after it.
+	SwitchStats ReloadScene(const ModelSet& NewModelSet);
+
+	// Keeps a CPU copy of the drawn instance, bounds and draw data for ReloadScene to diff against. Off by default,
+	// the copy is as big as the scene's instance data.
+	void SetReloadTracking(bool Enabled);
 	glm::vec3 GetSceneRoot();
+
+	// Picked on every full upload: quantized when every instance is translation, rotation and scale.
+	INSTANCEFORMAT GetInstanceFormat();
+
+	// Vertex format of the next scene whose geometry is uploaded whole (or refilled, see SwitchScene). Float by
+	// default, compact is 12 instead of 24 bytes per vertex for large maps (VkVertexFormat.h).
+	void SetVertexFormat(VERTEXFORMAT Format);
+	VERTEXFORMAT GetVertexFormat();
 	GLFWwindow* Get_Window();
 	void AddObserver(IObserver* Observer);
 
@@ -35,6 +82,19 @@ public:
 	void UpdateLightColor(glm::vec3 LightColor);
 	void UpdateDrawMode(DRAWMODE DrawMode);
 
+	// Frustum culling tests each instance's world AABB after its bounding sphere. On by default.
+	void SetBoxCulling(bool Enabled);
+
+	// Lays down depth with the position stream alone before the shaded pass, so every pixel is shaded once.
+	// Off by default.
+	void SetDepthPrepass(bool Enabled);
+
+	// Material of draw command DrawIndex (a mesh, in scene order). Setting one only rewrites its slot of the
+	// material buffer, geometry and instances are untouched.
+	uint32_t GetMaterialCount();
+	MaterialData GetMaterial(uint32_t DrawIndex);
+	void SetMaterial(uint32_t DrawIndex, const MaterialData& Material);
+
 	struct DrawInfo {
 		glm::vec3 LightPosition;
 		glm::vec3 LightColor;
@@ -49,7 +109,14 @@ private:
 
 	void RecordComputeCommands(uint32_t CurrentFrame, bool FrustumCull);
 	void RecordGraphicsCommands(uint32_t CurrentFrame, uint32_t ImageIndex);
+	void RecordSceneDraws(VkCommandBuffer CommandBuffer, uint32_t CurrentFrame, bool DepthOnly);
 	void RecreateSwapchainHelper();
+	// Packs Stream of vertices [First, First + Count) in Format to Output
+	using VertexStreamFill = std::function<void(VERTEXFORMAT Format, VERTEXSTREAM Stream, void* Output, VkDeviceSize First, VkDeviceSize Count)>;
+	void ReplaceGeometry(uint32_t VertexCount, uint32_t IndexCount, const VertexStreamFill& WriteVertices, const data::StreamFill& WriteIndices);
+	void ReplaceDrawBuffers(std::span<const InstanceData> Instances, std::span<const BoundingBoxData> Bounds, std::span<const VkDrawIndexedIndirectCommand> DrawCommands, std::span<const MaterialData> Materials, std::span<const MeshDecodeData> MeshDecode);
+	void UpdateDrawBuffers(std::span<const InstanceData> Instances, std::span<const BoundingBoxData> Bounds, std::span<const VkDrawIndexedIndirectCommand> DrawCommands, std::span<const MaterialData> Materials, std::span<const MeshDecodeData> MeshDecode, SwitchStats& Stats);
+	void PlaceGeometry(const ModelSet& NewModelSet, std::vector<VkDrawIndexedIndirectCommand>& DrawCommands, std::vector<MeshDecodeData>& MeshDecode, VkDeviceSize Budget, SwitchStats& Stats);
 
 	const std::vector<const char*> ValidationLayersToSupport = {
 		"VK_LAYER_KHRONOS_validation"
@@ -69,6 +136,30 @@ private:
 
 	uint32_t mesh_count;
 	uint32_t unique_mesh_count;
+	uint32_t vertex_count = 0;
+	uint32_t index_count = 0;
+	bool box_culling = true;
+	bool depth_prepass = false;
+	INSTANCEFORMAT instance_format = INSTANCE_AFFINE;
+	VERTEXFORMAT vertex_format = VERTEX_FLOAT;			// Of what is in vertex_buffers
+	VERTEXFORMAT requested_vertex_format = VERTEX_FLOAT;
+
+	// Where each keyed mesh sits in vertex_buffers / index_buffer, see SwitchScene
+	struct ResidentMesh {
+		uint32_t first_index;
+		int32_t vertex_offset;
+	};
+	std::unordered_map<uint64_t, ResidentMesh> resident_meshes;
+
+	// CPU copy of the draw buffers' contents while reload tracking is on, see ReloadScene
+	bool reload_tracking = false;
+	std::vector<InstanceData> drawn_instances;
+	std::vector<BoundingBoxData> drawn_bounds;
+	std::vector<VkDrawIndexedIndirectCommand> drawn_commands;
+	std::vector<MeshDecodeData> drawn_mesh_decode;
+
+	// Always kept, one small entry per draw, so SetMaterial and ReloadScene can diff against it
+	std::vector<MaterialData> drawn_materials;
 
 	VkInstance vulkan_instance;
 	VkSurfaceKHR vulkan_surface;
@@ -97,10 +188,12 @@ private:
 	std::vector<VkImage> swapchain_images;
 	std::vector<VkImageView> swapchain_image_views;
 
-	data::Buffer vertex_buffer;
+	data::Buffer vertex_buffers[VERTEX_STREAM_COUNT];		// One per VERTEXSTREAM, bound at binding = stream
 	data::Buffer index_buffer;
 	data::Buffer bounding_box_buffer;
 	data::Buffer instance_data_buffer;
+	data::Buffer material_buffer;
+	data::Buffer mesh_decode_buffer;
 
 	std::array<data::Buffer, MAX_FRAMES_IN_FLIGHT> should_draw_buffers;
 	std::array<data::Buffer, MAX_FRAMES_IN_FLIGHT> indirect_command_buffers;
@@ -113,7 +206,8 @@ private:
 	std::vector<VkSemaphore> compute_finished_semaphores;
 
 	VkPipelineLayout pipeline_layout;
-	VkPipeline graphics_pipeline;
+	VkPipeline graphics_pipelines[INSTANCE_FORMAT_COUNT][VERTEX_FORMAT_COUNT];
+	VkPipeline depth_pipelines[INSTANCE_FORMAT_COUNT][VERTEX_FORMAT_COUNT];	// Position stream only, no colour writes
 	VkPipeline compute_pipeline;
 	VkCommandPool graphics_command_pool;
 	VkCommandPool compute_command_pool;
@@ -2,6 +2,10 @@
 
 #include <vulkan/vulkan.hpp>
 #include <optional>
+#include <memory>
+#include <span>
+#include <algorithm>
+#include <cmath>
 
 #include <GLFW/glfw3.h>
 #define GLFW_EXPOSE_NATIVE_WIN32
@@ -22,20 +26,45 @@ namespace renderer {
 		std::optional<uint32_t> present_family;
 	};
 
+	// Rows of the instance's 3x4 affine model matrix. The 4th row is always (0, 0, 0, 1), so it is not stored.
 	struct InstanceData {
-		alignas(16) glm::mat4 model;
-		alignas(16) glm::vec4 array_index;
+		alignas(16) glm::vec4 rows[3];
 	};
 
+	// Optional compact form of InstanceData for scenes whose instances are all translation, rotation and scale.
+	// Scale is 3 halfs, the rotation quaternion 4 snorm16s. Laid out as the 2 uvec4s shader.vert reads.
+	struct QuantizedInstanceData {
+		glm::vec3 position;
+		uint32_t scale_xy;
+		uint32_t scale_z;		// Upper half unused
+		uint32_t rotation_xy;
+		uint32_t rotation_zw;
+		uint32_t unused;
+	};
+
+	// How instance_data_buffer is laid out, picked per scene. Value of shader.vert's specialization constant 0.
+	enum INSTANCEFORMAT { INSTANCE_AFFINE, INSTANCE_QUANTIZED, INSTANCE_FORMAT_COUNT };
+
+	inline InstanceData MakeInstanceData(const glm::mat4& Model) {
+		glm::mat4 rows = glm::transpose(Model);
+		return { { rows[0], rows[1], rows[2] } };
+	}
+
+	inline glm::mat4 GetModelMatrix(const InstanceData& Instance) {
+		return glm::transpose(glm::mat4(Instance.rows[0], Instance.rows[1], Instance.rows[2], glm::vec4(0, 0, 0, 1)));
+	}
+
+	// World space bounds of one instance, tested against the frustum by cull.comp
 	struct BoundingBoxData {
-		alignas(16) glm::vec4 center_point;
-		alignas(16) glm::vec4 radius; // Only x value is used (crucial for std430 alignment)
+		alignas(16) glm::vec4 center_point; // w is the bounding sphere radius
+		alignas(16) glm::vec4 half_extents; // Half size of the world AABB around center_point, w unused (std430 alignment)
 	};
 
 	struct UBOData {
 		alignas(16) glm::mat4 view;
 		alignas(16) glm::mat4 proj;
 		alignas(16) glm::vec4 frustum_planes[6];
+		alignas(16) glm::uvec4 cull_settings; // x instance count, y 1 to test the world AABB after the sphere
 	};
 
 	enum DRAWMODE { NORMALS, SOFT, HARD };
@@ -44,61 +73,118 @@ namespace renderer {
 		alignas(16) glm::vec4 light_color;
 		alignas(16) glm::vec4 light_position;
 		alignas(16) glm::vec4 mode; // (Only x is used) 0 = Normals, 1 = Soft Shading, 2 = Hard Shading
+		uint32_t draw_index;	// Pushed again before every draw, indexes the material and mesh decode tables
 	};
 
+	// How the parser decodes vertices and how meshes are kept on the CPU. The GPU copy is packed into one of the
+	// formats of VkVertexFormat.h.
 	struct Vertex {
 		glm::vec3 position;
-		glm::vec3 color;
 		glm::vec3 normal;
 
-		static VkVertexInputBindingDescription GetBindingDescription() {
-			VkVertexInputBindingDescription binding_description{};
-			binding_description.binding = 0;
-			binding_description.stride = sizeof(Vertex);
-			binding_description.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-			return binding_description;
+		bool operator==(const Vertex& other) const {
+			return position == other.position && normal == other.normal;
 		}
+	};
 
-		static std::array<VkVertexInputAttributeDescription, 3> GetAttributeDescription() {
-			std::array<VkVertexInputAttributeDescription, 3> attribute_descriptions = {};
-
-			// Position
-			attribute_descriptions[0].binding = 0;
-			attribute_descriptions[0].location = 0;
-			attribute_descriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT; // Vec3
-			attribute_descriptions[0].offset = offsetof(Vertex, position);
-
-			// Color
-			attribute_descriptions[1].binding = 0;
-			attribute_descriptions[1].location = 1;
-			attribute_descriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT; // Vec3
-			attribute_descriptions[1].offset = offsetof(Vertex, color);
+	// How the vertex buffers are laid out, picked per scene. Value of shader.vert's specialization constant 1.
+	enum VERTEXFORMAT { VERTEX_FLOAT, VERTEX_COMPACT, VERTEX_FORMAT_COUNT };
 
-			// Normal
-			attribute_descriptions[2].binding = 0;
-			attribute_descriptions[2].location = 2;
-			attribute_descriptions[2].format = VK_FORMAT_R32G32B32_SFLOAT; // Vec3
-			attribute_descriptions[2].offset = offsetof(Vertex, normal);
+	// Vertices are split into one buffer per stream, each its own vertex input binding (the binding is the stream).
+	// Depth only passes bind just the positions.
+	enum VERTEXSTREAM { VERTEX_STREAM_POSITION, VERTEX_STREAM_ATTRIBUTES, VERTEX_STREAM_COUNT };
 
-			return attribute_descriptions;
-		}
+	// One per draw command. Compact positions are stored as 0..1 within the mesh's box: position = offset + packed * scale.
+	// The vertex range is only read on the CPU, it says which box each scene vertex is packed against.
+	struct MeshDecodeData {
+		alignas(16) glm::vec3 offset;
+		uint32_t first_vertex;
+		alignas(16) glm::vec3 scale;
+		uint32_t vertex_count;
+	};
 
-		bool operator==(const Vertex& other) const {
-			return position == other.position && color == other.color && normal == other.normal;
-		}
+	// Shading parameters of one mesh, one per draw command in the material buffer. Colour is the per object tint the
+	// parser picks, later material parameters go here too.
+	struct MaterialData {
+		alignas(16) glm::vec4 color;
 	};
 
+	// Views into the arena of the ModelSet that owns them.
 	struct Mesh {
-		std::vector<Vertex> vertices;
-		std::vector<uint32_t> indices;
+		std::span<Vertex> vertices;
+		std::span<uint32_t> indices;
 	};
 
 	struct MeshInstances {
 		Mesh mesh;
 		uint32_t instance_count = 0;
-		std::vector<glm::mat4> instance_model_matrices;
+		std::span<glm::mat4> instance_model_matrices;
+		MaterialData material = { glm::vec4(1) };
+
+		// Content key of meshes shared through a geometry library (MP_Library.h), 0 for meshes owned by the scene
+		// unless MP::KeyMeshesByContent gave them one for hot reload.
+		// A keyed model with no vertices is a reference the library has not filled in yet.
+		uint64_t mesh_key = 0;
+
+		// Mesh space bounds, only present when the source file stored them (MP v2)
+		bool has_local_bounds = false;
+		glm::vec3 local_bounds_min = glm::vec3(0);
+		glm::vec3 local_bounds_max = glm::vec3(0);
+	};
+
+	// A parsed scene. Every vertex, index and matrix array lives in the arena blocks, so freeing a scene is a few deletes.
+	// A whole file parse knows every size up front and uses one block, streamed parses add blocks as objects arrive.
+	struct ModelSet {
+		std::vector<MeshInstances> models;
+		std::vector<std::unique_ptr<std::byte[]>> arena_blocks;
+		size_t arena_size = 0;
+	};
+
+	// Mesh space bounds: the local AABB, and the sphere around its centre that holds every vertex
+	struct MeshBounds {
+		glm::vec3 center = glm::vec3(0);
+		glm::vec3 half_extents = glm::vec3(0);
+		float radius = 0;
 	};
 
+	inline MeshBounds ComputeMeshBounds(const Mesh& MeshData) {
+		MeshBounds bounds;
+		if (MeshData.vertices.empty()) {
+			return bounds;
+		}
+
+		glm::vec3 min = MeshData.vertices[0].position;
+		glm::vec3 max = min;
+		for (const Vertex& v : MeshData.vertices) {
+			min = glm::min(min, v.position);
+			max = glm::max(max, v.position);
+		}
+		bounds.center = (min + max) * 0.5f;
+		bounds.half_extents = (max - min) * 0.5f;
+
+		float radius_squared = 0;
+		for (const Vertex& v : MeshData.vertices) {
+			glm::vec3 offset = v.position - bounds.center;
+			radius_squared = std::max(radius_squared, glm::dot(offset, offset));
+		}
+		bounds.radius = std::sqrt(radius_squared);
+
+		return bounds;
+	}
+
+	// Moves mesh bounds to world space with the whole instance matrix. The radius grows by the largest axis scale,
+	// each world AABB extent is the local extents projected onto that axis (Arvo's transformed box).
+	inline BoundingBoxData TransformBounds(const MeshBounds& Bounds, const glm::mat4& Model) {
+		glm::mat3 linear = glm::mat3(Model);
+		float scale = std::max({ glm::length(linear[0]), glm::length(linear[1]), glm::length(linear[2]) });
+		glm::mat3 absolute = glm::mat3(glm::abs(linear[0]), glm::abs(linear[1]), glm::abs(linear[2]));
+
+		BoundingBoxData world;
+		world.center_point = glm::vec4(glm::vec3(Model * glm::vec4(Bounds.center, 1)), Bounds.radius * scale);
+		world.half_extents = glm::vec4(absolute * Bounds.half_extents, 0);
+		return world;
+	}
+
 	static VkCommandBuffer BeginSingleTimeCommand(VkCommandPool CommandPool, VkDevice LogicalDevice) {
 		VkCommandBufferAllocateInfo alloc_info{};
 		alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
@@ -1,5 +1,7 @@
 #include "VkDataSetup.h"
 #include "VkCommon.h"
+#include <algorithm>
+#include <vector>
 
 namespace {
 
@@ -63,6 +65,26 @@ namespace {
 
 		return buffer_struct;
 	}
+
+	// Replaces Instance with a buffer of at least Size bytes when it is smaller, keeping its first KeepSize bytes
+	void ReserveBuffer(renderer::data::Buffer& Instance, VkDeviceSize KeepSize, VkDeviceSize Size, VkBufferUsageFlags Usage, renderer::data::BaseBufferContext Base) {
+
+		if (Size <= Instance.ByteSize) return;
+
+		VkDeviceSize capacity = std::max<VkDeviceSize>(Instance.ByteSize * 2, Size);
+		renderer::data::Buffer grown = CreateBufferHelper(Base.LogicalDevice, Base.PhysicalDevice, capacity, Usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+		KeepSize = std::min(KeepSize, Instance.ByteSize);
+		if (KeepSize > 0) {
+			VkCommandBuffer command_buffer = renderer::BeginSingleTimeCommand(Base.CommandPool, Base.LogicalDevice);
+			VkBufferCopy copy_region{.srcOffset = 0, .dstOffset = 0, .size = KeepSize};
+			vkCmdCopyBuffer(command_buffer, Instance.Buffer, grown.Buffer, 1, &copy_region);
+			renderer::EndSingleTimeCommand(command_buffer, Base.CommandPool, Base.LogicalDevice, Base.GraphicsQueue);
+		}
+
+		renderer::data::DestroyBuffer(Base.LogicalDevice, Instance);
+		Instance = grown;
+	}
 }
 
 namespace renderer::data {
@@ -86,8 +108,54 @@ namespace renderer::data {
 	}
 
 	Buffer CreateBuffer(const void* Data, VkDeviceSize DataSize, VkBufferUsageFlags Usage, BaseBufferContext Base) {
+		return CreateBufferStreamed(DataSize, 1, [&](void* Output, VkDeviceSize First, VkDeviceSize Count) {
+			memcpy(Output, static_cast<const std::uint8_t*>(Data) + First, (size_t)Count);
+		}, Usage, Base);
+	}
+
+	Buffer CreateBufferStreamed(VkDeviceSize ElementCount, VkDeviceSize ElementSize, const StreamFill& Fill, VkBufferUsageFlags Usage, BaseBufferContext Base) {
+
+		VkDeviceSize data_size = ElementCount * ElementSize;
+		if (data_size == 0) return Buffer{};
+
+		// Create temp buffer, reused for every chunk
+		VkDeviceSize chunk_elements = std::min(ElementCount, std::max<VkDeviceSize>(StagingChunkSize / ElementSize, 1));
+		VkDeviceSize chunk_size = chunk_elements * ElementSize;
+
+		VkBufferUsageFlags temp_usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+		VkMemoryPropertyFlags temp_properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+		Buffer temp_buffer = CreateBufferHelper(Base.LogicalDevice, Base.PhysicalDevice, chunk_size, temp_usage, temp_properties);
+
+		void* data;
+		vkMapMemory(Base.LogicalDevice, temp_buffer.Memory, 0, chunk_size, 0, &data);
 
-		if (DataSize == 0) return Buffer{};
+		// Create final buffer
+		Buffer buffer = CreateBufferHelper(Base.LogicalDevice, Base.PhysicalDevice, data_size, Usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+		// Fill temp buffer -> copy to final buffer, one chunk at a time. The copy is waited on before the next fill.
+		for (VkDeviceSize first = 0; first < ElementCount; first += chunk_elements) {
+			VkDeviceSize count = std::min(chunk_elements, ElementCount - first);
+			Fill(data, first, count);
+
+			VkCommandBuffer command_buffer = BeginSingleTimeCommand(Base.CommandPool, Base.LogicalDevice);
+			VkBufferCopy copy_region{.srcOffset = 0, .dstOffset = first * ElementSize, .size = count * ElementSize};
+			vkCmdCopyBuffer(command_buffer, temp_buffer.Buffer, buffer.Buffer, 1, &copy_region);
+			EndSingleTimeCommand(command_buffer, Base.CommandPool, Base.LogicalDevice, Base.GraphicsQueue);
+		}
+
+		// Destroy temp
+		vkUnmapMemory(Base.LogicalDevice, temp_buffer.Memory);
+		DestroyBuffer(Base.LogicalDevice, temp_buffer);
+
+		return buffer;
+	}
+
+	void AppendToBuffer(Buffer& Instance, VkDeviceSize UsedSize, const void* Data, VkDeviceSize DataSize, VkBufferUsageFlags Usage, BaseBufferContext Base) {
+
+		if (DataSize == 0) return;
+
+		// Grow, keeping what is already there
+		ReserveBuffer(Instance, UsedSize, UsedSize + DataSize, Usage, Base);
 
 		// Create temp buffer
 		VkBufferUsageFlags temp_usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
@@ -100,19 +168,49 @@ namespace renderer::data {
 		memcpy(data, Data, (size_t)DataSize);
 		vkUnmapMemory(Base.LogicalDevice, temp_buffer.Memory);
 
-		// Create final buffer
-		Buffer buffer = CreateBufferHelper(Base.LogicalDevice, Base.PhysicalDevice, DataSize, Usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
-		// Copy temp buffer -> final buffer
+		// Copy temp buffer -> end of the data already in Instance
 		VkCommandBuffer command_buffer = BeginSingleTimeCommand(Base.CommandPool, Base.LogicalDevice);
-		VkBufferCopy copy_region{.srcOffset = 0, .dstOffset = 0, .size = DataSize};
-		vkCmdCopyBuffer(command_buffer, temp_buffer.Buffer, buffer.Buffer, 1, &copy_region);
+		VkBufferCopy copy_region{.srcOffset = 0, .dstOffset = UsedSize, .size = DataSize};
+		vkCmdCopyBuffer(command_buffer, temp_buffer.Buffer, Instance.Buffer, 1, &copy_region);
 		EndSingleTimeCommand(command_buffer, Base.CommandPool, Base.LogicalDevice, Base.GraphicsQueue);
 
-		// Destroy temp
 		DestroyBuffer(Base.LogicalDevice, temp_buffer);
+	}
 
-		return buffer;
+	void WriteBufferRegions(Buffer& Instance, VkDeviceSize KeepSize, const void* Data, VkDeviceSize DataSize, std::span<const VkBufferCopy> Regions, VkBufferUsageFlags Usage, BaseBufferContext Base) {
+
+		ReserveBuffer(Instance, KeepSize, DataSize, Usage, Base);
+
+		VkDeviceSize staged_size = 0;
+		for (const VkBufferCopy& region : Regions) {
+			staged_size += region.size;
+		}
+		if (staged_size == 0) return;
+
+		// Regions are packed one after another in the temp buffer
+		VkBufferUsageFlags temp_usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+		VkMemoryPropertyFlags temp_properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+		Buffer temp_buffer = CreateBufferHelper(Base.LogicalDevice, Base.PhysicalDevice, staged_size, temp_usage, temp_properties);
+
+		std::vector<VkBufferCopy> copy_regions;
+		copy_regions.reserve(Regions.size());
+
+		void* data;
+		vkMapMemory(Base.LogicalDevice, temp_buffer.Memory, 0, staged_size, 0, &data);
+		VkDeviceSize staged_offset = 0;
+		for (const VkBufferCopy& region : Regions) {
+			memcpy(static_cast<std::uint8_t*>(data) + staged_offset, static_cast<const std::uint8_t*>(Data) + region.srcOffset, (size_t)region.size);
+			copy_regions.push_back({.srcOffset = staged_offset, .dstOffset = region.dstOffset, .size = region.size});
+			staged_offset += region.size;
+		}
+		vkUnmapMemory(Base.LogicalDevice, temp_buffer.Memory);
+
+		// One submit for every region
+		VkCommandBuffer command_buffer = BeginSingleTimeCommand(Base.CommandPool, Base.LogicalDevice);
+		vkCmdCopyBuffer(command_buffer, temp_buffer.Buffer, Instance.Buffer, static_cast<uint32_t>(copy_regions.size()), copy_regions.data());
+		EndSingleTimeCommand(command_buffer, Base.CommandPool, Base.LogicalDevice, Base.GraphicsQueue);
+
+		DestroyBuffer(Base.LogicalDevice, temp_buffer);
 	}
 
 	void DestroyBuffer(VkDevice LogicalDevice, Buffer& Instance) {
@@ -131,7 +229,9 @@ namespace renderer::data {
 		Buffer InstanceData,
 		Buffer BoundingBoxData,
 		std::array<data::UBO, MAX_FRAMES_IN_FLIGHT> UniformBuffers,
-		std::array<data::Buffer, MAX_FRAMES_IN_FLIGHT> ShouldDrawFlagBuffers){
+		std::array<data::Buffer, MAX_FRAMES_IN_FLIGHT> ShouldDrawFlagBuffers,
+		Buffer Materials,
+		Buffer MeshDecode){
 
 		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
 
@@ -195,7 +295,37 @@ namespace renderer::data {
 			should_draw_flags.descriptorCount = 1;
 			should_draw_flags.pBufferInfo = &should_draw_flags_info;
 
-			std::array<VkWriteDescriptorSet, 4> descriptor_writes = {ubo, instance_data, bouding_box_array, should_draw_flags};
+			// [4] Update Materials SSBO
+			VkDescriptorBufferInfo materials_info{};
+			materials_info.buffer = Materials.Buffer;
+			materials_info.offset = 0;
+			materials_info.range = Materials.ByteSize;
+
+			VkWriteDescriptorSet materials = {};
+			materials.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			materials.dstSet = DescriptorSet[i];
+			materials.dstBinding = 4;
+			materials.dstArrayElement = 0;
+			materials.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			materials.descriptorCount = 1;
+			materials.pBufferInfo = &materials_info;
+
+			// [5] Update Mesh Decode SSBO
+			VkDescriptorBufferInfo mesh_decode_info{};
+			mesh_decode_info.buffer = MeshDecode.Buffer;
+			mesh_decode_info.offset = 0;
+			mesh_decode_info.range = MeshDecode.ByteSize;
+
+			VkWriteDescriptorSet mesh_decode = {};
+			mesh_decode.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			mesh_decode.dstSet = DescriptorSet[i];
+			mesh_decode.dstBinding = 5;
+			mesh_decode.dstArrayElement = 0;
+			mesh_decode.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			mesh_decode.descriptorCount = 1;
+			mesh_decode.pBufferInfo = &mesh_decode_info;
+
+			std::array<VkWriteDescriptorSet, 6> descriptor_writes = {ubo, instance_data, bouding_box_array, should_draw_flags, materials, mesh_decode};
 
 			vkUpdateDescriptorSets(LogicalDevice, static_cast<uint32_t>(descriptor_writes.size()), descriptor_writes.data(), 0, nullptr);
 		}
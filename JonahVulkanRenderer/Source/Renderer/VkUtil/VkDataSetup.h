@@ -1,13 +1,15 @@
 #pragma once
 
+#include <functional>
+#include <span>
 #include <vulkan/vulkan.hpp>
 #include "VkCommon.h"
 
 namespace renderer::data {
 
 	struct Buffer {
-		VkBuffer Buffer;
-		VkDeviceMemory Memory;
+		VkBuffer Buffer = VK_NULL_HANDLE;
+		VkDeviceMemory Memory = VK_NULL_HANDLE;
 		uint64_t ByteSize = 0;
 	};
 	struct BaseBufferContext {
@@ -16,9 +18,29 @@ namespace renderer::data {
 		VkQueue GraphicsQueue;
 		VkCommandPool CommandPool;
 	};
+	// Largest temp buffer an upload maps at once, bigger uploads go through it in pieces
+	const VkDeviceSize StagingChunkSize = 64ull * 1024 * 1024;
+
+	// Writes elements [First, First + Count) of the data being uploaded to Output
+	using StreamFill = std::function<void(void* Output, VkDeviceSize First, VkDeviceSize Count)>;
+
 	Buffer CreateBuffer(const void* Data, VkDeviceSize DataSize, VkBufferUsageFlags Usage, BaseBufferContext Base);
+
+	// Like CreateBuffer, but the data never has to exist in one piece on the CPU. Fill writes it straight into the
+	// mapped temp buffer, at most StagingChunkSize bytes (whole elements) at a time.
+	Buffer CreateBufferStreamed(VkDeviceSize ElementCount, VkDeviceSize ElementSize, const StreamFill& Fill, VkBufferUsageFlags Usage, BaseBufferContext Base);
 	void DestroyBuffer(VkDevice LogicalDevice, Buffer& Instance);
 
+	// Copies Data in at UsedSize. When it does not fit, Instance is replaced by a buffer at least twice the size
+	// with the first UsedSize bytes copied over on the GPU, so ByteSize is the capacity and can be past the data.
+	// The device must be idle. Usage needs VK_BUFFER_USAGE_TRANSFER_SRC_BIT and VK_BUFFER_USAGE_TRANSFER_DST_BIT.
+	void AppendToBuffer(Buffer& Instance, VkDeviceSize UsedSize, const void* Data, VkDeviceSize DataSize, VkBufferUsageFlags Usage, BaseBufferContext Base);
+
+	// Copies the Regions of Data (srcOffset into Data, dstOffset into Instance) through one temp buffer and one submit.
+	// Instance first grows to hold DataSize bytes like AppendToBuffer, keeping its first KeepSize bytes.
+	// The device must be idle.
+	void WriteBufferRegions(Buffer& Instance, VkDeviceSize KeepSize, const void* Data, VkDeviceSize DataSize, std::span<const VkBufferCopy> Regions, VkBufferUsageFlags Usage, BaseBufferContext Base);
+
 	struct UBO {
 		Buffer Buffer;
 		void* BufferMapped;
@@ -32,5 +54,7 @@ namespace renderer::data {
 		Buffer InstanceData, 
 		Buffer BoundingBoxData,
 		std::array<data::UBO, MAX_FRAMES_IN_FLIGHT> UniformBuffers,
-		std::array<data::Buffer, MAX_FRAMES_IN_FLIGHT> ShouldDrawFlagBuffers);
+		std::array<data::Buffer, MAX_FRAMES_IN_FLIGHT> ShouldDrawFlagBuffers,
+		Buffer Materials,
+		Buffer MeshDecode);
 }
\ No newline at end of file
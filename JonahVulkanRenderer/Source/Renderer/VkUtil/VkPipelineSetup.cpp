@@ -6,6 +6,7 @@
 
 #include "VkPipelineSetup.h"
 #include "VkCommon.h"
+#include "VkVertexFormat.h"
 
 namespace {
 
@@ -150,7 +151,21 @@ namespace renderer::pipeline {
 		should_draw_flags.pImmutableSamplers = nullptr;
 		should_draw_flags.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
 
-		std::array<VkDescriptorSetLayoutBinding, 4> bindings = { ubo, instance_data, bounding_box_data, should_draw_flags };
+		VkDescriptorSetLayoutBinding materials{};
+		materials.binding = 4;
+		materials.descriptorCount = 1;
+		materials.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		materials.pImmutableSamplers = nullptr;
+		materials.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+		VkDescriptorSetLayoutBinding mesh_decode{};
+		mesh_decode.binding = 5;
+		mesh_decode.descriptorCount = 1;
+		mesh_decode.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		mesh_decode.pImmutableSamplers = nullptr;
+		mesh_decode.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+
+		std::array<VkDescriptorSetLayoutBinding, 6> bindings = { ubo, instance_data, bounding_box_data, should_draw_flags, materials, mesh_decode };
 
 		VkDescriptorSetLayoutCreateInfo create_info{};
 		create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
@@ -173,7 +188,7 @@ namespace renderer::pipeline {
 
 		VkDescriptorPoolSize ssbo;
 		ssbo.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-		ssbo.descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT) * 3;
+		ssbo.descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT) * 5;
 
 		std::array<VkDescriptorPoolSize, 2> pools = { ubo, ssbo };
 
@@ -215,7 +230,7 @@ namespace renderer::pipeline {
 	VkPipelineLayout CreatePipelineLayout(VkDevice LogicalDevice, VkDescriptorSetLayout DescriptorLayout) {
 		
 		VkPushConstantRange push_constant_range{};
-		push_constant_range.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+		push_constant_range.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
 		push_constant_range.offset = 0;
 		push_constant_range.size = sizeof(PushConstants);
 		
@@ -233,13 +248,18 @@ namespace renderer::pipeline {
 		return pipeline_layout;
 	}
 
-	VkPipeline CreateGraphicsPipeline(VkDevice LogicalDevice, VkPipelineLayout Layout, VkRenderPass RenderPass, const char* VertexShaderPath, const char* FragmentShaderPath) {
+	VkPipeline CreateGraphicsPipeline(VkDevice LogicalDevice, VkPipelineLayout Layout, VkRenderPass RenderPass, const char* VertexShaderPath, const char* FragmentShaderPath, INSTANCEFORMAT InstanceFormat, VERTEXFORMAT VertexFormat) {
 
-		auto vertex_shader_binary = ReadFile(VertexShaderPath);
-		auto fragment_shader_binary = ReadFile(FragmentShaderPath);
+		bool depth_only = FragmentShaderPath == nullptr;
 
+		auto vertex_shader_binary = ReadFile(VertexShaderPath);
 		VkShaderModule vertex_shader_module = CreateShaderModule(vertex_shader_binary, LogicalDevice);
-		VkShaderModule fragment_shader_module = CreateShaderModule(fragment_shader_binary, LogicalDevice);
+
+		VkShaderModule fragment_shader_module = VK_NULL_HANDLE;
+		if (!depth_only) {
+			auto fragment_shader_binary = ReadFile(FragmentShaderPath);
+			fragment_shader_module = CreateShaderModule(fragment_shader_binary, LogicalDevice);
+		}
 
 		VkPipelineShaderStageCreateInfo vertex_stage{};
 		vertex_stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
@@ -247,6 +267,23 @@ namespace renderer::pipeline {
 		vertex_stage.module = vertex_shader_module;
 		vertex_stage.pName = "main";
 
+		// shader.vert's INSTANCE_FORMAT and VERTEX_FORMAT
+		uint32_t specialization_data[2] = { static_cast<uint32_t>(InstanceFormat), static_cast<uint32_t>(VertexFormat) };
+
+		VkSpecializationMapEntry specialization_entries[2] = {};
+		for (uint32_t i = 0; i < 2; i++) {
+			specialization_entries[i].constantID = i;
+			specialization_entries[i].offset = i * sizeof(uint32_t);
+			specialization_entries[i].size = sizeof(uint32_t);
+		}
+
+		VkSpecializationInfo vertex_specialization{};
+		vertex_specialization.mapEntryCount = 2;
+		vertex_specialization.pMapEntries = specialization_entries;
+		vertex_specialization.dataSize = sizeof(specialization_data);
+		vertex_specialization.pData = specialization_data;
+		vertex_stage.pSpecializationInfo = &vertex_specialization;
+
 		VkPipelineShaderStageCreateInfo fragment_stage{};
 		fragment_stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 		fragment_stage.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
@@ -258,13 +295,11 @@ namespace renderer::pipeline {
 		VkPipelineVertexInputStateCreateInfo vertex_input_info{};
 		vertex_input_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
 
-		auto binding_description = Vertex::GetBindingDescription();
-		vertex_input_info.vertexBindingDescriptionCount = 1;
-		vertex_input_info.pVertexBindingDescriptions = &binding_description;
-
-		auto attribute_description = Vertex::GetAttributeDescription();
-		vertex_input_info.vertexAttributeDescriptionCount = static_cast<uint32_t>(attribute_description.size());
-		vertex_input_info.pVertexAttributeDescriptions = attribute_description.data();
+		VertexInputDescription vertex_input = GetVertexInputDescription(VertexFormat, depth_only);
+		vertex_input_info.vertexBindingDescriptionCount = static_cast<uint32_t>(vertex_input.bindings.size());
+		vertex_input_info.pVertexBindingDescriptions = vertex_input.bindings.data();
+		vertex_input_info.vertexAttributeDescriptionCount = static_cast<uint32_t>(vertex_input.attributes.size());
+		vertex_input_info.pVertexAttributeDescriptions = vertex_input.attributes.data();
 
 		VkPipelineInputAssemblyStateCreateInfo input_assembly{};
 		input_assembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
@@ -290,7 +325,8 @@ namespace renderer::pipeline {
 		depth_stencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
 		depth_stencil.depthTestEnable = VK_TRUE;
 		depth_stencil.depthWriteEnable = VK_TRUE;
-		depth_stencil.depthCompareOp = VK_COMPARE_OP_LESS;
+		// Or equal, so the shaded pass still draws where a depth pre-pass already wrote the same depth
+		depth_stencil.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
 		depth_stencil.depthBoundsTestEnable = VK_FALSE;
 		depth_stencil.stencilTestEnable = VK_FALSE;
 
@@ -317,7 +353,7 @@ namespace renderer::pipeline {
 		multisampling.alphaToOneEnable = VK_FALSE;
 
 		VkPipelineColorBlendAttachmentState color_blend_attachment{};
-		color_blend_attachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+		color_blend_attachment.colorWriteMask = depth_only ? 0 : VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
 		color_blend_attachment.blendEnable = VK_TRUE;
 		color_blend_attachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
 		color_blend_attachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
@@ -334,7 +370,7 @@ namespace renderer::pipeline {
 
 		VkGraphicsPipelineCreateInfo pipeline_info{};
 		pipeline_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-		pipeline_info.stageCount = 2;
+		pipeline_info.stageCount = depth_only ? 1 : 2;
 
 		pipeline_info.pStages = shader_stages;
 		pipeline_info.pVertexInputState = &vertex_input_info;
@@ -358,7 +394,9 @@ namespace renderer::pipeline {
 			throw std::runtime_error("Failed to create graphics pipeline.");
 		}
 
-		vkDestroyShaderModule(LogicalDevice, fragment_shader_module, nullptr);
+		if (fragment_shader_module != VK_NULL_HANDLE) {
+			vkDestroyShaderModule(LogicalDevice, fragment_shader_module, nullptr);
+		}
 		vkDestroyShaderModule(LogicalDevice, vertex_shader_module, nullptr);
 
 		return graphics_pipeline;
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <vulkan/vulkan.hpp>
+#include "VkCommon.h"
 
 namespace renderer::pipeline {
 
@@ -11,7 +12,9 @@ namespace renderer::pipeline {
 	std::vector<VkDescriptorSet> CreateDescriptorSets(VkDevice LogicalDevice, VkDescriptorSetLayout Layout, VkDescriptorPool Pool);
 
 	VkPipelineLayout CreatePipelineLayout(VkDevice LogicalDevice, VkDescriptorSetLayout DescriptorLayout);
-	VkPipeline CreateGraphicsPipeline(VkDevice LogicalDevice, VkPipelineLayout Layout, VkRenderPass RenderPass, const char* VertexShaderPath, const char* FragmentShaderPath);
+	// The vertex shader is built for the layout of instance_data_buffer (InstanceFormat) and of the vertex streams (VertexFormat).
+	// No FragmentShaderPath makes a depth only pipeline: it binds just the position stream and writes no colour.
+	VkPipeline CreateGraphicsPipeline(VkDevice LogicalDevice, VkPipelineLayout Layout, VkRenderPass RenderPass, const char* VertexShaderPath, const char* FragmentShaderPath, INSTANCEFORMAT InstanceFormat, VERTEXFORMAT VertexFormat);
 	VkPipeline CreateComputePipeline(VkDevice LogicalDevice, VkPipelineLayout Layout, const char* ComputeShaderPath);
 
 }
\ No newline at end of file
@@ -1,112 +1,437 @@
 #include "VkSceneProcesser.h"
+#include "../../Util/JobSystem.h"
+#include <glm/gtc/quaternion.hpp>
+#include <glm/packing.hpp>
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <cstring>
+#include <stdexcept>
 
 namespace renderer::scene {
 
-	SceneParser::SceneParser(const std::vector<MeshInstances>& NewModelSet) {
+	namespace {
 
-		model_set = NewModelSet;
+		// Spreads the low 21 bits of Value out to every third bit
+		uint64_t SpreadBits(uint64_t Value) {
+			Value &= 0x1FFFFF;
+			Value = (Value | Value << 32) & 0x1F00000000FFFF;
+			Value = (Value | Value << 16) & 0x1F0000FF0000FF;
+			Value = (Value | Value << 8) & 0x100F00F00F00F00F;
+			Value = (Value | Value << 4) & 0x10C30C30C30C30C3;
+			Value = (Value | Value << 2) & 0x1249249249249249;
+			return Value;
+		}
+
+		// Z-order of Point on a 2^21 grid over [Min, Max] in every axis
+		uint64_t MortonCode(glm::vec3 Point, glm::vec3 Min, glm::vec3 Max) {
+			glm::vec3 extent = glm::max(Max - Min, glm::vec3(1e-20f));
+			glm::vec3 cell = glm::clamp((Point - Min) / extent, 0.0f, 1.0f) * float(0x1FFFFF);
+			return SpreadBits(uint64_t(cell.x)) | SpreadBits(uint64_t(cell.y)) << 1 | SpreadBits(uint64_t(cell.z)) << 2;
+		}
+
+	} // namespace unnamed
 
-		uint32_t m = 0;
+	// Two passes: a serial prefix sum gives every drawn mesh its place in each output array, then the meshes fill
+	// their parts of the presized arrays in parallel. What a mesh writes only depends on that mesh, so the output is
+	// byte for byte what one thread would build.
+	SceneParser::SceneParser(const ModelSet& NewModelSet, bool CopyGeometry, bool MortonOrder) {
+
+		copy_geometry = CopyGeometry;
+		vertex_count = 0;
+		index_count = 0;
 		mesh_count = 0;
 		scene_root = glm::vec3(0, 0, 0);
-		scene_vertices = {};
-		scene_indices = {};
-		draw_commands = {};
-		bounding_data = {};
-		instance_data = {};
 
-		for (MeshInstances model : model_set) {
+		// Where each drawn mesh goes
+		struct MeshPlacement {
+			const MeshInstances* model;
+			uint32_t first_vertex;
+			uint32_t first_index;
+			uint32_t first_instance;
+		};
+		std::vector<MeshPlacement> placements;
+		std::vector<uint64_t> costs;
+
+		for (const MeshInstances& model : NewModelSet.models) {
 
-			Mesh mesh = model.mesh;
+			const Mesh& mesh = model.mesh;
 
 			bool no_data = mesh.vertices.size() == 0 || mesh.indices.size() == 0;
 			if (no_data) continue;
 
+			placements.push_back({ &model, vertex_count, index_count, mesh_count });
+			costs.push_back(mesh.vertices.size() + mesh.indices.size() + model.instance_count);
+
+			if (!copy_geometry) {
+				mesh_sources.push_back({ &mesh, vertex_count, index_count });
+			}
+
+			vertex_count += static_cast<uint32_t>(mesh.vertices.size());
+			index_count += static_cast<uint32_t>(mesh.indices.size());
 			mesh_count += model.instance_count;
+		}
 
-			// Move vertex data
-			uint32_t offset = static_cast<uint32_t>(scene_vertices.size());
-			glm::vec3 sum = glm::vec3(0);
-			float max_distance_from_center = -1;
+		if (copy_geometry) {
+			scene_vertices.resize(vertex_count);
+			scene_indices.resize(index_count);
+		}
+		draw_commands.resize(placements.size());
+		materials.resize(placements.size());
+		mesh_decode.resize(placements.size());
+		instance_data.resize(mesh_count);
+		bounding_data.resize(mesh_count);
 
-			for (const Vertex& v : mesh.vertices) {
-				scene_vertices.push_back(v);
-				sum += v.position;
+		// First instance of each mesh, in file order, whose candidate is not the origin. The first mesh with one wins below
+		std::vector<glm::vec3> root_candidates(placements.size(), glm::vec3(0, 0, 0));
 
-				float distance_from_center = glm::distance(v.position, glm::vec3(0, 0, 0));
+		util::GetJobSystem().ParallelFor(static_cast<uint32_t>(placements.size()), [&](uint32_t d) {
 
-				if (distance_from_center > max_distance_from_center) {
-					max_distance_from_center = distance_from_center;
-				}
+			const MeshPlacement& placement = placements[d];
+			const MeshInstances& model = *placement.model;
+			const Mesh& mesh = model.mesh;
+
+			// Move vertex data
+			if (copy_geometry) {
+				std::copy(mesh.vertices.begin(), mesh.vertices.end(), scene_vertices.begin() + placement.first_vertex);
 			}
 
+			MeshBounds local_bounds = ComputeMeshBounds(mesh);
+			mesh_decode[d] = MakeMeshDecode(local_bounds, placement.first_vertex, static_cast<uint32_t>(mesh.vertices.size()));
+
 			// Move index data
-			uint32_t first_index = static_cast<uint32_t>(scene_indices.size());
-			for (uint32_t i : mesh.indices) {
-				scene_indices.push_back(i + offset);
+			if (copy_geometry) {
+				uint32_t* output = scene_indices.data() + placement.first_index;
+				for (uint32_t i : mesh.indices) {
+					*output++ = i + placement.first_vertex;
+				}
 			}
 
 			// Create draw command
-			VkDrawIndexedIndirectCommand indirect_command{};
+			VkDrawIndexedIndirectCommand& indirect_command = draw_commands[d];
 			indirect_command.instanceCount = model.instance_count;
-			indirect_command.firstInstance = m;
-			indirect_command.firstIndex = first_index;
+			indirect_command.firstInstance = placement.first_instance;
+			indirect_command.firstIndex = placement.first_index;
 			indirect_command.indexCount = static_cast<uint32_t>(mesh.indices.size());
+			materials[d] = model.material;
 
-			draw_commands.push_back(indirect_command);
+			// Instance order within the mesh: file order, or by Morton code of the world centre over the mesh's instances
+			std::vector<uint32_t> order;
+			if (MortonOrder && model.instance_count > 1) {
+				std::vector<glm::vec3> centers(model.instance_count);
+				glm::vec3 min = glm::vec3(std::numeric_limits<float>::max());
+				glm::vec3 max = glm::vec3(std::numeric_limits<float>::lowest());
 
-			m += model.instance_count;
+				for (uint32_t i = 0; i < model.instance_count; i++) {
+					centers[i] = glm::vec3(model.instance_model_matrices[i] * glm::vec4(local_bounds.center, 1));
+					min = glm::min(min, centers[i]);
+					max = glm::max(max, centers[i]);
+				}
 
-			float length = static_cast<float>(mesh.vertices.size());
-			glm::vec4 mesh_local_center_point = glm::vec4(sum.x / length, sum.y / length, sum.z / length, 1);
+				std::vector<std::pair<uint64_t, uint32_t>> codes(model.instance_count);
+				for (uint32_t i = 0; i < model.instance_count; i++) {
+					codes[i] = { MortonCode(centers[i], min, max), i };
+				}
+				std::sort(codes.begin(), codes.end());
 
-			// Find model center and instance data
-			for (int i = 0; i < static_cast<int>(model.instance_count); i++) {
+				order.resize(model.instance_count);
+				for (uint32_t i = 0; i < model.instance_count; i++) {
+					order[i] = codes[i].second;
+				}
+			}
+
+			// Instance bounds and data
+			uint32_t root_instance = std::numeric_limits<uint32_t>::max();
+			for (uint32_t k = 0; k < model.instance_count; k++) {
 
+				uint32_t i = order.empty() ? k : order[k];
 				const glm::mat4& instance_model_matrix = model.instance_model_matrices[i];
 
-				glm::vec4 mesh_world_center_point = instance_model_matrix[3] + mesh_local_center_point;
-				mesh_world_center_point.w = 1;
+				BoundingBoxData& mesh_bounding_box = bounding_data[placement.first_instance + k];
+				mesh_bounding_box = TransformBounds(local_bounds, instance_model_matrix);
 
-				if (scene_root == glm::vec3(0, 0, 0)) {
-					scene_root = mesh_world_center_point + glm::vec4(max_distance_from_center, 0, 0, 0);
+				// Tracked by file order index, so the start view does not depend on the instance order
+				glm::vec3 candidate = glm::vec3(mesh_bounding_box.center_point) + glm::vec3(mesh_bounding_box.center_point.w, 0, 0);
+				if (i < root_instance && candidate != glm::vec3(0, 0, 0)) {
+					root_instance = i;
+					root_candidates[d] = candidate;
 				}
 
-				BoundingBoxData mesh_bounding_box;
-				mesh_bounding_box.center_point = mesh_world_center_point;
-				mesh_bounding_box.radius = glm::vec4(max_distance_from_center, 0, 0, 0);
-				bounding_data.push_back(mesh_bounding_box);
+				instance_data[placement.first_instance + k] = MakeInstanceData(instance_model_matrix);
+			}
+		}, costs);
 
-				instance_data.push_back({ instance_model_matrix , glm::vec4(0) });
+		for (const glm::vec3& candidate : root_candidates) {
+			if (candidate != glm::vec3(0, 0, 0)) {
+				scene_root = candidate;
+				break;
 			}
 		}
 	}
 
-	std::vector<InstanceData> SceneParser::GetInstanceData() {
+	std::span<const InstanceData> SceneParser::GetInstanceData() const {
 		return instance_data;
 	}
 
-	std::vector<BoundingBoxData> SceneParser::GetBoundingData() {
+	std::span<const BoundingBoxData> SceneParser::GetBoundingData() const {
 		return bounding_data;
 	}
 
-	std::vector<VkDrawIndexedIndirectCommand> SceneParser::GetDrawCommands() {
+	std::span<const VkDrawIndexedIndirectCommand> SceneParser::GetDrawCommands() const {
 		return draw_commands;
 	}
 
-	std::vector<Vertex> SceneParser::GetSceneVertices() {
+	std::span<const MaterialData> SceneParser::GetMaterials() const {
+		return materials;
+	}
+
+	std::span<const MeshDecodeData> SceneParser::GetMeshDecode() const {
+		return mesh_decode;
+	}
+
+	std::span<const Vertex> SceneParser::GetSceneVertices() const {
 		return scene_vertices;
 	}
 
-	std::vector<uint32_t> SceneParser::GetSceneIndices() {
+	std::span<const uint32_t> SceneParser::GetSceneIndices() const {
 		return scene_indices;
 	}
 
-	uint32_t SceneParser::GetMeshCount() {
+	uint32_t SceneParser::GetVertexCount() const {
+		return vertex_count;
+	}
+
+	uint32_t SceneParser::GetIndexCount() const {
+		return index_count;
+	}
+
+	uint32_t SceneParser::GetMeshCount() const {
 		return mesh_count;
 	}
 
-	glm::vec3 SceneParser::GetSceneRoot() {
+	glm::vec3 SceneParser::GetSceneRoot() const {
 		return scene_root;
 	}
+
+	SceneView SceneParser::GetSceneView() const {
+		SceneView view;
+		view.vertices = scene_vertices;
+		view.indices = scene_indices;
+		view.instance_data = instance_data;
+		view.bounding_data = bounding_data;
+		view.draw_commands = draw_commands;
+		view.materials = materials;
+		view.mesh_decode = mesh_decode;
+		view.mesh_count = mesh_count;
+		view.scene_root = scene_root;
+		return view;
+	}
+
+	void SceneParser::WriteVertices(uint64_t First, uint64_t Count, Vertex* Output) const {
+		if (copy_geometry) {
+			std::copy_n(scene_vertices.begin() + First, Count, Output);
+			return;
+		}
+		if (Count == 0) return;
+
+		// Last mesh starting at or before First, then on through the meshes after it
+		auto source = std::upper_bound(mesh_sources.begin(), mesh_sources.end(), First, [](uint64_t Value, const MeshSource& Source) {
+			return Value < Source.first_vertex;
+		}) - 1;
+
+		for (; Count > 0; source++) {
+			uint64_t local = First - source->first_vertex;
+			uint64_t count = std::min<uint64_t>(Count, source->mesh->vertices.size() - local);
+
+			std::copy_n(source->mesh->vertices.begin() + local, count, Output);
+			Output += count;
+			First += count;
+			Count -= count;
+		}
+	}
+
+	void SceneParser::WriteVertexStream(VERTEXFORMAT Format, VERTEXSTREAM Stream, uint64_t First, uint64_t Count, void* Output) const {
+		auto read_vertices = [this](uint64_t First, uint64_t Count, Vertex* Output) {
+			WriteVertices(First, Count, Output);
+		};
+		scene::WriteVertexStream(Format, Stream, mesh_decode, First, Count, read_vertices, Output);
+	}
+
+	void SceneParser::WriteIndices(uint64_t First, uint64_t Count, uint32_t* Output) const {
+		if (copy_geometry) {
+			std::copy_n(scene_indices.begin() + First, Count, Output);
+			return;
+		}
+		if (Count == 0) return;
+
+		auto source = std::upper_bound(mesh_sources.begin(), mesh_sources.end(), First, [](uint64_t Value, const MeshSource& Source) {
+			return Value < Source.first_index;
+		}) - 1;
+
+		for (; Count > 0; source++) {
+			uint64_t local = First - source->first_index;
+			uint64_t count = std::min<uint64_t>(Count, source->mesh->indices.size() - local);
+
+			for (uint64_t i = 0; i < count; i++) {
+				Output[i] = source->mesh->indices[local + i] + source->first_vertex;
+			}
+			Output += count;
+			First += count;
+			Count -= count;
+		}
+	}
+
+	void ExtractFrustumPlanes(const glm::mat4& ViewProjection, glm::vec4 Planes[6]) {
+		glm::mat4 matrix = glm::transpose(ViewProjection);
+
+		enum side { LEFT = 0, RIGHT = 1, TOP = 2, BOTTOM = 3, NEAR_ = 4, FAR_ = 5 };
+
+		Planes[LEFT] = matrix[3] + matrix[0];
+		Planes[RIGHT] = matrix[3] - matrix[0];
+		Planes[TOP] = matrix[3] - matrix[1];
+		Planes[BOTTOM] = matrix[3] + matrix[1];
+		Planes[NEAR_] = matrix[2];
+		Planes[FAR_] = matrix[3] - matrix[2];
+
+		for (auto i = 0; i < 6; i++)
+		{
+			float length = glm::length(glm::vec3(Planes[i]));
+			Planes[i] /= length;
+		}
+	}
+
+	bool IsInFrustum(const BoundingBoxData& Bounds, const glm::vec4 Planes[6], bool TestBox) {
+		glm::vec3 center = glm::vec3(Bounds.center_point);
+
+		for (int i = 0; i < 6; i++) {
+			glm::vec3 normal = glm::vec3(Planes[i]);
+			float distance = glm::dot(normal, center) + Planes[i].w;
+
+			if (distance + Bounds.center_point.w < 0.0f) {
+				return false;
+			}
+			if (TestBox && distance + glm::dot(glm::vec3(Bounds.half_extents), glm::abs(normal)) < 0.0f) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	size_t GetInstanceStride(INSTANCEFORMAT Format) {
+		return Format == INSTANCE_QUANTIZED ? sizeof(QuantizedInstanceData) : sizeof(InstanceData);
+	}
+
+	bool QuantizeInstance(const InstanceData& Instance, QuantizedInstanceData& Output) {
+		glm::mat4 model = GetModelMatrix(Instance);
+		glm::mat3 linear = glm::mat3(model);
+
+		glm::vec3 scale = glm::vec3(glm::length(linear[0]), glm::length(linear[1]), glm::length(linear[2]));
+		float max_scale = std::max({ scale.x, scale.y, scale.z });
+
+		// Half floats: the smallest normal value up to the largest value
+		if (std::min({ scale.x, scale.y, scale.z }) < 6.2e-5f || max_scale > 65000.0f) {
+			return false;
+		}
+
+		glm::mat3 rotation = glm::mat3(linear[0] / scale.x, linear[1] / scale.y, linear[2] / scale.z);
+		if (glm::determinant(rotation) < 0) {
+			scale.z = -scale.z;
+			rotation[2] = -rotation[2];
+		}
+		glm::quat quaternion = glm::normalize(glm::quat_cast(rotation));
+
+		Output.position = glm::vec3(model[3]);
+		Output.scale_xy = glm::packHalf2x16(glm::vec2(scale.x, scale.y));
+		Output.scale_z = glm::packHalf2x16(glm::vec2(scale.z, 0));
+		Output.rotation_xy = glm::packSnorm2x16(glm::vec2(quaternion.x, quaternion.y));
+		Output.rotation_zw = glm::packSnorm2x16(glm::vec2(quaternion.z, quaternion.w));
+		Output.unused = 0;
+
+		// Rebuild it the way shader.vert does and compare
+		glm::vec2 unpacked_xy = glm::unpackSnorm2x16(Output.rotation_xy);
+		glm::vec2 unpacked_zw = glm::unpackSnorm2x16(Output.rotation_zw);
+		glm::quat unpacked = glm::normalize(glm::quat(unpacked_zw.y, unpacked_xy.x, unpacked_xy.y, unpacked_zw.x));
+		glm::vec2 scale_xy = glm::unpackHalf2x16(Output.scale_xy);
+		float scale_z = glm::unpackHalf2x16(Output.scale_z).x;
+
+		glm::mat3 rebuilt = glm::mat3_cast(unpacked);
+		rebuilt[0] *= scale_xy.x;
+		rebuilt[1] *= scale_xy.y;
+		rebuilt[2] *= scale_z;
+
+		float tolerance = max_scale * 1e-3f;
+		for (int c = 0; c < 3; c++) {
+			glm::vec3 error = glm::abs(rebuilt[c] - linear[c]);
+			if (std::max({ error.x, error.y, error.z }) > tolerance) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	INSTANCEFORMAT ChooseInstanceFormat(std::span<const InstanceData> Instances) {
+		const uint32_t block_size = 16384;
+		uint32_t block_count = static_cast<uint32_t>((Instances.size() + block_size - 1) / block_size);
+		std::atomic<bool> all_pack = true;
+
+		util::GetJobSystem().ParallelFor(block_count, [&](uint32_t b) {
+			size_t end = std::min<size_t>(Instances.size(), size_t(b + 1) * block_size);
+			QuantizedInstanceData packed;
+
+			for (size_t i = size_t(b) * block_size; i < end && all_pack.load(std::memory_order_relaxed); i++) {
+				if (!QuantizeInstance(Instances[i], packed)) {
+					all_pack = false;
+				}
+			}
+		});
+
+		return all_pack ? INSTANCE_QUANTIZED : INSTANCE_AFFINE;
+	}
+
+	void WriteInstances(INSTANCEFORMAT Format, std::span<const InstanceData> Instances, void* Output) {
+		if (Format == INSTANCE_AFFINE) {
+			std::memcpy(Output, Instances.data(), Instances.size_bytes());
+			return;
+		}
+
+		QuantizedInstanceData* output = static_cast<QuantizedInstanceData*>(Output);
+		for (const InstanceData& instance : Instances) {
+			QuantizeInstance(instance, *output++);
+		}
+	}
+
+	void WriteVertexStream(VERTEXFORMAT Format, VERTEXSTREAM Stream, std::span<const MeshDecodeData> MeshDecode, uint64_t First, uint64_t Count, const VertexReader& Read, void* Output) {
+		if (Count == 0) return;
+
+		// Floats go through a small scratch buffer, a mesh at a time
+		const uint64_t block_size = 16384;
+		thread_local std::vector<Vertex> scratch;
+		scratch.resize(block_size);
+
+		std::byte* output = static_cast<std::byte*>(Output);
+		size_t stride = GetStreamStride(Format, Stream);
+
+		auto decode = std::upper_bound(MeshDecode.begin(), MeshDecode.end(), First, [](uint64_t Value, const MeshDecodeData& Decode) {
+			return Value < Decode.first_vertex;
+		});
+
+		while (Count > 0) {
+			if (decode == MeshDecode.begin() || First >= uint64_t((decode - 1)->first_vertex) + (decode - 1)->vertex_count) {
+				throw std::runtime_error("Vertex is not in any draw's mesh.");
+			}
+			const MeshDecodeData& mesh = *(decode - 1);
+
+			uint64_t count = std::min({ Count, uint64_t(mesh.first_vertex) + mesh.vertex_count - First, block_size });
+			Read(First, count, scratch.data());
+			PackVertices(Format, Stream, std::span<const Vertex>(scratch.data(), count), mesh, output);
+
+			output += count * stride;
+			First += count;
+			Count -= count;
+
+			if (First == uint64_t(mesh.first_vertex) + mesh.vertex_count) {
+				decode++;
+			}
+		}
+	}
 }
\ No newline at end of file
@@ -4,31 +4,111 @@
 #define GLM_ENABLE_EXPERIMENTAL 
 #include <glm/glm.hpp>
 #include <vulkan/vulkan.hpp>
+#include <functional>
 #include "VkCommon.h"
+#include "VkVertexFormat.h"
 
 namespace renderer::scene {
 
+	// The final GPU-ready arrays of a scene. Owned elsewhere: by a SceneParser or a mapped cooked file.
+	struct SceneView {
+		std::span<const Vertex> vertices;
+		std::span<const uint32_t> indices;
+		std::span<const InstanceData> instance_data;
+		std::span<const BoundingBoxData> bounding_data;
+		std::span<const VkDrawIndexedIndirectCommand> draw_commands;
+		std::span<const MaterialData> materials;	// One per draw command
+		std::span<const MeshDecodeData> mesh_decode;	// One per draw command
+		uint32_t mesh_count = 0;
+		glm::vec3 scene_root = glm::vec3(0, 0, 0);
+	};
+
+	// Builds the GPU arrays of a ModelSet. Move only, the arrays are as big as the scene.
 	class SceneParser {
 
 	public:
-		SceneParser(const std::vector<MeshInstances>& NewModelSet);
-		std::vector<InstanceData> GetInstanceData();
-		std::vector<BoundingBoxData> GetBoundingData();
-		std::vector<VkDrawIndexedIndirectCommand> GetDrawCommands();
-		std::vector<Vertex> GetSceneVertices();
-		std::vector<uint32_t> GetSceneIndices();
-		uint32_t GetMeshCount();
-		glm::vec3 GetSceneRoot();
+		// CopyGeometry false leaves the vertices and indices in NewModelSet, which then has to outlive the parser.
+		// They are only reachable through WriteVertices / WriteIndices, so uploads can write them straight into
+		// staging memory and the scene's geometry is never held twice. GetSceneView has them empty.
+		// MortonOrder sorts each mesh's instances along a 3D Morton (Z-order) curve through their world centres, so
+		// instances near each other are next to each other in the instance and bounds arrays. Draw commands and the
+		// set of instances are unchanged, only the order within each mesh's range.
+		SceneParser(const ModelSet& NewModelSet, bool CopyGeometry = true, bool MortonOrder = false);
+
+		SceneParser(const SceneParser&) = delete;
+		SceneParser& operator=(const SceneParser&) = delete;
+		SceneParser(SceneParser&&) = default;
+		SceneParser& operator=(SceneParser&&) = default;
+
+		std::span<const InstanceData> GetInstanceData() const;
+		std::span<const BoundingBoxData> GetBoundingData() const;
+		std::span<const VkDrawIndexedIndirectCommand> GetDrawCommands() const;
+		std::span<const MaterialData> GetMaterials() const;
+		std::span<const MeshDecodeData> GetMeshDecode() const;
+		std::span<const Vertex> GetSceneVertices() const;
+		std::span<const uint32_t> GetSceneIndices() const;
+		uint32_t GetVertexCount() const;
+		uint32_t GetIndexCount() const;
+		uint32_t GetMeshCount() const;
+		glm::vec3 GetSceneRoot() const;
+		SceneView GetSceneView() const;
+
+		// Copies scene vertices [First, First + Count) to Output, with or without CopyGeometry.
+		void WriteVertices(uint64_t First, uint64_t Count, Vertex* Output) const;
+
+		// Packs one stream of scene vertices [First, First + Count) to Output in Format, see the free WriteVertexStream.
+		void WriteVertexStream(VERTEXFORMAT Format, VERTEXSTREAM Stream, uint64_t First, uint64_t Count, void* Output) const;
+
+		// Copies scene indices [First, First + Count) to Output, rebased to scene vertex numbers like GetSceneIndices.
+		void WriteIndices(uint64_t First, uint64_t Count, uint32_t* Output) const;
 
 	private:
-		std::vector<MeshInstances> model_set;
+		// Where a mesh left in the ModelSet lands in the scene arrays
+		struct MeshSource {
+			const Mesh* mesh;
+			uint32_t first_vertex;
+			uint32_t first_index;
+		};
 
 		std::vector<InstanceData> instance_data;
 		std::vector<BoundingBoxData> bounding_data;
 		std::vector<VkDrawIndexedIndirectCommand> draw_commands;
+		std::vector<MaterialData> materials;
+		std::vector<MeshDecodeData> mesh_decode;
 		std::vector<Vertex> scene_vertices;
 		std::vector<uint32_t> scene_indices;
+		std::vector<MeshSource> mesh_sources;
+		bool copy_geometry;
+		uint32_t vertex_count;
+		uint32_t index_count;
 		uint32_t mesh_count;
 		glm::vec3 scene_root;
 	};
+
+	// Normalized left, right, top, bottom, near and far planes of a view projection, pointing inwards.
+	void ExtractFrustumPlanes(const glm::mat4& ViewProjection, glm::vec4 Planes[6]);
+
+	// CPU copy of the test cull.comp runs per instance. The sphere goes first, TestBox adds the world AABB,
+	// which is tighter for long or flat meshes.
+	bool IsInFrustum(const BoundingBoxData& Bounds, const glm::vec4 Planes[6], bool TestBox);
+
+	// Bytes per instance in instance_data_buffer.
+	size_t GetInstanceStride(INSTANCEFORMAT Format);
+
+	// Splits the instance into position, rotation and scale (a mirror becomes a negative z scale) and packs it.
+	// False when the packed form would not rebuild the matrix to within 1/1000 of its largest scale, e.g. shear.
+	bool QuantizeInstance(const InstanceData& Instance, QuantizedInstanceData& Output);
+
+	// INSTANCE_QUANTIZED when every instance packs, INSTANCE_AFFINE otherwise.
+	INSTANCEFORMAT ChooseInstanceFormat(std::span<const InstanceData> Instances);
+
+	// Writes Instances to Output in Format. Instances must all pack for INSTANCE_QUANTIZED.
+	void WriteInstances(INSTANCEFORMAT Format, std::span<const InstanceData> Instances, void* Output);
+
+	// Fills Output with float scene vertices [First, First + Count), e.g. SceneParser::WriteVertices.
+	using VertexReader = std::function<void(uint64_t First, uint64_t Count, Vertex* Output)>;
+
+	// Writes Stream of scene vertices [First, First + Count) to Output in Format, Count of the stream's packed struct.
+	// MeshDecode (one per draw, in vertex order) gives the box each vertex is packed against.
+	void WriteVertexStream(VERTEXFORMAT Format, VERTEXSTREAM Stream, std::span<const MeshDecodeData> MeshDecode, uint64_t First, uint64_t Count, const VertexReader& Read, void* Output);
 }
\ No newline at end of file
@@ -0,0 +1,252 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+#include "VkCommon.h"
+
+// GPU vertex formats. Each one declares its packed structs and its fields once, the Vulkan vertex input, the CPU
+// pack and unpack and the pipeline variant (the VERTEXFORMAT it is built with) all come from that declaration.
+// Every format is split into a position stream and an attribute stream (VERTEXSTREAM), one packed struct each.
+// A new format needs its structs, an entry in WithVertexFormat and its decode in shader.vert.
+namespace renderer {
+
+	// One vertex shader input of a format, offset is within its stream's struct
+	struct VertexField {
+		uint32_t location;
+		VERTEXSTREAM stream;
+		VkFormat format;
+		uint32_t offset;
+	};
+
+	// Mesh box of a mesh's bounds. Flat axes get a scale of 0, every vertex packs to 0 there.
+	inline MeshDecodeData MakeMeshDecode(const MeshBounds& Bounds, uint32_t FirstVertex, uint32_t VertexCount) {
+		MeshDecodeData decode;
+		decode.offset = Bounds.center - Bounds.half_extents;
+		decode.first_vertex = FirstVertex;
+		decode.scale = Bounds.half_extents * 2.0f;
+		decode.vertex_count = VertexCount;
+		return decode;
+	}
+
+	// Octahedral normal encoding (Cigolle et al.), unit vector to [-1, 1]^2 and back. A zero normal encodes to +z.
+	inline glm::vec2 OctEncode(glm::vec3 Normal) {
+		float sum = std::abs(Normal.x) + std::abs(Normal.y) + std::abs(Normal.z);
+		if (!(sum > 0.0f)) return glm::vec2(0.0f);
+
+		glm::vec2 folded = glm::vec2(Normal) / sum;
+		if (Normal.z < 0.0f) {
+			glm::vec2 sign = glm::vec2(folded.x >= 0.0f ? 1.0f : -1.0f, folded.y >= 0.0f ? 1.0f : -1.0f);
+			folded = (1.0f - glm::abs(glm::vec2(folded.y, folded.x))) * sign;
+		}
+		return folded;
+	}
+
+	inline glm::vec3 OctDecode(glm::vec2 Encoded) {
+		glm::vec3 normal = glm::vec3(Encoded, 1.0f - std::abs(Encoded.x) - std::abs(Encoded.y));
+		float fold = std::max(-normal.z, 0.0f);
+		normal.x += normal.x >= 0.0f ? -fold : fold;
+		normal.y += normal.y >= 0.0f ? -fold : fold;
+		return glm::normalize(normal);
+	}
+
+	// Same rounding as the Vulkan UNORM / SNORM conversions in reverse
+	inline uint16_t PackUnorm16(float Value) {
+		return static_cast<uint16_t>(std::lround(std::clamp(Value, 0.0f, 1.0f) * 65535.0f));
+	}
+
+	inline int16_t PackSnorm16(float Value) {
+		return static_cast<int16_t>(std::lround(std::clamp(Value, -1.0f, 1.0f) * 32767.0f));
+	}
+
+	// Vertex as the parser decodes it, 12 + 12 bytes
+	struct FloatPosition {
+		glm::vec3 position;
+	};
+
+	struct FloatAttributes {
+		glm::vec3 normal;
+	};
+
+	struct FloatVertexFormat {
+		using Position = FloatPosition;
+		using Attributes = FloatAttributes;
+		static constexpr VERTEXFORMAT id = VERTEX_FLOAT;
+		static constexpr const char* name = "float";
+
+		static constexpr std::array<VertexField, 2> fields = { {
+			{ 0, VERTEX_STREAM_POSITION, VK_FORMAT_R32G32B32_SFLOAT, offsetof(FloatPosition, position) },
+			{ 1, VERTEX_STREAM_ATTRIBUTES, VK_FORMAT_R32G32B32_SFLOAT, offsetof(FloatAttributes, normal) },
+		} };
+
+		static Position PackPosition(const Vertex& Input, const MeshDecodeData&) {
+			return { Input.position };
+		}
+
+		static Attributes PackAttributes(const Vertex& Input) {
+			return { Input.normal };
+		}
+
+		static Vertex Unpack(const Position& InputPosition, const Attributes& InputAttributes, const MeshDecodeData&) {
+			return { InputPosition.position, InputAttributes.normal };
+		}
+	};
+
+	// 8 + 4 bytes: position as unorm16 within the mesh box, normal octahedron encoded as two snorm16s.
+	// Position w is padding, 3 component 16 bit formats are not required to work as vertex input.
+	struct CompactPosition {
+		uint16_t position[4];
+	};
+
+	struct CompactAttributes {
+		int16_t normal[2];
+	};
+
+	struct CompactVertexFormat {
+		using Position = CompactPosition;
+		using Attributes = CompactAttributes;
+		static constexpr VERTEXFORMAT id = VERTEX_COMPACT;
+		static constexpr const char* name = "compact";
+
+		static constexpr std::array<VertexField, 2> fields = { {
+			{ 0, VERTEX_STREAM_POSITION, VK_FORMAT_R16G16B16A16_UNORM, offsetof(CompactPosition, position) },
+			{ 1, VERTEX_STREAM_ATTRIBUTES, VK_FORMAT_R16G16_SNORM, offsetof(CompactAttributes, normal) },
+		} };
+
+		static Position PackPosition(const Vertex& Input, const MeshDecodeData& Decode) {
+			Position output = {};
+			for (int axis = 0; axis < 3; axis++) {
+				float scale = Decode.scale[axis];
+				output.position[axis] = scale > 0.0f ? PackUnorm16((Input.position[axis] - Decode.offset[axis]) / scale) : 0;
+			}
+			return output;
+		}
+
+		static Attributes PackAttributes(const Vertex& Input) {
+			glm::vec2 normal = OctEncode(Input.normal);
+			return { { PackSnorm16(normal.x), PackSnorm16(normal.y) } };
+		}
+
+		static Vertex Unpack(const Position& InputPosition, const Attributes& InputAttributes, const MeshDecodeData& Decode) {
+			glm::vec3 packed = glm::vec3(InputPosition.position[0], InputPosition.position[1], InputPosition.position[2]) / 65535.0f;
+			glm::vec2 normal = glm::max(glm::vec2(InputAttributes.normal[0], InputAttributes.normal[1]) / 32767.0f, glm::vec2(-1.0f));
+			return { Decode.offset + packed * Decode.scale, OctDecode(normal) };
+		}
+	};
+
+	static_assert(sizeof(CompactPosition) + sizeof(CompactAttributes) == 12);
+
+	// Calls Function with a default constructed Format struct of the runtime format
+	template <class Function>
+	decltype(auto) WithVertexFormat(VERTEXFORMAT Format, Function&& Body) {
+		switch (Format) {
+		case VERTEX_COMPACT: return Body(CompactVertexFormat{});
+		default: return Body(FloatVertexFormat{});
+		}
+	}
+
+	template <class Format>
+	size_t GetStreamStride(VERTEXSTREAM Stream) {
+		return Stream == VERTEX_STREAM_POSITION ? sizeof(typename Format::Position) : sizeof(typename Format::Attributes);
+	}
+
+	// Binding i is stream i
+	template <class Format>
+	std::array<VkVertexInputBindingDescription, VERTEX_STREAM_COUNT> GetBindingDescriptions() {
+		std::array<VkVertexInputBindingDescription, VERTEX_STREAM_COUNT> binding_descriptions = {};
+		for (uint32_t stream = 0; stream < VERTEX_STREAM_COUNT; stream++) {
+			binding_descriptions[stream].binding = stream;
+			binding_descriptions[stream].stride = static_cast<uint32_t>(GetStreamStride<Format>(static_cast<VERTEXSTREAM>(stream)));
+			binding_descriptions[stream].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+		}
+		return binding_descriptions;
+	}
+
+	template <class Format>
+	std::array<VkVertexInputAttributeDescription, Format::fields.size()> GetAttributeDescriptions() {
+		std::array<VkVertexInputAttributeDescription, Format::fields.size()> attribute_descriptions = {};
+		for (size_t i = 0; i < Format::fields.size(); i++) {
+			attribute_descriptions[i].binding = Format::fields[i].stream;
+			attribute_descriptions[i].location = Format::fields[i].location;
+			attribute_descriptions[i].format = Format::fields[i].format;
+			attribute_descriptions[i].offset = Format::fields[i].offset;
+		}
+		return attribute_descriptions;
+	}
+
+	// Writes one stream of Input, Output holds Input.size() of that stream's struct
+	template <class Format>
+	void PackVertices(VERTEXSTREAM Stream, std::span<const Vertex> Input, const MeshDecodeData& Decode, void* Output) {
+		if (Stream == VERTEX_STREAM_POSITION) {
+			typename Format::Position* output = static_cast<typename Format::Position*>(Output);
+			for (const Vertex& vertex : Input) {
+				*output++ = Format::PackPosition(vertex, Decode);
+			}
+		}
+		else {
+			typename Format::Attributes* output = static_cast<typename Format::Attributes*>(Output);
+			for (const Vertex& vertex : Input) {
+				*output++ = Format::PackAttributes(vertex);
+			}
+		}
+	}
+
+	template <class Format>
+	void UnpackVertices(const void* Positions, const void* Attributes, size_t Count, const MeshDecodeData& Decode, Vertex* Output) {
+		const typename Format::Position* positions = static_cast<const typename Format::Position*>(Positions);
+		const typename Format::Attributes* attributes = static_cast<const typename Format::Attributes*>(Attributes);
+		for (size_t i = 0; i < Count; i++) {
+			Output[i] = Format::Unpack(positions[i], attributes[i], Decode);
+		}
+	}
+
+	// Runtime versions of the above for the format a scene picked
+
+	struct VertexInputDescription {
+		std::vector<VkVertexInputBindingDescription> bindings;
+		std::vector<VkVertexInputAttributeDescription> attributes;
+	};
+
+	// PositionOnly leaves out the attribute stream and its fields, for pipelines that only need depth
+	inline VertexInputDescription GetVertexInputDescription(VERTEXFORMAT Format, bool PositionOnly = false) {
+		return WithVertexFormat(Format, [&]<class F>(F) {
+			VertexInputDescription description;
+			for (const VkVertexInputBindingDescription& binding : GetBindingDescriptions<F>()) {
+				if (!PositionOnly || binding.binding == VERTEX_STREAM_POSITION) {
+					description.bindings.push_back(binding);
+				}
+			}
+			for (const VkVertexInputAttributeDescription& attribute : GetAttributeDescriptions<F>()) {
+				if (!PositionOnly || attribute.binding == VERTEX_STREAM_POSITION) {
+					description.attributes.push_back(attribute);
+				}
+			}
+			return description;
+		});
+	}
+
+	inline size_t GetStreamStride(VERTEXFORMAT Format, VERTEXSTREAM Stream) {
+		return WithVertexFormat(Format, [&]<class F>(F) { return GetStreamStride<F>(Stream); });
+	}
+
+	// Every stream together, the bytes one vertex takes on the GPU
+	inline size_t GetVertexStride(VERTEXFORMAT Format) {
+		return WithVertexFormat(Format, []<class F>(F) { return sizeof(typename F::Position) + sizeof(typename F::Attributes); });
+	}
+
+	inline const char* GetVertexFormatName(VERTEXFORMAT Format) {
+		return WithVertexFormat(Format, []<class F>(F) { return F::name; });
+	}
+
+	inline void PackVertices(VERTEXFORMAT Format, VERTEXSTREAM Stream, std::span<const Vertex> Input, const MeshDecodeData& Decode, void* Output) {
+		WithVertexFormat(Format, [&]<class F>(F) { PackVertices<F>(Stream, Input, Decode, Output); });
+	}
+
+	inline void UnpackVertices(VERTEXFORMAT Format, const void* Positions, const void* Attributes, size_t Count, const MeshDecodeData& Decode, Vertex* Output) {
+		WithVertexFormat(Format, [&]<class F>(F) { UnpackVertices<F>(Positions, Attributes, Count, Decode, Output); });
+	}
+}
\ No newline at end of file
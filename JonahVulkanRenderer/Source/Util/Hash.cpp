@@ -0,0 +1,67 @@
+#include "Hash.h"
+#include "JobSystem.h"
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+	constexpr uint64_t BlockSize = 1 << 20;
+}
+
+namespace util {
+
+	uint64_t Hash64(std::span<const std::uint8_t> Bytes, uint64_t Seed) {
+		const uint64_t m = 0xc6a4a7935bd1e995ull;
+		const int r = 47;
+
+		uint64_t h = Seed ^ (Bytes.size() * m);
+
+		const std::uint8_t* data = Bytes.data();
+		const size_t word_count = Bytes.size() / 8;
+
+		for (size_t i = 0; i < word_count; i++) {
+			uint64_t k;
+			std::memcpy(&k, data + i * 8, 8);
+
+			k *= m;
+			k ^= k >> r;
+			k *= m;
+
+			h ^= k;
+			h *= m;
+		}
+
+		const std::uint8_t* tail = data + word_count * 8;
+		switch (Bytes.size() & 7) {
+		case 7: h ^= uint64_t(tail[6]) << 48; [[fallthrough]];
+		case 6: h ^= uint64_t(tail[5]) << 40; [[fallthrough]];
+		case 5: h ^= uint64_t(tail[4]) << 32; [[fallthrough]];
+		case 4: h ^= uint64_t(tail[3]) << 24; [[fallthrough]];
+		case 3: h ^= uint64_t(tail[2]) << 16; [[fallthrough]];
+		case 2: h ^= uint64_t(tail[1]) << 8; [[fallthrough]];
+		case 1: h ^= uint64_t(tail[0]);
+			h *= m;
+		}
+
+		h ^= h >> r;
+		h *= m;
+		h ^= h >> r;
+
+		return h;
+	}
+
+	uint64_t HashParallel(std::span<const std::uint8_t> Bytes) {
+		uint32_t block_count = static_cast<uint32_t>((Bytes.size() + BlockSize - 1) / BlockSize);
+		std::vector<uint64_t> block_hashes(block_count);
+
+		GetJobSystem().ParallelFor(block_count, [&](uint32_t i) {
+			uint64_t start = uint64_t(i) * BlockSize;
+			block_hashes[i] = Hash64(Bytes.subspan(start, std::min<uint64_t>(BlockSize, Bytes.size() - start)), i);
+		});
+
+		std::span<const std::uint8_t> hash_bytes(reinterpret_cast<const std::uint8_t*>(block_hashes.data()), block_hashes.size() * sizeof(uint64_t));
+		return Hash64(hash_bytes, Bytes.size());
+	}
+
+} // namespace util
\ No newline at end of file
@@ -0,0 +1,14 @@
+#pragma once
+#include <cstdint>
+#include <span>
+
+namespace util {
+
+	// MurmurHash64A. Fast and well mixed, not cryptographic: only meant for spotting changed content.
+	uint64_t Hash64(std::span<const std::uint8_t> Bytes, uint64_t Seed = 0);
+
+	// Hashes 1 MB blocks in parallel on the job system, then hashes the block hashes.
+	// Gives a different value than Hash64 for the same bytes, so do not mix the two for one key.
+	uint64_t HashParallel(std::span<const std::uint8_t> Bytes);
+
+} // namespace util
\ No newline at end of file
@@ -0,0 +1,356 @@
+#include "JobSystem.h"
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <numeric>
+#include <queue>
+#include <string>
+
+namespace {
+
+	thread_local uint32_t current_worker_index = UINT32_MAX;
+
+	double SecondsSince(std::chrono::steady_clock::time_point Start) {
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - Start).count();
+	}
+}
+
+namespace util {
+
+	struct JobSystem::Batch {
+		const std::function<void(uint32_t)>* job;
+		std::span<const uint64_t> costs;
+
+		std::atomic<uint32_t> remaining;
+		std::mutex done_lock;
+		std::condition_variable done_signal;
+
+		std::mutex error_lock;
+		std::exception_ptr error;
+
+		struct AtomicStats {
+			std::atomic<uint64_t> jobs_run = 0;
+			std::atomic<uint64_t> jobs_stolen = 0;
+			std::atomic<uint64_t> cost_run = 0;
+			std::atomic<uint64_t> busy_nanoseconds = 0;
+		};
+		std::unique_ptr<AtomicStats[]> stats;
+	};
+
+	double BatchStats::Utilisation(size_t Worker) const {
+		if (wall_seconds <= 0 || Worker >= workers.size()) return 0;
+		return workers[Worker].busy_seconds / wall_seconds;
+	}
+
+	void BatchStats::Print() const {
+		std::streamsize precision = std::cout.precision();
+		std::cout << "Job batch finished in " << wall_seconds * 1000.0 << "ms" << std::endl;
+
+		for (size_t i = 0; i < workers.size(); i++) {
+			const WorkerStats& w = workers[i];
+			bool is_caller = i + 1 == workers.size();
+
+			if (is_caller && w.jobs_run == 0) break;
+
+			std::string name = is_caller ? "caller" : "worker " + std::to_string(i);
+			std::cout << "  " << std::left << std::setw(10) << name << std::right << std::setw(8) << w.jobs_run << " jobs (" << w.jobs_stolen << " stolen), ";
+			std::cout << w.cost_run << " cost, " << std::fixed << std::setprecision(1) << Utilisation(i) * 100.0 << "% busy" << std::endl;
+		}
+
+		std::cout << std::defaultfloat << std::setprecision(precision);
+	}
+
+	JobSystem::JobSystem(uint32_t WorkerCount) {
+
+		if (WorkerCount == 0) {
+			WorkerCount = std::max(1u, std::thread::hardware_concurrency());
+		}
+
+		queues.reserve(WorkerCount);
+		for (uint32_t i = 0; i < WorkerCount; i++) {
+			queues.push_back(std::make_unique<WorkerQueue>());
+		}
+
+		workers.reserve(WorkerCount);
+		for (uint32_t i = 0; i < WorkerCount; i++) {
+			workers.emplace_back(&JobSystem::WorkerLoop, this, i);
+		}
+	}
+
+	JobSystem::~JobSystem() {
+		{
+			std::lock_guard<std::mutex> guard(sleep_lock);
+			stopping = true;
+		}
+		sleep_signal.notify_all();
+
+		for (std::thread& t : workers) {
+			if (t.joinable()) {
+				t.join();
+			}
+		}
+	}
+
+	uint32_t JobSystem::GetWorkerCount() const {
+		return static_cast<uint32_t>(workers.size());
+	}
+
+	BatchStats JobSystem::ParallelFor(uint32_t Count, const std::function<void(uint32_t)>& Job, std::span<const uint64_t> Costs) {
+
+		BatchStats result;
+		result.workers.resize(workers.size() + 1);
+
+		if (Count == 0) return result;
+
+		auto start = std::chrono::steady_clock::now();
+
+		Batch batch;
+		batch.job = &Job;
+		batch.costs = Costs.size() == Count ? Costs : std::span<const uint64_t>{};
+		batch.remaining = Count;
+		batch.stats = std::make_unique<Batch::AtomicStats[]>(workers.size() + 1);
+
+		// Deal jobs out largest first, each to the queue with the least total cost so far
+		uint32_t queue_count = static_cast<uint32_t>(queues.size());
+		std::vector<std::vector<Item>> assignment(queue_count);
+
+		if (batch.costs.empty()) {
+			uint32_t chunk_size = (Count + queue_count - 1) / queue_count;
+			for (uint32_t i = 0; i < Count; i++) {
+				assignment[i / chunk_size].push_back({ &batch, i });
+			}
+		}
+		else {
+			std::vector<uint32_t> order(Count);
+			std::iota(order.begin(), order.end(), 0);
+			std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return batch.costs[a] > batch.costs[b]; });
+
+			using Load = std::pair<uint64_t, uint32_t>;
+			std::priority_queue<Load, std::vector<Load>, std::greater<Load>> loads;
+			for (uint32_t q = 0; q < queue_count; q++) {
+				loads.push({ 0, q });
+			}
+
+			for (uint32_t i : order) {
+				Load lightest = loads.top();
+				loads.pop();
+				assignment[lightest.second].push_back({ &batch, i });
+				loads.push({ lightest.first + std::max<uint64_t>(batch.costs[i], 1), lightest.second });
+			}
+		}
+
+		// Count goes up before the items are visible so a fast worker can never take it below zero
+		{
+			std::lock_guard<std::mutex> guard(sleep_lock);
+			queued_items += Count;
+		}
+
+		for (uint32_t q = 0; q < queue_count; q++) {
+			if (assignment[q].empty()) continue;
+
+			std::lock_guard<std::mutex> guard(queues[q]->lock);
+			queues[q]->items.insert(queues[q]->items.end(), assignment[q].begin(), assignment[q].end());
+		}
+		sleep_signal.notify_all();
+
+		// Help out until our batch is done. Only our own items are taken, another batch's job may block on something we
+		// know nothing about (the MP parsers run loops that wait for reads to land).
+		uint32_t caller_index = current_worker_index;
+		while (true) {
+			if (TryRunFromBatch(caller_index, batch)) continue;
+
+			// Jobs finish under done_lock, so once remaining reads zero here no worker touches the batch again
+			std::unique_lock<std::mutex> guard(batch.done_lock);
+			if (batch.done_signal.wait_for(guard, std::chrono::milliseconds(1), [&] { return batch.remaining.load() == 0; })) {
+				break;
+			}
+		}
+
+		result.wall_seconds = SecondsSince(start);
+		for (size_t i = 0; i < result.workers.size(); i++) {
+			result.workers[i].jobs_run = batch.stats[i].jobs_run;
+			result.workers[i].jobs_stolen = batch.stats[i].jobs_stolen;
+			result.workers[i].cost_run = batch.stats[i].cost_run;
+			result.workers[i].busy_seconds = static_cast<double>(batch.stats[i].busy_nanoseconds) / 1e9;
+		}
+
+		if (batch.error) {
+			std::rethrow_exception(batch.error);
+		}
+
+		return result;
+	}
+
+	void JobSystem::Submit(std::function<void()> Job) {
+		{
+			std::lock_guard<std::mutex> guard(sleep_lock);
+			queued_items++;
+		}
+
+		{
+			std::lock_guard<std::mutex> guard(submitted_lock);
+			submitted.push_back(std::move(Job));
+		}
+		sleep_signal.notify_one();
+	}
+
+	void JobSystem::WorkerLoop(uint32_t WorkerIndex) {
+		current_worker_index = WorkerIndex;
+
+		while (true) {
+			if (TryRunOne(WorkerIndex)) continue;
+			if (TryRunSubmitted()) continue;
+
+			std::unique_lock<std::mutex> guard(sleep_lock);
+			sleep_signal.wait(guard, [&] { return stopping || queued_items.load() > 0; });
+
+			if (stopping) return;
+		}
+	}
+
+	bool JobSystem::TryRunOne(uint32_t WorkerIndex) {
+		Item work;
+		uint32_t stats_index = WorkerIndex < queues.size() ? WorkerIndex : static_cast<uint32_t>(queues.size());
+
+		if (WorkerIndex < queues.size() && PopOwn(WorkerIndex, work)) {
+			RunItem(work, stats_index, false);
+			return true;
+		}
+
+		if (Steal(WorkerIndex, work)) {
+			RunItem(work, stats_index, true);
+			return true;
+		}
+
+		return false;
+	}
+
+	bool JobSystem::TryRunFromBatch(uint32_t WorkerIndex, Batch& Own) {
+		uint32_t queue_count = static_cast<uint32_t>(queues.size());
+		uint32_t stats_index = WorkerIndex < queue_count ? WorkerIndex : queue_count;
+		uint32_t start = WorkerIndex < queue_count ? WorkerIndex : 0;
+		auto is_own = [&](const Item& Work) { return Work.batch == &Own; };
+
+		// Front of our own queue first, then the back of everyone else's, same as PopOwn and Steal
+		for (uint32_t n = 0; n < queue_count; n++) {
+			uint32_t victim = (start + n) % queue_count;
+			bool stolen = victim != WorkerIndex;
+			Item work;
+
+			{
+				WorkerQueue& queue = *queues[victim];
+				std::lock_guard<std::mutex> guard(queue.lock);
+
+				if (!stolen) {
+					auto found = std::find_if(queue.items.begin(), queue.items.end(), is_own);
+					if (found == queue.items.end()) continue;
+
+					work = *found;
+					queue.items.erase(found);
+				}
+				else {
+					auto found = std::find_if(queue.items.rbegin(), queue.items.rend(), is_own);
+					if (found == queue.items.rend()) continue;
+
+					work = *found;
+					queue.items.erase(std::next(found).base());
+				}
+				queued_items--;
+			}
+
+			RunItem(work, stats_index, stolen);
+			return true;
+		}
+
+		return false;
+	}
+
+	bool JobSystem::TryRunSubmitted() {
+		std::function<void()> job;
+		{
+			std::lock_guard<std::mutex> guard(submitted_lock);
+			if (submitted.empty()) return false;
+
+			job = std::move(submitted.front());
+			submitted.pop_front();
+			queued_items--;
+		}
+
+		try {
+			job();
+		}
+		catch (...) {
+			std::terminate();
+		}
+		return true;
+	}
+
+	bool JobSystem::PopOwn(uint32_t WorkerIndex, Item& Output) {
+		WorkerQueue& queue = *queues[WorkerIndex];
+		std::lock_guard<std::mutex> guard(queue.lock);
+
+		if (queue.items.empty()) return false;
+
+		Output = queue.items.front();
+		queue.items.pop_front();
+		queued_items--;
+		return true;
+	}
+
+	bool JobSystem::Steal(uint32_t WorkerIndex, Item& Output) {
+		uint32_t queue_count = static_cast<uint32_t>(queues.size());
+		uint32_t start = WorkerIndex < queue_count ? WorkerIndex + 1 : 0;
+
+		for (uint32_t n = 0; n < queue_count; n++) {
+			uint32_t victim = (start + n) % queue_count;
+			if (victim == WorkerIndex) continue;
+
+			WorkerQueue& queue = *queues[victim];
+			std::lock_guard<std::mutex> guard(queue.lock);
+
+			if (queue.items.empty()) continue;
+
+			Output = queue.items.back();
+			queue.items.pop_back();
+			queued_items--;
+			return true;
+		}
+
+		return false;
+	}
+
+	void JobSystem::RunItem(const Item& Work, uint32_t StatsIndex, bool Stolen) {
+		Batch& batch = *Work.batch;
+		auto start = std::chrono::steady_clock::now();
+
+		try {
+			(*batch.job)(Work.index);
+		}
+		catch (...) {
+			std::lock_guard<std::mutex> guard(batch.error_lock);
+			if (!batch.error) batch.error = std::current_exception();
+		}
+
+		auto busy = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+
+		Batch::AtomicStats& stats = batch.stats[StatsIndex];
+		stats.jobs_run++;
+		stats.jobs_stolen += Stolen ? 1 : 0;
+		stats.cost_run += batch.costs.empty() ? 1 : batch.costs[Work.index];
+		stats.busy_nanoseconds += static_cast<uint64_t>(busy);
+
+		std::lock_guard<std::mutex> guard(batch.done_lock);
+		if (batch.remaining.fetch_sub(1) == 1) {
+			batch.done_signal.notify_all();
+		}
+	}
+
+	JobSystem& GetJobSystem() {
+		static JobSystem job_system;
+		return job_system;
+	}
+
+} // namespace util
\ No newline at end of file
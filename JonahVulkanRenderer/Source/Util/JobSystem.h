@@ -0,0 +1,93 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <vector>
+
+namespace util {
+
+	struct WorkerStats {
+		uint64_t jobs_run = 0;
+		uint64_t jobs_stolen = 0;
+		uint64_t cost_run = 0;
+		double busy_seconds = 0;
+	};
+
+	// Per-worker numbers for one ParallelFor call. The last entry is shared by non-pool threads (the caller) that helped.
+	struct BatchStats {
+		double wall_seconds = 0;
+		std::vector<WorkerStats> workers;
+
+		// busy_seconds / wall_seconds for the given worker.
+		double Utilisation(size_t Worker) const;
+		void Print() const;
+	};
+
+	// Persistent pool of worker threads, each with its own job queue. Idle workers steal from the back of other
+	// queues so one large job does not leave the rest of the pool waiting.
+	class JobSystem {
+
+	public:
+		// WorkerCount 0 uses std::thread::hardware_concurrency().
+		explicit JobSystem(uint32_t WorkerCount = 0);
+		~JobSystem();
+
+		JobSystem(const JobSystem&) = delete;
+		JobSystem& operator=(const JobSystem&) = delete;
+
+		uint32_t GetWorkerCount() const;
+
+		// Runs Job(i) for every i in [0, Count) and blocks until all have finished. The calling thread helps out, but only
+		// with this batch, so a job that blocks for a long time can never end up stalling an unrelated caller.
+		// Costs (optional, one per job) drive the initial split: jobs are dealt largest first to the least loaded queue.
+		// The first exception thrown by a job is rethrown here once the batch has drained.
+		BatchStats ParallelFor(uint32_t Count, const std::function<void(uint32_t)>& Job, std::span<const uint64_t> Costs = {});
+
+		// Runs Job once on a pool worker and returns straight away. Workers only take these when they have no ParallelFor
+		// work, and ParallelFor callers never help with them, so a long job can not hold up someone else's batch.
+		// Job must handle its own errors, an exception escaping it terminates.
+		void Submit(std::function<void()> Job);
+
+	private:
+		struct Batch;
+
+		struct Item {
+			Batch* batch;
+			uint32_t index;
+		};
+
+		struct WorkerQueue {
+			std::mutex lock;
+			std::deque<Item> items;
+		};
+
+		void WorkerLoop(uint32_t WorkerIndex);
+		bool TryRunOne(uint32_t WorkerIndex);
+		bool TryRunFromBatch(uint32_t WorkerIndex, Batch& Own);
+		bool TryRunSubmitted();
+		bool PopOwn(uint32_t WorkerIndex, Item& Output);
+		bool Steal(uint32_t WorkerIndex, Item& Output);
+		void RunItem(const Item& Work, uint32_t StatsIndex, bool Stolen);
+
+		std::vector<std::thread> workers;
+		std::vector<std::unique_ptr<WorkerQueue>> queues;
+
+		std::mutex submitted_lock;
+		std::deque<std::function<void()>> submitted;
+
+		std::mutex sleep_lock;
+		std::condition_variable sleep_signal;
+		std::atomic<uint64_t> queued_items = 0;
+		bool stopping = false;
+	};
+
+	// Process wide pool shared by the CPU stages (MP parsing, scene building, culling).
+	JobSystem& GetJobSystem();
+
+} // namespace util
\ No newline at end of file
@@ -0,0 +1,84 @@
+#include "MemoryStats.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <fstream>
+#include <string>
+#include <sys/resource.h>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+#endif
+
+namespace util {
+
+#ifdef _WIN32
+
+	uint64_t GetCurrentResidentBytes() {
+		PROCESS_MEMORY_COUNTERS counters{};
+		if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+		return counters.WorkingSetSize;
+	}
+
+	uint64_t GetPeakResidentBytes() {
+		PROCESS_MEMORY_COUNTERS counters{};
+		if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+		return counters.PeakWorkingSetSize;
+	}
+
+	bool ResetPeakResidentBytes() {
+		return false;
+	}
+
+#else
+
+	namespace {
+
+		// Reads a "Key:   1234 kB" line from /proc/self/status.
+		uint64_t ReadStatusKilobytes(const char* Key) {
+			std::ifstream status("/proc/self/status");
+			std::string line;
+			std::string key = std::string(Key) + ":";
+
+			while (std::getline(status, line)) {
+				if (line.compare(0, key.size(), key) == 0) {
+					return std::stoull(line.substr(key.size())) * 1024;
+				}
+			}
+			return 0;
+		}
+	}
+
+	uint64_t GetCurrentResidentBytes() {
+		return ReadStatusKilobytes("VmRSS");
+	}
+
+	uint64_t GetPeakResidentBytes() {
+		uint64_t peak = ReadStatusKilobytes("VmHWM");
+		if (peak != 0) return peak;
+
+		rusage usage{};
+		getrusage(RUSAGE_SELF, &usage);
+		return static_cast<uint64_t>(usage.ru_maxrss) * 1024;
+	}
+
+	bool ResetPeakResidentBytes() {
+#ifdef __GLIBC__
+		// Hand freed heap pages back to the OS first, otherwise the next measurement reuses them and reports no growth.
+		malloc_trim(0);
+#endif
+		// Writing 5 to clear_refs resets VmHWM to the current RSS (Linux 4.0+).
+		std::ofstream clear_refs("/proc/self/clear_refs");
+		if (!clear_refs) return false;
+		clear_refs << "5";
+		return static_cast<bool>(clear_refs.flush());
+	}
+
+#endif
+
+} // namespace util
\ No newline at end of file
@@ -0,0 +1,19 @@
+#pragma once
+#include <cstdint>
+
+namespace util {
+
+	// Resident set size (working set on Windows) of the current process in bytes.
+	uint64_t GetCurrentResidentBytes();
+
+	// Highest resident set size seen so far in bytes.
+	uint64_t GetPeakResidentBytes();
+
+	// Resets the peak counter to the current resident size. Only supported on Linux, returns false elsewhere.
+	bool ResetPeakResidentBytes();
+
+	inline double BytesToMegabytes(uint64_t Bytes) {
+		return static_cast<double>(Bytes) / (1024.0 * 1024.0);
+	}
+
+} // namespace util
\ No newline at end of file
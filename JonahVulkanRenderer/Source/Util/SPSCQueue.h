@@ -0,0 +1,70 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <optional>
+#include <vector>
+
+namespace util {
+
+	// Bounded ring buffer for exactly one producer thread and one consumer thread. Neither side ever takes a lock,
+	// so the render thread can poll it every frame without stalling behind the producer.
+	template <class T>
+	class SPSCQueue {
+
+	public:
+		// Capacity is rounded up to a power of two.
+		explicit SPSCQueue(size_t Capacity) {
+			size_t size = 1;
+			while (size < Capacity) {
+				size *= 2;
+			}
+
+			slots.resize(size);
+			mask = size - 1;
+		}
+
+		SPSCQueue(const SPSCQueue&) = delete;
+		SPSCQueue& operator=(const SPSCQueue&) = delete;
+
+		// Producer only. False (Value untouched) when full.
+		bool TryPush(T&& Value) {
+			const size_t write = tail.load(std::memory_order_relaxed);
+
+			if (write - head.load(std::memory_order_acquire) == slots.size()) {
+				return false;
+			}
+
+			slots[write & mask] = std::move(Value);
+			tail.store(write + 1, std::memory_order_release);
+			return true;
+		}
+
+		// Consumer only. Empty when nothing is waiting.
+		std::optional<T> TryPop() {
+			const size_t read = head.load(std::memory_order_relaxed);
+
+			if (read == tail.load(std::memory_order_acquire)) {
+				return std::nullopt;
+			}
+
+			std::optional<T> value = std::move(slots[read & mask]);
+			slots[read & mask] = T();
+			head.store(read + 1, std::memory_order_release);
+			return value;
+		}
+
+		// Only exact when called from the consumer.
+		bool Empty() const {
+			return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+		}
+
+	private:
+		std::vector<T> slots;
+		size_t mask = 0;
+
+		// Each index is written by one side only, kept on separate cache lines so the two threads do not fight over one
+		alignas(64) std::atomic<size_t> head = 0; // Next slot to pop
+		alignas(64) std::atomic<size_t> tail = 0; // Next slot to push
+	};
+
+} // namespace util
\ No newline at end of file
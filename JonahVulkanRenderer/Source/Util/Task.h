@@ -0,0 +1,143 @@
+#pragma once
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <semaphore>
+#include <utility>
+#include "JobSystem.h"
+
+namespace util {
+
+	// Lazy coroutine result. Nothing runs until the task is awaited, started or waited on. Await it from another coroutine,
+	// or Start() it and Get() the result from plain code. Do not do both with one task.
+	template <class T>
+	class Task {
+
+	public:
+		struct promise_type {
+			std::optional<T> value;
+			std::exception_ptr error;
+			std::coroutine_handle<> continuation;
+			std::binary_semaphore done{ 0 };
+
+			Task get_return_object() {
+				return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+			}
+
+			std::suspend_always initial_suspend() noexcept {
+				return {};
+			}
+
+			// Hands over to whoever awaited the task, or wakes Get()
+			auto final_suspend() noexcept {
+				struct FinalAwaiter {
+					bool await_ready() noexcept { return false; }
+
+					std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> Handle) noexcept {
+						promise_type& promise = Handle.promise();
+						if (promise.continuation) {
+							return promise.continuation;
+						}
+
+						promise.done.release();
+						return std::noop_coroutine();
+					}
+
+					void await_resume() noexcept {}
+				};
+				return FinalAwaiter{};
+			}
+
+			void return_value(T Value) {
+				value.emplace(std::move(Value));
+			}
+
+			void unhandled_exception() {
+				error = std::current_exception();
+			}
+
+			T TakeResult() {
+				if (error) {
+					std::rethrow_exception(error);
+				}
+				return std::move(*value);
+			}
+		};
+
+		Task(Task&& Other) noexcept : handle(std::exchange(Other.handle, nullptr)) {}
+
+		Task& operator=(Task&& Other) noexcept {
+			if (this != &Other) {
+				if (handle) handle.destroy();
+				handle = std::exchange(Other.handle, nullptr);
+			}
+			return *this;
+		}
+
+		Task(const Task&) = delete;
+		Task& operator=(const Task&) = delete;
+
+		// Get() must have returned before a started task goes away.
+		~Task() {
+			if (handle) handle.destroy();
+		}
+
+		// Runs the coroutine on this thread up to its first suspension, which for pool coroutines is straight away.
+		void Start() {
+			if (!started) {
+				started = true;
+				handle.resume();
+			}
+		}
+
+		// Blocks until the result is ready, starting the task if needed. Rethrows what the coroutine threw.
+		T Get() {
+			Start();
+			handle.promise().done.acquire();
+			return handle.promise().TakeResult();
+		}
+
+		auto operator co_await() && noexcept {
+			struct Awaiter {
+				std::coroutine_handle<promise_type> handle;
+
+				bool await_ready() noexcept { return false; }
+
+				// Symmetric transfer, the awaiting coroutine resumes when this one finishes
+				std::coroutine_handle<> await_suspend(std::coroutine_handle<> Awaiting) noexcept {
+					handle.promise().continuation = Awaiting;
+					return handle;
+				}
+
+				T await_resume() {
+					return handle.promise().TakeResult();
+				}
+			};
+			started = true;
+			return Awaiter{ handle };
+		}
+
+	private:
+		explicit Task(std::coroutine_handle<promise_type> Handle) : handle(Handle) {}
+
+		std::coroutine_handle<promise_type> handle;
+		bool started = false;
+	};
+
+	// co_await ResumeOnJobSystem() continues the coroutine on a worker of the shared pool.
+	inline auto ResumeOnJobSystem(JobSystem& Pool = GetJobSystem()) {
+		struct Awaiter {
+			JobSystem& pool;
+
+			bool await_ready() noexcept { return false; }
+
+			void await_suspend(std::coroutine_handle<> Handle) {
+				pool.Submit([Handle] { Handle.resume(); });
+			}
+
+			void await_resume() noexcept {}
+		};
+		return Awaiter{ Pool };
+	}
+
+} // namespace util
\ No newline at end of file
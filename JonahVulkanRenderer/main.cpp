@@ -1,9 +1,57 @@
 #include "Source/Renderer/Renderer.h"
 #include "Source/Game/Application.h"
+#include "Source/MP Loader/MP_Tool.h"
+#include <optional>
+#include <string>
 
-int main() {
+int main(int argc, char** argv) {
 
-	game::Application* app = new game::Application();
+	// --scene <file.mp | -> opens the renderer on that scene, - reads it from stdin (e.g. piped from ParseUSD.py)
+	// --progressive <file.mp> [x y z] starts drawing straight away and streams the scene in nearest to x y z first
+	// --library <library.mp> <file.mp> opens a scene written against a geometry library (the share tool)
+	// --watch <file.mp> [library.mp] reloads the scene every time the file is saved, uploading only what changed
+	// --compact in front of any of the above packs vertices to 12 instead of 24 bytes on the GPU
+	std::string scene_path;
+	std::string library_path;
+	bool progressive = false;
+	bool watch = false;
+	std::optional<glm::vec3> focus;
+	renderer::VERTEXFORMAT vertex_format = renderer::VERTEX_FLOAT;
+
+	if (argc > 1 && std::string(argv[1]) == "--compact") {
+		vertex_format = renderer::VERTEX_COMPACT;
+		argv[1] = argv[0];
+		argv++;
+		argc--;
+	}
+
+	if (argc == 3 && std::string(argv[1]) == "--scene") {
+		scene_path = argv[2];
+	}
+	else if (argc == 4 && std::string(argv[1]) == "--library") {
+		library_path = argv[2];
+		scene_path = argv[3];
+	}
+	else if ((argc == 3 || argc == 4) && std::string(argv[1]) == "--watch") {
+		scene_path = argv[2];
+		watch = true;
+		if (argc == 4) {
+			library_path = argv[3];
+		}
+	}
+	else if ((argc == 3 || argc == 6) && std::string(argv[1]) == "--progressive") {
+		scene_path = argv[2];
+		progressive = true;
+		if (argc == 6) {
+			focus = glm::vec3(std::stof(argv[3]), std::stof(argv[4]), std::stof(argv[5]));
+		}
+	}
+	else if (argc > 1) {
+		// Any other arguments run the MP tools instead of the renderer
+		return MP::RunToolCommand(argc, argv);
+	}
+
+	game::Application* app = new game::Application(scene_path, progressive, focus, library_path, watch, vertex_format);
 	GLFWwindow* window = app->Get_Window();
 
 	// Main Application Loop